@@ -93,6 +93,16 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define CNTXT_HASH_TABLE_DEPTH	    79
 
+// Timeouts of hashed entries are kept on a hierarchical timer wheel so that
+// cs_cntxt_age only visits entries which have expired.  A tick is
+// 1<<CNTXT_WHEEL_TICK_SHIFT usec (~1ms), each level has CNTXT_WHEEL_SLOTS
+// slots covering CNTXT_WHEEL_SLOTS times the span of the level below.
+// Four levels cover ~4.8 hours, longer timeouts wait on the last slot.
+#define CNTXT_WHEEL_TICK_SHIFT		10
+#define CNTXT_WHEEL_BITS			6
+#define CNTXT_WHEEL_SLOTS			(1 << CNTXT_WHEEL_BITS)
+#define CNTXT_WHEEL_LEVELS			4
+
 struct _cntxt_entry;
 
 // response mad is supplied to callback only if Status is VSTATUS_OK
@@ -120,6 +130,9 @@ typedef struct _cntxt_entry {
 	void *          callback_data; // caller-specific data passed to callback
 	struct _cntxt_entry *next;	// Link List next pointer
 	struct _cntxt_entry *prev;	// Link List prev pointer
+	uint64_t		expire;		// time entry is due to be aged out
+	struct _cntxt_entry *timerNext;		// timer wheel slot list
+	struct _cntxt_entry **timerPprev;	// NULL if not on timer wheel
 } cntxt_entry_t;
 
 typedef struct _generic_cntxt_ {
@@ -157,6 +170,11 @@ typedef struct _generic_cntxt_ {
     Sema_t		    freeContextWaitSema;
  	cntxt_entry_t   *free_list;
     cntxt_entry_t 	*hash[CNTXT_HASH_TABLE_DEPTH];
+	uint64_t		wheelTick;			// next timer wheel tick to be aged
+	int				numTimers;			// entries on the timer wheel
+	uint64_t		wheelSlotMask[CNTXT_WHEEL_LEVELS];	// slots which may
+										// be non-empty
+	cntxt_entry_t	*wheel[CNTXT_WHEEL_LEVELS][CNTXT_WHEEL_SLOTS];
     cntxt_entry_t 	*pool;      // array of context entries 'poolSize' deep
     Pool_t          *globalPool;    // pool to allocate data from if needed for queued messages
 } generic_cntxt_t;
@@ -965,6 +965,14 @@ typedef struct _SMXmlConfig {
     uint32_t    node_appearance_msg_thresh;
     uint32_t    spine_first_routing;
     uint32_t    shortestPathBalanced;
+    uint32_t    incremental_cost_matrix_threshold;
+    uint32_t    lft_threads;
+    uint32_t    lft_carry_over;
+    uint32_t    mft_incremental;
+    uint32_t    sa_worker_threads;
+    uint32_t    sa_path_index_entries;
+    uint32_t    sa_path_wildcard_cache_mb;
+    uint32_t    sa_cache_max_mb;
     uint32_t    lmc;
     uint32_t    lmc_e0;
 	char		routing_algorithm[STRING_SIZE];
@@ -973,6 +981,7 @@ typedef struct _SMXmlConfig {
 	uint32_t	enforceVFPathRecs;	// Default to Enable to limit pathrecord scope to VFs
 									// otherwise, use PKEY as scope limit.
 	uint32_t	sma_batch_size;
+	uint32_t	sma_batch_size_max;
 	uint32_t	max_parallel_reqs;
  	uint32_t	check_mft_responses;
 	uint32_t	min_supported_vls;
@@ -1018,6 +1027,8 @@ typedef struct _SMXmlConfig {
 
 	/* STL EXTENSIONS */
 	uint32_t	lft_multi_block;			// # of LFT blocks per MAD. Valid range is 1-31.
+	uint32_t	lft_delta_writes;			// 0/1 - if true, rebalanced LFTs of known switches are
+											// written as ordered deltas against the last sweep.
 	uint32_t	use_aggregates;				// 0/1 - if true, combine MADs where possible.
 	uint32_t    optimized_buffer_control;	// 0/1 - if true, use multi-port and uniform buffer ctrl
 											// MADs to program switch ports.
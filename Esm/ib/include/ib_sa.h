@@ -198,9 +198,15 @@ typedef	struct {
 /*
  * subscriber table (informInfo)
  */
+typedef struct _SubscriberEntry SubscriberEntry_t;
+
+#define SA_SUBSCRIBER_TRAP_CHAINS   256     /* power of 2 */
+
 typedef struct {
     CS_HashTablep   subsMap;  /* pointer to hashmap of subscriptions */
     Lock_t          subsLock;
+    SubscriberEntry_t *trapIndex[SA_SUBSCRIBER_TRAP_CHAINS]; /* chains of the subscriptions by trap number */
+    SubscriberEntry_t *allTraps;    /* subscriptions to TRAP_ALL */
 } SubscriberTable_t;
 
 /*
@@ -221,12 +227,31 @@ typedef struct {
 } SubscriberKey_t;
 typedef SubscriberKey_t * SubscriberKeyp;
 
+/*
+ *	event subscription entry, the value stored in subsMap
+ */
+struct _SubscriberEntry {
+    STL_INFORM_INFO_RECORD record;  /* first, so the map's values can be used as STL_INFORM_INFO_RECORD * */
+    SubscriberKeyp      key;        /* the entry's key in subsMap */
+    SubscriberEntry_t   *next;      /* trap number chain */
+    SubscriberEntry_t   **prevp;
+};
+
 /*
  * service record table (ServiceRecord)
  */
+typedef struct _ServiceRecEntry ServiceRecEntry_t;
+
 typedef struct {
     CS_HashTablep   serviceRecMap;  /* pointer to hashmap of service records */
     Lock_t          serviceRecLock;
+    ServiceRecEntry_t **idIndex;    /* chains of the records by ServiceID */
+    ServiceRecEntry_t **gidIndex;   /* chains of the records by ServiceGID */
+    uint32_t        indexMask;      /* chains per index - 1 */
+    uint32_t        indexed;        /* records in the indexes */
+    ServiceRecEntry_t **leases;     /* heap of the records with a lease, soonest expiry first */
+    uint32_t        numLeases;
+    uint32_t        maxLeases;
 } ServiceRecTable_t;
 
 /*
@@ -239,6 +264,19 @@ typedef struct {
 } ServiceRecKey_t;
 typedef ServiceRecKey_t * ServiceRecKeyp;
 
+/*
+ *	service record table entry, the value stored in serviceRecMap
+ */
+struct _ServiceRecEntry {
+    OpaServiceRecord_t  osr;        /* first, so the map's values can be used as OpaServiceRecordp */
+    ServiceRecEntry_t   *idNext;    /* ServiceID chain */
+    ServiceRecEntry_t   **idPrevp;
+    ServiceRecEntry_t   *gidNext;   /* ServiceGID chain */
+    ServiceRecEntry_t   **gidPrevp;
+    uint32_t            leaseSlot;  /* in leases, SA_SERVICE_NO_LEASE if eternal */
+};
+#define SA_SERVICE_NO_LEASE 0xffffffff
+
 //
 // Calculate 8-byte multiple padding for multi record SA responses
 //
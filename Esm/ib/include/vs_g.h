@@ -317,6 +317,10 @@ extern int vs_thread_setname(char* name);
 
 /*=== Pool Services ===*/
 #define VMEM_PAGE	(0x00000008)	/* Return page aligned chunks	*/
+#define VMEM_ARENA	(0x00000010)	/* Bump allocate out of large	*/
+					/* chunks; vs_pool_free is a	*/
+					/* no-op and vs_pool_delete	*/
+					/* releases everything at once	*/
 
 
 #define DELETE_MARKER	0xCECE
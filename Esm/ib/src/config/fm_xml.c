@@ -1778,6 +1778,14 @@ boolean smInitConfig(SMXmlConfig_t *smp)
 	DEFAULT_AND_CKSUM_INT(smp->node_appearance_msg_thresh, 0, CKSUM_OVERALL_DISRUPT_CONSIST);
 	DEFAULT_AND_CKSUM_INT(smp->spine_first_routing, 0, CKSUM_OVERALL_DISRUPT_CONSIST);
 	DEFAULT_AND_CKSUM_INT(smp->shortestPathBalanced, 1, CKSUM_OVERALL_DISRUPT_CONSIST);
+	DEFAULT_AND_CKSUM_INT(smp->incremental_cost_matrix_threshold, 16, CKSUM_OVERALL_DISRUPT);
+	DEFAULT_AND_CKSUM_INT(smp->lft_threads, 4, CKSUM_OVERALL_DISRUPT_CONSIST);
+	DEFAULT_AND_CKSUM_INT(smp->lft_carry_over, 1, CKSUM_OVERALL_DISRUPT_CONSIST);
+	DEFAULT_AND_CKSUM_INT(smp->mft_incremental, 1, CKSUM_OVERALL_DISRUPT_CONSIST);
+	DEFAULT_AND_CKSUM_INT(smp->sa_worker_threads, 0, CKSUM_OVERALL_DISRUPT_CONSIST);
+	DEFAULT_AND_CKSUM_INT(smp->sa_path_index_entries, 65536, CKSUM_OVERALL_DISRUPT_CONSIST);
+	DEFAULT_AND_CKSUM_INT(smp->sa_path_wildcard_cache_mb, 64, CKSUM_OVERALL_DISRUPT_CONSIST);
+	DEFAULT_AND_CKSUM_INT(smp->sa_cache_max_mb, 64, CKSUM_OVERALL_DISRUPT_CONSIST);
 	DEFAULT_AND_CKSUM_INT(smp->lid, 0x0, CKSUM_OVERALL_DISRUPT);
 	DEFAULT_AND_CKSUM_INT(smp->P_Key_8B, 0, CKSUM_OVERALL_DISRUPT_CONSIST);
 	DEFAULT_AND_CKSUM_INT(smp->P_Key_10B, 0, CKSUM_OVERALL_DISRUPT_CONSIST);
@@ -1840,16 +1848,22 @@ boolean smInitConfig(SMXmlConfig_t *smp)
 	DEFAULT_AND_CKSUM_INT(smp->enforceVFPathRecs, 1, CKSUM_OVERALL_DISRUPT_CONSIST);
 
 	DEFAULT_INT(smp->sma_batch_size, 2);
+	DEFAULT_INT(smp->sma_batch_size_max, 0);
 	DEFAULT_INT(smp->max_parallel_reqs, 3);
 	DEFAULT_INT(smp->max_supported_lid, SM_DEFAULT_MAX_LID);
     if (smp->sma_batch_size == 0)
         smp->sma_batch_size = 1;
+	if (smp->sma_batch_size_max > 255)
+		smp->sma_batch_size_max = 255;
+	if (smp->sma_batch_size_max && smp->sma_batch_size_max < smp->sma_batch_size)
+		smp->sma_batch_size_max = smp->sma_batch_size;
     if (smp->max_parallel_reqs == 0)
         smp->max_parallel_reqs = 1;
 	if (smp->max_supported_lid == 0)
         smp->max_supported_lid = SM_DEFAULT_MAX_LID;
 	smp->max_supported_lid |= 0x3FF; // Rounded up to 1K boundary.
 	CKSUM_DATA(smp->sma_batch_size, CKSUM_OVERALL_DISRUPT_CONSIST);
+	CKSUM_DATA(smp->sma_batch_size_max, CKSUM_OVERALL_DISRUPT_CONSIST);
 	CKSUM_DATA(smp->max_parallel_reqs, CKSUM_OVERALL_DISRUPT_CONSIST);
 	CKSUM_DATA(smp->max_supported_lid, CKSUM_OVERALL_DISRUPT_CONSIST);
 
@@ -2094,6 +2108,7 @@ boolean smInitConfig(SMXmlConfig_t *smp)
 	if ((smp->lft_multi_block == UNDEFINED_XML32) || (smp->lft_multi_block > (STL_MAX_PAYLOAD_SMP_DR/MAX_LFT_ELEMENTS_BLOCK)))
 		smp->lft_multi_block = STL_MAX_PAYLOAD_SMP_DR/MAX_LFT_ELEMENTS_BLOCK;
 	CKSUM_DATA(smp->lft_multi_block, CKSUM_OVERALL_DISRUPT_CONSIST);
+	DEFAULT_AND_CKSUM_INT(smp->lft_delta_writes, 1, CKSUM_OVERALL_DISRUPT_CONSIST);
 	DEFAULT_AND_CKSUM_INT(smp->use_aggregates, 1, CKSUM_OVERALL_DISRUPT_CONSIST);
 	DEFAULT_AND_CKSUM_INT(smp->optimized_buffer_control, 1, CKSUM_OVERALL_DISRUPT_CONSIST);
 
@@ -2244,6 +2259,14 @@ void smShowConfig(SMXmlConfig_t *smp, SMDPLXmlConfig_t *dplp, SMMcastConfig_t *m
 	printf("XML - node_appearance_msg_thresh %u\n", (unsigned int)smp->node_appearance_msg_thresh);
 	printf("XML - spine_first_routing %u\n", (unsigned int)smp->spine_first_routing);
 	printf("XML - shortestPathBalanced %u\n", (unsigned int)smp->shortestPathBalanced);
+	printf("XML - incremental_cost_matrix_threshold %u\n", (unsigned int)smp->incremental_cost_matrix_threshold);
+	printf("XML - lft_threads %u\n", (unsigned int)smp->lft_threads);
+	printf("XML - lft_carry_over %u\n", (unsigned int)smp->lft_carry_over);
+	printf("XML - mft_incremental %u\n", (unsigned int)smp->mft_incremental);
+	printf("XML - sa_worker_threads %u\n", (unsigned int)smp->sa_worker_threads);
+	printf("XML - sa_path_index_entries %u\n", (unsigned int)smp->sa_path_index_entries);
+	printf("XML - sa_path_wildcard_cache_mb %u\n", (unsigned int)smp->sa_path_wildcard_cache_mb);
+	printf("XML - sa_cache_max_mb %u\n", (unsigned int)smp->sa_cache_max_mb);
 	printf("XML - lid 0x%x\n", (unsigned int)smp->lid);
 	printf("XML - lmc 0x%x\n", (unsigned int)smp->lmc);
 	printf("XML - lmc_e0 0x%x\n", (unsigned int)smp->lmc_e0);
@@ -2276,6 +2299,7 @@ void smShowConfig(SMXmlConfig_t *smp, SMDPLXmlConfig_t *dplp, SMMcastConfig_t *m
 	printf("XML - queryValidation %u\n", (unsigned int)smp->queryValidation);
 	printf("XML - enforceVFPathRecs %u\n", (unsigned int)smp->enforceVFPathRecs);
 	printf("XML - sma_batch_size %u\n", (unsigned int)smp->sma_batch_size);
+	printf("XML - sma_batch_size_max %u\n", (unsigned int)smp->sma_batch_size_max);
 	printf("XML - max_parallel_reqs %u\n", (unsigned int)smp->max_parallel_reqs);
 	printf("XML - check_mft_responses %u\n", (unsigned int)smp->check_mft_responses);
 	printf("XML - sm_debug_perf %u\n", (unsigned int)smp->sm_debug_perf);
@@ -2300,6 +2324,7 @@ void smShowConfig(SMXmlConfig_t *smp, SMDPLXmlConfig_t *dplp, SMMcastConfig_t *m
 	printf("XML - use_cached_node_data %u\n", (unsigned int)smp->use_cached_node_data);
 	printf("XML - NoReplyIfBusy %u\n", (unsigned int)smp->NoReplyIfBusy);
 	printf("XML - lft_multi_block %u\n", (unsigned int)smp->lft_multi_block);
+	printf("XML - lft_delta_writes %u\n", (unsigned int)smp->lft_delta_writes);
 	printf("XML - use_aggregates %u\n", (unsigned int)smp->use_aggregates);
 	printf("XML - optimized_buffer_control %u\n", (unsigned int)smp->optimized_buffer_control);
 	printf("XML - sma_spoofing_check %u\n", (unsigned int)smp->sma_spoofing_check);
@@ -6528,10 +6553,19 @@ static IXML_FIELD SmFields[] = {
 	{ tag:"NodeAppearanceMsgThreshold", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, node_appearance_msg_thresh) },
 	{ tag:"SpineFirstRouting", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, spine_first_routing) },
 	{ tag:"ShortestPathBalanced", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, shortestPathBalanced) },
+	{ tag:"IncrementalCostMatrixThreshold", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, incremental_cost_matrix_threshold) },
+	{ tag:"LftThreads", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, lft_threads) },
+	{ tag:"LftCarryOver", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, lft_carry_over) },
+	{ tag:"MftIncremental", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, mft_incremental) },
+	{ tag:"SaWorkerThreads", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, sa_worker_threads) },
+	{ tag:"SaPathIndexEntries", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, sa_path_index_entries) },
+	{ tag:"SaPathWildcardCacheMB", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, sa_path_wildcard_cache_mb) },
+	{ tag:"SaCacheMaxMB", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, sa_cache_max_mb) },
 	{ tag:"PathSelection", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, path_selection), end_func:SmPathSelectionParserEnd },
 	{ tag:"QueryValidation", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, queryValidation) },
 	{ tag:"EnforceVFPathRecord", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, enforceVFPathRecs) },
 	{ tag:"SmaBatchSize", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, sma_batch_size) },
+	{ tag:"SmaBatchSizeMax", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, sma_batch_size_max) },
 	{ tag:"MaxParallelReqs", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, max_parallel_reqs) },
  	{ tag:"CheckMftResponses", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, check_mft_responses) },
 	{ tag:"MonitorStandby", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, monitor_standby_enable) },
@@ -6608,6 +6642,7 @@ static IXML_FIELD SmFields[] = {
 	{ tag:"DebugLidAssign", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, sm_debug_lid_assign) },
 	{ tag:"NoReplyIfBusy", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, NoReplyIfBusy) },
 	{ tag:"LftMultiblock", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, lft_multi_block) },
+	{ tag:"LftDeltaWrites", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, lft_delta_writes) },
 	{ tag:"UseAggregateMADs", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, use_aggregates) },
 	{ tag:"OptimizedBufferControl", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, optimized_buffer_control) },
 	{ tag:"SmaSpoofingCheck", format:'u', IXML_FIELD_INFO(SMXmlConfig_t, sma_spoofing_check) },
@@ -92,6 +92,134 @@ static void cntxt_insert_head ( cntxt_entry_t **listCntx, cntxt_entry_t *entry )
     entry->prev = NULL;
 }
 
+//
+// put a context entry on the timer wheel slot for its expire time
+//
+static void cntxt_timer_link( cntxt_entry_t *entry, generic_cntxt_t *cntx ) {
+    uint64_t    tick, delta;
+    int         level, shift;
+    unsigned    slot;
+    cntxt_entry_t **head;
+
+    // round up so the whole tick has expired once it is aged
+    tick = (entry->expire + (1 << CNTXT_WHEEL_TICK_SHIFT) - 1) >> CNTXT_WHEEL_TICK_SHIFT;
+    if (tick < cntx->wheelTick)
+        tick = cntx->wheelTick;
+    delta = tick - cntx->wheelTick;
+    for (level = 0, shift = 0; level < CNTXT_WHEEL_LEVELS - 1; level++, shift += CNTXT_WHEEL_BITS) {
+        if (delta < (1ull << (shift + CNTXT_WHEEL_BITS)))
+            break;
+    }
+    if (delta >= (1ull << (shift + CNTXT_WHEEL_BITS))) {
+        // beyond the last level, re-linked when that slot is cascaded
+        tick = cntx->wheelTick + (1ull << (shift + CNTXT_WHEEL_BITS)) - 1;
+    }
+    slot = (tick >> shift) & (CNTXT_WHEEL_SLOTS - 1);
+
+    head = &cntx->wheel[level][slot];
+    if (*head) (*head)->timerPprev = &entry->timerNext;
+    entry->timerNext = *head;
+    entry->timerPprev = head;
+    *head = entry;
+    cntx->wheelSlotMask[level] |= 1ull << slot;
+    ++cntx->numTimers;
+}
+
+//
+// take a context entry off the timer wheel.  The slot's bit in
+// wheelSlotMask is left set and cleared lazily when the slot is found empty.
+//
+static void cntxt_timer_unlink( cntxt_entry_t *entry, generic_cntxt_t *cntx ) {
+    if (! entry->timerPprev)
+        return;
+    *entry->timerPprev = entry->timerNext;
+    if (entry->timerNext) entry->timerNext->timerPprev = entry->timerPprev;
+    entry->timerNext = NULL;
+    entry->timerPprev = NULL;
+    --cntx->numTimers;
+}
+
+//
+// (re)compute when a hashed context entry times out and move it to the
+// matching timer wheel slot.  Must be called whenever tstamp, RespTimeout or
+// sendFailed of a hashed entry change.
+//
+static void cntxt_timer_arm( cntxt_entry_t *entry, generic_cntxt_t *cntx ) {
+    cntxt_timer_unlink( entry, cntx );
+    // with nothing on the wheel there is nothing to age between the last
+    // aged tick and now, catch up so a long idle period is not walked
+    if (! cntx->numTimers && cntx->wheelTick < (entry->tstamp >> CNTXT_WHEEL_TICK_SHIFT))
+        cntx->wheelTick = entry->tstamp >> CNTXT_WHEEL_TICK_SHIFT;
+    // if a send failed, use normal timeouts.  If send did not
+    // fail, we use timeoutAdder.  timeoutAdder will be 0 if this
+    // is our primary aging mechanism.  If we are using OFED
+    // timeouts, timeoutAdder will allow this mechanism to
+    // be a safety net in case OFED fails to provide a return MAD
+    entry->expire = entry->tstamp + entry->RespTimeout
+                    + (entry->sendFailed ? 0 : cntx->timeoutAdder);
+    cntxt_timer_link( entry, cntx );
+}
+
+//
+// move the entries of a higher level timer wheel slot down to the levels
+// below, called as the aged tick crosses the start of the slot
+//
+static void cntxt_timer_cascade( generic_cntxt_t *cntx, int level, unsigned slot ) {
+    cntxt_entry_t *entry, *list = cntx->wheel[level][slot];
+
+    cntx->wheel[level][slot] = NULL;
+    cntx->wheelSlotMask[level] &= ~(1ull << slot);
+    while ((entry = list) != NULL) {
+        list = entry->timerNext;
+        entry->timerNext = NULL;
+        entry->timerPprev = NULL;
+        --cntx->numTimers;
+        cntxt_timer_link( entry, cntx );
+    }
+}
+
+//
+// earliest tick at which cs_cntxt_age has work to do: the first occupied
+// level 0 slot or the cascade of the first occupied higher level slot,
+// whichever comes first.  Only valid when numTimers != 0.
+//
+static uint64_t cntxt_timer_next( generic_cntxt_t *cntx ) {
+    uint64_t    mask, rot, tick, next = 0;
+    int         level, shift, wrapped;
+    unsigned    idx, dist, slot;
+
+    for (level = 0, shift = 0; level < CNTXT_WHEEL_LEVELS; level++, shift += CNTXT_WHEEL_BITS) {
+        idx = (cntx->wheelTick >> shift) & (CNTXT_WHEEL_SLOTS - 1);
+        // the current slot of a higher level is cascaded as its first tick
+        // is aged, once past that anything on it is a full revolution away
+        wrapped = level && (cntx->wheelTick & ((1ull << shift) - 1));
+        dist = 0;
+        while ((mask = cntx->wheelSlotMask[level]) != 0) {
+            // rotate so bit 0 is the current slot of this level
+            rot = idx ? (mask >> idx) | (mask << (CNTXT_WHEEL_SLOTS - idx)) : mask;
+            if (wrapped && (rot & ~1ull))
+                rot &= ~1ull;
+            dist = __builtin_ctzll(rot);
+            slot = (idx + dist) & (CNTXT_WHEEL_SLOTS - 1);
+            if (cntx->wheel[level][slot])
+                break;
+            cntx->wheelSlotMask[level] &= ~(1ull << slot);
+        }
+        if (! mask)
+            continue;
+        if (level == 0) {
+            tick = cntx->wheelTick + dist;
+        } else {
+            if (dist == 0 && wrapped)
+                dist = CNTXT_WHEEL_SLOTS;
+            tick = ((cntx->wheelTick >> shift) + dist) << shift;
+        }
+        if (! next || tick < next)
+            next = tick;
+    }
+    return next;
+}
+
 void cs_cntxt_lock( generic_cntxt_t *cntx ) {
     vs_lock(&cntx->lock);
 }
@@ -124,6 +252,7 @@ static void cntxt_reserve( cntxt_entry_t *a_cntxt, generic_cntxt_t *cntx ) {
     a_cntxt->hashed = 1 ;
     vs_time_get( &a_cntxt->tstamp );
     cntxt_insert_head( &cntx->hash[ bucket ], a_cntxt );
+    cntxt_timer_arm( a_cntxt, cntx );
 }
 
 // remove context entry from hash list
@@ -139,6 +268,7 @@ static void cntxt_unhash( cntxt_entry_t *entry, generic_cntxt_t *cntx)
             bucket = 0;
         entry->hashed = 0 ;
         cntxt_delete_entry( &cntx->hash[ bucket ], entry );
+        cntxt_timer_unlink( entry, cntx );
     }
     entry->prev = NULL;
     entry->next = NULL;
@@ -300,10 +430,12 @@ Status_t cs_cntxt_send_mad_nolock (cntxt_entry_t *entry, generic_cntxt_t *cntx)
     Status_t    status;
 	uint32_t	datalen;
 
-    if (! entry->hashed)
+    if (! entry->hashed) {
         cntxt_reserve( entry, cntx );	// clears sendFailed
-    else
+    } else {
         entry->sendFailed = 0;
+        cntxt_timer_arm( entry, cntx );
+    }
 
     //if (entry->retries == 0) {
         //IB_LOG_INFINI_INFOLX("sending notice mad, TID=", entry->tid);
@@ -352,6 +484,7 @@ count++;
 				   cs_getAidName(entry->mad.base.mclass, entry->mad.base.aid), (uint32)entry->mad.datasize,
 				   entry->index, entry->mad.addrInfo.dlid, entry->tid);
 			entry->sendFailed = 1;
+			cntxt_timer_arm( entry, cntx );
 		}
 		return status;
 	}
@@ -362,6 +495,7 @@ count++;
                cs_getAidName(entry->mad.base.mclass, entry->mad.base.aid),
                entry->index, entry->mad.addrInfo.dlid, entry->tid);
         entry->sendFailed = 1;
+        cntxt_timer_arm( entry, cntx );
     }
     return status;
 }
@@ -406,6 +540,11 @@ Status_t cs_cntxt_instance_init (Pool_t *pool, generic_cntxt_t *cntx, uint64_t t
     cntx->numAlloc = 0;
     cntx->numFree = cntx->poolSize;
     cntx->free_list = NULL;
+    memset( cntx->wheel, 0, sizeof(cntx->wheel));
+    memset( cntx->wheelSlotMask, 0, sizeof(cntx->wheelSlotMask));
+    cntx->numTimers = 0;
+    vs_time_get( &cntx->wheelTick );
+    cntx->wheelTick >>= CNTXT_WHEEL_TICK_SHIFT;
     entry = (cntxt_entry_t *)cntx->pool;
     for( i = 0, entry = (cntxt_entry_t *)cntx->pool; i < cntx->poolSize ; i++, entry++ ) {
         //IB_LOG_INFINI_INFOX("entry ptr=", (uint32_t)entry);
@@ -541,15 +680,22 @@ Status_t cs_cntxt_timeout_entry(cntxt_entry_t *tout_cntxt, generic_cntxt_t *cntx
 /*
  * Age context and do resends for those that timed out
  * 
- * Returns the smallest time left for the context that is going to expire next.
+ * Only the timer wheel slots for the ticks since the last call are visited,
+ * so the cost is proportional to the number of entries which expired.
+ *
+ * Returns the time left until the next entry may expire, 0 if none are
+ * outstanding.  This is rounded up to the end of the entry's wheel tick, and
+ * may be earlier than the expiry when the next entry is on a higher level
+ * and has to be cascaded first.
  */
 uint64_t cs_cntxt_age(generic_cntxt_t *cntx)
 {
-    cntxt_entry_t*  a_cntxt = NULL ;
     cntxt_entry_t*	tout_cntxt ;
-    int i;
+    cntxt_entry_t*	expired ;
+    int             level;
+    unsigned        idx, slot;
     Status_t        status;
-    uint64_t	    timenow=0, smallest_timeleft=0, time_left=0;
+    uint64_t	    timenow=0, smallest_timeleft=0, nowTick, tick;
 
 	IB_ENTER(__func__, cntx, 0, 0, 0 );
 
@@ -557,60 +703,61 @@ uint64_t cs_cntxt_age(generic_cntxt_t *cntx)
         IB_LOG_ERRORRC("Failed to lock context rc:", status);
     } else {
     	vs_time_get( &timenow );   
-        for (i = 0; i < cntx->hashTableDepth; i++) {
-            a_cntxt = (cntxt_entry_t *)cntx->hash[ i ];
-            while( a_cntxt ) {
-				// if a send failed, use normal timeouts.  If send did not
-				// fail, we use timeoutAdder.  timeoutAdder will be 0 if this
-				// is our primary aging mechanism.  If we are using OFED
-				// timeouts, timeoutAdder will allow this mechanism to
-				// be a safety net in case OFED fails to provide a return MAD
-				uint64_t timeoutAdder= a_cntxt->sendFailed?0:cntx->timeoutAdder;
-                // Iterate before the pointers are destroyed
-                tout_cntxt = a_cntxt;
-                a_cntxt = a_cntxt->next;
-                //IB_LOG_INFINI_INFO("checking context index ", tout_cntxt->index);
-                if ( timenow - tout_cntxt->tstamp >= tout_cntxt->RespTimeout + timeoutAdder) {
-                    // Timeout this entry
-					//if (cntx->timeoutAdder) printf("Entry aged out: tid=0x%lx send failed=%d delta=%lu adder=%lu\n", tout_cntxt->tid, tout_cntxt->sendFailed, timenow - tout_cntxt->tstamp, timeoutAdder);
-
-#if 0
-                    // Get timed out entry to head of hash
-                    cntxt_delete_entry( &cntx->hash[ i ], tout_cntxt );
-                    cntxt_insert_head( &cntx->hash[ i ], tout_cntxt );
-#endif
-
-					status = cs_cntxt_timeout_entry(tout_cntxt, cntx, timenow);
-					if (status == VSTATUS_TIMEOUT
-						|| (cntx->errorOnSendFail && status != VSTATUS_OK)) {
-						/*if this context is being released, don't consider
-						 * it for smallest_timeleft calculation
-						 */
-						cntxt_release( tout_cntxt, cntx, status, NULL );
-						continue;
-                    }
-					// If errorOnSendFail = 0, for send errors (VSTATUS_BAD)
-					// we leave entry in hash and will retry it next time
-					// timeout expires.
-					// Successful retry (VSTATUS_OK) also stays on hash
+        nowTick = timenow >> CNTXT_WHEEL_TICK_SHIFT;
+        if (! cntx->numTimers && cntx->wheelTick <= nowTick)
+            cntx->wheelTick = nowTick + 1;
+        while (cntx->wheelTick <= nowTick) {
+            tick = cntx->wheelTick;
+            idx = tick & (CNTXT_WHEEL_SLOTS - 1);
+            if (idx == 0) {
+                // level 0 wrapped, pull the next slot of each higher
+                // level which also wrapped down to the levels below
+                for (level = 1; level < CNTXT_WHEEL_LEVELS; level++) {
+                    slot = (tick >> (level * CNTXT_WHEEL_BITS)) & (CNTXT_WHEEL_SLOTS - 1);
+                    cntxt_timer_cascade( cntx, level, slot );
+                    if (slot)
+                        break;
                 }
+            }
+            if (! cntx->wheel[0][idx]) {
+                // nothing due on this tick, skip to the next one with an
+                // occupied slot or a cascade to do
+                cntx->wheelSlotMask[0] &= ~(1ull << idx);
+                tick = cntx->numTimers ? MAX(cntxt_timer_next(cntx), tick + 1) : nowTick + 1;
+                cntx->wheelTick = MIN(tick, nowTick + 1);
+                continue;
+            }
 
-				/* check remaining time for this context before it times out */
-				time_left = tout_cntxt->RespTimeout - (timenow - tout_cntxt->tstamp);
-				time_left += tout_cntxt->sendFailed?0:cntx->timeoutAdder;
-
-				/* if it is the context with the smallest time left for its
-				 * timeout, then update smallest_timeleft
-				*/
-				if (smallest_timeleft) {
-					if ( time_left < smallest_timeleft)
-						smallest_timeleft = time_left;
-				} else {
-					/* smallest_timeleft is 0, no previous time_left values */
-					smallest_timeleft = time_left;
+            // Detach the slot.  Entries re-armed while it is processed
+            // (retries, callbacks reusing the entry) go on later ticks.
+            expired = cntx->wheel[0][idx];
+            expired->timerPprev = &expired;
+            cntx->wheel[0][idx] = NULL;
+            cntx->wheelSlotMask[0] &= ~(1ull << idx);
+            cntx->wheelTick = tick + 1;
+
+            while ((tout_cntxt = expired) != NULL) {
+                cntxt_timer_unlink( tout_cntxt, cntx );
+                // Timeout this entry
+				//if (cntx->timeoutAdder) printf("Entry aged out: tid=0x%lx send failed=%d delta=%lu\n", tout_cntxt->tid, tout_cntxt->sendFailed, timenow - tout_cntxt->tstamp);
+
+				status = cs_cntxt_timeout_entry(tout_cntxt, cntx, timenow);
+				if (status == VSTATUS_TIMEOUT
+					|| (cntx->errorOnSendFail && status != VSTATUS_OK)) {
+					cntxt_release( tout_cntxt, cntx, status, NULL );
 				}
+				// If errorOnSendFail = 0, for send errors (VSTATUS_BAD)
+				// we leave entry in hash and will retry it next time
+				// timeout expires.
+				// Successful retry (VSTATUS_OK) also stays on hash.
+				// Either way the send re-armed the entry's timer.
             }
         }
+
+        /* check remaining time for the context which will time out next */
+        if (cntx->numTimers)
+            smallest_timeleft = (cntxt_timer_next(cntx) << CNTXT_WHEEL_TICK_SHIFT) - timenow;
+
         if (vs_unlock(&cntx->lock)) {
             IB_LOG_ERROR0("Failed to unlock context");
         }
@@ -92,7 +92,7 @@ vs_pool_create (Pool_t * handle, uint32_t options,
 {
   Status_t rc;
   size_t namesize;
-  const uint32_t valid_options = 0;
+  const uint32_t valid_options = VMEM_ARENA;
 
   IB_ENTER (function, (unint) handle, options, (unint) address,
 	    (uint32_t) size);
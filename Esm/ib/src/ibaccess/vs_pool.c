@@ -105,12 +105,28 @@ typedef	struct _PBuffer {
 	uint32_t	size;
 } PBuffer_t;
 
+/*
+ * VMEM_ARENA chunk header.  Objects are carved out of the chunk that
+ * follows it and are only released when the whole pool is deleted.
+ */
+typedef struct _ArenaChunk {
+	struct _ArenaChunk *next;
+	uint64_t	size;
+} ArenaChunk_t;
+
+/* alignment of VMEM_ARENA allocations, matches what malloc guarantees */
+#define ARENA_ALIGN	16
+
 typedef struct
 {
 	uint64_t  numBytesAlloc;	// amount allocated from pool
 #if USE_PBUFFER_LIST
 	PBuffer_t *buffers;
 #endif /* USE_PBUFFER_LIST */
+	ArenaChunk_t *arenaChunks;	// VMEM_ARENA: all chunks, newest first
+	uint8_t   *arenaNext;		// VMEM_ARENA: next free byte in current chunk
+	uint8_t   *arenaEnd;		// VMEM_ARENA: end of current chunk
+	uint32_t  arenaChunkSize;	// VMEM_ARENA: usable bytes per chunk
 } Implpriv_Pool_t;
 
 
@@ -177,6 +193,11 @@ vs_implpool_create(Pool_t *poolp, uint32_t options, uint8_t *name, void *address
 #if USE_PBUFFER_LIST
 	((Implpriv_Pool_t*)poolp->opaque)->buffers = NULL;
 #endif /* USE_PBUFFER_LIST */
+	if (options & VMEM_ARENA) {
+		// for an arena the pool size is the chunk size
+		((Implpriv_Pool_t*)poolp->opaque)->arenaChunkSize =
+			(size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+	}
 
 	IB_EXIT (function, VSTATUS_OK);
 	return(VSTATUS_OK);
@@ -193,6 +214,18 @@ vs_implpool_delete(Pool_t *poolp) {
 		return(VSTATUS_ILLPARM);
 	}
 
+	if (poolp->options & VMEM_ARENA) {
+		Implpriv_Pool_t *arena = (Implpriv_Pool_t*) poolp->opaque;
+		ArenaChunk_t *chunkp;
+
+		while ((chunkp = arena->arenaChunks) != NULL) {
+			arena->arenaChunks = chunkp->next;
+			free(chunkp);
+		}
+		arena->arenaNext = arena->arenaEnd = NULL;
+		arena->numBytesAlloc = 0;
+	}
+
 #if USE_PBUFFER_LIST
 	PBuffer_t	*bufferp;
 	Implpriv_Pool_t *impl = (Implpriv_Pool_t*) poolp->opaque;
@@ -216,6 +249,46 @@ vs_implpool_delete(Pool_t *poolp) {
 #define AtomicAdd64(p,a) __sync_add_and_fetch((p),(a))
 #define AtomicSubtract64(p,a) __sync_sub_and_fetch((p),(a))
 
+/*
+ * VMEM_ARENA allocation.  Requests are bump allocated from the current
+ * chunk; a request larger than a quarter of a chunk gets a chunk of its
+ * own so it doesn't waste the tail of the current one.  Chunks come from
+ * calloc, and since arena memory is never reused there is no per-object
+ * memset or header.  Called with the pool lock held.
+ */
+static Status_t
+arena_alloc(Pool_t *poolp, uint32_t reqSize, void **address) {
+	Implpriv_Pool_t *arena = (Implpriv_Pool_t *)poolp->opaque;
+	size_t hdrBytes = (sizeof(ArenaChunk_t) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	size_t bytes = ((size_t)reqSize + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	boolean oversized = bytes > arena->arenaChunkSize / 4;
+	size_t chunkBytes;
+	ArenaChunk_t *chunkp;
+
+	if (bytes <= (size_t)(arena->arenaEnd - arena->arenaNext)) {
+		*address = arena->arenaNext;
+		arena->arenaNext += bytes;
+		return VSTATUS_OK;
+	}
+
+	chunkBytes = hdrBytes + (oversized ? bytes : arena->arenaChunkSize);
+	chunkp = (ArenaChunk_t *)calloc(1, chunkBytes);
+	if (chunkp == NULL)
+		return VSTATUS_NOMEM;
+
+	chunkp->size = chunkBytes;
+	chunkp->next = arena->arenaChunks;
+	arena->arenaChunks = chunkp;
+	arena->numBytesAlloc += chunkBytes;
+
+	*address = (uint8_t *)chunkp + hdrBytes;
+	if (!oversized) {
+		arena->arenaNext = (uint8_t *)*address + bytes;
+		arena->arenaEnd = (uint8_t *)chunkp + chunkBytes;
+	}
+	return VSTATUS_OK;
+}
+
 
 Status_t
 vs_implpool_alloc(Pool_t *poolp, uint32_t reqSize, void **address) {
@@ -229,6 +302,12 @@ vs_implpool_alloc(Pool_t *poolp, uint32_t reqSize, void **address) {
 		IB_EXIT (function, VSTATUS_ILLPARM);
 		return(VSTATUS_ILLPARM);
 	}
+
+	if (poolp->options & VMEM_ARENA) {
+		Status_t rc = arena_alloc(poolp, reqSize, address);
+		IB_EXIT (function, rc);
+		return rc;
+	}
 // TBD - don't need Buffer_t header for normal case below, could save space
 
 	DEBUG_ASSERT(reqSize < UINT32_MAX);
@@ -365,6 +444,12 @@ vs_implpool_free(Pool_t *poolp, void *address) {
 		return(VSTATUS_ILLPARM);
 	}
 
+	/* arena memory is only released by vs_pool_delete */
+	if (poolp->options & VMEM_ARENA) {
+		IB_EXIT (function, VSTATUS_OK);
+		return VSTATUS_OK;
+	}
+
 # if (ABORT_ON_OVERWRITE)
 	address -= sizeof(uint32_t);
 # endif
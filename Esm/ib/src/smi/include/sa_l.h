@@ -109,22 +109,40 @@ typedef struct _FieldMask {
 	uint16_t	length;			// number of bits in field
 } FieldMask_t;
 
+//
+//      Query scratch pads (the template below and sa_data) are per thread,
+//      since SA worker threads process queries concurrently.
+//
+#if !defined(__VXWORKS__)
+#define SA_THREAD_LOCAL	__thread
+#else
+#define SA_THREAD_LOCAL
+#endif
+
 //
 //      Scratch pad for template queries.
 //
-extern	uint8_t         template_mask[4096];
-extern	uint32_t        template_offset;
-extern	uint32_t        template_length;
-extern	FieldMask_t     *template_fieldp;
+extern	SA_THREAD_LOCAL uint8_t         template_mask[4096];
+extern	SA_THREAD_LOCAL uint32_t        template_offset;
+extern	SA_THREAD_LOCAL uint32_t        template_length;
+extern	SA_THREAD_LOCAL FieldMask_t     *template_fieldp;
 
 //
 // SA Caching
 //
 
-#define SA_NUM_CACHES 2         // number of cached query types
+#define SA_NUM_CACHES 7         // number of cached query types
 
 #define SA_CACHE_FI_NODES     0 // all NodeRecords where NodeType == FI
 #define SA_CACHE_SWITCH_NODES 1 // all NodeRecords where NodeType == Switch
+#define SA_CACHE_PORTINFO     2 // all PortInfoRecords
+#define SA_CACHE_LINKS        3 // all LinkRecords
+#define SA_CACHE_SWITCHINFO   4 // all SwitchInfoRecords
+#define SA_CACHE_VFABRICS     5 // all VFabricRecords
+#define SA_CACHE_LFTS         6 // all LFTableRecords
+
+#define SA_CACHE_FIRST_CAPPED SA_CACHE_PORTINFO // the NodeRecord caches are
+                                // always built; SaCacheMaxMB caps the rest
 
 #define SA_CACHE_CLEAN_INTERVAL 30*VTIMER_1S // time between clearing of the
                                        // "previous" list of in-use elements
@@ -151,11 +169,46 @@ typedef struct {
 	                          // use.  should be minimal as all queries using
 	                          // the caches should finish between sweeps
 	Lock_t         lock; // lock mediating topology and query threads
+	uint64_t       hits[SA_NUM_CACHES];    // queries answered from each cache
+	uint64_t       misses[SA_NUM_CACHES];  // queries it could have answered
+	                                       // had it been built
+	uint32_t       skipped[SA_NUM_CACHES]; // sweeps that left it unbuilt for
+	                                       // size or SaCacheMaxMB
 } SACache_t;
 
 // prototype of function to be called to build each cache
 typedef Status_t (*SACacheBuildFunc_t)(SACacheEntry_t *, Topology_t *);
 
+#define SA_RESP_CHUNK_SIZE   (64 * 1024) // bytes of records in a full response chunk
+#define SA_RESP_MAX_SEGMENTS 0x100000    // RMPP segments one response may take
+
+// bytes of records in each RMPP segment of the reply to a request
+#define SA_RESP_SEGMENT_LEN(MAIP) \
+	((MAIP)->base.bversion == STL_BASE_VERSION ? STL_SA_DATA_LEN : IB_SA_DATA_LEN)
+
+// a piece of an SA response, holding whole records back to back
+typedef struct SARespChunk {
+	struct SARespChunk *next;
+	uint8_t  *data;     // records; follows the chunk header
+	uint32_t len;       // bytes of records in the chunk
+	uint32_t size;      // bytes the chunk can hold
+} SARespChunk_t;
+
+// an SA response built a record at a time.  chunks are added as records
+// are written, so a response takes memory for the records it holds rather
+// than for the largest response the SA may send, and RMPP sends segments
+// straight from the chunks instead of from a private copy.
+typedef struct {
+	SARespChunk_t *head;
+	SARespChunk_t *tail;
+	uint32_t len;       // bytes of records
+	uint32_t maxLen;    // bytes SA_RESP_MAX_SEGMENTS segments can carry
+	uint32_t size;      // bytes of chunks allocated
+	uint32_t refCount;  // the handler building it and the context sending it
+	SARespChunk_t *cursor;     // chunk the last copy ended in
+	uint32_t cursorOffset;     // offset in the response of cursor's first byte
+} SAResponse_t;
+
 //
 //	Authentication structure.
 //
@@ -167,7 +220,8 @@ typedef	struct {
 	uint32_t	numKeys;
 } Authenticator_t;
 
-#define SA_CNTXT_HASH_TABLE_DEPTH	64
+#define SA_CNTXT_HASH_TABLE_DEPTH	64		// initial buckets, doubled as contexts are hashed
+#define SA_CNTXT_POOL_CHUNK			256		// contexts allocated before the first request
 extern uint32_t sa_max_cntxt;
 extern uint32_t sa_data_length;	// maximum SA response size
 extern uint32_t sa_max_ib_path_records;// maximum IB path records in one response
@@ -177,6 +231,7 @@ typedef struct sa_cntxt {
 	uint64_t	tstamp ;
 	uint64_t	tid ;		// Tid for hash table search
 	STL_LID		lid ;		// Lid for hash table search
+    uint8_t     mclass;     // management class for hash table search
     uint16_t    method;     // initial method requested by initiator
     IBhandle_t	sendFd;     // mai handle to use for sending packets (fd_sa for 1st seg and fd_sa_w threafter)
 	uint8_t		hashed ;	// Entry is inserted into the hash table
@@ -197,12 +252,13 @@ typedef struct sa_cntxt {
     uint64_t    RespTimeout;// current response timeout value (13.6.3.1)
     uint64_t    tTime;      // total transaction timeout value (13.6.3.2)
 	uint16_t	retries;    // retry count
-	uint16_t	last_ack;   // last segment number acked
-    uint16_t    segTotal;   // total segments in response
+	uint32_t	last_ack;   // last segment number acked
+    uint32_t    segTotal;   // total segments in response
 	struct sa_cntxt *next ;	// Link List next pointer
 	struct sa_cntxt *prev ;	// Link List prev pointer
     uint8_t     chkSum;     // checksum of rmpp response 
 	SACacheEntry_t *cache;  // pointer to cache structure if applicable
+	SAResponse_t *resp;     // response chunks, sent in place of data if set
 	Status_t (*freeDataFunc)(struct sa_cntxt *); // func to call to free data. may
 	                        // either free locally allocated data, or defer to
 	                        // the cache mechanism to decref the cache
@@ -210,6 +266,11 @@ typedef struct sa_cntxt {
 	                        // to process the incoming packet.
 } sa_cntxt_t ;
 
+// largest response a context can send; responses built in chunks are only
+// bounded by the RMPP segment count
+#define SA_CNTXT_MAX_LEN(CNTXT) \
+	((CNTXT)->resp ? (CNTXT)->resp->maxLen : sa_data_length)
+
 //
 //	Macros for SA filter creation.
 //
@@ -240,6 +301,16 @@ typedef enum {
     ContextExistGetMulti = 4    // existing getMult request
 } SAContextGet_t;
 
+//
+// Handlers sa_main_reader_process() passes a request to once it has
+// looked up its context.
+//
+typedef struct {
+	Status_t (*process)(Mai_t *, sa_cntxt_t *);		// new request
+	Status_t (*getmulti)(Mai_t *, sa_cntxt_t *);	// in progress getMulti request
+	Status_t (*reply)(Mai_t *, sa_cntxt_t *);		// BUSY reply when out of contexts
+} SAReaderOps_t;
+
 //
 // Rate macros - these allow us to compare rates easily
 //
@@ -295,7 +366,8 @@ extern SubscriberTable_t   saSubscribers;
 extern ServiceRecTable_t   saServiceRecords;
 extern  uint32_t    saDebugRmpp;    // controls output of SA INFO RMPP+ messages
 extern uint32_t     saRmppCheckSum; // rmppp response checksum control
-extern	uint8_t		*sa_data;
+extern	SA_THREAD_LOCAL uint8_t	*sa_data;
+extern	SA_THREAD_LOCAL uint32_t	sa_data_size;	// bytes in sa_data, 0 if sa_data_length
 extern SACache_t	saCache;
 extern SACacheBuildFunc_t	saCacheBuildFunctions[];	
 
@@ -305,11 +377,22 @@ extern SACacheBuildFunc_t	saCacheBuildFunctions[];
 Status_t    sa_SubscriberInit(void);
 void        sa_SubscriberDelete(void);
 void        sa_SubscriberClear(void);
+STL_INFORM_INFO_RECORD *sa_SubscriberAlloc(void);
+int32_t     sa_SubscriberInsert(SubscriberKeyp, STL_INFORM_INFO_RECORD *);
+STL_INFORM_INFO_RECORD *sa_SubscriberRemove(SubscriberKeyp);
+void        sa_SubscriberUnindex(STL_INFORM_INFO_RECORD *);
 Status_t    sa_ServiceRecInit(void);
 void        sa_ServiceRecDelete(void);
 void        sa_ServiceRecClear(void);
+OpaServiceRecordp sa_ServiceRecAlloc(void);
+int32_t     sa_ServiceRecInsert(ServiceRecKeyp, OpaServiceRecordp);
+OpaServiceRecordp sa_ServiceRecRemove(ServiceRecKeyp);
+void        sa_ServiceRecUnindex(OpaServiceRecordp);
+void        sa_ServiceRecSetExpireTime(OpaServiceRecordp, uint64_t);
 Status_t    sa_McGroupInit(void);
 void        sa_McGroupDelete(void);
+Status_t    sa_PathRecIndexInit(uint32_t, uint32_t);
+void        sa_PathRecIndexUpdate(Topology_t *, int);
 Status_t	sa_Authenticate_Path(STL_LID, STL_LID);
 Status_t	sa_Authenticate_Access(uint32_t, STL_LID, STL_LID, STL_LID);
 Status_t	sa_Compare_Node_Port_PKeys(Node_t*, Port_t*);
@@ -341,6 +424,9 @@ Status_t	sa_MFTableRecord(Mai_t *, sa_cntxt_t* );
 Status_t	sa_NodeRecord(Mai_t *, sa_cntxt_t* );
 Status_t	sa_PartitionRecord(Mai_t *, sa_cntxt_t* );
 Status_t	sa_PathRecord(Mai_t *, sa_cntxt_t* );
+Status_t	sa_PathRecord_Set(uint8_t*, uint32_t*, uint8_t, uint32_t, Port_t*, STL_LID, Port_t*,
+				  STL_LID, PKey_t, uint64_t, uint8_t, uint8_t);
+Status_t	sa_PathRecord_Wildcard(uint8_t*, Port_t *, uint8_t,  uint32_t, uint32_t *, PKey_t, uint8_t, Node_t*, uint64_t, uint8_t);
 Status_t	sa_PortInfoRecord(Mai_t *, sa_cntxt_t* );
 Status_t	sa_SAResponse(Mai_t *, sa_cntxt_t* );
 Status_t	sa_SCSCTableRecord(Mai_t *, sa_cntxt_t* );
@@ -350,6 +436,8 @@ Status_t	sa_SCVLTableRecord(Mai_t *, sa_cntxt_t* );
 Status_t	sa_SMInfoRecord(Mai_t *, sa_cntxt_t* );
 Status_t	sa_ServiceRecord(Mai_t *, sa_cntxt_t* );
 Status_t    sa_ServiceRecord_Age(uint32_t *);
+Status_t	sa_ServiceRecord_DoAdd(uint16_t, STL_SERVICE_RECORD *, uint32_t *, int);
+Status_t	sa_IbServiceRecord_GetTable(Mai_t *, SAResponse_t *, uint32_t *);
 Status_t	sa_SwitchInfoRecord(Mai_t *, sa_cntxt_t* );
 Status_t	sa_Trap(Mai_t *);
 Status_t	sa_VLArbitrationRecord(Mai_t *, sa_cntxt_t* );
@@ -374,6 +462,16 @@ Status_t	sa_DeviceGroupNameRecord(Mai_t *, sa_cntxt_t * );
 Status_t	sa_DeviceTreeMemberRecord(Mai_t *, sa_cntxt_t * );
 Status_t	sa_NodeRecord_BuildCACache(SACacheEntry_t *, Topology_t *);
 Status_t	sa_NodeRecord_BuildSwitchCache(SACacheEntry_t *, Topology_t *);
+Status_t	sa_PortInfoRecord_BuildCache(SACacheEntry_t *, Topology_t *);
+Status_t	sa_LinkRecord_BuildCache(SACacheEntry_t *, Topology_t *);
+Status_t	sa_SwitchInfoRecord_BuildCache(SACacheEntry_t *, Topology_t *);
+Status_t	sa_VFabricRecord_BuildCache(SACacheEntry_t *, Topology_t *);
+Status_t	sa_LFTableRecord_BuildCache(SACacheEntry_t *, Topology_t *);
+Status_t	sa_PortInfoRecord_GetTable(Mai_t *, uint32_t *, SACacheEntry_t **);
+Status_t	sa_LinkRecord_GetTable(Mai_t *, uint32_t *, SACacheEntry_t **);
+Status_t	sa_SwitchInfoRecord_GetTable(Mai_t *, uint32_t *, SACacheEntry_t **);
+Status_t	sa_VFabric_GetTable(Mai_t *, uint32_t *, SACacheEntry_t **);
+Status_t	sa_LFTableRecord_GetTable(Mai_t *, uint32_t *, SACacheEntry_t **);
 
 Status_t	sa_SwitchCostRecord(Mai_t *, sa_cntxt_t* );
 
@@ -386,7 +484,13 @@ Status_t	sa_process_getmulti(Mai_t *, sa_cntxt_t*);
 Status_t	sa_process_mad(Mai_t *, sa_cntxt_t*);
 Status_t    sa_process_inflight_rmpp_request(Mai_t *, sa_cntxt_t*);
 void		sa_main_reader(uint32_t, uint8_t **);
+void		sa_main_reader_process(Mai_t *, uint64_t, const SAReaderOps_t *);
+Status_t	sa_workers_start(uint32_t, uint64_t, const SAReaderOps_t *);
+Status_t	sa_workers_submit(Mai_t *);
+void		sa_workers_stop(void);
 void		sa_main_writer(uint32_t argc, uint8_t ** argv);
+Status_t	sa_cntxt_init(void);
+void		sa_cntxt_table_info(uint32_t *, uint32_t *, uint32_t *);
 void        sa_cntxt_age(void);
 sa_cntxt_t* sa_cntxt_find( Mai_t* );
 SAContextGet_t	sa_cntxt_get( Mai_t*, void**);
@@ -394,16 +498,27 @@ Status_t   	sa_cntxt_release( sa_cntxt_t* );
 Status_t	sa_cntxt_reserve( sa_cntxt_t* );
 Status_t	sa_cntxt_data( sa_cntxt_t*, void*, uint32_t );
 Status_t	sa_cntxt_data_cached(sa_cntxt_t *, void *, uint32_t, SACacheEntry_t *);
+Status_t	sa_cntxt_data_resp(sa_cntxt_t *, SAResponse_t *);
 void        sa_cntxt_clear(void);
 Status_t	sa_SetDefBcGrp( void );
 
 Status_t	sa_cache_init(void);
 Status_t	sa_cache_alloc_transient(SACacheEntry_t *[], int, SACacheEntry_t **);
 Status_t	sa_cache_get(int, SACacheEntry_t **);
+SACacheEntry_t *sa_cache_lookup(int);
+Status_t	sa_cache_alloc_records(SACacheEntry_t *, uint32_t, uint32_t, uint8_t **);
 void		sa_cache_clean(void);
 Status_t	sa_cache_release(SACacheEntry_t *);
 Status_t    sa_cache_cntxt_free(sa_cntxt_t *);
 
+Status_t	sa_resp_alloc(uint32_t, SAResponse_t **);
+void		sa_resp_hold(SAResponse_t *);
+void		sa_resp_release(SAResponse_t *);
+uint8_t *	sa_resp_reserve(SAResponse_t *, uint32_t, uint32_t);
+void		sa_resp_commit(SAResponse_t *, uint32_t, uint32_t, uint32_t *);
+void		sa_resp_copy(SAResponse_t *, uint32_t, uint8_t *, uint32_t);
+uint8_t		sa_resp_checksum(SAResponse_t *);
+
 char *      sa_getMethodText(int method);
 char *      sa_getAidName(uint16_t aid);
 
@@ -471,14 +471,40 @@ void INCREMENT_MAD_STATUS_COUNTERS(Mai_t * mad) {
 	}
 }
 
+//
+// Per-phase sweep timing.  topology_main() records the elapsed time of each
+// sweep_functions[] entry and of the sweep as a whole.  The most recent
+// SM_SWEEP_PHASE_HISTORY samples of each phase are kept so that percentiles
+// can be reported alongside the running min/max/mean.  Times are in usec.
+//
+#define SM_SWEEP_PHASE_MAX		32
+#define SM_SWEEP_PHASE_HISTORY	64
+
+typedef struct {
+	const char *	name;
+	uint32_t		count;		// samples since the stats were last cleared
+	uint32_t		next;		// next slot to overwrite in history[]
+	uint64_t		last;
+	uint64_t		min;
+	uint64_t		max;
+	uint64_t		total;
+	uint64_t		history[SM_SWEEP_PHASE_HISTORY];
+} sm_sweep_phase_stats_t;
+
+extern sm_sweep_phase_stats_t smSweepPhaseStats[SM_SWEEP_PHASE_MAX];
+extern uint32_t smSweepPhaseCount;
+
 // Function prototypes
 extern void sm_init_counters(void);
 extern void sm_process_sweep_counters(void);
 extern void sm_reset_counters(void);
 extern void sm_print_counters_to_stream(FILE * out);
+extern void sm_record_sweep_phase(const char * name, uint64_t elapsed);
+extern void sm_get_sweep_phase_stats(sm_sweep_phase_stats_t * stats, uint32_t * count);
 
 #ifndef __VXWORKS__
 extern char * sm_print_counters_to_buf(void);
+extern char * sm_print_sweep_phase_stats_to_buf(char * buf, int * len);
 #endif
 
 #endif	// _SM_COUNTERS_H_
@@ -340,6 +340,15 @@ typedef struct {
 	STL_HFI_CONGESTION_CONTROL_TABLE hfiCongCon;
 } HfiCongestionControlTableRefCount_t;
 
+// Async SMA request statistics of a node, carried over between sweeps
+typedef struct {
+	uint32_t	responses;	// responses received
+	uint32_t	late;		// responses received only after a retry
+	uint32_t	timeouts;	// requests that timed out on every attempt
+	uint32_t	shrinks;	// times the window was reduced
+	uint64_t	respTime;	// total response time of the responses, in usec
+} SmaDispatchStats_t;
+
 //
 //	Per Port structure.
 //
@@ -512,8 +521,11 @@ typedef	struct _Node {
 	bitset_t	vfMember;
 	bitset_t	fullPKeyMember;
 	bitset_t	dgMembership;
-	uint8_t     asyncReqsSupported; // number of async requests node can handle
+	uint8_t     asyncReqsSupported; // window of async requests node can handle
 	uint8_t     asyncReqsOutstanding; // number of async requests on the wire
+	uint8_t     asyncReqsLossWindow; // window at which a request was last lost
+	uint16_t    asyncReqsAcked; // timely responses since the window last changed
+	SmaDispatchStats_t asyncStats;
 	uint8_t		portsInInit; 
 	uint8_t		activeVLs; 
 	uint8_t		arbCap;			// capability of switch internal
@@ -711,6 +723,27 @@ static __inline__ int sm_path_portmask_pop_first(SmPathPortmask_t * ports) {
  */
 #define SM_PATH_SIZE(NumSwitches) ((NumSwitches) * SM_PATH_SWITCH_SPAN(NumSwitches))
 
+/**
+	Compact form of the cost and path matrices, built once a routing module
+	has finished computing them.
+
+	Costs take one byte per switch pair when every finite cost fits below
+	SM_COST_MATRIX_INFINITY_8, two bytes otherwise.  Next hop portmasks are
+	deduplicated per source switch: each pair holds an index into the
+	distinct portmasks of its row, which start at masks[rowOffset[i]].
+ */
+#define SM_COST_MATRIX_INFINITY_8	0xFF
+
+typedef struct _SmCostMatrix {
+	uint32_t			switches;	// switch index space the matrix covers
+	uint8_t				costWidth;	// bytes per cost entry, 1 or 2
+	void				*cost;		// switches * switches entries of costWidth bytes
+	uint16_t			*pathIndex;	// switches * switches indices into the row's portmasks
+	uint32_t			*rowOffset;	// first portmask of each row
+	SmPathPortmask_t	*masks;		// distinct portmasks of all rows
+	uint32_t			numMasks;
+} SmCostMatrix_t;
+
 //
 // Routing structures
 //
@@ -904,8 +937,9 @@ typedef struct _RoutingFuncs {
 
 	/**
 		Delete any routing data associated with a node in the topology.
+		Routing data may have been allocated from sm_topo_pool().
 	*/
-	void (*delete_node)(struct _Node *);
+	void (*delete_node)(struct _Topology *, struct _Node *);
 
 	/**
 		Number of VLs that can be shared between the same SL type of different
@@ -1021,6 +1055,8 @@ typedef	struct _Topology {
 
 	uint16_t         *cost; // array for path resolution (cost matrix)
 	SmPathPortmask_t *path; // array for path resolution (next-hop matrix, each entry is a portmask of best next hops)
+	SmCostMatrix_t   costMatrix; // compact cost and path matrices, replaces cost and path once routing is calculated
+	uint8_t          costMatrixBfs; // cost matrix was computed by the BFS engine rather than Floyd's algorithm
 
 	Node_t		*node_head;	// linked list of nodes
 	Node_t		*node_tail;	// ditto
@@ -1048,6 +1084,8 @@ typedef	struct _Topology {
 	uint16_t	numLoopPaths; // number of loop paths in fabric
 	LoopPath_t	*loopPaths; // loop paths in fabric
 	Node_t		**nodeArray;	// Array of all nodes
+	Port_t		**lidPortArray;	// Port owning each unicast LID, built by sweep_resolve()
+	STL_LID		lidPortArrayMax;	// last LID covered by lidPortArray
 	cl_qmap_t	*nodeMap;	// Sorted GUID tree of all nodes
 	cl_qmap_t	*portMap;	// Sorted GUID tree of all ports
 	cl_qmap_t	*nodeIdMap; // Sorted Node tree based on the locally assigned node id.
@@ -1057,6 +1095,7 @@ typedef	struct _Topology {
 	uint8_t		maxISLMtu;		// Maximum ISL MTU value seen in the fabric
 	uint8_t		maxISLRate;		// Maximum ISL rate value seen in the fabric
 	uint8_t		qosEnforced; // QoS is being enforced based on fabric parameters
+	uint32_t	mftGeneration; // sm_calculate_mfts() pass that produced the switch MFTs
 
 	/// Allocated in sm_routing_makeModule(), freed in either topology_release_saved_topology() and/or topology_clearNew()
 	RoutingModule_t * routingModule;
@@ -1080,16 +1119,44 @@ typedef	struct _Topology {
 
 	/// Store switch lids for efficient cost queries
 	cl_qmap_t	* switchLids;
+
+	/// VMEM_ARENA pool for objects that live exactly as long as this
+	/// topology (nodes, port data, their bitsets and MFTs).  Released in
+	/// one shot by topology_free_topology(); see sm_topo_pool().
+	Pool_t		* arena;
 #ifdef __VXWORKS__
 	uint8_t		pad[8192];	// general scratch pad area for ESM
 #endif
 } Topology_t;
 
+//
+// Pool for objects that live exactly as long as topop.  Falls back to sm_pool
+// for topologies built without an arena.  Memory from it must be released
+// through the same pool, and never outlives the topology.
+//
+static __inline__ Pool_t * sm_topo_pool(Topology_t *topop) {
+	return (topop && topop->arena) ? topop->arena : &sm_pool;
+}
+
+Status_t sm_topology_arena_create(Topology_t *topop);
+void sm_topology_arena_delete(Topology_t *topop);
+Status_t topology_free_topology(Topology_t *topop, boolean need_old_topo_lock, boolean freeRoutingMod);
+void sm_topology_publish(Topology_t *retired);
+
 Status_t sm_lidmap_alloc(void);
 void sm_lidmap_free(void);
 Status_t sm_lidmap_reset(void);
 Status_t sm_lidmap_update_missing(void);
 
+#define SM_LID_ALLOC_MAX_LMC	7
+Status_t sm_lid_alloc_init(STL_LID maxLid);
+void sm_lid_alloc_free(void);
+void sm_lid_alloc_reset(void);
+void sm_lid_alloc_reserve(STL_LID lid, STL_LID count);
+void sm_lid_alloc_claim(STL_LID lid, STL_LID count);
+void sm_lid_alloc_release(STL_LID lid, STL_LID count);
+STL_LID sm_lid_alloc_find(uint8_t lmc);
+
 struct MissingLidEntry;
 
 typedef	struct {
@@ -1118,6 +1185,8 @@ typedef struct MissingLidEntry {
 //
 typedef	struct _McMember {
 	struct _McMember	*next;
+	struct _McMember	**prevp;	// link that points at this member
+	struct _McMember	*gidNext;	// group's PortGID index chain
 	STL_LID			slid;
 	uint8_t			proxy;
 	uint8_t			state;
@@ -1139,10 +1208,14 @@ typedef enum {
 
 typedef enum {
 	McGroupUnrealizable = (1 << 0), // Signifies that the group has become unrealizable
+	McGroupMftDirty = (1 << 1),     // Membership changed since the group's MFT entries were computed
 } McGroupFlags;
 
 typedef	struct _McGroup {
 	struct _McGroup		*next;
+	struct _McGroup		**prevp;	// link that points at this group
+	struct _McGroup		*mgidNext;	// sm_McGroupsByMgid chain
+	struct _McGroup		*mlidNext;	// sm_McGroupsByMlid chain
 	IB_GID			mGid;
 	uint32_t		members_full;
 	uint32_t		qKey;
@@ -1157,6 +1230,9 @@ typedef	struct _McGroup {
 	uint8_t			tClass;
 	uint8_t			scope;
 	McMember_t		*mcMembers;
+	McMember_t		**memberIndex;	// mcMembers hashed by PortGID, may be NULL
+	uint32_t		memberMask;	// memberIndex chains - 1
+	uint32_t		numMembers;
 	uint32_t		index_pool; /* Next index to use for new Mc Member records */
 	bitset_t		vfMembers;
 	bitset_t		new_vfMembers;
@@ -1239,6 +1315,10 @@ typedef struct {
 // context code)
 #define SM_DISPATCH_STALL_THRESHOLD 7 // (0 - 255)
 
+// full windows of timely responses a node needs before its window is grown
+// back to, or past, the window at which it last lost a request
+#define SM_DISPATCH_PROBE_WINDOWS 256
+
 typedef struct sm_dispatch_send_params {
 	SmMaiHandle_t *fd;
 	uint32_t method;
@@ -1402,6 +1482,41 @@ static __inline__ void setResweepReason(SweepReason_t reason) {
 #define	Min(X,Y)		((X) < (Y) ? (X) : (Y))
 #define	Max(X,Y)		((X) > (Y) ? (X) : (Y))
 
+//
+//	Cost and path matrix accessors.  Routing modules compute into the
+//	dense cost and path arrays; once sm_routing_compact_cost_matrix() has
+//	run the same values are read from the compact form.  Indices are switch
+//	indices (swIdx) within the topology passed in.
+//
+static __inline__ int sm_cost_matrix_valid(const Topology_t *topop) {
+	return topop->cost != NULL || topop->costMatrix.cost != NULL;
+}
+
+static __inline__ uint16_t sm_cost_matrix_cost(const Topology_t *topop, int i, int j) {
+	const SmCostMatrix_t *cm = &topop->costMatrix;
+	size_t ij;
+	uint8_t cost8;
+
+	if (topop->cost)
+		return topop->cost[(size_t)i * topop->max_sws + j];
+
+	ij = (size_t)i * cm->switches + j;
+	if (cm->costWidth == 1) {
+		cost8 = ((const uint8_t *)cm->cost)[ij];
+		return cost8 == SM_COST_MATRIX_INFINITY_8 ? Cost_Infinity : cost8;
+	}
+	return ((const uint16_t *)cm->cost)[ij];
+}
+
+static __inline__ const SmPathPortmask_t *sm_cost_matrix_path(const Topology_t *topop, int i, int j) {
+	const SmCostMatrix_t *cm = &topop->costMatrix;
+
+	if (topop->path)
+		return &topop->path[(size_t)i * topop->max_sws + j];
+
+	return &cm->masks[cm->rowOffset[i] + cm->pathIndex[(size_t)i * cm->switches + j]];
+}
+
 #define	PathToPort(NP,PP)	((NP)->nodeInfo.NodeType == NI_TYPE_SWITCH ? 	\
 				(NP)->path : (PP)->path)
 
@@ -1651,31 +1766,26 @@ static __inline__ Port_t * sm_get_node_end_port(Node_t *nodep) {
 //	Macros for allocating Multicast Groups and Members
 //
 #define	McGroup_Enqueue(GROUPP) {						\
-	if (sm_McGroups == NULL) {						\
-		GROUPP->next = NULL;						\
-		sm_McGroups = GROUPP;						\
-	} else {								\
-		GROUPP->next = sm_McGroups;					\
-		sm_McGroups = GROUPP;						\
+	if ((GROUPP->next = sm_McGroups) != NULL) {				\
+		sm_McGroups->prevp = &GROUPP->next;				\
 	}									\
+	GROUPP->prevp = &sm_McGroups;						\
+	sm_McGroups = GROUPP;							\
+	sm_multicast_index_group(GROUPP);					\
 }
 
 #define	McGroup_Dequeue(GROUPP) {						\
-	McGroup_t		*localGroup;					\
-										\
-	if (sm_McGroups == GROUPP) {						\
-		sm_McGroups = (GROUPP)->next;					\
-	} else {								\
-		for_all_multicast_groups(localGroup) {				\
-			if (localGroup->next == GROUPP) {			\
-				localGroup->next = (GROUPP)->next;		\
-				break;						\
-			}							\
-		}								\
+	sm_multicast_unindex_group(GROUPP);					\
+	if ((*(GROUPP)->prevp = (GROUPP)->next) != NULL) {			\
+		(GROUPP)->next->prevp = (GROUPP)->prevp;			\
 	}									\
 }
 
-#define	McGroup_Create(GROUPP) {						\
+//
+//	The MGID and MLID a group is indexed under are set here and must not
+//	change until the group is deleted.
+//
+#define	McGroup_Create(GROUPP,MGID,MLID) {					\
 	size_t		local_size;						\
 	Status_t	local_status;						\
 										\
@@ -1686,6 +1796,9 @@ static __inline__ Port_t * sm_get_node_end_port(Node_t *nodep) {
 	}									\
 										\
 	memset((void *)GROUPP, 0, local_size);					\
+	GROUPP->mGid = (MGID);							\
+	GROUPP->mLid = (MLID);							\
+	GROUPP->flags = McGroupMftDirty;					\
 	if (!bitset_init(&sm_pool, &GROUPP->vfMembers, MAX_VFABRICS)) { \
 		IB_FATAL_ERROR_NODUMP("McGroup_Create: can't allocate space");				\
 	}									\
@@ -1705,6 +1818,9 @@ static __inline__ Port_t * sm_get_node_end_port(Node_t *nodep) {
 	McGroup_Dequeue(GROUPP);						\
 	bitset_free(&GROUPP->vfMembers); \
 	bitset_free(&GROUPP->new_vfMembers); \
+	if (GROUPP->memberIndex) {						\
+		(void)vs_pool_free(&sm_pool, (void *)GROUPP->memberIndex);	\
+	}									\
 	local_status = vs_pool_free(&sm_pool, (void *)GROUPP);			\
 	if (local_status != VSTATUS_OK) {					\
 		IB_FATAL_ERROR("can't free space");				\
@@ -1712,31 +1828,26 @@ static __inline__ Port_t * sm_get_node_end_port(Node_t *nodep) {
 }
 
 #define	McMember_Enqueue(GROUPP,MEMBERP) {					\
-	if (GROUPP->mcMembers == NULL) {					\
-		MEMBERP->next = NULL;						\
-		GROUPP->mcMembers = MEMBERP;					\
-	} else {								\
-		MEMBERP->next = GROUPP->mcMembers;				\
-		GROUPP->mcMembers = MEMBERP;					\
+	if ((MEMBERP->next = GROUPP->mcMembers) != NULL) {			\
+		GROUPP->mcMembers->prevp = &MEMBERP->next;			\
 	}									\
+	MEMBERP->prevp = &GROUPP->mcMembers;					\
+	GROUPP->mcMembers = MEMBERP;						\
+	sm_multicast_index_member(GROUPP, MEMBERP);				\
 }
 
 #define	McMember_Dequeue(GROUPP,MEMBERP) {					\
-	McMember_t		*localMember;					\
-										\
-	if ((GROUPP)->mcMembers == MEMBERP) {					\
-		(GROUPP)->mcMembers = (MEMBERP)->next;				\
-	} else {								\
-		for_all_multicast_members(GROUPP, localMember) {		\
-			if (localMember->next == MEMBERP) {			\
-				localMember->next = (MEMBERP)->next;		\
-				break;						\
-			}							\
-		}								\
+	sm_multicast_unindex_member(GROUPP, MEMBERP);				\
+	if ((*(MEMBERP)->prevp = (MEMBERP)->next) != NULL) {			\
+		(MEMBERP)->next->prevp = (MEMBERP)->prevp;			\
 	}									\
 }
 
-#define	McMember_Create(GROUPP,MEMBERP) { 					\
+//
+//	As with groups, the PortGID a member is indexed under is set here and
+//	must not change; copies of a request into record must carry the same one.
+//
+#define	McMember_Create(GROUPP,MEMBERP,PORTGID) { 				\
 	size_t		local_size;						\
 	Status_t	local_status;						\
 										\
@@ -1747,14 +1858,17 @@ static __inline__ Port_t * sm_get_node_end_port(Node_t *nodep) {
 	}									\
 										\
 	memset((void *)MEMBERP, 0, local_size);					\
+	MEMBERP->record.RID.PortGID = (PORTGID);				\
 	MEMBERP->index = ++GROUPP->index_pool;				 \
 	McMember_Enqueue(GROUPP, MEMBERP);					\
+	GROUPP->flags |= McGroupMftDirty;					\
 }
 
 #define	McMember_Delete(GROUPP,MEMBERP) {					\
 	Status_t	local_status;						\
 										\
 	McMember_Dequeue(GROUPP, MEMBERP);					\
+	GROUPP->flags |= McGroupMftDirty;					\
 	local_status = vs_pool_free(&sm_pool, (void *)MEMBERP);			\
 	if (local_status != VSTATUS_OK) {					\
 		IB_FATAL_ERROR("can't free space");				\
@@ -1895,9 +2009,6 @@ extern 	uint32_t 	sm_needed_vls;
 extern 	uint32_t 	sm_def_mc_group;
 extern  uint8_t		sm_env[32];
 extern	STL_LID 	sm_lid;
-extern	STL_LID 	sm_lmc_0_freeLid_hint;
-extern	STL_LID 	sm_lmc_e0_freeLid_hint;
-extern	STL_LID 	sm_lmc_freeLid_hint;
 extern	uint32_t	sm_state;
 extern  uint32_t	sm_prevState;
 extern  int			sm_saw_another_sm;
@@ -1976,7 +2087,7 @@ extern uint32_t	sm_mcRootCostDeltaThreshold;
 extern uint32_t sm_numMcGroups;
 extern ATOMIC_UINT sm_McGroups_Need_Prog;
 extern	McGroup_t	*sm_McGroups;
-extern  Lock_t      sm_McGroups_lock;
+extern  Lock_t      sm_McGroups_lock;	// rwlock: vs_rdlock() for lookups, vs_lock() to change groups
 
 extern uint64_t sm_mcSpanningTreeRootGuid;
 extern Lock_t sm_mcSpanningTreeRootGuidLock;
@@ -2233,6 +2344,32 @@ void		topology_rcv(uint32_t, uint8_t **);
 
 void sm_portinfo_nop_init(STL_PORT_INFO *pi);
 
+//
+//	LFT writes planned for switches whose programmed LFT is known from the
+//	previous topology.  Only the blocks that differ are written, in runs of
+//	up to lft_multi_block blocks, and writes of a later wave are only sent
+//	once every write of the earlier waves has completed.
+//
+typedef struct {
+	Node_t		*switchp;
+	uint32_t	block;			// first LFT block of the SMP
+	uint16_t	numBlocks;
+	uint16_t	wave;
+} SmLftWrite_t;
+
+typedef struct {
+	SmLftWrite_t	*writes;	// ordered by wave
+	uint32_t		numWrites;
+	uint32_t		numWaves;
+	uint32_t		changedBlocks;
+	uint32_t		fullSwitches;	// written in full; no more SMPs than their changes
+	bitset_t		switches;	// swIdx of the switches planned for
+} SmLftWritePlan_t;
+
+Node_t		*sm_lft_delta_base(Topology_t *oldtp, Node_t *switchp);
+Status_t	sm_plan_lft_writes(Topology_t *topop, Topology_t *oldtp, SwitchList_t *swlist, SmLftWritePlan_t *plan);
+void		sm_free_lft_write_plan(SmLftWritePlan_t *plan);
+
 Status_t	sm_calculate_lft(Topology_t *topop, Node_t *switchp);
 Status_t	sm_write_minimal_lft_blocks(Topology_t *topop, Node_t *switchp, SmpAddr_t * addr);
 Status_t	sm_write_full_lfts_by_block_LR(Topology_t *topop, SwitchList_t *swlist, int rebalance);
@@ -2390,6 +2527,11 @@ Status_t	sm_mark_new_endnode(Node_t * nodep);
 int      sm_get_route(Topology_t *, Node_t *, uint8_t, STL_LID, uint8_t*);
 uint8_t  sm_get_slsc(Topology_t *, Port_t*, uint8_t);
 Status_t sm_routing_copy_cost_matrix(Topology_t *src_topop, Topology_t *dst_topop);
+Status_t sm_routing_compact_cost_matrix(Topology_t *topop);
+void     sm_routing_remap_cost_matrix(Topology_t *topop, const uint32_t *oldIdx, uint32_t switches);
+void     sm_routing_expand_cost_matrix(Topology_t *topop, uint16_t *cost, SmPathPortmask_t *path);
+void     sm_routing_free_cost_matrix(Topology_t *topop);
+size_t   sm_routing_cost_matrix_size(Topology_t *topop);
 Status_t sm_routing_prep_new_switch(Topology_t *topop, Node_t *nodep, SmpAddr_t *addr);
 Status_t sm_routing_route_switch_LR(Topology_t *topop, SwitchList_t *swlist, int rebalance);
 Status_t sm_routing_route_new_switch_LR(Topology_t *topop, SwitchList_t *swlist, int rebalance);
@@ -2410,6 +2552,9 @@ extern Status_t sm_routing_func_post_process_routing_copy_noop(Topology_t *src_t
 extern Status_t sm_routing_func_alloc_cost_matrix_floyds(Topology_t *topop);
 extern Status_t sm_routing_func_init_cost_matrix_floyds(Topology_t *topop);
 extern Status_t sm_routing_func_calc_cost_matrix_floyds(Topology_t * topop, int switches, unsigned short * cost, SmPathPortmask_t * path);
+extern Status_t sm_routing_func_calc_cost_matrix_bfs(Topology_t * topop, int switches, unsigned short * cost, SmPathPortmask_t * path);
+extern Status_t sm_routing_func_update_cost_matrix(Topology_t *old_topop, Topology_t *new_topop);
+extern void sm_routing_func_floyds_blocked(int switches, unsigned short * cost, SmPathPortmask_t * path);
 extern int sm_routing_func_routing_mode_noop(void);
 extern int sm_routing_func_routing_mode_linear(void);
 extern boolean sm_routing_func_false(void);
@@ -2421,6 +2566,8 @@ extern Status_t sm_routing_func_copy_routing_lfts(Topology_t *src_topop, Topolog
 extern Status_t sm_routing_func_init_switch_routing_lfts(Topology_t * topop, int * routing_needed, int * rebalance);
 extern Status_t sm_routing_func_calculate_lft(Topology_t * topop, Node_t * switchp);
 extern Status_t sm_routing_func_setup_xft(Topology_t *topop, Node_t *switchp, Node_t *nodep, Port_t *orig_portp, uint8_t *portnos);
+extern Status_t sm_routing_func_setup_xft_candidates(Topology_t *topop, Node_t *switchp, Node_t *nodep, Port_t *orig_portp, uint8_t *portnos, const SwitchportToNextGuid_t *candidates, int numCandidates);
+extern int sm_routing_func_xft_dest_index(Topology_t *topop, Node_t *nodep, Port_t *orig_portp);
 extern int sm_routing_func_select_ports(Topology_t *topop, Node_t *switchp, int endIndex, SwitchportToNextGuid_t *ordered_ports, boolean selectBest);
 extern Status_t sm_routing_func_setup_pgs(struct _Topology *topop, struct _Node * srcSw, struct _Node * dstSw);
 extern int sm_routing_func_get_port_group(Topology_t *topop, Node_t *switchp, Node_t *nodep, uint8_t *portnos);
@@ -2497,6 +2644,8 @@ Status_t sm_dispatch_wait(sm_dispatch_t *disp);
 void sm_dispatch_clear(sm_dispatch_t *disp);
 Status_t sm_dispatch_update(sm_dispatch_t *disp);
 void sm_dispatch_bump_passcount(sm_dispatch_t *disp);
+void sm_dispatch_init_node(Node_t *nodep, Node_t *oldnodep);
+void sm_dispatch_adjust_window(Node_t *nodep, Status_t status, uint64_t respTime, boolean windowFull);
 
 //
 // sm_partMgr.c prototypes
@@ -2675,9 +2824,17 @@ Status_t	sm_multicast_gid_check(IB_GID);
 Status_t	sm_multicast_gid_assign(uint32_t, IB_GID);
 Status_t	sm_multicast_gid_valid(uint8_t, IB_GID);
 Status_t	sm_calculate_mfts(void);
+Status_t	sm_calculate_mfts_incremental(void);
 Status_t	sm_set_all_mft(int force, Topology_t *curr_tp, Topology_t *prev_tp);
 Status_t	sm_multicast_switch_mft_copy(void);
 McGroup_t	*sm_find_multicast_gid(IB_GID);
+McGroup_t	*sm_find_multicast_mlid(STL_LID);
+McGroup_t	*sm_find_next_multicast_mlid(McGroup_t *);
+void		sm_multicast_index_group(McGroup_t *);
+void		sm_multicast_unindex_group(McGroup_t *);
+void		sm_multicast_index_member(McGroup_t *, McMember_t *);
+void		sm_multicast_unindex_member(McGroup_t *, McMember_t *);
+void		sm_multicast_index_clear(void);
 Status_t	sm_multicast_assign_lid(IB_GID mGid, PKey_t pKey, uint8_t mtu, uint8_t rate, STL_LID requestedLid, STL_LID * lid);
 Status_t	sm_multicast_decommision_group(McGroup_t * group);
 McGroup_t	*sm_find_next_multicast_gid(IB_GID);
@@ -2820,6 +2977,25 @@ Status_t	sm_dump_state(const char * dumpDir);
 */
 Status_t sm_Node_init_lft(Node_t * switchp, size_t * outSize);
 
+///@return number of remaining references to the LFT
+uint32 sm_Node_release_lft(Node_t * switchp);
+
+/**
+	Get the LFT of @c switchp for writing.  If the table is still shared with
+	the previous topology, gives @c switchp a private copy first.
+
+	@return LFT of @c switchp, or NULL if there is none or the copy could not be allocated.
+*/
+PORT * sm_Node_get_lft_wr(Node_t * switchp);
+
+/**
+	Carry the LFT of @c src over to @c dest.  With LftCarryOver enabled and
+	an unchanged LinearFDBTop the table is shared; otherwise @c dest gets a
+	new table initialized from @c src.  Callers that go on to modify the
+	table must use sm_Node_get_lft_wr().
+*/
+Status_t sm_Node_copy_lft(Node_t * dest, const Node_t * src);
+
 void sm_node_release_changes(Node_t * nodep);
 
 Status_t sm_port_init_changes(Port_t * portp);
@@ -2886,6 +3062,7 @@ PortData_t *sm_alloc_port(Topology_t *topop, Node_t *nodep, uint32_t portIndex);
 void        sm_free_port(Topology_t *topop, Port_t * portp);
 void        sm_node_free_port(Topology_t *topop, Node_t *nodep);
 Status_t    sm_build_node_array(Topology_t *topop);
+Status_t    sm_build_lid_port_array(Topology_t *topop);
 Status_t    sm_clearIsSM(void);
 extern uint8_t sm_isActive(void);
 extern uint8_t sm_isDeactivated(void);
@@ -3007,14 +3184,14 @@ Node_t * Node_Create(Topology_t *topop, const STL_NODE_INFO *nodeInfo,
 	Node_t *nodep = NULL;
 
 	local_size = sizeof(Node_t) + (portCount * sizeof(Port_t)) + 16;
-	local_status = vs_pool_alloc(&sm_pool, local_size, (void *)&nodep);
+	local_status = vs_pool_alloc(sm_topo_pool(topop), local_size, (void *)&nodep);
 	if (local_status == VSTATUS_OK) {
 		memset((void *)nodep, 0, local_size);
 		nodep->nodeInfo = *nodeInfo;
 		nodep->nodeDesc = *nodeDesc;
 		memcpy(nodeDescStr, nodeDesc->NodeString, ND_LEN);
 		if (strlen(nodeDescStr) == ND_LEN) {
-			local_status = vs_pool_alloc(&sm_pool, ND_LEN+1, (void *)&nodep->nodeDescString);
+			local_status = vs_pool_alloc(sm_topo_pool(topop), ND_LEN+1, (void *)&nodep->nodeDescString);
 			if (local_status != VSTATUS_OK) {
 				IB_FATAL_ERROR_NODUMP("Can't allocate space for node's description");
 			}
@@ -3025,9 +3202,9 @@ Node_t * Node_Create(Topology_t *topop, const STL_NODE_INFO *nodeInfo,
 				Node_Enqueue_Type(topop, nodep, ca_head, ca_tail);
 			} else if (nodeType == NI_TYPE_SWITCH) {
 			  if (sm_mcast_mlid_table_cap) {
-				local_status = vs_pool_alloc(&sm_pool, sizeof(STL_PORTMASK*) * sm_mcast_mlid_table_cap, (void*)&nodep->mft);
+				local_status = vs_pool_alloc(sm_topo_pool(topop), sizeof(STL_PORTMASK*) * sm_mcast_mlid_table_cap, (void*)&nodep->mft);
 				if (local_status == VSTATUS_OK) {
-					local_status = vs_pool_alloc(&sm_pool, sizeof(STL_PORTMASK) * sm_mcast_mlid_table_cap * STL_MFTABLE_POSITION_COUNT, (void*)&nodep->mft[0]);
+					local_status = vs_pool_alloc(sm_topo_pool(topop), sizeof(STL_PORTMASK) * sm_mcast_mlid_table_cap * STL_MFTABLE_POSITION_COUNT, (void*)&nodep->mft[0]);
 					if (local_status == VSTATUS_OK) {
 						memset((void *)nodep->mft[0], 0, (sizeof(STL_PORTMASK) * sm_mcast_mlid_table_cap * STL_MFTABLE_POSITION_COUNT));
 						for (local_i = 1; local_i < sm_mcast_mlid_table_cap; ++local_i) {
@@ -3044,12 +3221,12 @@ Node_t * Node_Create(Topology_t *topop, const STL_NODE_INFO *nodeInfo,
 				Node_Enqueue_Type(topop, nodep, switch_head, switch_tail);
 			  }
 			}
-			if (!bitset_init(&sm_pool, &nodep->activePorts, portCount) ||
-				!bitset_init(&sm_pool, &nodep->initPorts, portCount) ||
+			if (!bitset_init(sm_topo_pool(topop), &nodep->activePorts, portCount) ||
+				!bitset_init(sm_topo_pool(topop), &nodep->initPorts, portCount) ||
 
-				!bitset_init(&sm_pool, &nodep->vfMember, MAX_VFABRICS) ||
-				!bitset_init(&sm_pool, &nodep->fullPKeyMember, MAX_VFABRICS) ||
-				!bitset_init(&sm_pool, &nodep->dgMembership, MAX_VFABRIC_GROUPS)) {
+				!bitset_init(sm_topo_pool(topop), &nodep->vfMember, MAX_VFABRICS) ||
+				!bitset_init(sm_topo_pool(topop), &nodep->fullPKeyMember, MAX_VFABRICS) ||
+				!bitset_init(sm_topo_pool(topop), &nodep->dgMembership, MAX_VFABRIC_GROUPS)) {
 				IB_FATAL_ERROR_NODUMP("Can't allocate space for node's activePorts");
 			}
 			if (local_status == VSTATUS_OK) {
@@ -3101,20 +3278,17 @@ void Node_Delete(Topology_t *topop, Node_t *nodep)
 	Status_t	local_status;
 
 	if (nodep->mft) {
-		local_status = vs_pool_free(&sm_pool, nodep->mft[0]);
+		local_status = vs_pool_free(sm_topo_pool(topop), nodep->mft[0]);
 		if (local_status != VSTATUS_OK) {
 			IB_FATAL_ERROR("Failed to free node's mft");
 		}
-		local_status = vs_pool_free(&sm_pool, nodep->mft);
+		local_status = vs_pool_free(sm_topo_pool(topop), nodep->mft);
 		if (local_status != VSTATUS_OK) {
 			IB_FATAL_ERROR("Failed to free node's mft pointers");
 		}
 	}
     if (nodep->lft) {
-        local_status = vs_pool_free(&sm_pool, nodep->lft);
-        if (local_status != VSTATUS_OK) {
-            IB_FATAL_ERROR("Failed to free node's lft");
-        }
+        sm_Node_release_lft(nodep);
     }
 	if (nodep->pgt)	{
 		vs_pool_free(&sm_pool, nodep->pgt);
@@ -3123,10 +3297,10 @@ void Node_Delete(Topology_t *topop, Node_t *nodep)
 		sm_Node_release_pgft(nodep);
 	}
 	if (nodep->routingData) {
-		topop->routingModule->funcs.delete_node(nodep);
+		topop->routingModule->funcs.delete_node(topop, nodep);
 	}
 	if (nodep->nodeDescString)	{
-		vs_pool_free(&sm_pool, nodep->nodeDescString);
+		vs_pool_free(sm_topo_pool(topop), nodep->nodeDescString);
 	}
 	if (nodep->portStateInfo) {
 		vs_pool_free(&sm_pool, nodep->portStateInfo);
@@ -3139,7 +3313,7 @@ void Node_Delete(Topology_t *topop, Node_t *nodep)
 	bitset_free(&nodep->dgMembership);
 	sm_node_free_port(topop, nodep);
 	sm_node_release_changes((nodep));
-	local_status = vs_pool_free(&sm_pool, (void *)nodep);
+	local_status = vs_pool_free(sm_topo_pool(topop), (void *)nodep);
 	if (local_status != VSTATUS_OK) {
 		IB_FATAL_ERROR("can't free space");
 	}
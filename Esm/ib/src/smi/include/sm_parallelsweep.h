@@ -191,6 +191,11 @@ void psc_drain_work_queue(ParallelSweepContext_t *psc);
 // Allocates and initializes a PSC.
 ParallelSweepContext_t *psc_init(void);
 
+// Allocates and initializes a PSC without MAI handles, for work items that
+// send no MADs, such as the LFT calculation.  psc_get_mai() must not be
+// called on it.
+ParallelSweepContext_t *psc_init_nomai(void);
+
 // Shuts down the worker threads and releases the MAI handles, then destroys
 // the parallel context. The work queue should be drained before calling this
 // function.
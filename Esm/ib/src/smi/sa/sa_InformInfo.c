@@ -176,6 +176,8 @@ sa_SubscriberClear(void)
 	(void) cs_hashtable_destroy(saSubscribers.subsMap, TRUE);	/* free
 																   everything 
 																 */
+	memset(saSubscribers.trapIndex, 0, sizeof(saSubscribers.trapIndex));
+	saSubscribers.allTraps = NULL;
 	if (NULL ==
 		(saSubscribers.subsMap =
 		 cs_create_hashtable("sa_subscriber", 16, sa_SubscriberHashFromKey,
@@ -187,6 +189,88 @@ sa_SubscriberClear(void)
 	(void) vs_unlock(&saSubscribers.subsLock);
 }
 
+/*
+ * Trap number index of the subscriber table.  A notice only goes to the
+ * subscriptions on the chain for its trap number and to those for
+ * TRAP_ALL, so forwarding a trap does not look at every subscription.  The
+ * values of subsMap are SubscriberEntry_t, which start with the
+ * STL_INFORM_INFO_RECORD the rest of the SM sees.  Records are allocated
+ * with sa_SubscriberAlloc(), and added to and removed from the map with
+ * the functions below, which keep the index in step with it; all of them
+ * must be called with subsLock held.  The trap number is part of the key,
+ * so replacing the InformInfo of an existing subscription never moves it.
+ */
+static __inline__ SubscriberEntry_t **
+sa_SubscriberChain(uint16_t trapnum)
+{
+	if (trapnum == TRAP_ALL)
+		return &saSubscribers.allTraps;
+	return &saSubscribers.trapIndex[trapnum & (SA_SUBSCRIBER_TRAP_CHAINS - 1)];
+}
+
+STL_INFORM_INFO_RECORD *
+sa_SubscriberAlloc(void)
+{
+	SubscriberEntry_t *entry;
+
+	if ((entry = (SubscriberEntry_t *) malloc(sizeof(SubscriberEntry_t))) == NULL)
+		return NULL;
+	memset(entry, 0, sizeof(SubscriberEntry_t));
+	return &entry->record;
+}
+
+/*
+ * Add a record from sa_SubscriberAlloc() to the table under subsKeyp,
+ * which is freed with it.  Returns 0 on failure, leaving both to the
+ * caller, as cs_hashtable_insert() does.
+ */
+int32_t
+sa_SubscriberInsert(SubscriberKeyp subsKeyp, STL_INFORM_INFO_RECORD * iRecordp)
+{
+	SubscriberEntry_t *entry = (SubscriberEntry_t *) iRecordp;
+	SubscriberEntry_t **chainp;
+
+	if (!cs_hashtable_insert(saSubscribers.subsMap, subsKeyp, iRecordp))
+		return 0;
+
+	entry->key = subsKeyp;
+	chainp = sa_SubscriberChain(subsKeyp->trapnum);
+	if ((entry->next = *chainp) != NULL)
+		entry->next->prevp = &entry->next;
+	entry->prevp = chainp;
+	*chainp = entry;
+	return 1;
+}
+
+/*
+ * Take a record out of the index after cs_hashtable_iterator_remove()
+ * took it out of the map.
+ */
+void
+sa_SubscriberUnindex(STL_INFORM_INFO_RECORD * iRecordp)
+{
+	SubscriberEntry_t *entry = (SubscriberEntry_t *) iRecordp;
+
+	if ((*entry->prevp = entry->next) != NULL)
+		entry->next->prevp = entry->prevp;
+	entry->key = NULL;
+}
+
+/*
+ * Remove the record under subsKeyp from the table and return it for the
+ * caller to free, or NULL if there is none.
+ */
+STL_INFORM_INFO_RECORD *
+sa_SubscriberRemove(SubscriberKeyp subsKeyp)
+{
+	STL_INFORM_INFO_RECORD *iRecordp;
+
+	if ((iRecordp = (STL_INFORM_INFO_RECORD *)
+		 cs_hashtable_remove(saSubscribers.subsMap, subsKeyp)) != NULL)
+		sa_SubscriberUnindex(iRecordp);
+	return iRecordp;
+}
+
 /*****************************************************************************/
 
 
@@ -582,9 +666,7 @@ sa_InformInfo_Subscribe(Mai_t * maip, STL_INFORM_INFO * iip, uint8_t ibMode)
 														subsMap,
 														subsKeyp))) {
 		/* allocate a subscriber iRecord for adding to hash table */
-		iRecordp =
-			(STL_INFORM_INFO_RECORD *)
-			malloc(sizeof(STL_INFORM_INFO_RECORD));
+		iRecordp = sa_SubscriberAlloc();
 		if (iRecordp == NULL) {
 			free(subsKeyp);
 			(void) vs_unlock(&saSubscribers.subsLock);
@@ -594,7 +676,6 @@ sa_InformInfo_Subscribe(Mai_t * maip, STL_INFORM_INFO * iip, uint8_t ibMode)
 					VSTATUS_NOMEM);
 			return VSTATUS_NOMEM;
 		}
-		memset(iRecordp, 0, sizeof(STL_INFORM_INFO_RECORD));
 		tmp = saInformCount++;	/* get next sequence number */
 		iRecordp->RID.Enum = tmp;
 		iRecordp->InformInfoData = *iip;
@@ -602,8 +683,7 @@ sa_InformInfo_Subscribe(Mai_t * maip, STL_INFORM_INFO * iip, uint8_t ibMode)
 		/* make copy of record for sync to stanbys */
 		memcpy((void *) &syncRecord, (void *) iRecordp,
 			   sizeof(STL_INFORM_INFO_RECORD));
-		if (!cs_hashtable_insert
-			(saSubscribers.subsMap, subsKeyp, iRecordp)) {
+		if (!sa_SubscriberInsert(subsKeyp, iRecordp)) {
 			free(subsKeyp);
 			free(iRecordp);
 			(void) vs_unlock(&saSubscribers.subsLock);
@@ -723,11 +803,7 @@ sa_InformInfo_Unsubscribe(Mai_t * maip, STL_INFORM_INFO * iip)
 	/* lock out subscribers table */
 	if (vs_lock(&saSubscribers.subsLock) != VSTATUS_OK)
 		return VSTATUS_BAD;
-	if (NULL ==
-		(iRecordp =
-		 (STL_INFORM_INFO_RECORD *) cs_hashtable_remove(saSubscribers.
-														subsMap,
-														&subsKey))) {
+	if (NULL == (iRecordp = sa_SubscriberRemove(&subsKey))) {
 		maip->base.status = MAD_STATUS_SA_NO_RECORDS;
 		IB_LOG_VERBOSE_FMT("sa_InformInfo_Unsubscribe",
 						   "Unsubscribe failed from lid 0x%.8X in topology "
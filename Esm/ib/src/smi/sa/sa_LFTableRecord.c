@@ -62,12 +62,13 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "sm_l.h"
 #include "sa_l.h"
 
-Status_t	sa_LFTableRecord_GetTable(Mai_t *, uint32_t *);
+Status_t	sa_LFTableRecord_GetTable(Mai_t *, uint32_t *, SACacheEntry_t **);
 
 Status_t
 sa_LFTableRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt ) {
 	uint32_t	records;
 	uint16_t	attribOffset;
+	SACacheEntry_t *cache = NULL;
 
 	IB_ENTER("sa_LFTableRecord", maip, 0, 0, 0);
 
@@ -91,7 +92,7 @@ sa_LFTableRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt ) {
 	}
 	// Check Base and Class Version
 	if (maip->base.bversion == STL_BASE_VERSION && maip->base.cversion == STL_SA_CLASS_VERSION) {
-		(void)sa_LFTableRecord_GetTable(maip, &records);
+		(void)sa_LFTableRecord_GetTable(maip, &records, &cache);
 	} else {
 		maip->base.status = MAD_STATUS_BAD_CLASS;
 		IB_LOG_WARN_FMT(__func__, "invalid Base and/or Class Versions: Base %u, Class %u",
@@ -117,7 +118,7 @@ sa_LFTableRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt ) {
 	}
 
     sa_cntxt->attribLen = attribOffset;
-	sa_cntxt_data( sa_cntxt, sa_data, records * attribOffset );
+	sa_cntxt_data_cached( sa_cntxt, sa_data, records * attribOffset, cache );
 	(void)sa_send_reply(maip, sa_cntxt );
 
 	IB_EXIT("sa_LFTableRecord", VSTATUS_OK);
@@ -171,7 +172,7 @@ sa_LFTableRecord_Set(uint8_t *lftp, Node_t *nodep, Port_t *portp, uint16_t index
 }
 
 Status_t
-sa_LFTableRecord_GetTable(Mai_t *maip, uint32_t *records) {
+sa_LFTableRecord_GetTable(Mai_t *maip, uint32_t *records, SACacheEntry_t **outCache) {
 	uint8_t		*data;
 	uint32_t	bytes;
 	uint32_t	index;
@@ -184,6 +185,7 @@ sa_LFTableRecord_GetTable(Mai_t *maip, uint32_t *records) {
 	IB_ENTER("sa_LFTableRecord_GetTable", maip, *records, 0, 0);
 
 	*records = 0;
+	*outCache = NULL;
 	data = sa_data;
 	bytes = Calculate_Padding(sizeof(STL_LINEAR_FORWARDING_TABLE_RECORD));
 
@@ -216,6 +218,14 @@ sa_LFTableRecord_GetTable(Mai_t *maip, uint32_t *records) {
 		return(status);
 	}
 
+	// every block of every switch is built once per sweep
+	if (!checkLid && !samad.header.mask && maip->base.method == SA_CM_GETTABLE &&
+		(*outCache = sa_cache_lookup(SA_CACHE_LFTS)) != NULL) {
+		*records = (*outCache)->records;
+		IB_EXIT("sa_LFTableRecord_GetTable", VSTATUS_OK);
+		return(VSTATUS_OK);
+	}
+
 //
 //      Load the LFTableRecords in the sa_data response
 //
@@ -265,3 +275,51 @@ done:
 	IB_EXIT("sa_LFTableRecord_GetTable", status);
 	return(status);
 }
+
+// Builds the response to a GETTABLE of every LFTableRecord in topop, one per
+// LFT block of each switch.
+//
+Status_t
+sa_LFTableRecord_BuildCache(SACacheEntry_t *cachep, Topology_t *topop) {
+	uint8_t		*data;
+	uint32_t	records;
+	uint32_t	index;
+	Node_t		*nodep;
+	Status_t	status;
+
+	IB_ENTER("sa_LFTableRecord_BuildCache", cachep, topop, 0, 0);
+
+	// a switch without an LFT fails the query; leave that to the query
+	records = 0;
+	for_all_switch_nodes(topop, nodep) {
+		if (nodep->lft == NULL) {
+			IB_EXIT("sa_LFTableRecord_BuildCache", VSTATUS_NOSUPPORT);
+			return(VSTATUS_NOSUPPORT);
+		}
+		records += nodep->switchInfo.LinearFDBTop / MAX_LFT_ELEMENTS_BLOCK + 1;
+	}
+
+	if ((status = sa_cache_alloc_records(cachep, records, sizeof(STL_LINEAR_FORWARDING_TABLE_RECORD), &data)) != VSTATUS_OK) {
+		IB_EXIT("sa_LFTableRecord_BuildCache", status);
+		return(status);
+	}
+
+	for_all_switch_nodes(topop, nodep) {
+		for (index = 0; index <= nodep->switchInfo.LinearFDBTop; index += MAX_LFT_ELEMENTS_BLOCK) {
+			if (sa_LFTableRecord_Set(data, nodep, nodep->port, index/MAX_LFT_ELEMENTS_BLOCK) != VSTATUS_OK) {
+				(void)vs_pool_free(&sm_pool, cachep->data);
+				cachep->data = NULL;
+				IB_EXIT("sa_LFTableRecord_BuildCache", VSTATUS_NOSUPPORT);
+				return(VSTATUS_NOSUPPORT);
+			}
+			sa_increment_and_pad(&data, sizeof(STL_LINEAR_FORWARDING_TABLE_RECORD),
+				Calculate_Padding(sizeof(STL_LINEAR_FORWARDING_TABLE_RECORD)), &cachep->records);
+		}
+	}
+
+	sprintf(cachep->name, "LFTableRecords");
+	cachep->valid = 1;
+
+	IB_EXIT("sa_LFTableRecord_BuildCache", VSTATUS_OK);
+	return(VSTATUS_OK);
+}
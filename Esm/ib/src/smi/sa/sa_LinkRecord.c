@@ -63,12 +63,13 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "sa_l.h"
 
 Status_t	sa_LinkRecord_Get(Mai_t *, uint32_t *);
-Status_t	sa_LinkRecord_GetTable(Mai_t *, uint32_t *);
+Status_t	sa_LinkRecord_GetTable(Mai_t *, uint32_t *, SACacheEntry_t **);
 
 Status_t
 sa_LinkRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt ) {
 	uint32_t	records;
 	uint32_t	attribOffset;
+	SACacheEntry_t *cache = NULL;
 
 	IB_ENTER("sa_LinkRecord", maip, 0, 0, 0);
 
@@ -92,7 +93,7 @@ sa_LinkRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt ) {
 	}
 	// Check Base and Class Version
 	if (maip->base.bversion == STL_BASE_VERSION && maip->base.cversion == STL_SA_CLASS_VERSION) {
-		(void)sa_LinkRecord_GetTable(maip, &records);
+		(void)sa_LinkRecord_GetTable(maip, &records, &cache);
 	} else {
 		// Generate an error response and return.
 		maip->base.status = MAD_STATUS_BAD_CLASS;
@@ -121,7 +122,7 @@ sa_LinkRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt ) {
 	attribOffset =  sizeof(STL_LINK_RECORD) + Calculate_Padding(sizeof(STL_LINK_RECORD));
 	sa_cntxt->attribLen = attribOffset;
 
-	sa_cntxt_data( sa_cntxt, sa_data, records * attribOffset);
+	sa_cntxt_data_cached( sa_cntxt, sa_data, records * attribOffset, cache);
 	(void)sa_send_reply(maip, sa_cntxt);
 
 	IB_EXIT("sa_LinkRecord", VSTATUS_OK);
@@ -140,14 +141,14 @@ isFromPort(Node_t *nodep1, Node_t *nodep2, uint32_t PortNumP1, uint32_t PortNumP
 }
 
 Status_t
-sa_LinkRecord_Set(uint8_t *lrp, Node_t *nodep, Port_t *portp) {
+sa_LinkRecord_Set(uint8_t *lrp, Topology_t *topop, Node_t *nodep, Port_t *portp) {
 	Port_t		*pNeighborPort;
 	Node_t		*pNeighborNode;
 	STL_LINK_RECORD linkRecord = {{0}};
 
 	IB_ENTER("sa_LinkRecord_Set", lrp, nodep, portp, 0);
 
-	pNeighborPort = sm_find_neighbor_node_and_port(&old_topology, portp, &pNeighborNode);
+	pNeighborPort = sm_find_neighbor_node_and_port(topop, portp, &pNeighborNode);
 	if (pNeighborPort == NULL) {
 		return (VSTATUS_BAD);
 	}
@@ -165,7 +166,7 @@ sa_LinkRecord_Set(uint8_t *lrp, Node_t *nodep, Port_t *portp) {
 }
 
 Status_t
-sa_LinkRecord_GetTable(Mai_t *maip, uint32_t *records) {
+sa_LinkRecord_GetTable(Mai_t *maip, uint32_t *records, SACacheEntry_t **outCache) {
 	uint8_t		*data;
 	uint32_t	bytes;
 	Node_t		*nodep;
@@ -176,6 +177,7 @@ sa_LinkRecord_GetTable(Mai_t *maip, uint32_t *records) {
 	IB_ENTER("sa_LinkRecord_GetTable", maip, *records, 0, 0);
 
 	*records = 0;
+	*outCache = NULL;
 	data = sa_data;
 	bytes = Calculate_Padding(sizeof(STL_LINK_RECORD));
 
@@ -203,6 +205,14 @@ sa_LinkRecord_GetTable(Mai_t *maip, uint32_t *records) {
 		return(VSTATUS_BAD);
 	}
 
+	// the whole table is built once per sweep
+	if (!samad.header.mask && maip->base.method == SA_CM_GETTABLE &&
+		(*outCache = sa_cache_lookup(SA_CACHE_LINKS)) != NULL) {
+		*records = (*outCache)->records;
+		IB_EXIT("sa_LinkRecord_GetTable", VSTATUS_OK);
+		return(VSTATUS_OK);
+	}
+
 //
 //	Find the LinkRecords in the SADB
 //
@@ -225,7 +235,7 @@ sa_LinkRecord_GetTable(Mai_t *maip, uint32_t *records) {
 			// if status is VSTATUS_BAD, the query should abort.
 			// if status is VSTATUS_OK, the record is good and should be returned.
 			// if status is VSTATUS_IGNORE, it means the link record didn't meet the LinkCondition criteria and should be ignored, but it is not an error.
-			if ((status = sa_LinkRecord_Set(data, nodep, portp)) == VSTATUS_BAD) {
+			if ((status = sa_LinkRecord_Set(data, &old_topology, nodep, portp)) == VSTATUS_BAD) {
 				maip->base.status = MAD_STATUS_SA_NO_RESOURCES;
 				goto done;
 			}
@@ -240,3 +250,52 @@ done:
 	IB_EXIT("sa_LinkRecord_GetTable", VSTATUS_OK);
 	return(VSTATUS_OK);
 }
+
+// Builds the response to a GETTABLE of every LinkRecord in topop.
+//
+Status_t
+sa_LinkRecord_BuildCache(SACacheEntry_t *cachep, Topology_t *topop) {
+	uint8_t		*data;
+	uint32_t	records;
+	Node_t		*nodep;
+	Port_t		*portp;
+	Status_t	status;
+
+	IB_ENTER("sa_LinkRecord_BuildCache", cachep, topop, 0, 0);
+
+	records = 0;
+	for_all_nodes(topop, nodep) {
+		for_all_physical_ports(nodep, portp) {
+			if (sm_valid_port(portp) && portp->state > IB_PORT_DOWN)
+				records++;
+		}
+	}
+
+	if ((status = sa_cache_alloc_records(cachep, records, sizeof(STL_LINK_RECORD), &data)) != VSTATUS_OK) {
+		IB_EXIT("sa_LinkRecord_BuildCache", status);
+		return(status);
+	}
+
+	for_all_nodes(topop, nodep) {
+		for_all_physical_ports(nodep, portp) {
+			if (!sm_valid_port(portp) || portp->state <= IB_PORT_DOWN)
+				continue;
+
+			// a port without a neighbor aborts the query; leave that to the query
+			if (sa_LinkRecord_Set(data, topop, nodep, portp) != VSTATUS_OK) {
+				(void)vs_pool_free(&sm_pool, cachep->data);
+				cachep->data = NULL;
+				IB_EXIT("sa_LinkRecord_BuildCache", VSTATUS_NOSUPPORT);
+				return(VSTATUS_NOSUPPORT);
+			}
+			sa_increment_and_pad(&data, sizeof(STL_LINK_RECORD),
+				Calculate_Padding(sizeof(STL_LINK_RECORD)), &cachep->records);
+		}
+	}
+
+	sprintf(cachep->name, "LinkRecords");
+	cachep->valid = 1;
+
+	IB_EXIT("sa_LinkRecord_BuildCache", VSTATUS_OK);
+	return(VSTATUS_OK);
+}
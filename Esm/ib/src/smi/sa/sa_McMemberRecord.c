@@ -76,13 +76,13 @@ extern	IB_GID nullGid;
 extern	Pool_t			sm_pool;
 
 /* Allow a McMemberRecord change to trigger a sweep */
-extern  uint32_t		sa_mft_reprog;
+extern  ATOMIC_UINT		sa_mft_reprog;
 
 /************ support for dynamic update of switch config parms *************/
 extern uint8_t sa_dynamicPlt[];
 
-static Status_t	sa_McMemberRecord_GetTable(Mai_t *, uint32_t *);
-static Status_t	sa_McMemberRecord_IBGetTable(Mai_t *, uint32_t *);
+static Status_t	sa_McMemberRecord_GetTable(Mai_t *, SAResponse_t *, uint32_t *);
+static Status_t	sa_McMemberRecord_IBGetTable(Mai_t *, SAResponse_t *, uint32_t *);
 
 static void	sa_updateMcDeleteCountForPort(Port_t *);
 
@@ -158,7 +158,9 @@ static uint32_t rateOneStepSmaller(uint32_t rate) {
 
 Status_t sa_McGroupInit(void) {
     sm_McGroups = NULL;
-    return vs_lock_init(&sm_McGroups_lock, VLOCK_FREE, VLOCK_THREAD);
+    sm_multicast_index_clear();
+    /* SA lookups share the lock; vs_lock() takes it exclusively */
+    return vs_lock_init(&sm_McGroups_lock, VLOCK_FREE, VLOCK_RWTHREAD);
 }
 
 
@@ -174,6 +176,7 @@ sa_McMemberRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt ) {
 	uint32_t	records;
 	uint16_t	attribOffset;
 	uint16_t	rec_sz;
+	SAResponse_t	*resp = NULL;
 
 	IB_ENTER("sa_McMemberRecord", maip, 0, 0, 0);
 
@@ -207,18 +210,18 @@ sa_McMemberRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt ) {
 		(void)sa_McMemberRecord_Set(NULL, maip, &records);
 		break;
 	case SA_CM_GET:
-		INCREMENT_COUNTER(smCounterSaRxGetMcMemberRecord);
-		if (maip->base.bversion == STL_BASE_VERSION)
-			(void)sa_McMemberRecord_GetTable(maip, &records);
-		else
-			(void)sa_McMemberRecord_IBGetTable(maip, &records);
-		break;
 	case SA_CM_GETTABLE:
-		INCREMENT_COUNTER(smCounterSaRxGetTblMcMemberRecord);
-		if (maip->base.bversion == STL_BASE_VERSION)
-			(void)sa_McMemberRecord_GetTable(maip, &records);
+		if (maip->base.method == SA_CM_GET) {
+			INCREMENT_COUNTER(smCounterSaRxGetMcMemberRecord);
+		} else {
+			INCREMENT_COUNTER(smCounterSaRxGetTblMcMemberRecord);
+		}
+		if (sa_resp_alloc(SA_RESP_SEGMENT_LEN(maip), &resp) != VSTATUS_OK)
+			maip->base.status = MAD_STATUS_SA_NO_RESOURCES;
+		else if (maip->base.bversion == STL_BASE_VERSION)
+			(void)sa_McMemberRecord_GetTable(maip, resp, &records);
 		else
-			(void)sa_McMemberRecord_IBGetTable(maip, &records);
+			(void)sa_McMemberRecord_IBGetTable(maip, resp, &records);
 		break;
 	case SA_CM_DELETE:
 		INCREMENT_COUNTER(smCounterSaRxDeleteMcMemberRecord);
@@ -253,7 +256,12 @@ sa_McMemberRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt ) {
 		attribOffset = rec_sz + Calculate_Padding(rec_sz);
 		sa_cntxt->attribLen = attribOffset;
 
-		sa_cntxt_data(sa_cntxt, sa_data, records * attribOffset);
+		if (resp) {
+			sa_cntxt_data_resp(sa_cntxt, records ? resp : NULL);
+			sa_resp_release(resp);
+		} else {
+			sa_cntxt_data(sa_cntxt, sa_data, records * attribOffset);
+		}
 		(void)sa_send_reply(maip, sa_cntxt);
 	}
 
@@ -825,10 +833,8 @@ sa_McMemberRecord_Set(Topology_t *topop, Mai_t *maip, uint32_t *records)
 
 		mcmp->MLID = mLid;
 
-		McGroup_Create(mcGroup);
+		McGroup_Create(mcGroup, mcmp->RID.MGID, mcmp->MLID);
 		createdGroup = 1;
-		memcpy(&(mcGroup->mGid), &mcmp->RID.MGID, 16);
-		mcGroup->mLid = mcmp->MLID;
 		mcGroup->qKey = mcmp->Q_Key;
 		mcGroup->pKey = mcmp->P_Key;
 		mcGroup->mtu = mcmp->Mtu;
@@ -841,7 +847,7 @@ sa_McMemberRecord_Set(Topology_t *topop, Mai_t *maip, uint32_t *records)
 		bitset_copy(&mcGroup->vfMembers, &mcGroupVf);
 		mcGroup->members_full++;
 
-		McMember_Create(mcGroup, mcMember);
+		McMember_Create(mcGroup, mcMember, mcmp->RID.PortGID);
 		mcMember->record = *mcmp;
 		mcMember->portGuid = guid;
 		mcMember->slid = maip->addrInfo.slid;
@@ -950,10 +956,8 @@ sa_McMemberRecord_Set(Topology_t *topop, Mai_t *maip, uint32_t *records)
 
 			mcmp->MLID = mLid;
 
-			McGroup_Create(mcGroup);
+			McGroup_Create(mcGroup, mcmp->RID.MGID, mcmp->MLID);
 			createdGroup = 1;
-			memcpy(&(mcGroup->mGid), &mcmp->RID.MGID, 16);
-			mcGroup->mLid = mcmp->MLID;
 			mcGroup->qKey = mcmp->Q_Key;
 			mcGroup->pKey = mcmp->P_Key;
 			mcGroup->mtu = mcmp->Mtu;
@@ -966,7 +970,7 @@ sa_McMemberRecord_Set(Topology_t *topop, Mai_t *maip, uint32_t *records)
 			bitset_copy(&mcGroup->vfMembers, &mcGroupVf);
 			mcGroup->members_full++;
 
-			McMember_Create(mcGroup, mcMember);
+			McMember_Create(mcGroup, mcMember, mcmp->RID.PortGID);
 			mcMember->record = *mcmp;
 			mcMember->portGuid = guid;
 			mcMember->slid = maip->addrInfo.slid;
@@ -1146,7 +1150,7 @@ sa_McMemberRecord_Set(Topology_t *topop, Mai_t *maip, uint32_t *records)
 			mcmp->Scope = mcGroup->scope;
 
 			if (!(mcMember = sm_find_multicast_member(mcGroup, mcmp->RID.PortGID))) {
-				McMember_Create(mcGroup, mcMember);
+				McMember_Create(mcGroup, mcMember, mcmp->RID.PortGID);
 				if (mcmp->JoinFullMember) {
 					mcGroup->members_full++;
 				}
@@ -1175,6 +1179,8 @@ sa_McMemberRecord_Set(Topology_t *topop, Mai_t *maip, uint32_t *records)
 			mcMember->slid = maip->addrInfo.slid;
 			mcMember->state = STL_MCMRECORD_GETJOINSTATE(mcmp);
 			mcMember->proxy = (maip->addrInfo.slid == portp->portData->lid) ? 0 : 1;// JSY - check LMC aliasing
+			if (newJoinState)
+				mcGroup->flags |= McGroupMftDirty;
 		}
 	}
 
@@ -1194,8 +1200,8 @@ done:
 
 		/* If not already triggered,
 		 * trigger sm_top to sweep and reprogram the switch MFTs */
-		if (!sa_mft_reprog)
-			sa_mft_reprog = newJoinState; 
+		if (newJoinState)
+			(void)AtomicCompareStore(&sa_mft_reprog, 0, newJoinState);
 	
 		/* Note the results */
 		*records = 1;
@@ -1514,6 +1520,7 @@ sa_McMemberRecord_Delete(Topology_t *topop, Mai_t *maip, uint32_t *records)
 			mcGroup->members_full--;
         }
 		mcMember->state = joinstate;
+		mcGroup->flags |= McGroupMftDirty;
 	}
 
 	/* If there are not any full members left, delete all the others
@@ -1550,7 +1557,7 @@ sa_McMemberRecord_Delete(Topology_t *topop, Mai_t *maip, uint32_t *records)
 	 */
 
 	/* Trigger sm_top to sweep and reprogram the switch MFTs */
-	sa_mft_reprog = 1;
+	AtomicWrite(&sa_mft_reprog, 1);
 
 
 //
@@ -1583,9 +1590,36 @@ done:
 	return(status);
 }
 
+/*
+ * GetTable walks only the groups a query can match: the one group for a
+ * named MGID, the groups on a named MLID, otherwise all of them.  Within a
+ * group a named PortGID is looked up instead of scanning the members.
+ */
+#define MC_WALK_ALL		0
+#define MC_WALK_MGID	1
+#define MC_WALK_MLID	2
+
+static McGroup_t *
+sa_McGroupWalkFirst(int walk, IB_GID mgid, STL_LID mlid) {
+	switch (walk) {
+	case MC_WALK_MGID:	return sm_find_multicast_gid(mgid);
+	case MC_WALK_MLID:	return sm_find_multicast_mlid(mlid);
+	default:			return sm_McGroups;
+	}
+}
+
+static McGroup_t *
+sa_McGroupWalkNext(int walk, McGroup_t *mcgp) {
+	switch (walk) {
+	case MC_WALK_MGID:	return NULL;
+	case MC_WALK_MLID:	return sm_find_next_multicast_mlid(mcgp);
+	default:			return mcgp->next;
+	}
+}
+
 #define STL_MC_REMOVE_MTU_RATE_LIFE_MASK    0x0000000000000F30ull 
 Status_t
-sa_McMemberRecord_GetTable(Mai_t *maip, uint32_t *records) {
+sa_McMemberRecord_GetTable(Mai_t *maip, SAResponse_t *resp, uint32_t *records) {
 	uint8_t			*data;
 	uint32_t		bytes;
 	STL_SA_MAD		samad;
@@ -1597,6 +1631,7 @@ sa_McMemberRecord_GetTable(Mai_t *maip, uint32_t *records) {
 	STL_MCMEMBER_RECORD	mcMemTemp = {{{{0}}}};
 	uint64_t		mask;
 	Port_t 			*senderPort;
+	int				walk, byPort;
 
 	IB_ENTER("sa_McMemberRecord_GetTable", maip, *records, 0, 0);
 
@@ -1604,7 +1639,6 @@ sa_McMemberRecord_GetTable(Mai_t *maip, uint32_t *records) {
 	mcmp = NULL;		// JSY - compiler is whining during development
 
 	*records = 0;
-	data = sa_data;
 	bytes = Calculate_Padding(sizeof(STL_MCMEMBER_RECORD));
 
 //
@@ -1656,22 +1690,20 @@ sa_McMemberRecord_GetTable(Mai_t *maip, uint32_t *records) {
 		return VSTATUS_OK;
 	}
 
-    (void)vs_lock(&sm_McGroups_lock);
+    (void)vs_rdlock(&sm_McGroups_lock);
 
 	/* For trusted queries, we return all the members of all groups with all the information.
 	   For non-trusted queries we return only one member per group.  We also clear the port guid,
 	   join state, and proxy join.
 	 */
 
-	for_all_multicast_groups(mcgp)
-	{
-		 /* If they are looking for a specific MGID, check that first,
-		  * no need to check every member's MGID */
-		if (samad.header.mask & STL_MCMEMBER_COMPONENTMASK_MGID &&
-			memcmp(&(mcgp->mGid), &mcMemQuery.RID.MGID, sizeof(mcgp->mGid))) {
-			continue;
-		}
+	walk = (samad.header.mask & STL_MCMEMBER_COMPONENTMASK_MGID) ? MC_WALK_MGID :
+		(samad.header.mask & STL_MCMEMBER_COMPONENTMASK_MLID) ? MC_WALK_MLID : MC_WALK_ALL;
+	byPort = (samad.header.mask & STL_MCMEMBER_COMPONENTMASK_PORTGID) != 0;
 
+	for (mcgp = sa_McGroupWalkFirst(walk, mcMemQuery.RID.MGID, mcMemQuery.MLID); mcgp != NULL;
+		 mcgp = sa_McGroupWalkNext(walk, mcgp))
+	{
 		// Since groups can only contain full members (for now), we don't need to worry about
 		// about limited members getting McMember records for other limited members.
 		if (VirtualFabrics != NULL && 
@@ -1681,8 +1713,10 @@ sa_McMemberRecord_GetTable(Mai_t *maip, uint32_t *records) {
 			continue;
 		}
 
-		for_all_multicast_members(mcgp, mcmp) {
-			if ((status = sa_check_len(data, sizeof(STL_MCMEMBER_RECORD), bytes)) != VSTATUS_OK) {
+		for (mcmp = byPort ? sm_find_multicast_member(mcgp, mcMemQuery.RID.PortGID) : mcgp->mcMembers;
+			 mcmp != NULL; mcmp = byPort ? NULL : mcmp->next) {
+			if ((data = sa_resp_reserve(resp, sizeof(STL_MCMEMBER_RECORD), bytes)) == NULL) {
+				status = VSTATUS_NOMEM;
 				maip->base.status = MAD_STATUS_SA_NO_RESOURCES;
 				IB_LOG_ERROR_FMT( "sa_McMemberRecord_GetTable",
 					   "Reached size limit at %d records", *records);
@@ -1690,11 +1724,10 @@ sa_McMemberRecord_GetTable(Mai_t *maip, uint32_t *records) {
 			}
 
 			BSWAPCOPY_STL_MCMEMBER_RECORD(&mcmp->record, (STL_MCMEMBER_RECORD*)data);
-			if (sa_template_test(samad.data, &data, sizeof(STL_MCMEMBER_RECORD), bytes, records) == VSTATUS_OK) {
+			if (sa_template_test_noinc(samad.data, data, sizeof(STL_MCMEMBER_RECORD)) == VSTATUS_OK) {
 				/* Not trusted queries can't see some fields and get one record per group */
 				if (sm_smInfo.SM_Key && samad.header.smKey != sm_smInfo.SM_Key)
 				{
-					data -= sizeof(STL_MCMEMBER_RECORD) + bytes;
 					BSWAPCOPY_STL_MCMEMBER_RECORD((STL_MCMEMBER_RECORD*)data, &mcMemTemp);
 					memset(&mcMemTemp.RID.PortGID, 0, sizeof(mcMemTemp.RID.PortGID));
 					mcMemTemp.JoinSendOnlyMember = 0;
@@ -1702,9 +1735,11 @@ sa_McMemberRecord_GetTable(Mai_t *maip, uint32_t *records) {
 					mcMemTemp.JoinFullMember = 0;
 					mcMemTemp.ProxyJoin = 0;
 					BSWAPCOPY_STL_MCMEMBER_RECORD(&mcMemTemp, (STL_MCMEMBER_RECORD*)data);
-					data += sizeof(STL_MCMEMBER_RECORD) + bytes;
+					sa_resp_commit(resp, sizeof(STL_MCMEMBER_RECORD), bytes, records);
 					break;
-				} else if ((samad.header.mask & STL_MCMEMBER_COMPONENTMASK_MGID) == 0)
+				}
+				sa_resp_commit(resp, sizeof(STL_MCMEMBER_RECORD), bytes, records);
+				if ((samad.header.mask & STL_MCMEMBER_COMPONENTMASK_MGID) == 0)
 				{
 					/* Per IBTA 15-0.2.5, only return one record per
 					 * multicast group if the MGID is is wildcarded */
@@ -1715,7 +1750,7 @@ sa_McMemberRecord_GetTable(Mai_t *maip, uint32_t *records) {
 	}
 
 done:
-	(void)vs_unlock(&sm_McGroups_lock);
+	(void)vs_rwunlock(&sm_McGroups_lock);
 	(void)vs_rwunlock(&old_topology_lock);
 
 	if (saDebugPerf) {
@@ -1729,7 +1764,7 @@ done:
 
 #define MC_REMOVE_MTU_RATE_LIFE_MASK    0x0000000000000F30ull 
 Status_t
-sa_McMemberRecord_IBGetTable(Mai_t *maip, uint32_t *records)
+sa_McMemberRecord_IBGetTable(Mai_t *maip, SAResponse_t *resp, uint32_t *records)
 {
 	uint8_t			*data;
 	uint32_t		bytes;
@@ -1742,6 +1777,7 @@ sa_McMemberRecord_IBGetTable(Mai_t *maip, uint32_t *records)
 	IB_MCMEMBER_RECORD	converted;
 	uint64_t		mask;
 	Port_t 			*senderPort;
+	int				walk, byPort;
 
 	IB_ENTER(__func__, maip, *records, 0, 0);
 
@@ -1749,7 +1785,6 @@ sa_McMemberRecord_IBGetTable(Mai_t *maip, uint32_t *records)
 	mcmp = NULL;		// JSY - compiler is whining during development
 
 	*records = 0;
-	data = sa_data;
 	bytes = Calculate_Padding(sizeof(IB_MCMEMBER_RECORD));
 	BSWAPCOPY_STL_SA_MAD((STL_SA_MAD*)maip->data, &samad, sizeof(IB_MCMEMBER_RECORD));
 	BSWAPCOPY_IB_MCMEMBER_RECORD((IB_MCMEMBER_RECORD*)samad.data, (IB_MCMEMBER_RECORD*)&mcMemQuery);
@@ -1782,24 +1817,22 @@ sa_McMemberRecord_IBGetTable(Mai_t *maip, uint32_t *records)
 		return VSTATUS_OK;
 	}
 
-    (void)vs_lock(&sm_McGroups_lock);
+    (void)vs_rdlock(&sm_McGroups_lock);
 
 	/* For trusted queries, we return all the members of all groups with all the information.
 	   For non-trusted queries we return only one member per group.  We also clear the port guid,
 	   join state, and proxy join.
 	 */
 
-	for_all_multicast_groups(mcgp) {
+	/* 16-bit MLIDs are matched by the template, not looked up */
+	walk = (samad.header.mask & IB_MCMEMBER_RECORD_COMP_MGID) ? MC_WALK_MGID : MC_WALK_ALL;
+	byPort = (samad.header.mask & IB_MCMEMBER_RECORD_COMP_PORTGID) != 0;
+
+	for (mcgp = sa_McGroupWalkFirst(walk, mcMemQuery.RID.MGID, 0); mcgp != NULL;
+		 mcgp = sa_McGroupWalkNext(walk, mcgp)) {
 		if (mcgp->sl > 15)
 			continue;
 
-		 /* If they are looking for a specific MGID, check that first,
-		  * no need to check every member's MGID */
-		if (samad.header.mask & IB_MCMEMBER_RECORD_COMP_MGID &&
-			memcmp(&(mcgp->mGid), &mcMemQuery.RID.MGID, sizeof(mcgp->mGid))) {
-			continue;
-		}
-
 		// Since groups can only contain full members (for now), we don't need to worry about
 		// about limited members getting McMember records for other limited members.
 		if (VirtualFabrics != NULL && 
@@ -1809,8 +1842,10 @@ sa_McMemberRecord_IBGetTable(Mai_t *maip, uint32_t *records)
 			continue;
 		}
 
-		for_all_multicast_members(mcgp, mcmp) {
-			if ((status = sa_check_len(data, sizeof(IB_MCMEMBER_RECORD), bytes)) != VSTATUS_OK) {
+		for (mcmp = byPort ? sm_find_multicast_member(mcgp, mcMemQuery.RID.PortGID) : mcgp->mcMembers;
+			 mcmp != NULL; mcmp = byPort ? NULL : mcmp->next) {
+			if ((data = sa_resp_reserve(resp, sizeof(IB_MCMEMBER_RECORD), bytes)) == NULL) {
+				status = VSTATUS_NOMEM;
 				maip->base.status = MAD_STATUS_SA_NO_RESOURCES;
 				IB_LOG_ERROR_FMT( __func__,
 					   "Reached size limit at %d records", *records);
@@ -1843,11 +1878,10 @@ sa_McMemberRecord_IBGetTable(Mai_t *maip, uint32_t *records)
 			converted.Reserved3[1] = 0;
 
 			BSWAPCOPY_IB_MCMEMBER_RECORD(&converted, (IB_MCMEMBER_RECORD*)data);
-			if (sa_template_test(samad.data, &data, sizeof(IB_MCMEMBER_RECORD), bytes, records) == VSTATUS_OK) {
+			if (sa_template_test_noinc(samad.data, data, sizeof(IB_MCMEMBER_RECORD)) == VSTATUS_OK) {
 				/* Not trusted queries can't see some fields and get one record per group */
 				if (sm_smInfo.SM_Key && samad.header.smKey != sm_smInfo.SM_Key)
 				{
-					data -= sizeof(IB_MCMEMBER_RECORD) + bytes;
 					BSWAPCOPY_IB_MCMEMBER_RECORD((IB_MCMEMBER_RECORD*)data, &mcMemTemp);
 					memset(&mcMemTemp.RID.PortGID, 0, sizeof(mcMemTemp.RID.PortGID));
 					mcMemTemp.JoinFullMember = 0;
@@ -1855,9 +1889,11 @@ sa_McMemberRecord_IBGetTable(Mai_t *maip, uint32_t *records)
 					mcMemTemp.JoinNonMember = 0;
 					mcMemTemp.ProxyJoin = 0;
 					BSWAPCOPY_IB_MCMEMBER_RECORD(&mcMemTemp, (IB_MCMEMBER_RECORD*)data);
-					data += sizeof(IB_MCMEMBER_RECORD) + bytes;
+					sa_resp_commit(resp, sizeof(IB_MCMEMBER_RECORD), bytes, records);
 					break;
-				} else if ((samad.header.mask & IB_MCMEMBER_RECORD_COMP_MGID) == 0)
+				}
+				sa_resp_commit(resp, sizeof(IB_MCMEMBER_RECORD), bytes, records);
+				if ((samad.header.mask & IB_MCMEMBER_RECORD_COMP_MGID) == 0)
 				{
 					/* Per IBTA 15-0.2.5, only return one record per
 					 * multicast group if the MGID is is wildcarded */
@@ -1871,7 +1907,7 @@ done:
 	if (saDebugPerf) {
         IB_LOG_INFINI_INFO("sa_McMemberRecord_GetTable: Number of member records to return is", *records);
     }
-    (void)vs_unlock(&sm_McGroups_lock);
+    (void)vs_rwunlock(&sm_McGroups_lock);
     (void)vs_rwunlock(&old_topology_lock);
 
 	IB_EXIT(__func__, status);
@@ -1911,7 +1947,7 @@ showStlGroups(int termWidth, uint8_t showNodeName) {
     
     PrintDestInitFile(&dest, stdout); 
     
-    status = vs_lock(&sm_McGroups_lock); 
+    status = vs_rdlock(&sm_McGroups_lock); 
     if (status != VSTATUS_OK) {
         sysPrintf("error locking sm_McGroups_lock %lu\n", (long)status); 
         return;
@@ -1942,7 +1978,7 @@ showStlGroups(int termWidth, uint8_t showNodeName) {
         }
     }
     
-    vs_unlock(&sm_McGroups_lock); 
+    vs_rwunlock(&sm_McGroups_lock); 
     if (showNodeName) 
         vs_rwunlock(&old_topology_lock); 
     
@@ -1990,12 +2026,10 @@ Status_t createBroadcastGroup(uint16_t pkey, uint8_t mtu, uint8_t rate, uint8_t
 		goto done;
 	}
 
-	McGroup_Create(mcGroup);
+	McGroup_Create(mcGroup, mGid, mLid);
 
-	McMember_Create(mcGroup, mcMember);
+	McMember_Create(mcGroup, mcMember, nullGid);
 
-	memcpy(&(mcGroup->mGid), &mGid, sizeof(mGid));
-	mcGroup->mLid         = mLid;
 	mcGroup->qKey         = qkey;
 	mcGroup->pKey         = pkey;
 	mcGroup->mtu          = mtu;
@@ -2311,9 +2345,9 @@ Status_t createMCastGroup(uint64_t* mgid, uint16_t pkey, uint8_t mtu, uint8_t ra
 			goto done;
 	}
 
-	McGroup_Create(mcGroup);
+	McGroup_Create(mcGroup, mGid, mLid);
 
-	McMember_Create(mcGroup, mcMember);
+	McMember_Create(mcGroup, mcMember, nullGid);
 
 	if (VirtualFabrics) {
 		if ((PKEY_VALUE(VirtualFabrics->v_fabric_all[vf].pkey) == PKEY_VALUE(pkey)) &&
@@ -2322,9 +2356,6 @@ Status_t createMCastGroup(uint64_t* mgid, uint16_t pkey, uint8_t mtu, uint8_t ra
 		}
 	}
 
-	memcpy(&(mcGroup->mGid), &mGid, sizeof(mGid));
-
-	mcGroup->mLid         = mLid;
 	mcGroup->qKey         = qkey;
 	mcGroup->pKey         = pkey;
 	mcGroup->mtu          = mtu;
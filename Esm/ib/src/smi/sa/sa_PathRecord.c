@@ -64,19 +64,120 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "fm_xml.h"
 
 void		sa_GroupPathRecord_Set(uint8_t * query, uint32_t * records, Port_t *src_portp, McGroup_t *group, uint8_t cversion);
-Status_t	sa_PathRecord_Set(uint8_t*, uint32_t*, uint8_t, uint32_t, Port_t*, STL_LID, Port_t*,
-				  STL_LID, PKey_t, uint64_t, uint8_t, uint8_t);
-Status_t	sa_PathRecord_Wildcard(uint8_t*, Port_t *, uint8_t,  uint32_t, uint32_t *, PKey_t, uint8_t, Node_t*, uint64_t, uint8_t);
 Status_t	sa_PathRecord_Selector_Check(IB_PATH_RECORD *, uint64_t);
 IB_GID		nullGid={.Raw={0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}};
 
 /************ support for dynamic update of switch config parms *************/
 extern uint8_t sa_dynamicPlt[];
 
-static STL_LID srcLids[128];
-static STL_LID dstLids[128];
+static SA_THREAD_LOCAL STL_LID srcLids[128];
+static SA_THREAD_LOCAL STL_LID dstLids[128];
 
-static uint8_t serviceIdCheck;
+static SA_THREAD_LOCAL uint8_t serviceIdCheck;
+
+//
+//	PathRecord index.  An MPI job launches with every rank asking the SA
+//	for paths to the other ranks, the same pairs of ports asked for again
+//	and again.  Answering each means matching the ports against the VFs
+//	and walking the LFTs between them, none of which depends on more of
+//	the query than its ports, LIDs, PKey, SL and ServiceID.  So the paths
+//	sa_PathRecord_Set() finds for such a key are kept here, ahead of the
+//	template test, and later queries with the key are answered from them.
+//	A key with more paths than an entry holds is marked so it is not
+//	captured again.  Wildcard queries, a path to every port, have a cache
+//	of their own below rather than evict the pairs.  A colliding key
+//	replaces an entry, which bounds the memory, and striped locks let the
+//	SA worker threads share the entries.
+//	The index is emptied when a sweep changes the routes, the ports and
+//	links they run over, the partitions or the virtual fabrics.
+//
+#define PATH_INDEX_RECORDS		2		// paths an entry holds
+#define PATH_INDEX_TOO_MANY		0xff	// count of a key with more paths
+#define PATH_INDEX_LOCKS		64
+
+typedef struct {
+	STL_LID			srcLid;			// base LIDs of the ports, 0 if empty
+	STL_LID			dstLid;
+	STL_LID			slid;			// as asked for
+	STL_LID			dlid;
+	uint64_t		serviceId;
+	PKey_t			pkey;
+	uint8_t			sl;
+	uint8_t			serviceIdChk;
+	uint8_t			count;			// of paths
+	IB_PATH_RECORD	paths[PATH_INDEX_RECORDS];
+} PathIndexEntry_t;
+
+static PathIndexEntry_t	*pathIndex;
+static uint32_t			pathIndexMask;			// entries - 1
+static uint64_t			pathIndexSignature;		// of the fabric the entries describe
+static Lock_t			pathIndexLocks[PATH_INDEX_LOCKS];
+static int				pathIndexLocksInit;
+
+//
+//	Wildcard cache.  A wildcard query takes the paths from its source to
+//	every port the requester shares a PKey with, which found port by port
+//	costs a walk of the LFTs to each of them.  The answer is kept instead
+//	per source port, requester and the rest of the key, as the paths in
+//	the order they were found, grouped by destination so that NumbPath
+//	and the too many records limit cut a later answer where they cut the
+//	first one.  A source with a destination of more paths than an entry
+//	takes per destination is marked and answered port by port.  An entry
+//	colliding with another replaces it, the entries take at most the
+//	megabytes given to sa_PathRecIndexInit(), share the index's locks and
+//	are freed whenever the index is emptied.
+//
+#define PATH_WILDCARD_SLOTS			1024
+#define PATH_WILDCARD_DEST_RECORDS	16		// paths an entry takes per destination
+
+typedef struct {
+	uint32_t		first;			// index of its first path
+	uint32_t		newNode;		// on another node than the one before
+} PathWildcardDest_t;
+
+typedef struct {
+	STL_LID			srcLid;			// base LID of the source port
+	STL_LID			slid;			// as asked for
+	uint64_t		reqNodeGuid;
+	uint64_t		serviceId;
+	PKey_t			pkey;
+	uint8_t			sl;
+	uint8_t			serviceIdChk;
+	uint8_t			tooMany;		// answered port by port
+	uint32_t		numDests;
+	uint32_t		numPaths;
+	uint32_t		bytes;
+	PathWildcardDest_t	*dests;		// numDests + 1, the last ends the paths
+	IB_PATH_RECORD	*paths;
+} PathWildcardEntry_t;
+
+static PathWildcardEntry_t	*pathWildcard[PATH_WILDCARD_SLOTS];
+static uint32_t				pathWildcardMaxBytes;
+static ATOMIC_UINT			pathWildcardBytes;
+
+//
+//	Where sa_PathRecord_Set() puts the paths it finds.  A response takes
+//	those that pass the template test into sa_data, up to numPath or too
+//	many records; a list for the PathRecord index or the wildcard cache
+//	takes them all, up to listMax.
+//
+typedef struct {
+	uint8_t			*query;
+	uint32_t		*records;
+	uint8_t			cversion;
+	uint32_t		numPath;
+	IB_PATH_RECORD	*list;			// NULL for a response
+	uint32_t		listed;
+	uint32_t		listMax;
+} PathRecordSink_t;
+
+static Status_t	sa_PathRecord_Paths(PathRecordSink_t *, Port_t *, STL_LID, Port_t *, STL_LID,
+				PKey_t, uint64_t, uint8_t, uint8_t);
+static Status_t	sa_PathRecWildcardFind(PathRecordSink_t *, PathWildcardEntry_t *, uint32_t, uint32_t);
+static Status_t	sa_PathRecWildcardCollect(PathWildcardEntry_t *, Port_t *, Node_t *,
+				PathWildcardEntry_t **);
+static Status_t	sa_PathRecWildcardAdd(PathRecordSink_t *, PathWildcardEntry_t *, uint32_t, uint32_t);
+static uint32_t	sa_PathRecWildcardSlot(PathWildcardEntry_t *);
 
 static Status_t
 create_ib_mask(Mai_t *maip, IB_SA_MAD *samad) {
@@ -381,9 +482,9 @@ sa_PathRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt) {
 		}
 
 		if ((dst_portp = sm_find_port_guid(&old_topology, guid)) == NULL) {
-			(void)vs_lock(&sm_McGroups_lock);   /* lock out the multicast group table */
+			(void)vs_rdlock(&sm_McGroups_lock);   /* lock out the multicast group table */
 			if ((mcastGroup = sm_find_multicast_gid(prp->DGID)) == NULL) {
-				(void)vs_unlock(&sm_McGroups_lock);
+				(void)vs_rwunlock(&sm_McGroups_lock);
 				maip->base.status = MAD_STATUS_SA_NO_RECORDS;
 				if (saDebugPerf || !guid)
 					IB_LOG_INFINI_INFOLX("sa_PathRecord: requested destination GUID not an active port nor a Multicast Group:", guid);
@@ -501,7 +602,7 @@ sa_PathRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt) {
 reply_PathRecord:
 	if (dstIsGroup) {
 		/*release the multicast group table if necessary */
-		(void)vs_unlock(&sm_McGroups_lock);
+		(void)vs_rwunlock(&sm_McGroups_lock);
 	}
 
 	(void)vs_rwunlock(&old_topology_lock);
@@ -533,7 +634,18 @@ reply_PathRecord:
 	return(VSTATUS_OK);
 }
 
-#define TOO_MANY_RECORDS(cversion, records) (records > sa_max_ib_path_records)
+// A worker's sa_data may hold fewer records than sa_max_ib_path_records.
+#define TOO_MANY_RECORDS(cversion, records) (records > sa_max_ib_path_records || \
+	(sa_data_size && (records) >= sa_data_size / sizeof(IB_PATH_RECORD)))
+
+// Returns nonzero if a wildcard query from src_portp takes paths to dst_portp.
+static __inline__ int
+sa_PathRecord_WildcardDest(Port_t *src_portp, Port_t *dst_portp, PKey_t pkey, Node_t *reqNodep) {
+	if (!sm_valid_port(dst_portp)) return 0;
+	if (dst_portp->state < IB_PORT_ARMED) return 0;
+	if (pkey && !smValidatePortPKey(pkey, dst_portp) && (src_portp != dst_portp)) return 0;
+	return sa_Compare_Node_Port_PKeys(reqNodep, dst_portp) == VSTATUS_OK;
+}
 
 Status_t
 sa_PathRecord_Wildcard(uint8_t * query, Port_t *src_portp, uint8_t cversion, STL_LID slid, uint32_t *records,
@@ -542,24 +654,50 @@ sa_PathRecord_Wildcard(uint8_t * query, Port_t *src_portp, uint8_t cversion, STL
 	Port_t		*dst_portp;
 	uint32_t	pathCount;
 	Status_t	status=VSTATUS_OK;
+	PathRecordSink_t	sink = { query, records, cversion, 0, NULL, 0, 0 };
+	PathWildcardEntry_t	key, *entry;
+	uint32_t	slot;
 
 	IB_ENTER("sa_PathRecord_Wildcard", src_portp, records, pkey, numPath);
 
+	if (pathWildcardMaxBytes && reqNodep && src_portp->portData->lid) {
+		memset(&key, 0, sizeof(key));
+		key.srcLid = src_portp->portData->lid;
+		key.slid = slid;
+		key.reqNodeGuid = reqNodep->nodeInfo.NodeGUID;
+		key.serviceId = serviceId;
+		key.pkey = pkey;
+		key.sl = sl;
+		key.serviceIdChk = serviceIdCheck;
+		slot = sa_PathRecWildcardSlot(&key);
+
+		status = sa_PathRecWildcardFind(&sink, &key, numPath, slot);
+		if (status == VSTATUS_NOT_FOUND) {
+			status = sa_PathRecWildcardCollect(&key, src_portp, reqNodep, &entry);
+			if (status == VSTATUS_OK)
+				status = sa_PathRecWildcardAdd(&sink, entry, numPath, slot);
+		}
+		// a source marked too many is answered port by port
+		if (status != VSTATUS_TOO_LARGE) {
+			IB_EXIT("sa_PathRecord_Wildcard", status);
+			return status;
+		}
+		status = VSTATUS_OK;
+	}
+
 	//
 	//	Loop over all of the nodes and find the paths.
 	//	
 	for_all_nodes(&old_topology, dst_nodep) {
 		for_all_end_ports(dst_nodep, dst_portp) {
-			if (!sm_valid_port(dst_portp)) continue;
-			if (dst_portp->state < IB_PORT_ARMED) continue;
-			if (pkey && !smValidatePortPKey(pkey, dst_portp) && (src_portp != dst_portp)) continue;
-			if (sa_Compare_Node_Port_PKeys(reqNodep, dst_portp) != VSTATUS_OK) continue;
+			if (!sa_PathRecord_WildcardDest(src_portp, dst_portp, pkey, reqNodep)) continue;
 
             // The path count is specified for each SRCGID-DSTGID pair
             // So reset the local path count for each dst port.
 			pathCount = (*records);
 
-			if ((status = sa_PathRecord_Set(query, records, cversion, pathCount+numPath, src_portp, slid,
+			sink.numPath = pathCount+numPath;
+			if ((status = sa_PathRecord_Paths(&sink, src_portp, slid,
 				dst_portp, STL_LID_PERMISSIVE, pkey, serviceId, serviceIdCheck, sl)) == VSTATUS_OK) {
                	if (TOO_MANY_RECORDS(cversion,(*records))) {
                  	*records = 0;
@@ -636,13 +774,12 @@ sa_GroupPathRecord_Set(uint8_t * query, uint32_t * records, Port_t *src_portp, M
 }
 
 void
-sa_FillPathRecord (uint8_t *query, uint32_t* records, Port_t *src_portp, STL_LID slid,
+sa_FillPathRecord (IB_PATH_RECORD *prp, Port_t *src_portp, STL_LID slid,
 				Port_t *dst_portp, STL_LID dlid, PKey_t pkey,
 				uint8_t mtu, uint8_t rate, uint8_t lifeMult,
 				uint32_t hopCount, uint64_t serviceId, uint8_t sl) {
 
 	IB_PATH_RECORD	pathRecord;
-	uint8_t			*cp = sa_data;
 	IB_GID DGID, SGID;
 
     //
@@ -719,8 +856,8 @@ sa_FillPathRecord (uint8_t *query, uint32_t* records, Port_t *src_portp, STL_LID
 
 	pathRecord.PktLifeTime += lifeMult;
 
-	IB_LOG_VERBOSE_FMT(__func__, "Path Record %u added to Response: DLID 0x%x SLID 0x%x SL %u MTU %u Rate %u pkey 0x%x",
-		*records, pathRecord.DLID, pathRecord.SLID,
+	IB_LOG_VERBOSE_FMT(__func__, "Path Record: DLID 0x%x SLID 0x%x SL %u MTU %u Rate %u pkey 0x%x",
+		pathRecord.DLID, pathRecord.SLID,
 		pathRecord.u2.s.SL, pathRecord.Mtu, pathRecord.Rate, pathRecord.P_Key);
 
 	// NOTA BENE: We don't copy the GIDs till after we bswap the rest
@@ -730,18 +867,459 @@ sa_FillPathRecord (uint8_t *query, uint32_t* records, Port_t *src_portp, STL_LID
 	pathRecord.DGID = DGID;
 	pathRecord.SGID = SGID;
 
-	if (sa_template_test_noinc(query, (uint8_t *)&pathRecord, sizeof(IB_PATH_RECORD)) != VSTATUS_OK)
-		return;
+	memcpy(prp, &pathRecord, sizeof(IB_PATH_RECORD));
+}
 
-	memcpy(cp + (*records)*sizeof(IB_PATH_RECORD),&pathRecord,sizeof(IB_PATH_RECORD));
-	(*records)++;
+// Returns nonzero once the sink takes no more paths.
+static int
+sa_PathRecord_Add(PathRecordSink_t *sink, IB_PATH_RECORD *prp) {
+	if (sink->list) {
+		if (sink->listed >= sink->listMax) {
+			sink->listed = PATH_INDEX_TOO_MANY;
+			return 1;
+		}
+		memcpy(&sink->list[sink->listed++], prp, sizeof(IB_PATH_RECORD));
+		return 0;
+	}
+
+	if (sa_template_test_noinc(sink->query, (uint8_t *)prp, sizeof(IB_PATH_RECORD)) == VSTATUS_OK) {
+		memcpy(sa_data + (*sink->records)*sizeof(IB_PATH_RECORD), prp, sizeof(IB_PATH_RECORD));
+		(*sink->records)++;
+	}
+	if (TOO_MANY_RECORDS(sink->cversion, (*sink->records))) {
+		IB_LOG_WARN("sa_PathRecord_Set: too many records:", (*sink->records));
+		return 1;
+	}
+	return sink->numPath && (*sink->records) >= sink->numPath;
+}
+
+static __inline__ uint64_t
+sa_PathRecIndexMix(uint64_t key) {
+	key *= 0x9e3779b97f4a7c15ull;
+	key ^= key >> 31;
+	key *= 0xbf58476d1ce4e5b9ull;
+	return key ^ (key >> 29);
+}
+
+static uint64_t
+sa_PathRecIndexHash(uint64_t signature, const void *data, size_t len) {
+	const uint8_t	*cp = data;
+	uint64_t		word;
+
+	for (; len >= sizeof(word); cp += sizeof(word), len -= sizeof(word)) {
+		memcpy(&word, cp, sizeof(word));
+		signature = sa_PathRecIndexMix(signature ^ word);
+	}
+	if (len) {
+		word = 0;
+		memcpy(&word, cp, len);
+		signature = sa_PathRecIndexMix(signature ^ word);
+	}
+	return signature;
+}
+
+static __inline__ uint32_t
+sa_PathRecIndexSlot(PathIndexEntry_t *key) {
+	uint64_t	hash;
+
+	hash = sa_PathRecIndexMix(key->srcLid | ((uint64_t)key->dstLid << 32));
+	hash = sa_PathRecIndexMix(hash ^ (key->slid | ((uint64_t)key->dlid << 32)));
+	hash = sa_PathRecIndexMix(hash ^ key->serviceId);
+	hash = sa_PathRecIndexMix(hash ^ (key->pkey | ((uint64_t)key->sl << 16) |
+		((uint64_t)key->serviceIdChk << 24)));
+	return hash & pathIndexMask;
+}
+
+static __inline__ int
+sa_PathRecIndexMatch(PathIndexEntry_t *entry, PathIndexEntry_t *key) {
+	return entry->srcLid == key->srcLid && entry->dstLid == key->dstLid &&
+		entry->slid == key->slid && entry->dlid == key->dlid &&
+		entry->serviceId == key->serviceId && entry->pkey == key->pkey &&
+		entry->sl == key->sl && entry->serviceIdChk == key->serviceIdChk;
+}
+
+//
+//	Copy the paths of the entry for key into key.  Returns 0 if the key
+//	is not in the index.
+//
+static int
+sa_PathRecIndexFind(PathIndexEntry_t *key, uint32_t slot) {
+	PathIndexEntry_t	*entry = &pathIndex[slot];
+	int					found = 0;
+
+	(void)vs_lock(&pathIndexLocks[slot & (PATH_INDEX_LOCKS - 1)]);
+	if (sa_PathRecIndexMatch(entry, key)) {
+		key->count = entry->count;
+		if (entry->count != PATH_INDEX_TOO_MANY)
+			memcpy(key->paths, entry->paths, entry->count * sizeof(IB_PATH_RECORD));
+		found = 1;
+	}
+	(void)vs_unlock(&pathIndexLocks[slot & (PATH_INDEX_LOCKS - 1)]);
+	return found;
+}
+
+static void
+sa_PathRecIndexAdd(PathIndexEntry_t *key, uint32_t slot) {
+	(void)vs_lock(&pathIndexLocks[slot & (PATH_INDEX_LOCKS - 1)]);
+	memcpy(&pathIndex[slot], key, sizeof(PathIndexEntry_t));
+	(void)vs_unlock(&pathIndexLocks[slot & (PATH_INDEX_LOCKS - 1)]);
+}
+
+static uint32_t
+sa_PathRecWildcardSlot(PathWildcardEntry_t *key) {
+	uint64_t	hash;
+
+	hash = sa_PathRecIndexMix(key->srcLid | ((uint64_t)key->slid << 32));
+	hash = sa_PathRecIndexMix(hash ^ key->reqNodeGuid);
+	hash = sa_PathRecIndexMix(hash ^ key->serviceId);
+	hash = sa_PathRecIndexMix(hash ^ (key->pkey | ((uint64_t)key->sl << 16) |
+		((uint64_t)key->serviceIdChk << 24)));
+	return hash & (PATH_WILDCARD_SLOTS - 1);
+}
+
+static __inline__ int
+sa_PathRecWildcardMatch(PathWildcardEntry_t *entry, PathWildcardEntry_t *key) {
+	return entry->srcLid == key->srcLid && entry->slid == key->slid &&
+		entry->reqNodeGuid == key->reqNodeGuid && entry->serviceId == key->serviceId &&
+		entry->pkey == key->pkey && entry->sl == key->sl &&
+		entry->serviceIdChk == key->serviceIdChk;
+}
+
+//
+//	Answer a wildcard query from entry, applying numPath and the too many
+//	records limit per destination as sa_PathRecord_Wildcard() does.
+//
+static Status_t
+sa_PathRecWildcardReplay(PathRecordSink_t *sink, PathWildcardEntry_t *entry, uint32_t numPath) {
+	uint32_t	dest, i, pathCount;
+	int			nodeDone = 0;
+
+	if (entry->tooMany)
+		return VSTATUS_TOO_LARGE;
+
+	for (dest = 0; dest < entry->numDests; dest++) {
+		if (entry->dests[dest].newNode)
+			nodeDone = 0;
+		if (nodeDone)
+			continue;
+
+		pathCount = *sink->records;
+		sink->numPath = pathCount + numPath;
+		for (i = entry->dests[dest].first; i < entry->dests[dest + 1].first; i++) {
+			if (sa_PathRecord_Add(sink, &entry->paths[i]))
+				break;
+		}
+		if (TOO_MANY_RECORDS(sink->cversion, *sink->records)) {
+			*sink->records = 0;
+			return VSTATUS_BAD;
+		}
+		if (numPath && *sink->records - pathCount >= numPath)
+			nodeDone = 1;
+	}
+	return VSTATUS_OK;
+}
+
+//
+//	Answer a wildcard query from the cache.  Returns VSTATUS_NOT_FOUND if
+//	key is not cached and VSTATUS_TOO_LARGE if it is to be answered port
+//	by port.
+//
+static Status_t
+sa_PathRecWildcardFind(PathRecordSink_t *sink, PathWildcardEntry_t *key, uint32_t numPath, uint32_t slot) {
+	PathWildcardEntry_t	*entry;
+	Status_t			status = VSTATUS_NOT_FOUND;
+
+	(void)vs_lock(&pathIndexLocks[slot & (PATH_INDEX_LOCKS - 1)]);
+	entry = pathWildcard[slot];
+	if (entry && sa_PathRecWildcardMatch(entry, key))
+		status = sa_PathRecWildcardReplay(sink, entry, numPath);
+	(void)vs_unlock(&pathIndexLocks[slot & (PATH_INDEX_LOCKS - 1)]);
+	return status;
+}
+
+//
+//	Find the paths from src_portp to every port a wildcard query for key
+//	takes, into a new entry.  Destinations without paths are left out, as
+//	they add no records to an answer.
+//
+static Status_t
+sa_PathRecWildcardCollect(PathWildcardEntry_t *key, Port_t *src_portp, Node_t *reqNodep,
+				PathWildcardEntry_t **entryp) {
+	PathRecordSink_t	sink = { NULL, NULL, 0, 0, NULL, 0, PATH_WILDCARD_DEST_RECORDS };
+	PathWildcardDest_t	*dests = NULL, *newDests;
+	IB_PATH_RECORD		*paths = NULL, *newPaths;
+	PathWildcardEntry_t	*entry;
+	Node_t				*dst_nodep, *last_nodep = NULL;
+	Port_t				*dst_portp;
+	uint32_t			numDests = 0, maxDests = 0, numPaths = 0, maxPaths = 0, bytes;
+	Status_t			status;
+
+	for_all_nodes(&old_topology, dst_nodep) {
+		for_all_end_ports(dst_nodep, dst_portp) {
+			if (!sa_PathRecord_WildcardDest(src_portp, dst_portp, key->pkey, reqNodep)) continue;
+
+			if (maxPaths - numPaths < PATH_WILDCARD_DEST_RECORDS || numDests + 1 >= maxDests) {
+				maxPaths = maxPaths ? maxPaths * 2 : 64 * PATH_WILDCARD_DEST_RECORDS;
+				maxDests = maxDests ? maxDests * 2 : 64;
+				if ((status = vs_pool_alloc(&sm_pool, sizeof(IB_PATH_RECORD) * maxPaths,
+						(void *)&newPaths)) != VSTATUS_OK) {
+					goto done;
+				}
+				if ((status = vs_pool_alloc(&sm_pool, sizeof(PathWildcardDest_t) * maxDests,
+						(void *)&newDests)) != VSTATUS_OK) {
+					(void)vs_pool_free(&sm_pool, newPaths);
+					goto done;
+				}
+				if (numPaths)
+					memcpy(newPaths, paths, sizeof(IB_PATH_RECORD) * numPaths);
+				if (numDests)
+					memcpy(newDests, dests, sizeof(PathWildcardDest_t) * numDests);
+				if (paths)
+					(void)vs_pool_free(&sm_pool, paths);
+				if (dests)
+					(void)vs_pool_free(&sm_pool, dests);
+				paths = newPaths;
+				dests = newDests;
+			}
+
+			sink.list = &paths[numPaths];
+			sink.listed = 0;
+			status = sa_PathRecord_Paths(&sink, src_portp, key->slid, dst_portp, STL_LID_PERMISSIVE,
+				key->pkey, key->serviceId, key->serviceIdChk, key->sl);
+			if (status == VSTATUS_NOMEM)
+				goto done;
+			if (status != VSTATUS_OK || sink.listed == 0)
+				continue;
+			if (sink.listed == PATH_INDEX_TOO_MANY) {
+				key->tooMany = 1;
+				numDests = numPaths = 0;
+				goto collected;
+			}
+			dests[numDests].first = numPaths;
+			dests[numDests].newNode = dst_nodep != last_nodep;
+			last_nodep = dst_nodep;
+			numDests++;
+			numPaths += sink.listed;
+		}
+	}
+
+collected:
+	bytes = sizeof(PathWildcardEntry_t) + sizeof(PathWildcardDest_t) * (numDests + 1) +
+		sizeof(IB_PATH_RECORD) * numPaths;
+	if ((status = vs_pool_alloc(&sm_pool, bytes, (void *)&entry)) != VSTATUS_OK)
+		goto done;
+	memcpy(entry, key, sizeof(PathWildcardEntry_t));
+	entry->numDests = numDests;
+	entry->numPaths = numPaths;
+	entry->bytes = bytes;
+	entry->dests = (PathWildcardDest_t *)(entry + 1);
+	entry->paths = (IB_PATH_RECORD *)(entry->dests + numDests + 1);
+	if (numDests)
+		memcpy(entry->dests, dests, sizeof(PathWildcardDest_t) * numDests);
+	entry->dests[numDests].first = numPaths;
+	entry->dests[numDests].newNode = 1;
+	if (numPaths)
+		memcpy(entry->paths, paths, sizeof(IB_PATH_RECORD) * numPaths);
+	*entryp = entry;
+
+done:
+	if (paths)
+		(void)vs_pool_free(&sm_pool, paths);
+	if (dests)
+		(void)vs_pool_free(&sm_pool, dests);
+	if (status != VSTATUS_OK)
+		IB_LOG_WARNRC("sa_PathRecord_Wildcard: insufficient memory to process request rc:", status);
+	return status;
 }
 
+//
+//	Cache entry in slot, unless it would take the cache past its limit,
+//	and answer the query from it.
+//
+static Status_t
+sa_PathRecWildcardAdd(PathRecordSink_t *sink, PathWildcardEntry_t *entry, uint32_t numPath, uint32_t slot) {
+	PathWildcardEntry_t	*old;
+	Status_t			status;
+
+	if (AtomicAdd(&pathWildcardBytes, entry->bytes) > pathWildcardMaxBytes) {
+		AtomicSubtractVoid(&pathWildcardBytes, entry->bytes);
+		status = sa_PathRecWildcardReplay(sink, entry, numPath);
+		(void)vs_pool_free(&sm_pool, entry);
+		return status;
+	}
+
+	(void)vs_lock(&pathIndexLocks[slot & (PATH_INDEX_LOCKS - 1)]);
+	old = pathWildcard[slot];
+	pathWildcard[slot] = entry;
+	status = sa_PathRecWildcardReplay(sink, entry, numPath);
+	(void)vs_unlock(&pathIndexLocks[slot & (PATH_INDEX_LOCKS - 1)]);
+
+	if (old) {
+		AtomicSubtractVoid(&pathWildcardBytes, old->bytes);
+		(void)vs_pool_free(&sm_pool, old);
+	}
+	return status;
+}
+
+// Called with old_topology_lock held for writing.
+static void
+sa_PathRecWildcardFlush(void) {
+	int		i;
+
+	for (i = 0; i < PATH_WILDCARD_SLOTS; i++) {
+		if (pathWildcard[i]) {
+			(void)vs_pool_free(&sm_pool, pathWildcard[i]);
+			pathWildcard[i] = NULL;
+		}
+	}
+	AtomicWrite(&pathWildcardBytes, 0);
+}
+
+//
+//	Everything besides the routes that sa_PathRecord_Set() reads: the
+//	links, the port states, LIDs, GIDs, MTUs and rates, how the switches
+//	forward, the PKeys and VF membership of the ports, the VFs and the
+//	settings the records are filled from.
+//
+static uint64_t
+sa_PathRecIndexSignature(Topology_t *topop) {
+	Node_t				*nodep;
+	Port_t				*portp;
+	VirtualFabrics_t	*VirtualFabrics = topop->vfs_ptr;
+	uint64_t			signature = 0;
+	int					vf;
+
+	for_all_nodes(topop, nodep) {
+		signature = sa_PathRecIndexMix(signature ^ nodep->nodeInfo.NodeGUID);
+		if (nodep->nodeInfo.NodeType == NI_TYPE_SWITCH) {
+			signature = sa_PathRecIndexMix(signature ^
+				(nodep->switchInfo.LinearFDBTop |
+				((uint64_t)nodep->switchInfo.RoutingMode.Enabled << 32) |
+				((uint64_t)nodep->switchInfo.u2.s.EnhancedPort0 << 40) |
+				((uint64_t)nodep->routingRecalculated << 48)));
+		}
+		for_all_ports(nodep, portp) {
+			if (!sm_valid_port(portp))
+				continue;
+			signature = sa_PathRecIndexMix(signature ^
+				(portp->index | ((uint64_t)portp->state << 8) |
+				((uint64_t)portp->portno << 16) | ((uint64_t)portp->nodeno << 24)));
+			signature = sa_PathRecIndexMix(signature ^
+				(portp->portData->lid | ((uint64_t)portp->portData->lmc << 32) |
+				((uint64_t)portp->portData->maxVlMtu << 40) |
+				((uint64_t)linkWidthToRate(portp->portData) << 48)));
+			signature = sa_PathRecIndexHash(signature ^ portp->portData->portInfo.SubnetPrefix,
+				portp->portData->gid, sizeof(portp->portData->gid));
+			signature = sa_PathRecIndexHash(signature, portp->portData->pPKey,
+				sizeof(portp->portData->pPKey));
+			if (portp->portData->vfMember.bits_m)
+				signature = sa_PathRecIndexHash(signature, portp->portData->vfMember.bits_m,
+					portp->portData->vfMember.nwords_m * sizeof(uint32_t));
+			if (portp->portData->fullPKeyMember.bits_m)
+				signature = sa_PathRecIndexHash(signature, portp->portData->fullPKeyMember.bits_m,
+					portp->portData->fullPKeyMember.nwords_m * sizeof(uint32_t));
+		}
+	}
+
+	if (VirtualFabrics) {
+		signature = sa_PathRecIndexMix(signature ^ (VirtualFabrics->overall_checksum |
+			((uint64_t)VirtualFabrics->number_of_vfs_all << 32)));
+		for (vf = 0; vf < VirtualFabrics->number_of_vfs_all && vf < MAX_VFABRICS; vf++)
+			signature = sa_PathRecIndexMix(signature ^ VirtualFabrics->v_fabric_all[vf].standby);
+	}
+	signature = sa_PathRecIndexMix(signature ^ (sm_config.path_selection |
+		((uint64_t)sm_config.enforceVFPathRecs << 32) |
+		((uint64_t)sm_config.sa_packet_lifetime_n2 << 40)));
+	return sa_PathRecIndexHash(signature, sa_dynamicPlt, DYNAMIC_PACKET_LIFETIME_ARRAY_SIZE);
+}
+
+//
+//	Allocate the PathRecord index, rounding entries down to a power of 2,
+//	and let the wildcard cache take up to wildcardMB megabytes.  0 entries
+//	or megabytes leaves those queries to be answered from the topology.
+//
 Status_t
-sa_PathRecord_Set(uint8_t * query, uint32_t* records, uint8_t cversion, uint32_t numPath, Port_t *src_portp,
-				STL_LID slid, Port_t *dst_portp, STL_LID dlid, PKey_t pkey,
+sa_PathRecIndexInit(uint32_t entries, uint32_t wildcardMB) {
+	PathIndexEntry_t	*index = NULL;
+	Status_t			status;
+	int					i;
+
+	IB_ENTER(__func__, entries, 0, 0, 0);
+
+	if (!pathIndexLocksInit) {
+		for (i = 0; i < PATH_INDEX_LOCKS; i++) {
+			status = vs_lock_init(&pathIndexLocks[i], VLOCK_FREE, VLOCK_THREAD);
+			if (status != VSTATUS_OK) {
+				IB_LOG_ERRORRC("sa_PathRecIndexInit: can't initialize PathRecord index lock rc:", status);
+				IB_EXIT(__func__, status);
+				return status;
+			}
+		}
+		pathIndexLocksInit = 1;
+	}
+
+	if (entries) {
+		while (entries & (entries - 1))
+			entries &= entries - 1;
+		status = vs_pool_alloc(&sm_pool, sizeof(PathIndexEntry_t) * entries, (void *)&index);
+		if (status != VSTATUS_OK) {
+			IB_LOG_ERRORRC("sa_PathRecIndexInit: can't allocate PathRecord index rc:", status);
+			IB_EXIT(__func__, status);
+			return status;
+		}
+		memset(index, 0, sizeof(PathIndexEntry_t) * entries);
+	}
+
+	(void)vs_wrlock(&old_topology_lock);
+	if (pathIndex)
+		(void)vs_pool_free(&sm_pool, pathIndex);
+	pathIndex = index;
+	pathIndexMask = entries ? entries - 1 : 0;
+	pathIndexSignature = sa_PathRecIndexSignature(&old_topology);
+	sa_PathRecWildcardFlush();
+	pathWildcardMaxBytes = MIN(wildcardMB, 4095) << 20;
+	(void)vs_rwunlock(&old_topology_lock);
+
+	IB_EXIT(__func__, VSTATUS_OK);
+	return VSTATUS_OK;
+}
+
+//
+//	Called with old_topology_lock held for writing once topop has been
+//	published as old_topology, or a setting the records are filled from
+//	has changed.  Keeps the entries, and those of the wildcard cache,
+//	unless flush is set or the fabric and settings they describe have
+//	changed.
+//
+void
+sa_PathRecIndexUpdate(Topology_t *topop, int flush) {
+	uint64_t	signature;
+
+	IB_ENTER(__func__, topop, flush, 0, 0);
+
+	signature = sa_PathRecIndexSignature(topop);
+	if (flush || signature != pathIndexSignature) {
+		if (pathIndex)
+			memset(pathIndex, 0, sizeof(PathIndexEntry_t) * (pathIndexMask + 1));
+		sa_PathRecWildcardFlush();
+		if (saDebugPerf && (pathIndex || pathWildcardMaxBytes)) {
+			IB_LOG_INFINI_INFO_FMT(__func__, "PathRecord index emptied");
+		}
+	}
+	pathIndexSignature = signature;
+
+	IB_EXIT(__func__, 0);
+}
+
+//
+//	Find the paths between two ports for sa_PathRecord_Set().
+//
+static Status_t
+sa_PathRecord_Paths(PathRecordSink_t *sink, Port_t *src_portp, STL_LID slid,
+				Port_t *dst_portp, STL_LID dlid, PKey_t pkey,
 				uint64_t serviceId, uint8_t serviceIdChk, uint8_t sl)
 {
+	IB_PATH_RECORD	pathRecord;
 	uint8_t			mtu, vfMtu;
 	uint8_t			rate, vfRate, rated;
 	uint32_t		hopCount=1;
@@ -759,14 +1337,14 @@ sa_PathRecord_Set(uint8_t * query, uint32_t* records, uint8_t cversion, uint32_t
 	Status_t		status=VSTATUS_OK;
 	uint8_t			inPortNum = 0;
 
-	IB_ENTER("sa_PathRecord_Set", src_portp, dst_portp, pkey, cversion);
+	IB_ENTER(__func__, src_portp, dst_portp, pkey, sl);
 
 	//
 	//  Get all VFs containing the src/dst which match appropriate path data
 	//
 	if (!bitset_init(&sm_pool, &vfs, MAX_VFABRICS)) {
 		IB_LOG_WARN0("sa_PathRecord_Set: insufficient memory to process request");
-		IB_EXIT("sa_PathRecord_Set", VSTATUS_NOMEM);
+		IB_EXIT(__func__, VSTATUS_NOMEM);
 		return(VSTATUS_NOMEM);
 	}
 
@@ -992,15 +1570,10 @@ sa_PathRecord_Set(uint8_t * query, uint32_t* records, uint8_t cversion, uint32_t
 				! lid_iterator_done(&iter);
 				lid_iterator_next(&iter, &slid_iter, &dlid_iter)) {
 	
-				sa_FillPathRecord(query, records, src_portp, slid_iter, dst_portp, dlid_iter,
+				sa_FillPathRecord(&pathRecord, src_portp, slid_iter, dst_portp, dlid_iter,
 								pkey, vfMtu, vfRate, lifeMult, hopCount, serviceId, sl);
-				if (TOO_MANY_RECORDS(cversion,(*records))) {
-            		IB_LOG_WARN("sa_PathRecord_Set: too many records:", (*records));
-            		goto done_PathRecordSet;
-        		}
-				if (numPath && (*records) >= numPath) {
+				if (sa_PathRecord_Add(sink, &pathRecord))
 					goto done_PathRecordSet;
-				}
 			}
 	
 		} else if (slid == STL_LID_PERMISSIVE) {
@@ -1009,15 +1582,10 @@ sa_PathRecord_Set(uint8_t * query, uint32_t* records, uint8_t cversion, uint32_t
 					sm_config.path_selection, &slid_iter);
 				! lid_iterator_done1(&iter);
 				lid_iterator_next1(&iter, &slid_iter)) {
-				sa_FillPathRecord(query, records, src_portp, slid_iter, dst_portp, dlid,
+				sa_FillPathRecord(&pathRecord, src_portp, slid_iter, dst_portp, dlid,
 								pkey, vfMtu, vfRate, lifeMult, hopCount, serviceId, sl);
-				if (TOO_MANY_RECORDS(cversion,(*records))) {
-            		IB_LOG_WARN("sa_PathRecord_Set: too many records:", (*records));
-            		goto done_PathRecordSet;
-        		}
-				if (numPath && (*records) >= numPath) {
+				if (sa_PathRecord_Add(sink, &pathRecord))
 					goto done_PathRecordSet;
-				}
 			}
 	
 		} else if (dlid == STL_LID_PERMISSIVE) {
@@ -1026,32 +1594,79 @@ sa_PathRecord_Set(uint8_t * query, uint32_t* records, uint8_t cversion, uint32_t
 					sm_config.path_selection, &dlid_iter);
 				! lid_iterator_done1(&iter);
 				lid_iterator_next1(&iter, &dlid_iter)) {
-				sa_FillPathRecord(query, records, src_portp, slid, dst_portp, dlid_iter,
+				sa_FillPathRecord(&pathRecord, src_portp, slid, dst_portp, dlid_iter,
 								pkey, vfMtu, vfRate, lifeMult, hopCount, serviceId, sl);
-				if (TOO_MANY_RECORDS(cversion,(*records))) {
-            		IB_LOG_WARN("sa_PathRecord_Set: too many records:", (*records));
-            		goto done_PathRecordSet;
-        		}
-				if (numPath && (*records) >= numPath) {
+				if (sa_PathRecord_Add(sink, &pathRecord))
 					goto done_PathRecordSet;
-				}
 			}
 	
 		} else {  // LID to LID
-			sa_FillPathRecord(query, records, src_portp, slid, dst_portp, dlid,
+			sa_FillPathRecord(&pathRecord, src_portp, slid, dst_portp, dlid,
 					  pkey, vfMtu, vfRate, lifeMult, hopCount, serviceId, sl);
-			if (TOO_MANY_RECORDS(cversion,(*records))) {
-            	IB_LOG_WARN("sa_PathRecord_Set: too many records:", (*records));
-            	goto done_PathRecordSet;
-        	}
-			if (numPath && (*records) >= numPath) {
+			if (sa_PathRecord_Add(sink, &pathRecord))
 				goto done_PathRecordSet;
-			}
 		}
 	}
 
 done_PathRecordSet:
 	bitset_free(&vfs);
+	IB_EXIT(__func__, status);
+	return status;
+}
+
+Status_t
+sa_PathRecord_Set(uint8_t * query, uint32_t* records, uint8_t cversion, uint32_t numPath, Port_t *src_portp,
+				STL_LID slid, Port_t *dst_portp, STL_LID dlid, PKey_t pkey,
+				uint64_t serviceId, uint8_t serviceIdChk, uint8_t sl)
+{
+	PathRecordSink_t	sink = { query, records, cversion, numPath, NULL, 0, 0 };
+	PathIndexEntry_t	key;
+	uint32_t			slot, i;
+	int					indexed = 0;
+	Status_t			status;
+
+	IB_ENTER("sa_PathRecord_Set", src_portp, dst_portp, pkey, cversion);
+
+	if (pathIndex && src_portp->portData->lid && dst_portp->portData->lid) {
+		key.srcLid = src_portp->portData->lid;
+		key.dstLid = dst_portp->portData->lid;
+		key.slid = slid;
+		key.dlid = dlid;
+		key.serviceId = serviceId;
+		key.pkey = pkey;
+		key.sl = sl;
+		key.serviceIdChk = serviceIdChk;
+		slot = sa_PathRecIndexSlot(&key);
+
+		indexed = sa_PathRecIndexFind(&key, slot);
+		if (!indexed) {
+			// failures are not kept, the next query reports them again
+			sink.list = key.paths;
+			sink.listMax = PATH_INDEX_RECORDS;
+			status = sa_PathRecord_Paths(&sink, src_portp, slid, dst_portp, dlid,
+				pkey, serviceId, serviceIdChk, sl);
+			if (status != VSTATUS_OK) {
+				IB_EXIT("sa_PathRecord_Set", status);
+				return status;
+			}
+			key.count = sink.listed;
+			sa_PathRecIndexAdd(&key, slot);
+			sink.list = NULL;
+			indexed = 1;
+		}
+	}
+
+	if (!indexed || key.count == PATH_INDEX_TOO_MANY) {
+		status = sa_PathRecord_Paths(&sink, src_portp, slid, dst_portp, dlid,
+			pkey, serviceId, serviceIdChk, sl);
+	} else {
+		for (i = 0; i < key.count; i++) {
+			if (sa_PathRecord_Add(&sink, &key.paths[i]))
+				break;
+		}
+		status = VSTATUS_OK;
+	}
+
 	IB_EXIT("sa_PathRecord_Set", status);
 	return status;
 }
@@ -63,7 +63,6 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "sm_l.h"
 #include "sa_l.h"
 
-static Status_t	sa_PortInfoRecord_GetTable(Mai_t *, uint32_t *);
 static Status_t sa_IbPortInfoRecord_GetTable(Mai_t *maip, uint32_t *records);
 static Status_t sa_IbPortInfoRecord_Set(uint8_t *prp, Node_t *nodep, Port_t *portp, STL_SA_MAD *samad);
 
@@ -71,6 +70,7 @@ Status_t
 sa_PortInfoRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt ) {
 	uint32_t			records, recordLength;
 	uint16_t			attribOffset;
+	SACacheEntry_t		*cache = NULL;
 
 	IB_ENTER("sa_PortInfoRecord", maip, 0, 0, 0);
 
@@ -96,7 +96,7 @@ sa_PortInfoRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt ) {
 	// Check Base and Class Version
 	if (maip->base.bversion == STL_BASE_VERSION && maip->base.cversion == STL_SA_CLASS_VERSION) {
 		recordLength = sizeof(STL_PORTINFO_RECORD);
-		(void)sa_PortInfoRecord_GetTable(maip, &records);
+		(void)sa_PortInfoRecord_GetTable(maip, &records, &cache);
 	} else if (maip->base.bversion == IB_BASE_VERSION && maip->base.cversion == SA_MAD_CVERSION) {
 		recordLength = sizeof(IB_PORTINFO_RECORD);
 		(void)sa_IbPortInfoRecord_GetTable(maip, &records);
@@ -127,7 +127,7 @@ sa_PortInfoRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt ) {
 
 	/* setup attribute offset for possible RMPP transfer */
 	sa_cntxt->attribLen = attribOffset;
-	sa_cntxt_data( sa_cntxt, sa_data, records * attribOffset);
+	sa_cntxt_data_cached( sa_cntxt, sa_data, records * attribOffset, cache);
 	(void)sa_send_reply(maip, sa_cntxt);
 
 	IB_EXIT("sa_PortInfoRecord", VSTATUS_OK);
@@ -169,7 +169,8 @@ sa_PortInfoRecord_Set(uint8_t *prp, Node_t *nodep, Port_t *portp, STL_SA_MAD *sa
 	sm_popo_get_ldr_log(&sm_popo, portp, portInfoRecord.LinkDownReasons);
 
     /* IBTA 1.2 C15-0.2.2 - zero out mKey if not trusted request */
-	if (sm_smInfo.SM_Key && samad->header.smKey != sm_smInfo.SM_Key) {
+	/* (no request when building the cache, which only trusted ones use) */
+	if (samad && sm_smInfo.SM_Key && samad->header.smKey != sm_smInfo.SM_Key) {
         portInfoRecord.PortInfo.M_Key = 0ull;
     }
 
@@ -244,8 +245,8 @@ sa_IbPortInfoRecord_Set(uint8_t *prp, Node_t *nodep, Port_t *portp, STL_SA_MAD *
 	return(VSTATUS_OK);
 }
 
-static Status_t
-sa_PortInfoRecord_GetTable(Mai_t *maip, uint32_t *records) {
+Status_t
+sa_PortInfoRecord_GetTable(Mai_t *maip, uint32_t *records, SACacheEntry_t **outCache) {
 	uint8_t		*data;
 	uint32_t	bytes;
 	Node_t		*nodep;
@@ -261,6 +262,7 @@ sa_PortInfoRecord_GetTable(Mai_t *maip, uint32_t *records) {
 	IB_ENTER("sa_PortInfoRecord_GetTable", maip, *records, 0, 0);
 
 	*records = 0;
+	*outCache = NULL;
 	data = sa_data;
 	bytes = Calculate_Padding(sizeof(STL_PORTINFO_RECORD));
 
@@ -322,6 +324,14 @@ sa_PortInfoRecord_GetTable(Mai_t *maip, uint32_t *records) {
         return(VSTATUS_OK);
     }
 
+	// the whole table is built once per sweep, with M_Keys for trusted requests
+	if (!checkLid && !checkCapMask && !samad.header.mask && maip->base.method == SA_CM_GETTABLE &&
+		!(sm_smInfo.SM_Key && samad.header.smKey != sm_smInfo.SM_Key) &&
+		(*outCache = sa_cache_lookup(SA_CACHE_PORTINFO)) != NULL) {
+		*records = (*outCache)->records;
+		goto done;
+	}
+
 	if (checkLid) {
 		Port_t		*matched_portp;
 		if ((matched_portp = sm_find_node_and_port_lid(&old_topology, endPortLid, &nodep)) != NULL) {
@@ -385,6 +395,56 @@ done:
 	return(status);
 }
 
+// Builds the response to a GETTABLE of every PortInfoRecord in topop.  The
+// records keep their M_Keys, so only trusted requests are answered from it.
+// LinkDownReasons are as of the sweep that built it.
+//
+Status_t
+sa_PortInfoRecord_BuildCache(SACacheEntry_t *cachep, Topology_t *topop) {
+	uint8_t		*data;
+	uint32_t	records;
+	Node_t		*nodep;
+	Port_t		*portp;
+	Status_t	status;
+
+	IB_ENTER("sa_PortInfoRecord_BuildCache", cachep, topop, 0, 0);
+
+	records = 0;
+	for_all_nodes(topop, nodep) {
+		for_all_ports(nodep, portp) {
+			if (sm_valid_port(portp) && portp->state > IB_PORT_DOWN)
+				records++;
+		}
+	}
+
+	if ((status = sa_cache_alloc_records(cachep, records, sizeof(STL_PORTINFO_RECORD), &data)) != VSTATUS_OK) {
+		IB_EXIT("sa_PortInfoRecord_BuildCache", status);
+		return(status);
+	}
+
+	for_all_nodes(topop, nodep) {
+		for_all_ports(nodep, portp) {
+			if (!sm_valid_port(portp) || portp->state <= IB_PORT_DOWN)
+				continue;
+
+			if (sa_PortInfoRecord_Set(data, nodep, portp, NULL) != VSTATUS_OK) {
+				(void)vs_pool_free(&sm_pool, cachep->data);
+				cachep->data = NULL;
+				IB_EXIT("sa_PortInfoRecord_BuildCache", VSTATUS_NOSUPPORT);
+				return(VSTATUS_NOSUPPORT);
+			}
+			sa_increment_and_pad(&data, sizeof(STL_PORTINFO_RECORD),
+				Calculate_Padding(sizeof(STL_PORTINFO_RECORD)), &cachep->records);
+		}
+	}
+
+	sprintf(cachep->name, "PortInfoRecords");
+	cachep->valid = 1;
+
+	IB_EXIT("sa_PortInfoRecord_BuildCache", VSTATUS_OK);
+	return(VSTATUS_OK);
+}
+
 static boolean sa_valid_ib_port_state(const Port_t	*portp)
 {
     // PortInfoRecords for the requesting node and remote nodes which it is permitted
@@ -64,13 +64,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "stl_print.h"
 
 
-Status_t	sa_ServiceRecord_GetTable(Mai_t *, uint32_t *);
-Status_t	sa_IbServiceRecord_GetTable(Mai_t *, uint32_t *);
+Status_t	sa_ServiceRecord_GetTable(Mai_t *, SAResponse_t *, uint32_t *);
 Status_t	sa_ServiceRecord_DoDelete(uint32_t *records, ServiceRecKey_t *srkeyp, uint8 *serviceName);
 Status_t	sa_ServiceRecord_Delete(Mai_t *maip, uint32_t *records);
 Status_t	sa_IbServiceRecord_Delete(Mai_t *maip, uint32_t *records);
-Status_t	sa_ServiceRecord_DoAdd(uint16_t slid, STL_SERVICE_RECORD *serviceRecordp,
-                       uint32_t *records, int havepkey);
 Status_t	sa_ServiceRecord_Add(Mai_t *maip, uint32_t *records);
 Status_t	sa_IbServiceRecord_Add(Mai_t *maip, uint32_t *records);
 
@@ -115,6 +112,307 @@ sa_ServiceRecCompare(void *key1, void *key2) {
 }
 
 
+/*
+ * Secondary indexes of the service record table.  Queries that name the
+ * ServiceID or the ServiceGID walk the chain of records with that ID or GID
+ * instead of the whole table, and the records with a lease are kept in a
+ * heap by expiry so aging only looks at those that expired.  The values of
+ * serviceRecMap are ServiceRecEntry_t, which start with the
+ * OpaServiceRecord_t the rest of the SM sees.  Records are allocated with
+ * sa_ServiceRecAlloc(), and added to and removed from the map with the
+ * functions below, which keep the indexes in step with it; all of them
+ * must be called with serviceRecLock held.
+ */
+#define SERVICE_INDEX_MIN		64		// chains per index to start with
+
+#define SERVICE_MATCH_ID		0x1		// key fields a query names
+#define SERVICE_MATCH_GID		0x2
+#define SERVICE_MATCH_PKEY		0x4
+#define SERVICE_MATCH_KEY		(SERVICE_MATCH_ID | SERVICE_MATCH_GID | SERVICE_MATCH_PKEY)
+
+static __inline__ uint32_t
+sa_ServiceRecIdChain(uint64_t serviceId) {
+	return (uint32_t)((serviceId * 0x9e3779b97f4a7c15ull) >> 32) & saServiceRecords.indexMask;
+}
+
+static __inline__ uint32_t
+sa_ServiceRecGidChain(IB_GID *gid) {
+	uint64_t	hash;
+
+	hash = (gid->AsReg64s.H * 0xbf58476d1ce4e5b9ull) ^ gid->AsReg64s.L;
+	return (uint32_t)((hash * 0x9e3779b97f4a7c15ull) >> 32) & saServiceRecords.indexMask;
+}
+
+static void
+sa_ServiceRecLink(ServiceRecEntry_t *entry) {
+	ServiceRecEntry_t	**chainp;
+
+	chainp = &saServiceRecords.idIndex[sa_ServiceRecIdChain(entry->osr.serviceRecord.RID.ServiceID)];
+	if ((entry->idNext = *chainp) != NULL)
+		entry->idNext->idPrevp = &entry->idNext;
+	entry->idPrevp = chainp;
+	*chainp = entry;
+
+	chainp = &saServiceRecords.gidIndex[sa_ServiceRecGidChain(&entry->osr.serviceRecord.RID.ServiceGID)];
+	if ((entry->gidNext = *chainp) != NULL)
+		entry->gidNext->gidPrevp = &entry->gidNext;
+	entry->gidPrevp = chainp;
+	*chainp = entry;
+}
+
+static void
+sa_ServiceRecUnlink(ServiceRecEntry_t *entry) {
+	if ((*entry->idPrevp = entry->idNext) != NULL)
+		entry->idNext->idPrevp = entry->idPrevp;
+	if ((*entry->gidPrevp = entry->gidNext) != NULL)
+		entry->gidNext->gidPrevp = entry->gidPrevp;
+}
+
+/*
+ * (Re)allocate both indexes with chains chains and relink the records.
+ * On failure the indexes are left as they were.
+ */
+static Status_t
+sa_ServiceRecIndexResize(uint32_t chains) {
+	ServiceRecEntry_t	**idIndex, **gidIndex, **oldIndex, *entry, *next;
+	uint32_t			i, oldChains;
+
+	idIndex = (ServiceRecEntry_t **)calloc(chains, sizeof(ServiceRecEntry_t *));
+	gidIndex = (ServiceRecEntry_t **)calloc(chains, sizeof(ServiceRecEntry_t *));
+	if (idIndex == NULL || gidIndex == NULL) {
+		free(idIndex);
+		free(gidIndex);
+		return VSTATUS_NOMEM;
+	}
+
+	oldIndex = saServiceRecords.idIndex;
+	oldChains = oldIndex ? saServiceRecords.indexMask + 1 : 0;
+	free(saServiceRecords.gidIndex);
+	saServiceRecords.idIndex = idIndex;
+	saServiceRecords.gidIndex = gidIndex;
+	saServiceRecords.indexMask = chains - 1;
+
+	// every record is on exactly one ServiceID chain
+	for (i = 0; i < oldChains; i++) {
+		for (entry = oldIndex[i]; entry != NULL; entry = next) {
+			next = entry->idNext;
+			sa_ServiceRecLink(entry);
+		}
+	}
+	free(oldIndex);
+	return VSTATUS_OK;
+}
+
+static void
+sa_ServiceRecLeaseUp(uint32_t slot) {
+	ServiceRecEntry_t	**heap = saServiceRecords.leases;
+	ServiceRecEntry_t	*entry = heap[slot];
+	uint32_t			parent;
+
+	while (slot > 0) {
+		parent = (slot - 1) / 2;
+		if (heap[parent]->osr.expireTime <= entry->osr.expireTime)
+			break;
+		heap[slot] = heap[parent];
+		heap[slot]->leaseSlot = slot;
+		slot = parent;
+	}
+	heap[slot] = entry;
+	entry->leaseSlot = slot;
+}
+
+static void
+sa_ServiceRecLeaseDown(uint32_t slot) {
+	ServiceRecEntry_t	**heap = saServiceRecords.leases;
+	ServiceRecEntry_t	*entry = heap[slot];
+	uint32_t			child;
+
+	while ((child = 2 * slot + 1) < saServiceRecords.numLeases) {
+		if (child + 1 < saServiceRecords.numLeases &&
+			heap[child + 1]->osr.expireTime < heap[child]->osr.expireTime)
+			child++;
+		if (entry->osr.expireTime <= heap[child]->osr.expireTime)
+			break;
+		heap[slot] = heap[child];
+		heap[slot]->leaseSlot = slot;
+		slot = child;
+	}
+	heap[slot] = entry;
+	entry->leaseSlot = slot;
+}
+
+static void
+sa_ServiceRecLeaseRemove(ServiceRecEntry_t *entry) {
+	ServiceRecEntry_t	*last;
+	uint32_t			slot = entry->leaseSlot;
+
+	entry->leaseSlot = SA_SERVICE_NO_LEASE;
+	last = saServiceRecords.leases[--saServiceRecords.numLeases];
+	if (last == entry)
+		return;
+	saServiceRecords.leases[slot] = last;
+	last->leaseSlot = slot;
+	sa_ServiceRecLeaseUp(slot);
+	sa_ServiceRecLeaseDown(last->leaseSlot);
+}
+
+static void
+sa_ServiceRecKeyFromRecord(ServiceRecKey_t *srkeyp, STL_SERVICE_RECORD *srp) {
+	memset(srkeyp, 0, sizeof(ServiceRecKey_t));
+	memcpy(&srkeyp->serviceGid, &srp->RID.ServiceGID, sizeof(IB_GID));
+	srkeyp->serviceId = srp->RID.ServiceID;
+	srkeyp->servicep_key = srp->RID.ServiceP_Key;
+}
+
+OpaServiceRecordp
+sa_ServiceRecAlloc(void) {
+	ServiceRecEntry_t	*entry;
+
+	if ((entry = (ServiceRecEntry_t *)malloc(sizeof(ServiceRecEntry_t))) == NULL)
+		return NULL;
+	memset(entry, 0, sizeof(ServiceRecEntry_t));
+	entry->leaseSlot = SA_SERVICE_NO_LEASE;
+	return &entry->osr;
+}
+
+/*
+ * Add a record from sa_ServiceRecAlloc() to the table under srkeyp, which
+ * is freed with it, with its expireTime already set.  Returns 0 on failure,
+ * leaving both to the caller, as cs_hashtable_insert() does.
+ */
+int32_t
+sa_ServiceRecInsert(ServiceRecKeyp srkeyp, OpaServiceRecordp osrp) {
+	ServiceRecEntry_t	*entry = (ServiceRecEntry_t *)osrp;
+	ServiceRecEntry_t	**leases;
+	uint32_t			maxLeases;
+
+	// room for every record in the heap, so a new lease never needs memory
+	if (saServiceRecords.indexed >= saServiceRecords.maxLeases) {
+		maxLeases = saServiceRecords.maxLeases ? 2 * saServiceRecords.maxLeases : SERVICE_INDEX_MIN;
+		leases = (ServiceRecEntry_t **)realloc(saServiceRecords.leases, maxLeases * sizeof(ServiceRecEntry_t *));
+		if (leases == NULL)
+			return 0;
+		saServiceRecords.leases = leases;
+		saServiceRecords.maxLeases = maxLeases;
+	}
+	if (!saServiceRecords.idIndex && sa_ServiceRecIndexResize(SERVICE_INDEX_MIN) != VSTATUS_OK)
+		return 0;
+	if (!cs_hashtable_insert(saServiceRecords.serviceRecMap, srkeyp, osrp))
+		return 0;
+
+	// a failed resize only makes the chains longer
+	if (saServiceRecords.indexed > saServiceRecords.indexMask)
+		(void)sa_ServiceRecIndexResize(2 * (saServiceRecords.indexMask + 1));
+	sa_ServiceRecLink(entry);
+	saServiceRecords.indexed++;
+
+	entry->leaseSlot = SA_SERVICE_NO_LEASE;
+	sa_ServiceRecSetExpireTime(osrp, osrp->expireTime);
+	return 1;
+}
+
+/*
+ * Take a record out of the indexes after cs_hashtable_iterator_remove()
+ * took it out of the map.
+ */
+void
+sa_ServiceRecUnindex(OpaServiceRecordp osrp) {
+	ServiceRecEntry_t	*entry = (ServiceRecEntry_t *)osrp;
+
+	sa_ServiceRecUnlink(entry);
+	if (entry->leaseSlot != SA_SERVICE_NO_LEASE)
+		sa_ServiceRecLeaseRemove(entry);
+	saServiceRecords.indexed--;
+}
+
+/*
+ * Remove the record under srkeyp from the table and return it for the
+ * caller to free, or NULL if there is none.
+ */
+OpaServiceRecordp
+sa_ServiceRecRemove(ServiceRecKeyp srkeyp) {
+	OpaServiceRecordp	osrp;
+
+	if ((osrp = (OpaServiceRecordp)cs_hashtable_remove(saServiceRecords.serviceRecMap, srkeyp)) != NULL)
+		sa_ServiceRecUnindex(osrp);
+	return osrp;
+}
+
+void
+sa_ServiceRecSetExpireTime(OpaServiceRecordp osrp, uint64_t expireTime) {
+	ServiceRecEntry_t	*entry = (ServiceRecEntry_t *)osrp;
+
+	osrp->expireTime = expireTime;
+	if (expireTime == VTIMER_ETERNITY) {
+		if (entry->leaseSlot != SA_SERVICE_NO_LEASE)
+			sa_ServiceRecLeaseRemove(entry);
+		return;
+	}
+	if (entry->leaseSlot == SA_SERVICE_NO_LEASE) {
+		entry->leaseSlot = saServiceRecords.numLeases++;
+		saServiceRecords.leases[entry->leaseSlot] = entry;
+	}
+	sa_ServiceRecLeaseUp(entry->leaseSlot);
+	sa_ServiceRecLeaseDown(entry->leaseSlot);
+}
+
+static __inline__ int
+sa_ServiceRecMatch(uint32_t match, STL_SERVICE_RECORD *srp, STL_SERVICE_RECORD *query) {
+	if ((match & SERVICE_MATCH_ID) && srp->RID.ServiceID != query->RID.ServiceID)
+		return 0;
+	if ((match & SERVICE_MATCH_PKEY) && srp->RID.ServiceP_Key != query->RID.ServiceP_Key)
+		return 0;
+	if ((match & SERVICE_MATCH_GID) &&
+		memcmp(srp->RID.ServiceGID.Raw, query->RID.ServiceGID.Raw, sizeof(IB_GID)))
+		return 0;
+	return 1;
+}
+
+typedef Status_t (*ServiceRecVisit_t)(OpaServiceRecordp, void *);
+
+/*
+ * Call visit for each record whose key fields named in match equal those
+ * of query, until it returns other than VSTATUS_OK, walking the narrowest
+ * index the query allows.  visit must not change the table.
+ */
+static Status_t
+sa_ServiceRecSelect(uint32_t match, STL_SERVICE_RECORD *query, ServiceRecVisit_t visit, void *arg) {
+	ServiceRecEntry_t	*entry;
+	OpaServiceRecordp	osrp;
+	ServiceRecKey_t		srkey;
+	CS_HashTableItr_t	itr;
+	Status_t			status = VSTATUS_OK;
+
+	if ((match & SERVICE_MATCH_KEY) == SERVICE_MATCH_KEY) {
+		sa_ServiceRecKeyFromRecord(&srkey, query);
+		if ((osrp = (OpaServiceRecordp)cs_hashtable_search(saServiceRecords.serviceRecMap, &srkey)) != NULL)
+			status = visit(osrp, arg);
+	} else if ((match & SERVICE_MATCH_ID) && saServiceRecords.idIndex) {
+		for (entry = saServiceRecords.idIndex[sa_ServiceRecIdChain(query->RID.ServiceID)];
+			 entry != NULL; entry = entry->idNext) {
+			if (sa_ServiceRecMatch(match, &entry->osr.serviceRecord, query) &&
+				(status = visit(&entry->osr, arg)) != VSTATUS_OK)
+				break;
+		}
+	} else if ((match & SERVICE_MATCH_GID) && saServiceRecords.gidIndex) {
+		for (entry = saServiceRecords.gidIndex[sa_ServiceRecGidChain(&query->RID.ServiceGID)];
+			 entry != NULL; entry = entry->gidNext) {
+			if (sa_ServiceRecMatch(match, &entry->osr.serviceRecord, query) &&
+				(status = visit(&entry->osr, arg)) != VSTATUS_OK)
+				break;
+		}
+	} else if (cs_hashtable_count(saServiceRecords.serviceRecMap) > 0) {
+		cs_hashtable_iterator(saServiceRecords.serviceRecMap, &itr);
+		do {
+			osrp = cs_hashtable_iterator_value(&itr);
+			if (sa_ServiceRecMatch(match, &osrp->serviceRecord, query) &&
+				(status = visit(osrp, arg)) != VSTATUS_OK)
+				break;
+		} while (cs_hashtable_iterator_advance(&itr));
+	}
+	return status;
+}
+
 /*
  * service record hash table initialization
  */
@@ -129,6 +427,8 @@ Status_t sa_ServiceRecInit(void) {
 		sa_ServiceRecCompare, CS_HASH_KEY_ALLOCATED))) {
 		status = VSTATUS_NOMEM;
 		IB_FATAL_ERROR_NODUMP("sa_main: Can't allocate subscriber hash table");
+	} else if ((status = sa_ServiceRecIndexResize(SERVICE_INDEX_MIN)) != VSTATUS_OK) {
+		IB_FATAL_ERROR_NODUMP("sa_main: Can't allocate service record indexes");
 	}
 	return status;
 }
@@ -139,6 +439,9 @@ Status_t sa_ServiceRecInit(void) {
 void sa_ServiceRecDelete(void) {
 	if (!saServiceRecords.serviceRecMap || vs_lock(&saServiceRecords.serviceRecLock) != VSTATUS_OK) return;
     (void) cs_hashtable_destroy(saServiceRecords.serviceRecMap, TRUE);  /* free everything */
+	free(saServiceRecords.idIndex);
+	free(saServiceRecords.gidIndex);
+	free(saServiceRecords.leases);
 	(void)vs_unlock(&saServiceRecords.serviceRecLock);
     (void)vs_lock_delete(&saServiceRecords.serviceRecLock);
     memset((void *)&saServiceRecords, 0, sizeof(ServiceRecTable_t));
@@ -156,6 +459,13 @@ void sa_ServiceRecClear(void) {
                                      sa_ServiceRecCompare, CS_HASH_KEY_ALLOCATED))) {
         IB_FATAL_ERROR_NODUMP("sa_ServiceRecClear: Can't reallocate service record hash table");
     }
+	/* the entries went with the map */
+	if (saServiceRecords.idIndex) {
+		memset(saServiceRecords.idIndex, 0, (saServiceRecords.indexMask + 1) * sizeof(ServiceRecEntry_t *));
+		memset(saServiceRecords.gidIndex, 0, (saServiceRecords.indexMask + 1) * sizeof(ServiceRecEntry_t *));
+	}
+	saServiceRecords.indexed = 0;
+	saServiceRecords.numLeases = 0;
 	(void)vs_unlock(&saServiceRecords.serviceRecLock);
 }
 
@@ -166,6 +476,7 @@ sa_ServiceRecord(Mai_t *maip, sa_cntxt_t *sa_cntxt) {
 	uint32_t	records;
 	uint16_t	attribOffset;
 	uint16_t	rec_sz;
+	SAResponse_t	*resp = NULL;
 
 	IB_ENTER("sa_ServiceRecord", maip, 0, 0, 0);
 
@@ -200,10 +511,12 @@ sa_ServiceRecord(Mai_t *maip, sa_cntxt_t *sa_cntxt) {
 		} else {
 			INCREMENT_COUNTER(smCounterSaRxGetTblServiceRecord);
 		}
-		if (maip->base.cversion == STL_SA_CLASS_VERSION) {
-			(void)sa_ServiceRecord_GetTable(maip, &records);
+		if (sa_resp_alloc(SA_RESP_SEGMENT_LEN(maip), &resp) != VSTATUS_OK) {
+			maip->base.status = MAD_STATUS_SA_NO_RESOURCES;
+		} else if (maip->base.cversion == STL_SA_CLASS_VERSION) {
+			(void)sa_ServiceRecord_GetTable(maip, resp, &records);
 		} else {
-			(void)sa_IbServiceRecord_GetTable(maip, &records);
+			(void)sa_IbServiceRecord_GetTable(maip, resp, &records);
 		}
 		break;
 	case SA_CM_SET:
@@ -252,32 +565,117 @@ sa_ServiceRecord(Mai_t *maip, sa_cntxt_t *sa_cntxt) {
 	attribOffset = rec_sz + Calculate_Padding(rec_sz);
 	sa_cntxt->attribLen = attribOffset;
 
-	sa_cntxt_data(sa_cntxt, sa_data, records * attribOffset);
+	if (resp) {
+		sa_cntxt_data_resp(sa_cntxt, records ? resp : NULL);
+		sa_resp_release(resp);
+	} else {
+		sa_cntxt_data(sa_cntxt, sa_data, records * attribOffset);
+	}
 	sa_send_reply(maip, sa_cntxt);
 
 	IB_EXIT("sa_ServiceRecord", VSTATUS_OK);
 	return(VSTATUS_OK);
 }
 
+/*
+ * a GET(TABLE) of service records in progress, handed to the visit functions
+ */
+typedef struct {
+	Mai_t				*maip;
+	uint8_t				*template;		// STL query, as received
+	STL_SERVICE_RECORD	*query;			// in host byte order
+	uint64_t			mask;			// IB component mask
+	uint64_t			smKey;
+	uint64_t			now;
+	SAResponse_t		*resp;			// records matched so far
+	uint32_t			*records;
+	Port_t				*reqPortp;
+} ServiceRecQuery_t;
+
+/*
+ * Filter a service record created with a pkey for an untrusted request.
+ * Returns 0 if the requester is not a member of the record's partition.
+ */
+static int
+sa_ServiceRecord_PKeyVisible(ServiceRecQuery_t *q, OpaServiceRecordp osrp, const char *func) {
+	Node_t		*reqNodep;
+
+	/* IBTA 1.2.1 C15-0.2-1.3 - if not trusted and pkey is defined on create, check req pkey */
+	if (!osrp->pkeyDefined)
+		return 1;
+	if (!q->reqPortp) {
+		q->reqPortp = sm_find_node_and_port_lid(&old_topology, q->maip->addrInfo.slid, &reqNodep);
+	}
+	if (!sm_valid_port(q->reqPortp) ||
+		q->reqPortp->state <= IB_PORT_DOWN ||
+		!smValidatePortPKey(osrp->serviceRecord.RID.ServiceP_Key, q->reqPortp)) {
+		IB_LOG_WARN_FMT(func, 
+			"Filter serviced record ID="FMT_U64" from lid 0x%.8X "
+			"due to pkey mismatch from request port",
+			osrp->serviceRecord.RID.ServiceID, q->maip->addrInfo.slid);
+		return 0;
+	}
+	return 1;
+}
+
+// Lease is given in "seconds from now" or "indefinite".
+static __inline__ uint32_t
+sa_ServiceRecord_Lease(OpaServiceRecordp osrp, uint64_t now) {
+	if (osrp->expireTime != VTIMER_ETERNITY)
+		return (uint32_t)((osrp->expireTime - now) / 1000000);
+	return 0xffffffff;
+}
+
+static Status_t
+sa_ServiceRecord_Put(OpaServiceRecordp osrp, void *arg) {
+	ServiceRecQuery_t	*q = (ServiceRecQuery_t *)arg;
+	STL_SERVICE_RECORD	*srp;
+	STL_SERVICE_RECORD	serviceRecord;
+
+	// tested before it goes in the response, which may not have room for it
+	BSWAPCOPY_STL_SERVICE_RECORD(&osrp->serviceRecord, &serviceRecord);
+	if (sa_template_test_noinc(q->template, (uint8_t*)&serviceRecord, 
+		sizeof(STL_SERVICE_RECORD)) != VSTATUS_OK) {
+		return VSTATUS_OK;
+	}
+	if ((srp = (STL_SERVICE_RECORD *)sa_resp_reserve(q->resp, 
+		sizeof(STL_SERVICE_RECORD), Calculate_Padding(sizeof(STL_SERVICE_RECORD)))) == NULL) {
+		q->maip->base.status = MAD_STATUS_SA_NO_RESOURCES;
+		IB_LOG_ERROR_FMT( "sa_ServiceRecord_GetTable",
+			   "Reached size limit at %d records", *q->records);
+		return VSTATUS_NOMEM;
+	}
+	memcpy(srp, &serviceRecord, sizeof(STL_SERVICE_RECORD));
+	srp->ServiceLease = ntoh32(sa_ServiceRecord_Lease(osrp, q->now));
+
+	if (sm_smInfo.SM_Key && q->smKey != sm_smInfo.SM_Key) {
+		if (!sa_ServiceRecord_PKeyVisible(q, osrp, "sa_ServiceRecord_GetTable"))
+			return VSTATUS_OK;
+
+		/* IBTA 1.2 C15-0.2.2 - do not return real serviceKey if not trusted request */
+		memset(srp->ServiceKey, 0, sizeof(srp->ServiceKey));
+	}
+
+	srp->RID.Reserved = 0;
+	srp->Reserved = 0;
+	/* put in outbut buffer */
+	sa_resp_commit(q->resp, sizeof(STL_SERVICE_RECORD), 
+		Calculate_Padding(sizeof(STL_SERVICE_RECORD)), q->records);
+	return VSTATUS_OK;
+}
+
 /* this function only returns records in STL format */
 Status_t
-sa_ServiceRecord_GetTable(Mai_t *maip, uint32_t *records) {
-	STL_SERVICE_RECORD	*srp;
-	uint32_t		temp;
-	uint32_t		pad_len;
-	uint64_t		now;
+sa_ServiceRecord_GetTable(Mai_t *maip, SAResponse_t *resp, uint32_t *records) {
 	STL_SA_MAD		samad;
 	Status_t		status;
-	OpaServiceRecord_t	*osrp;
-    ServiceRecKeyp  srkeyp;
-    CS_HashTableItr_t itr;
-	Port_t*			reqPortp=NULL;
-	Node_t*			reqNodep;
+	STL_SERVICE_RECORD	query;
+	ServiceRecQuery_t	q;
+	uint32_t		match = 0;
     
 	IB_ENTER("sa_ServiceRecord_GetTable", maip, *records, 0, 0);
 
 	*records = 0;
-	pad_len = Calculate_Padding(sizeof(STL_SERVICE_RECORD));
 
 //
 //  Verify the size of the data received for the request
@@ -292,8 +690,7 @@ sa_ServiceRecord_GetTable(Mai_t *maip, uint32_t *records) {
 	}
 
 	BSWAPCOPY_STL_SA_MAD((STL_SA_MAD*)maip->data, &samad, sizeof(STL_SERVICE_RECORD));
-
-	(void)vs_time_get(&now);
+	BSWAPCOPY_STL_SERVICE_RECORD((STL_SERVICE_RECORD*)samad.data, &query);
 
     /* Create the template mask for the lookup */
 	status = sa_create_template_mask(maip->base.aid, samad.header.mask);
@@ -302,66 +699,21 @@ sa_ServiceRecord_GetTable(Mai_t *maip, uint32_t *records) {
 		return(status);
 	}
 
-    /* Look for this record being a duplicate of another ServiceRecord */
-	srp = (STL_SERVICE_RECORD*)sa_data;
-	if (vs_lock(&saServiceRecords.serviceRecLock) != VSTATUS_OK) return VSTATUS_BAD;
-    if (cs_hashtable_count(saServiceRecords.serviceRecMap) > 0)
-    {
-		cs_hashtable_iterator(saServiceRecords.serviceRecMap, &itr);
-        do {
-            srkeyp = cs_hashtable_iterator_key(&itr);
-            osrp = cs_hashtable_iterator_value(&itr);
+	if (samad.header.mask & STL_SERVICE_RECORD_COMP_SERVICEID) match |= SERVICE_MATCH_ID;
+	if (samad.header.mask & STL_SERVICE_RECORD_COMP_SERVICEGID) match |= SERVICE_MATCH_GID;
+	if (samad.header.mask & STL_SERVICE_RECORD_COMP_SERVICEPKEY) match |= SERVICE_MATCH_PKEY;
 
-			BSWAPCOPY_STL_SERVICE_RECORD(&osrp->serviceRecord, srp);
-            status = sa_template_test_noinc(samad.data, (uint8_t*)srp, 
-				sizeof(STL_SERVICE_RECORD));
-            if (status == VSTATUS_OK) {
-                if ((status = sa_check_len((uint8_t*)srp, 
-					sizeof(STL_SERVICE_RECORD), pad_len)) != VSTATUS_OK) {
-                    maip->base.status = MAD_STATUS_SA_NO_RESOURCES;
-                    IB_LOG_ERROR_FMT( "sa_ServiceRecord_GetTable",
-                           "Reached size limit at %d records", *records);
-                    break;
-                }
-
-				// Lease is given in "seconds from now" or "indefinite".
-                if (osrp->expireTime != VTIMER_ETERNITY) {
-                    temp = (uint32_t)((osrp->expireTime - now) / 1000000);
-                } else {
-                    temp = 0xffffffff;
-                }
-                srp->ServiceLease = ntoh32(temp);
-
-                if (sm_smInfo.SM_Key && samad.header.smKey != sm_smInfo.SM_Key) {
-					/* IBTA 1.2.1 C15-0.2-1.3 - if not trusted and pkey is defined on create, check req pkey */
-					if (osrp->pkeyDefined) {
-						if (!reqPortp) {
-							reqPortp = sm_find_node_and_port_lid(&old_topology, maip->addrInfo.slid, 
-								&reqNodep);
-						}
-						if (!sm_valid_port(reqPortp) ||
-							reqPortp->state <= IB_PORT_DOWN ||
-							!smValidatePortPKey(srkeyp->servicep_key, reqPortp)) {
-							IB_LOG_WARN_FMT( "sa_ServiceRecord_GetTable", 
-								"Filter serviced record ID="FMT_U64" from lid 0x%.8X "
-								"due to pkey mismatch from request port",
-								osrp->serviceRecord.RID.ServiceID, maip->addrInfo.slid);
-							continue;
-						}
-					}
-
-					/* IBTA 1.2 C15-0.2.2 - do not return real serviceKey if not trusted request */
-                    memset(srp->ServiceKey, 0, sizeof(srp->ServiceKey));
-                }
-				
-				srp->RID.Reserved = 0;
-				srp->Reserved = 0;
-                /* put in outbut buffer */
-                sa_increment_and_pad((uint8_t**)&srp, sizeof(STL_SERVICE_RECORD), 
-					pad_len, records);
-            }
-        } while (cs_hashtable_iterator_advance(&itr));
-    }
+	memset(&q, 0, sizeof(q));
+	q.maip = maip;
+	q.template = samad.data;
+	q.query = &query;
+	q.smKey = samad.header.smKey;
+	q.resp = resp;
+	q.records = records;
+	(void)vs_time_get(&q.now);
+
+	if (vs_lock(&saServiceRecords.serviceRecLock) != VSTATUS_OK) return VSTATUS_BAD;
+	status = sa_ServiceRecSelect(match, &query, sa_ServiceRecord_Put, &q);
 	(void)vs_unlock(&saServiceRecords.serviceRecLock);
 	if (saDebugPerf) IB_LOG_INFINI_INFO("sa_serviceRecord_GetTable: Number of service records found is ", *records); 
 
@@ -369,26 +721,70 @@ sa_ServiceRecord_GetTable(Mai_t *maip, uint32_t *records) {
 	return(status);
 }
 
+static Status_t
+sa_IbServiceRecord_Put(OpaServiceRecordp osrp, void *arg) {
+	ServiceRecQuery_t	*q = (ServiceRecQuery_t *)arg;
+	IB_SERVICE_RECORD	*ibsrp;
+	STL_SERVICE_RECORD	*answer = &osrp->serviceRecord;
+
+	// ServiceID, ServiceP_Key and ServiceGID were matched by sa_ServiceRecSelect()
+	if (q->mask & IB_SERVICE_RECORD_COMP_SERVICELEASE &&
+		q->query->ServiceLease != answer->ServiceLease) {
+		return VSTATUS_OK;
+	} else if (q->mask & IB_SERVICE_RECORD_COMP_SERVICEKEY &&
+		memcmp(q->query->ServiceKey, answer->ServiceKey, sizeof(q->query->ServiceKey))) {
+		return VSTATUS_OK;
+	} else if (q->mask & IB_SERVICE_RECORD_COMP_SERVICENAME &&
+		memcmp(q->query->ServiceName, answer->ServiceName, sizeof(q->query->ServiceName))) {
+		return VSTATUS_OK;
+	}
+	if ((ibsrp = (IB_SERVICE_RECORD *)sa_resp_reserve(q->resp, 
+		sizeof(IB_SERVICE_RECORD), Calculate_Padding(sizeof(IB_SERVICE_RECORD)))) == NULL) {
+		q->maip->base.status = MAD_STATUS_SA_NO_RESOURCES;
+		IB_LOG_ERROR_FMT( "sa_IbServiceRecord_GetTable",
+			   "Reached size limit at %d records", *q->records);
+		return VSTATUS_NOMEM;
+	}
+
+	//Map back to IB, and to network byte order
+	memcpy(ibsrp->RID.ServiceGID.Raw, answer->RID.ServiceGID.Raw, sizeof(ibsrp->RID.ServiceGID.Raw));
+	ibsrp->RID.ServiceID = answer->RID.ServiceID;
+	// Field does not exist in IB: = hton32(answer->RID.ServiceLID);
+	ibsrp->RID.ServiceP_Key = answer->RID.ServiceP_Key;
+	ibsrp->ServiceLease = sa_ServiceRecord_Lease(osrp, q->now);
+	memcpy(ibsrp->ServiceKey,answer->ServiceKey,sizeof(ibsrp->ServiceKey));
+	memcpy(ibsrp->ServiceName,answer->ServiceName,sizeof(ibsrp->ServiceName));
+	memcpy(ibsrp->ServiceData8,answer->ServiceData8,sizeof(ibsrp->ServiceData8));
+	memcpy(ibsrp->ServiceData16,answer->ServiceData16,sizeof(ibsrp->ServiceData16));
+	memcpy(ibsrp->ServiceData32,answer->ServiceData32,sizeof(ibsrp->ServiceData32));
+	memcpy(ibsrp->ServiceData64,answer->ServiceData64,sizeof(ibsrp->ServiceData64));
+	BSWAP_IB_SERVICE_RECORD(ibsrp);
+
+	if (sm_smInfo.SM_Key && q->smKey != sm_smInfo.SM_Key) {
+		if (!sa_ServiceRecord_PKeyVisible(q, osrp, "sa_IbServiceRecord_GetTable"))
+			return VSTATUS_OK;
+
+		/* IBTA 1.2 C15-0.2.2 - do not return real serviceKey if not trusted request */
+		memset(ibsrp->ServiceKey, 0, sizeof(ibsrp->ServiceKey));
+	}
+	/* put in outbut buffer */
+	sa_resp_commit(q->resp, sizeof(IB_SERVICE_RECORD), 
+		Calculate_Padding(sizeof(IB_SERVICE_RECORD)), q->records);
+	return VSTATUS_OK;
+}
 
 Status_t
-sa_IbServiceRecord_GetTable(Mai_t *maip, uint32_t *records) {
+sa_IbServiceRecord_GetTable(Mai_t *maip, SAResponse_t *resp, uint32_t *records) {
 	IB_SERVICE_RECORD	*ibsrp;
 	STL_SERVICE_RECORD	query;
 	Status_t			status=VSTATUS_OK;
-	uint32_t			temp;
-	uint32_t			pad_len;
-	uint64_t			now;
 	IB_SA_MAD			samad;
-	OpaServiceRecord_t	*osrp;
-    ServiceRecKeyp		srkeyp;
-    CS_HashTableItr_t	itr;
-	Port_t*				reqPortp=NULL;
-	Node_t*				reqNodep;
+	ServiceRecQuery_t	q;
+	uint32_t			match = 0;
     
 	IB_ENTER("sa_IbServiceRecord_GetTable", maip, *records, 0, 0);
 
 	*records = 0;
-	pad_len = Calculate_Padding(sizeof(IB_SERVICE_RECORD));
 	
 	BSWAPCOPY_IB_SA_MAD((IB_SA_MAD*)maip->data, &samad,
 		sizeof(IB_SERVICE_RECORD));
@@ -409,98 +805,23 @@ sa_IbServiceRecord_GetTable(Mai_t *maip, uint32_t *records) {
 	memcpy(&query.ServiceData64,&ibsrp->ServiceData64,sizeof(query.ServiceData64));
 	BSWAP_STL_SERVICE_RECORD(&query);
 
-	(void)vs_time_get(&now);
+	if (samad.SaHdr.ComponentMask & IB_SERVICE_RECORD_COMP_SERVICEID) match |= SERVICE_MATCH_ID;
+	if (samad.SaHdr.ComponentMask & IB_SERVICE_RECORD_COMP_SERVICEGID) match |= SERVICE_MATCH_GID;
+	if (samad.SaHdr.ComponentMask & IB_SERVICE_RECORD_COMP_SERVICEPKEY) match |= SERVICE_MATCH_PKEY;
+
+	memset(&q, 0, sizeof(q));
+	q.maip = maip;
+	q.query = &query;
+	q.mask = samad.SaHdr.ComponentMask;
+	q.smKey = samad.SaHdr.SmKey;
+	q.resp = resp;
+	q.records = records;
+	(void)vs_time_get(&q.now);
 
-	/* Look for this record being a duplicate of another ServiceRecord */
-	ibsrp = (IB_SERVICE_RECORD*)sa_data;
 	if (vs_lock(&saServiceRecords.serviceRecLock) != VSTATUS_OK) {
 		return VSTATUS_BAD;
-	} else if (cs_hashtable_count(saServiceRecords.serviceRecMap) > 0) {
-		STL_SERVICE_RECORD *answer;
-
-		cs_hashtable_iterator(saServiceRecords.serviceRecMap, &itr);
-		do {
-			srkeyp = cs_hashtable_iterator_key(&itr);
-			osrp = cs_hashtable_iterator_value(&itr);
-			answer = &osrp->serviceRecord;
-
-			if (samad.SaHdr.ComponentMask & IB_SERVICE_RECORD_COMP_SERVICEID &&
-				query.RID.ServiceID != answer->RID.ServiceID) {
-				continue;
-			} else if (samad.SaHdr.ComponentMask & IB_SERVICE_RECORD_COMP_SERVICEPKEY &&
-				query.RID.ServiceP_Key != answer->RID.ServiceP_Key) {
-				continue;
-			} else if (samad.SaHdr.ComponentMask & IB_SERVICE_RECORD_COMP_SERVICEGID &&
-				memcmp(query.RID.ServiceGID.Raw, 
-					answer->RID.ServiceGID.Raw, 
-					sizeof(IB_GID))) {
-				continue;
-			} else if (samad.SaHdr.ComponentMask & IB_SERVICE_RECORD_COMP_SERVICELEASE &&
-				query.ServiceLease != answer->ServiceLease) {
-				continue;
-			} else if (samad.SaHdr.ComponentMask & IB_SERVICE_RECORD_COMP_SERVICEKEY &&
-				memcmp(query.ServiceKey, answer->ServiceKey, sizeof(query.ServiceKey))) {
-				continue;
-			} else if (samad.SaHdr.ComponentMask & IB_SERVICE_RECORD_COMP_SERVICENAME &&
-				memcmp(query.ServiceName, answer->ServiceName, sizeof(query.ServiceName))) {
-				continue;
-			}
-			if ((status = sa_check_len((uint8_t*)ibsrp, 
-				sizeof(IB_SERVICE_RECORD), pad_len)) != VSTATUS_OK) {
-				maip->base.status = MAD_STATUS_SA_NO_RESOURCES;
-				IB_LOG_ERROR_FMT( "sa_IbServiceRecord_GetTable",
-					   "Reached size limit at %d records", *records);
-				   break;
-			   }
-
-			// Lease is given in "seconds from now" or "indefinite".
-			if (osrp->expireTime != VTIMER_ETERNITY) {
-				temp = (uint32_t)((osrp->expireTime - now) / 1000000);
-			} else {
-				temp = 0xffffffff;
-			}
-
-			//Map back to IB, and to network byte order
-			memcpy(ibsrp->RID.ServiceGID.Raw, answer->RID.ServiceGID.Raw, sizeof(ibsrp->RID.ServiceGID.Raw));
-			ibsrp->RID.ServiceID = answer->RID.ServiceID;
-			// Field does not exist in IB: = hton32(answer->RID.ServiceLID);
-			ibsrp->RID.ServiceP_Key = answer->RID.ServiceP_Key;
-			ibsrp->ServiceLease = temp;
-			memcpy(ibsrp->ServiceKey,answer->ServiceKey,sizeof(ibsrp->ServiceKey));
-			memcpy(ibsrp->ServiceName,answer->ServiceName,sizeof(ibsrp->ServiceName));
-			memcpy(ibsrp->ServiceData8,answer->ServiceData8,sizeof(ibsrp->ServiceData8));
-			memcpy(ibsrp->ServiceData16,answer->ServiceData16,sizeof(ibsrp->ServiceData16));
-			memcpy(ibsrp->ServiceData32,answer->ServiceData32,sizeof(ibsrp->ServiceData32));
-			memcpy(ibsrp->ServiceData64,answer->ServiceData64,sizeof(ibsrp->ServiceData64));
-			BSWAP_IB_SERVICE_RECORD(ibsrp);
-
-			if (sm_smInfo.SM_Key && samad.SaHdr.SmKey != sm_smInfo.SM_Key) {
-				/* IBTA 1.2.1 C15-0.2-1.3 - if not trusted and pkey is defined on create, check req pkey */
-				if (osrp->pkeyDefined) {
-					reqPortp = sm_find_node_and_port_lid(&old_topology, 
-						maip->addrInfo.slid, 
-						&reqNodep);
-
-					if (!sm_valid_port(reqPortp) ||
-						reqPortp->state <= IB_PORT_DOWN ||
-						!smValidatePortPKey(srkeyp->servicep_key, reqPortp)) {
-						IB_LOG_WARN_FMT( "sa_IbServiceRecord_GetTable", 
-							"Filter serviced record ID="FMT_U64" from lid "
-							"0x%.8X due to pkey mismatch from request port",
-							osrp->serviceRecord.RID.ServiceID, 
-							maip->addrInfo.slid);
-						continue;
-					}
-				}
-
-				/* IBTA 1.2 C15-0.2.2 - do not return real serviceKey if not trusted request */
-				memset(ibsrp->ServiceKey, 0, sizeof(ibsrp->ServiceKey));
-			}
-			/* put in outbut buffer */
-			sa_increment_and_pad((uint8_t**)&ibsrp, sizeof(IB_SERVICE_RECORD), 
-				pad_len, records);
-		} while (cs_hashtable_iterator_advance(&itr));
 	}
+	status = sa_ServiceRecSelect(match, &query, sa_IbServiceRecord_Put, &q);
 	(void)vs_unlock(&saServiceRecords.serviceRecLock);
 	if (saDebugPerf) {
 		IB_LOG_INFINI_INFO("sa_IbServiceRecord_GetTable: "
@@ -560,7 +881,7 @@ sa_ServiceRecord_DoDelete(uint32_t *records, ServiceRecKey_t *srkeyp, uint8 *ser
 
     /* lock out service record hash table */
 	if (vs_lock(&saServiceRecords.serviceRecLock) != VSTATUS_OK) return VSTATUS_BAD;
-    if (NULL == (osrp = (OpaServiceRecordp)cs_hashtable_remove(saServiceRecords.serviceRecMap, srkeyp))) {
+    if (NULL == (osrp = sa_ServiceRecRemove(srkeyp))) {
 		IB_LOG_VERBOSE_FMT( "sa_serviceRecord_DoDelete",
 			"Could not find service record ID="FMT_U64" for GID="FMT_GID", Name=%.63s", 
 			srkeyp->serviceId, 
@@ -731,7 +1052,7 @@ sa_ServiceRecord_DoAdd(uint16_t slid, STL_SERVICE_RECORD *serviceRecordp,
     }
     if (NULL == (osrp = (OpaServiceRecordp)cs_hashtable_search(saServiceRecords.serviceRecMap, srkeyp))) {
         /* allocate a service record for adding to hash table */
-        if ((osrp = (OpaServiceRecordp) malloc(sizeof(OpaServiceRecord_t))) == NULL) {
+        if ((osrp = sa_ServiceRecAlloc()) == NULL) {
             free(srkeyp);
             (void)vs_unlock(&saServiceRecords.serviceRecLock);
             IB_FATAL_ERROR_NODUMP("sa_ServiceRecord_Add: Can't allocate Service Record hash entry");
@@ -746,7 +1067,7 @@ sa_ServiceRecord_DoAdd(uint16_t slid, STL_SERVICE_RECORD *serviceRecordp,
         } else {
             osrp->expireTime = VTIMER_ETERNITY;
         }
-        if (!cs_hashtable_insert(saServiceRecords.serviceRecMap, srkeyp, osrp)) {
+        if (!sa_ServiceRecInsert(srkeyp, osrp)) {
             (void)vs_unlock(&saServiceRecords.serviceRecLock);
             IB_LOG_ERROR_FMT( "sa_ServiceRecord_Add", 
                    "Failed to ADD serviced record ID="FMT_U64", serviceName[%s] from lid 0x%.8X to service record hashtable",
@@ -771,9 +1092,9 @@ sa_ServiceRecord_DoAdd(uint16_t slid, STL_SERVICE_RECORD *serviceRecordp,
         free(srkeyp);
 		/* Update the expiration timer since this is now a duplicate record */
 		if (timer != 0xffffffff) {
-			osrp->expireTime = now + (1000000 * (uint64_t)timer);
+			sa_ServiceRecSetExpireTime(osrp, now + (1000000 * (uint64_t)timer));
 		} else {
-			osrp->expireTime = VTIMER_ETERNITY;
+			sa_ServiceRecSetExpireTime(osrp, VTIMER_ETERNITY);
 		}
 		if (saDebugPerf) {
             IB_LOG_INFINI_INFO_FMT( "sa_ServiceRecord_Add",
@@ -839,14 +1160,14 @@ sa_IbServiceRecord_Add(Mai_t *maip, uint32_t *records) {
 }
 
 /*
- *	clear the records whose timers have expired.
+ *	clear the records whose timers have expired, soonest first from the
+ *	lease heap.
  */
 Status_t
 sa_ServiceRecord_Age(uint32_t *records) {
-	uint32_t		moreEntries;
 	uint64_t		now;
 	OpaServiceRecord_t	*osrp;
-    CS_HashTableItr_t itr;
+	ServiceRecKey_t	srkey;
 
 	IB_ENTER("sa_ServiceRecord_Age", *records, 0, 0, 0);
 
@@ -854,22 +1175,23 @@ sa_ServiceRecord_Age(uint32_t *records) {
     *records=0;
 	if (!saServiceRecords.serviceRecMap || vs_lock(&saServiceRecords.serviceRecLock) != VSTATUS_OK) 
         return VSTATUS_BAD;
-    if (cs_hashtable_count(saServiceRecords.serviceRecMap) > 0)
-    {
-		cs_hashtable_iterator(saServiceRecords.serviceRecMap, &itr);
-        do {
-            osrp = cs_hashtable_iterator_value(&itr);
-            if (osrp->expireTime < now) {
-                /* remove record from hash table */
-                moreEntries = cs_hashtable_iterator_remove(&itr);
-                ++(*records);
-                /* sync the service record deletion to standby SMs if necessary */
-                (void)sm_dbsync_syncService(DBSYNC_TYPE_DELETE, osrp);
-				free(osrp);
-            } else
-                moreEntries = cs_hashtable_iterator_advance(&itr);
-        } while (moreEntries);
-    }
+	while (saServiceRecords.numLeases > 0 &&
+		(osrp = &saServiceRecords.leases[0]->osr)->expireTime < now) {
+		/* remove record from hash table */
+		sa_ServiceRecKeyFromRecord(&srkey, &osrp->serviceRecord);
+		if (sa_ServiceRecRemove(&srkey) == NULL) {
+			/* not where its key says; drop it from the heap so aging goes on */
+			IB_LOG_ERROR_FMT("sa_ServiceRecord_Age",
+				"Expired service record ID="FMT_U64" is not in the service record table",
+				osrp->serviceRecord.RID.ServiceID);
+			sa_ServiceRecLeaseRemove((ServiceRecEntry_t *)osrp);
+			continue;
+		}
+		++(*records);
+		/* sync the service record deletion to standby SMs if necessary */
+		(void)sm_dbsync_syncService(DBSYNC_TYPE_DELETE, osrp);
+		free(osrp);
+	}
 	(void)vs_unlock(&saServiceRecords.serviceRecLock);
 
 	IB_EXIT("sa_ServiceRecord_Age", VSTATUS_OK);
@@ -153,7 +153,7 @@ sa_SwitchCostRecord_Set(uint8_t *cp, Node_t *source_nodep, cl_map_item_t **start
 		}
 
 		costRecord.Cost[i].DLID = dest_portp->portData->lid;
-		costRecord.Cost[i].value = old_topology.cost[Index(source_nodep->swIdx, dest_nodep->swIdx)];
+		costRecord.Cost[i].value = sm_cost_matrix_cost(&old_topology, source_nodep->swIdx, dest_nodep->swIdx);
 		++i;
 	}
 
@@ -62,13 +62,14 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "sm_l.h"
 #include "sa_l.h"
 
-Status_t	sa_SwitchInfoRecord_GetTable(Mai_t *, uint32_t *);
+Status_t	sa_SwitchInfoRecord_GetTable(Mai_t *, uint32_t *, SACacheEntry_t **);
 
 Status_t
 sa_SwitchInfoRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt) {
 	uint32_t	records;
 	uint16_t	attribOffset;
 	uint16_t	rec_sz;
+	SACacheEntry_t *cache = NULL;
 
 	IB_ENTER("sa_SwitchInfoRecord", maip, 0, 0, 0);
 
@@ -94,7 +95,7 @@ sa_SwitchInfoRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt) {
 	// Check Base and Class Version
 	if (maip->base.bversion == STL_BASE_VERSION && maip->base.cversion == STL_SA_CLASS_VERSION) {
 		rec_sz = sizeof(STL_SWITCHINFO_RECORD);
-		(void)sa_SwitchInfoRecord_GetTable(maip, &records);
+		(void)sa_SwitchInfoRecord_GetTable(maip, &records, &cache);
 	} else {
 		// Generate an error response and return.
 		maip->base.status = MAD_STATUS_BAD_CLASS;
@@ -120,7 +121,7 @@ sa_SwitchInfoRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt) {
 	attribOffset = sizeof(STL_SWITCHINFO_RECORD) + Calculate_Padding(rec_sz);
 	/* setup attribute offset for possible RMPP transfer */
 	sa_cntxt->attribLen = attribOffset;
-	sa_cntxt_data( sa_cntxt, sa_data, records * attribOffset);
+	sa_cntxt_data_cached( sa_cntxt, sa_data, records * attribOffset, cache);
 	(void)sa_send_reply(maip, sa_cntxt);
 
 	IB_EXIT("sa_SwitchInfoRecord", VSTATUS_OK);
@@ -154,13 +155,15 @@ sa_SwitchInfoRecord_Set(uint8_t *srp, Node_t *nodep, Port_t *portp) {
 	switchInfoRecord.Reserved = 0;
 	switchInfoRecord.SwitchInfoData = nodep->switchInfo;
 	BSWAPCOPY_STL_SWITCHINFO_RECORD(&switchInfoRecord, (STL_SWITCHINFO_RECORD*)srp);
+	// the copy skips Reserved; don't leave what sa_data held before in it
+	((STL_SWITCHINFO_RECORD*)srp)->Reserved = 0;
 
 	IB_EXIT("sa_SwitchInfoRecord_Set", VSTATUS_OK);
 	return(VSTATUS_OK);
 }
 
 Status_t
-sa_SwitchInfoRecord_GetTable(Mai_t *maip, uint32_t *records) {
+sa_SwitchInfoRecord_GetTable(Mai_t *maip, uint32_t *records, SACacheEntry_t **outCache) {
 	uint8_t		*data;
 	uint32_t	bytes;
 	Node_t		*nodep;
@@ -173,6 +176,7 @@ sa_SwitchInfoRecord_GetTable(Mai_t *maip, uint32_t *records) {
 	IB_ENTER("sa_SwitchInfoRecord_GetTable", maip, *records, 0, 0);
 
 	*records = 0;
+	*outCache = NULL;
 	data = sa_data;
 	bytes = Calculate_Padding(sizeof(STL_SWITCHINFO_RECORD));
 
@@ -205,6 +209,14 @@ sa_SwitchInfoRecord_GetTable(Mai_t *maip, uint32_t *records) {
 		return(status);
 	}
 
+	// the whole table is built once per sweep
+	if (!checkLid && !samad.header.mask && maip->base.method == SA_CM_GETTABLE &&
+		(*outCache = sa_cache_lookup(SA_CACHE_SWITCHINFO)) != NULL) {
+		*records = (*outCache)->records;
+		IB_EXIT("sa_SwitchInfoRecord_GetTable", VSTATUS_OK);
+		return(VSTATUS_OK);
+	}
+
 //
 //      Load the SwitchInfoRecords in the SADB
 //
@@ -255,3 +267,42 @@ done:
 	IB_EXIT("sa_SwitchInfoRecord_GetTable", status);
 	return(status);
 }
+
+// Builds the response to a GETTABLE of every SwitchInfoRecord in topop.
+//
+Status_t
+sa_SwitchInfoRecord_BuildCache(SACacheEntry_t *cachep, Topology_t *topop) {
+	uint8_t		*data;
+	uint32_t	records;
+	Node_t		*nodep;
+	Status_t	status;
+
+	IB_ENTER("sa_SwitchInfoRecord_BuildCache", cachep, topop, 0, 0);
+
+	records = 0;
+	for_all_switch_nodes(topop, nodep)
+		records++;
+
+	if ((status = sa_cache_alloc_records(cachep, records, sizeof(STL_SWITCHINFO_RECORD), &data)) != VSTATUS_OK) {
+		IB_EXIT("sa_SwitchInfoRecord_BuildCache", status);
+		return(status);
+	}
+
+	for_all_switch_nodes(topop, nodep) {
+		// a switch without a port 0 cuts the reply short; leave that to the query
+		if (sa_SwitchInfoRecord_Set(data, nodep, nodep->port) != VSTATUS_OK) {
+			(void)vs_pool_free(&sm_pool, cachep->data);
+			cachep->data = NULL;
+			IB_EXIT("sa_SwitchInfoRecord_BuildCache", VSTATUS_NOSUPPORT);
+			return(VSTATUS_NOSUPPORT);
+		}
+		sa_increment_and_pad(&data, sizeof(STL_SWITCHINFO_RECORD),
+			Calculate_Padding(sizeof(STL_SWITCHINFO_RECORD)), &cachep->records);
+	}
+
+	sprintf(cachep->name, "SwitchInfoRecs");
+	cachep->valid = 1;
+
+	IB_EXIT("sa_SwitchInfoRecord_BuildCache", VSTATUS_OK);
+	return(VSTATUS_OK);
+}
@@ -153,6 +153,24 @@ Status_t sm_sa_forward_trap (STL_NOTICE * noticep) {
     return status;
 }
 
+//
+// Fill in the heads of the subscriber chains a notice could match and
+// return how many there are: the subscriptions to TRAP_ALL and the chain
+// for its trap number.  Chains are shared by trap numbers, so callers still
+// check the trap number of each subscription.  Needs to be called with
+// subsLock held.
+//
+static __inline__ int
+sa_Trap_SubscriberChains(STL_NOTICE * noticep, SubscriberEntry_t ** chains)
+{
+	int numChains = 0;
+
+	chains[numChains++] = saSubscribers.allTraps;
+	if (noticep->Attributes.Generic.TrapNumber != TRAP_ALL)
+		chains[numChains++] = saSubscribers.trapIndex[noticep->Attributes.Generic.TrapNumber & (SA_SUBSCRIBER_TRAP_CHAINS - 1)];
+	return numChains;
+}
+
 //
 // determine number of notices that would be sent out
 //
@@ -160,22 +178,22 @@ int sm_sa_getNoticeCount (STL_NOTICE * noticep)
 {
 	int noticeCount=0;
 	STL_INFORM_INFO_RECORD *	iRecordp = NULL;
-    CS_HashTableItr_t itr;
+	SubscriberEntry_t *chains[2], *entry;
+	int i, numChains;
 
 	IB_ENTER("sa_notice_count", 0, 0, 0, 0);
 	
 	(void)vs_lock(&saSubscribers.subsLock);
-    if (cs_hashtable_count(saSubscribers.subsMap) > 0)
-    {
-        cs_hashtable_iterator(saSubscribers.subsMap, &itr);
-        do {
-            iRecordp = cs_hashtable_iterator_value(&itr);
+	numChains = sa_Trap_SubscriberChains(noticep, chains);
+	for (i = 0; i < numChains; i++) {
+		for (entry = chains[i]; entry != NULL; entry = entry->next) {
+			iRecordp = &entry->record;
 			if (iRecordp->InformInfoData.IsGeneric == noticep->Attributes.Generic.u.s.IsGeneric &&
-                (iRecordp->InformInfoData.Type == TRAP_ALL || iRecordp->InformInfoData.Type == noticep->Attributes.Generic.u.s.Type) &&
-                (iRecordp->InformInfoData.u.Generic.TrapNumber == TRAP_ALL || iRecordp->InformInfoData.u.Generic.TrapNumber == noticep->Attributes.Generic.TrapNumber))
-                ++noticeCount;
-        } while (cs_hashtable_iterator_advance(&itr));
-    }
+				(iRecordp->InformInfoData.Type == TRAP_ALL || iRecordp->InformInfoData.Type == noticep->Attributes.Generic.u.s.Type) &&
+				(iRecordp->InformInfoData.u.Generic.TrapNumber == TRAP_ALL || iRecordp->InformInfoData.u.Generic.TrapNumber == noticep->Attributes.Generic.TrapNumber))
+				++noticeCount;
+		}
+	}
 	(void)vs_unlock(&saSubscribers.subsLock);
 
 	IB_EXIT("sa_notice_count", noticeCount);
@@ -184,39 +202,42 @@ int sm_sa_getNoticeCount (STL_NOTICE * noticep)
 
 
 /*
- * Used for Traps that come from the SM itself, like Mgroup create and destroy
- * In this case, the caller creates the notice structure
+ * Forwards a notice to the subscribers that asked for it.  Used for Traps
+ * that come from the SM itself, like Mgroup create and destroy, in which
+ * case the caller creates the notice structure, and by sa_Trap for the
+ * Traps it receives.
  */
 Status_t
 sm_sa_forwardNotice(STL_NOTICE * noticep)
 {
 	STL_INFORM_INFO_RECORD * iRecordp = NULL;
-    SubscriberKeyp subsKeyp = NULL;
-    CS_HashTableItr_t itr;
+	SubscriberEntry_t *chains[2], *entry;
+	int i, numChains;
 
 	IB_ENTER("sm_sa_forwardNotice", 0, 0, 0, 0);
 	
 	(void)vs_lock(&saSubscribers.subsLock);
-    if (cs_hashtable_count(saSubscribers.subsMap) > 0)
-    {
-        cs_hashtable_iterator(saSubscribers.subsMap, &itr);
-        do {
-            subsKeyp = cs_hashtable_iterator_key(&itr);
-            iRecordp = cs_hashtable_iterator_value(&itr);
+	numChains = sa_Trap_SubscriberChains(noticep, chains);
+	for (i = 0; i < numChains; i++) {
+		for (entry = chains[i]; entry != NULL; entry = entry->next) {
+			iRecordp = &entry->record;
+			/* Check that the generic flags match */
 			if (iRecordp->InformInfoData.IsGeneric != noticep->Attributes.Generic.u.s.IsGeneric) {
 				continue;
 			}
+			/* Check that the severity levels are OK */
 			if (iRecordp->InformInfoData.Type != TRAP_ALL && iRecordp->InformInfoData.Type != noticep->Attributes.Generic.u.s.Type) {
 				continue;
 			}
+			/* Check that the trap number is OK */
 			if (iRecordp->InformInfoData.u.Generic.TrapNumber != TRAP_ALL && iRecordp->InformInfoData.u.Generic.TrapNumber != noticep->Attributes.Generic.TrapNumber) {
 				continue;
 			}
 			if (iRecordp->InformInfoData.u.Generic.u2.s.ProducerType != NODE_TYPE_ALL &&
-                iRecordp->InformInfoData.u.Generic.u2.s.ProducerType != 0 &&
-                iRecordp->InformInfoData.u.Generic.u2.s.ProducerType != noticep->Attributes.Generic.u.s.ProducerType) {
+				iRecordp->InformInfoData.u.Generic.u2.s.ProducerType != 0 &&
+				iRecordp->InformInfoData.u.Generic.u2.s.ProducerType != noticep->Attributes.Generic.u.s.ProducerType) {
 				/* 
-                 * work around host bug that used channel adapter for gid in/out service
+				 * work around host bug that used channel adapter for gid in/out service
 				 * and multicast group create destroy
 				 */
 				if (noticep->Attributes.Generic.TrapNumber >= MAD_SMT_PORT_UP && noticep->Attributes.Generic.TrapNumber <= MAD_SMT_MCAST_GRP_DELETED){
@@ -227,9 +248,10 @@ sm_sa_forwardNotice(STL_NOTICE * noticep)
 					continue;
 				}
 			}
-			sa_Trap_Forward(subsKeyp, noticep);
-        } while (cs_hashtable_iterator_advance(&itr));
-    }
+			/* This subscriber is OK, send them this Trap */
+			(void)sa_Trap_Forward(entry->key, noticep);
+		}
+	}
 	(void)vs_unlock(&saSubscribers.subsLock);
 
 	IB_EXIT("sm_sa_forwardNotice", VSTATUS_OK);
@@ -425,9 +447,6 @@ Status_t
 sa_Trap(Mai_t *maip) {
 	STL_NOTICE  notice = {{{{0}}}};
 	STL_TRAP_BAD_KEY_DATA pkeyTrap;
-	STL_INFORM_INFO_RECORD *	iRecordp = NULL;
-	SubscriberKeyp  subsKeyp = NULL;
-	CS_HashTableItr_t itr;
     uint64_t    tid=0;
 	Port_t *portp, *extPortp, *neighborPortp, *neighborExtPortp;
 	Node_t *nodep, *neighborNodep;
@@ -505,45 +524,7 @@ sa_Trap(Mai_t *maip) {
 	(void)mai_reply(fd_async->fdMai, maip);
 
 	/* Look for subscribers */
-	(void)vs_lock(&saSubscribers.subsLock);
-	if (cs_hashtable_count(saSubscribers.subsMap) > 0)
-	{
-		cs_hashtable_iterator(saSubscribers.subsMap, &itr);
-		do {
-			subsKeyp = cs_hashtable_iterator_key(&itr);
-			iRecordp = cs_hashtable_iterator_value(&itr);
-
-			/* Check that the generic flags match */
-			if (iRecordp->InformInfoData.IsGeneric != notice.Attributes.Generic.u.s.IsGeneric) {
-				continue;
-			}
-			/* Check that the severity levels are OK */
-			if ((iRecordp->InformInfoData.Type != TRAP_ALL) && (iRecordp->InformInfoData.Type != notice.Attributes.Generic.u.s.Type)) {
-				continue;
-			}
-			/* Check that the trap number is OK */
-			if ((iRecordp->InformInfoData.u.Generic.TrapNumber != TRAP_ALL) && (iRecordp->InformInfoData.u.Generic.TrapNumber != notice.Attributes.Generic.TrapNumber)) {
-				continue;
-			}
-			if ((iRecordp->InformInfoData.u.Generic.u2.s.ProducerType != NODE_TYPE_ALL) && (iRecordp->InformInfoData.u.Generic.u2.s.ProducerType != 0) && 
-					(iRecordp->InformInfoData.u.Generic.u2.s.ProducerType != notice.Attributes.Generic.u.s.ProducerType)) {
-				/* 
-				 * work around host bug that used channel adapter for gid in/out service
-				 * and multicast group create destroy
-				 */
-				if (notice.Attributes.Generic.TrapNumber >= MAD_SMT_PORT_UP && notice.Attributes.Generic.TrapNumber <= MAD_SMT_MCAST_GRP_DELETED){
-					if (iRecordp->InformInfoData.u.Generic.u2.s.ProducerType != NOTICE_PRODUCERTYPE_CA) {
-						continue;
-					}
-				} else {
-					continue;
-				}
-			}
-			/* This subscriber is OK, send them this Trap */
-			(void)sa_Trap_Forward(subsKeyp, &notice);
-		} while (cs_hashtable_iterator_advance(&itr));
-	}
-	(void)vs_unlock(&saSubscribers.subsLock);
+	(void)sm_sa_forwardNotice(&notice);
 
 	if (sm_config.IgnoreTraps) {
 		// filter out all traps
@@ -52,12 +52,13 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "sa_l.h"
 #include "stl_print.h"
 
-Status_t sa_VFabric_GetTable(Mai_t *, uint32_t *);
+Status_t sa_VFabric_GetTable(Mai_t *, uint32_t *, SACacheEntry_t **);
 
 Status_t
 sa_VFabricRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt) {
 	uint32_t	records;
     uint16_t    attribOffset;
+	SACacheEntry_t *cache = NULL;
 
 	IB_ENTER("sa_VFabricRecord", maip, sa_cntxt, 0, 0);
 
@@ -79,7 +80,7 @@ sa_VFabricRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt) {
 	}
 	// Check Base and Class Version
 	if (maip->base.bversion == STL_BASE_VERSION && maip->base.cversion == STL_SA_CLASS_VERSION) {
-		(void)sa_VFabric_GetTable(maip, &records);
+		(void)sa_VFabric_GetTable(maip, &records, &cache);
 	} else {
 		// Generate an error response and return.
 		maip->base.status = MAD_STATUS_BAD_CLASS;
@@ -107,7 +108,7 @@ sa_VFabricRecord(Mai_t *maip, sa_cntxt_t* sa_cntxt) {
     /* setup attribute offset for possible RMPP transfer */
     sa_cntxt->attribLen = attribOffset;
 
-	sa_cntxt_data(sa_cntxt, sa_data, records * attribOffset);
+	sa_cntxt_data_cached(sa_cntxt, sa_data, records * attribOffset, cache);
 	(void)sa_send_reply(maip, sa_cntxt);
 
 	IB_EXIT("sa_VFabricRecord", VSTATUS_OK);
@@ -188,7 +189,7 @@ sa_VFabric_Set(STL_VFINFO_RECORD *vfrp, VirtualFabrics_t *vfsp, VF_t *vfp, STL_S
 
 
 Status_t
-sa_VFabric_GetTable(Mai_t *maip, uint32_t *records)
+sa_VFabric_GetTable(Mai_t *maip, uint32_t *records, SACacheEntry_t **outCache)
 {
 	uint8_t			*data;
 	uint32_t		bytes;
@@ -205,6 +206,7 @@ sa_VFabric_GetTable(Mai_t *maip, uint32_t *records)
 	IB_ENTER("sa_VFabric_GetTable", maip, *records, 0, 0);
 
 	*records = 0;
+	*outCache = NULL;
 	data = sa_data;
 	bytes = Calculate_Padding(sizeof(STL_VFINFO_RECORD));
 	BSWAPCOPY_STL_SA_MAD((STL_SA_MAD*)maip->data, &samad, sizeof(STL_VFINFO_RECORD));
@@ -264,6 +266,13 @@ sa_VFabric_GetTable(Mai_t *maip, uint32_t *records)
 	if (smValidatePortPKey(DEFAULT_PKEY, reqPortp))
 		reqInFullDefault=1;
 
+	// every VF is built once per sweep for requestors that may see them all
+	if (reqInFullDefault && !samad.header.mask && maip->base.method == SA_CM_GETTABLE &&
+		(*outCache = sa_cache_lookup(SA_CACHE_VFABRICS)) != NULL) {
+		*records = (*outCache)->records;
+		goto reply_vFabric;
+	}
+
 	for (vf=0; vf < VirtualFabrics->number_of_vfs_all && vf < MAX_VFABRICS; vf++) {
 		VF_t *vfp = &VirtualFabrics->v_fabric_all[vf];
 
@@ -372,6 +381,56 @@ reply_vFabric:
 	return(status);
 }
 
+// Builds the response to a GETTABLE of every VFabricRecord in topop, as a
+// full member of the Default PKey sees it.
+//
+Status_t
+sa_VFabricRecord_BuildCache(SACacheEntry_t *cachep, Topology_t *topop)
+{
+	uint8_t			*data;
+	uint32_t		records;
+	Status_t		status;
+	int				vf;
+	VirtualFabrics_t *VirtualFabrics = topop->vfs_ptr;
+	IB_GID mGid = (IB_GID){.Raw = {0}};
+
+	IB_ENTER("sa_VFabricRecord_BuildCache", cachep, topop, 0, 0);
+
+	// without VFs the query is rejected; leave that to the query
+	if (!VirtualFabrics) {
+		IB_EXIT("sa_VFabricRecord_BuildCache", VSTATUS_NOSUPPORT);
+		return(VSTATUS_NOSUPPORT);
+	}
+
+	records = 0;
+	for (vf=0; vf < VirtualFabrics->number_of_vfs_all && vf < MAX_VFABRICS; vf++) {
+		if (!VirtualFabrics->v_fabric_all[vf].standby)
+			records++;
+	}
+
+	if ((status = sa_cache_alloc_records(cachep, records, sizeof(STL_VFINFO_RECORD), &data)) != VSTATUS_OK) {
+		IB_EXIT("sa_VFabricRecord_BuildCache", status);
+		return(status);
+	}
+
+	for (vf=0; vf < VirtualFabrics->number_of_vfs_all && vf < MAX_VFABRICS; vf++) {
+		VF_t *vfp = &VirtualFabrics->v_fabric_all[vf];
+
+		if (vfp->standby) continue;
+
+		sa_VFabric_Set((STL_VFINFO_RECORD*)data, VirtualFabrics, vfp, NULL, 0, mGid);
+		BSWAP_STL_VFINFO_RECORD((STL_VFINFO_RECORD*)data);
+		sa_increment_and_pad(&data, sizeof(STL_VFINFO_RECORD),
+			Calculate_Padding(sizeof(STL_VFINFO_RECORD)), &cachep->records);
+	}
+
+	sprintf(cachep->name, "VFabricRecords");
+	cachep->valid = 1;
+
+	IB_EXIT("sa_VFabricRecord_BuildCache", VSTATUS_OK);
+	return(VSTATUS_OK);
+}
+
 void showStlVFabrics(void) {
 	STL_VFINFO_RECORD vFabricRecord;
 	int vf;
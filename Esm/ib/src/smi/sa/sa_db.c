@@ -62,7 +62,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "sm_l.h"
 #include "sa_l.h"
 
-extern uint8_t		*sa_data;
+extern SA_THREAD_LOCAL uint8_t	*sa_data;
+extern SA_THREAD_LOCAL uint32_t	sa_data_size;
 extern uint32_t		sa_data_length;
 
 
@@ -127,7 +128,7 @@ sa_check_len(uint8_t *dst, uint32_t length, uint32_t bytes) {
 	IB_ENTER("sa_check_len", dst, length, bytes, 0);
 
 	if (dst < sa_data ||
-		dst + length + bytes > sa_data + sa_data_length) {
+		dst + length + bytes > sa_data + (sa_data_size ? sa_data_size : sa_data_length)) {
 
 		status = VSTATUS_NOMEM;
 	} else {
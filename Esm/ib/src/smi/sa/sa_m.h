@@ -45,13 +45,14 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //===========================================================================//
 
 //
-//	Scratch pad for template queries.  They must be used sequentially.
+//	Scratch pad for template queries.  They must be used sequentially
+//	within a thread; each SA worker thread has its own.
 //
-uint8_t		template_mask[4096];
-uint16_t	template_type;
-uint32_t	template_offset;
-uint32_t	template_length;
-FieldMask_t	*template_fieldp;
+SA_THREAD_LOCAL uint8_t		template_mask[4096];
+SA_THREAD_LOCAL uint16_t	template_type;
+SA_THREAD_LOCAL uint32_t	template_offset;
+SA_THREAD_LOCAL uint32_t	template_length;
+SA_THREAD_LOCAL FieldMask_t	*template_fieldp;
 
 FieldMask_t 	StlNodeRecordFieldMask[] = {
 	{     0,    32 },	// RID.LID
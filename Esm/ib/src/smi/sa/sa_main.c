@@ -67,9 +67,10 @@ extern	uint32_t	sm_port;
 extern	Pool_t		sm_pool;
 extern 	uint8_t		nullData[];
 extern  uint64_t	topology_wakeup_time;
-uint32_t            sa_mft_reprog=0;
+ATOMIC_UINT         sa_mft_reprog=0;
 
-uint8_t				*sa_data;
+SA_THREAD_LOCAL uint8_t	*sa_data;
+SA_THREAD_LOCAL uint32_t	sa_data_size;	// bytes in this thread's sa_data, 0 if sa_data_length
 uint32_t			sa_data_length;
 uint32_t			sa_max_ib_path_records;
 uint32_t            saDebugRmpp=0;  // control SA RMPP INFO debug messages; default off in ESM
@@ -82,6 +83,11 @@ SACache_t           saCache;
 SACacheBuildFunc_t  saCacheBuildFunctions[SA_NUM_CACHES] = {
 	sa_NodeRecord_BuildCACache,
 	sa_NodeRecord_BuildSwitchCache,
+	sa_PortInfoRecord_BuildCache,
+	sa_LinkRecord_BuildCache,
+	sa_SwitchInfoRecord_BuildCache,
+	sa_VFabricRecord_BuildCache,
+	sa_LFTableRecord_BuildCache,
 };
 
 
@@ -90,14 +96,25 @@ SACacheBuildFunc_t  saCacheBuildFunctions[SA_NUM_CACHES] = {
 /************ support for dynamic update of switch config parms *************/
 uint8_t sa_dynamicPlt[DYNAMIC_PACKET_LIFETIME_ARRAY_SIZE]={1,16,17,17,18,18,18,18,19,19};   // entry zero set to 1 indicates table in use
 
+// Contexts are carved out of chunks allocated as the request load requires,
+// each as large as all the chunks before it, until sa_max_cntxt exist.
+typedef struct sa_cntxt_chunk {
+	struct sa_cntxt_chunk	*next;
+	uint64_t				count;		// contexts following this header
+} sa_cntxt_chunk_t;
+
 static  Lock_t      sa_cntxt_lock;
-static 	sa_cntxt_t	*sa_hash[ SA_CNTXT_HASH_TABLE_DEPTH ];
-//static 	sa_cntxt_t	sa_cntxt_pool[ sa_max_cntxt ];
-static 	sa_cntxt_t	*sa_cntxt_pool;
+static 	sa_cntxt_t	**sa_hash;			// sa_hash_size buckets, a power of 2
+static	uint32_t	sa_hash_size;
+static	uint32_t	sa_hash_count;		// contexts in sa_hash
+static	sa_cntxt_chunk_t *sa_cntxt_chunks;
+static	uint32_t	sa_cntxt_pooled;	// contexts in all chunks
 static 	sa_cntxt_t	*sa_cntxt_free_list ;
 static  int	sa_cntxt_nalloc = 0 ;
 static 	int	sa_cntxt_nfree = 0 ;
 static  int sa_main_reader_exit = 0;
+static  ATOMIC_UINT numContextBusy = 0;	// bumped by every SA worker
+static  Lock_t      sa_update_lock;		// serializes Set and Delete requests
 static  int sa_main_writer_exit = 0;
 
 #define	INCR_SA_CNTXT_NFREE() {  \
@@ -151,6 +168,31 @@ static  int sa_main_writer_exit = 0;
 static uint64_t	timeLastAged=0;
 static uint64_t timeMftLastUpdated=0;
 
+/*
+ * Set and Delete requests change SA state that only the reader thread wrote
+ * before there were SA workers, so they are still processed one at a time.
+ * Queries run concurrently, each under its own hold of old_topology_lock.
+ */
+static Status_t
+sa_process_request(Mai_t *maip, sa_cntxt_t *sa_cntxt)
+{
+	Status_t	status;
+
+	if (maip->base.method != SA_CM_SET && maip->base.method != SA_CM_DELETE)
+		return sa_process_mad(maip, sa_cntxt);
+
+	(void)vs_lock(&sa_update_lock);
+	status = sa_process_mad(maip, sa_cntxt);
+	(void)vs_unlock(&sa_update_lock);
+	return status;
+}
+
+static const SAReaderOps_t saReaderOps = {
+	sa_process_request,
+	sa_process_getmulti,
+	sa_send_reply,
+};
+
 int sa_filter_reports(Mai_t * data)
 {
 	if (data->base.method == SA_CM_REPORT)
@@ -276,7 +318,6 @@ int sa_writer_filter(Mai_t *maip)
 int
 sa_main(void) {
 	Status_t		status;
-	int 			i;
 
 	IB_ENTER("sa_main", 0, 0, 0, 0);
 
@@ -290,40 +331,30 @@ sa_main(void) {
 		return 1;
 	}
     
-    // 
-    //  Zero context hash table
     //
-	memset( sa_hash, 0, sizeof( sa_hash ));
-	sa_cntxt_pool = NULL;
-    IB_LOG_VERBOSE("sa_main: Allocating SA context pool with num entries=", sa_max_cntxt);
-	status = vs_pool_alloc(&sm_pool, sizeof(sa_cntxt_t) * sa_max_cntxt, (void *)&sa_cntxt_pool);
-	if (status != VSTATUS_OK) {
+    //  Allocate the context hash table and the first chunk of the pool
+    //
+	status = sa_cntxt_init();
+	if (status == VSTATUS_NOMEM) {
 		IB_LOG_ERROR_FMT(__func__, "sa_main: Can't allocate SA context pool");
 		return 2;
+	} else if (status != VSTATUS_OK) {
+		IB_LOG_ERRORRC("sa_main: can't initialize SA context pool lock rc:", status);
+        return 3;
 	}
-	memset( sa_cntxt_pool, 0, sizeof( sa_cntxt_t ) * sa_max_cntxt);
-	sa_cntxt_free_list = NULL ;
-	for( i = 0 ; i < sa_max_cntxt ; ++i ) {
-		sa_cntxt_insert_head( sa_cntxt_free_list, &sa_cntxt_pool[i] );
-	}
-    sa_cntxt_nfree = sa_max_cntxt;
-    sa_cntxt_nalloc = 0;
-
-    // initialize SA context lock
-	status = vs_lock_init(&sa_cntxt_lock, VLOCK_FREE, VLOCK_THREAD);
+	status = vs_lock_init(&sa_update_lock, VLOCK_FREE, VLOCK_THREAD);
 	if (status != VSTATUS_OK) {
-		IB_LOG_ERRORRC("sa_main: can't initialize SA context pool lock rc:", status);
+		IB_LOG_ERRORRC("sa_main: can't initialize SA update lock rc:", status);
         return 3;
 	}
+	if (sa_PathRecIndexInit(sm_config.sa_path_index_entries, sm_config.sa_path_wildcard_cache_mb) != VSTATUS_OK) {
+		IB_LOG_ERROR_FMT(__func__, "sa_main: Can't allocate PathRecord index");
+		return 2;
+	}
     //
-    //	Allocate the SA storage pool.
+    //	The SA storage pool, sa_data, is allocated by each thread that
+    //	processes requests: the reader or its workers.
     //
-	status = vs_pool_alloc(&sm_pool, sa_data_length, (void*)&sa_data);
-	if (status != VSTATUS_OK) {
-		IB_LOG_ERROR_FMT(__func__, "sa_main: can't allocate sa data");
-		return 4;
-	}
-	memset(sa_data,0,sa_data_length);
 
     //
     //	Fill in my ClassPortInfo_t and add it to the database.
@@ -370,17 +401,339 @@ sa_main(void) {
 }
 
 
+/*
+ * Hand one request taken off the SA reader queue to its context: a new
+ * request is processed, an in progress getMulti continued, a duplicate
+ * dropped and BUSY returned when no context is available.  The handlers
+ * come from ops so that the same path can be driven without a fabric.
+ */
+void
+sa_main_reader_process(Mai_t *in_mad, uint64_t reqTimeToLive, const SAReaderOps_t *ops) {
+	sa_cntxt_t	*sa_cntxt=NULL;
+	uint64_t	now, delta, max_delta;
+	int			tries=0, retry=0;
+    SAContextGet_t  cntxGetStatus=0;
+	uint32_t	busy;
+
+    /* 
+     * Drop new requests that have been sitting on SA reader queue for too long 
+     */
+    if (in_mad->intime) {
+		/* PR 110586 - On some RHEL 5 systems, we've seen  weird issues with gettimeofday() [used by vs_time_get()]
+		 * where once in a while the time difference calculated from successive calls to gettimeofday()
+		 * results in a negative value. Due to this, we might actually consider a request stale even if
+		 * its not. Work around this by making calls to gettimeofday() till it returns us some
+		 * sane values. Just to be extra cautious, bound the retries so that we don't get stuck in the loop.  
+		 */
+		tries = 0;
+		/* Along with negative values also check for unreasonably high values of delta*/
+		max_delta = 30*reqTimeToLive;
+		do {
+			vs_time_get( &now );
+			delta = now - in_mad->intime;
+			tries++;
+			
+			if ((now < in_mad->intime) || (delta > max_delta)) {
+				vs_thread_sleep(1);
+				retry = 1;
+			} else {
+				retry = 0;
+			}	
+		} while (retry && tries < 20);
+
+        if (delta > reqTimeToLive) {
+			INCREMENT_COUNTER(smCounterSaDroppedRequests);
+            if (smDebugPerf || saDebugPerf) {
+                IB_LOG_INFINI_INFO_FMT( "sa_main_reader",
+                       "Dropping stale %s[%s] request from LID[0x%x], TID="FMT_U64"; On queue for %d.%d seconds.", 
+                       sa_getMethodText((int)in_mad->base.method), sa_getAidName((int)in_mad->base.aid), in_mad->addrInfo.slid, 
+                       in_mad->base.tid, (int)(delta/1000000), (int)((delta - delta/1000000*1000000))/1000);
+            }
+            /* drop the request without returning a response; sender will retry */
+            return;
+        }
+    }
+    /* 
+     * get a context to process request; sa_cntxt can be:
+     *   1. NULL if resources are scarce
+     *   2. NULL if request is dup of existing request
+     *   3. in progress getMulti request context
+     *   4. New context for a brand new request 
+     */
+    cntxGetStatus = sa_cntxt_get( in_mad, (void *)&sa_cntxt );
+    if (cntxGetStatus == ContextAllocated) {
+		/* process the new request */
+		ops->process( in_mad, sa_cntxt );
+		/* 
+		 * This may not necessarily release context based on if someone else has reserved it
+		 */
+		if(sa_cntxt) sa_cntxt_release( sa_cntxt );
+	} else if (cntxGetStatus == ContextExist) {
+		INCREMENT_COUNTER(smCounterSaDuplicateRequests);
+		/* this is a duplicate request */
+		if (saDebugPerf || saDebugRmpp) {
+			IB_LOG_INFINI_INFO_FMT( "sa_main_reader",
+			       "SA_READER received duplicate %s[%s] from LID [0x%x] with TID ["FMT_U64"] ", 
+			       sa_getMethodText((int)in_mad->base.method), sa_getAidName((int)in_mad->base.aid),in_mad->addrInfo.slid, in_mad->base.tid);
+		}
+    } else if (cntxGetStatus == ContextNotAvailable) {
+		INCREMENT_COUNTER(smCounterSaContextNotAvailable);
+        /* we are swamped, return BUSY to caller */
+        if (saDebugPerf || saDebugRmpp) { /* log msg before send changes method and lids */
+            IB_LOG_INFINI_INFO_FMT( "sa_main_reader",
+                   "NO CONTEXT AVAILABLE, returning MAD_STATUS_BUSY to %s[%s] request from LID [0x%x], TID ["FMT_U64"]!",
+                   sa_getMethodText((int)in_mad->base.method), sa_getAidName((int)in_mad->base.aid), in_mad->addrInfo.slid, in_mad->base.tid);
+        }
+        in_mad->base.status = MAD_STATUS_BUSY;
+        ops->reply( in_mad, sa_cntxt );
+        if (((busy = AtomicIncrement(&numContextBusy)) % sa_max_cntxt) == 0) {
+            IB_LOG_INFINI_INFO_FMT( "sa_main_reader",
+                   "Had to drop %u SA requests since start due to no available contexts",
+                   busy);
+        }
+    } else if (cntxGetStatus == ContextExistGetMulti) {
+        /* continue processing the getMulti request */
+        ops->getmulti( in_mad, sa_cntxt );
+        if(sa_cntxt) sa_cntxt_release( sa_cntxt );
+    } else {
+        IB_LOG_WARN("sa_main_reader: Invalid sa_cntxt_get return code:", cntxGetStatus);
+    }
+}
+
+#ifdef ENABLE_MULTITHREADED
+//
+// SA worker threads.  The reader hands each request to the worker chosen
+// by its source LID, so a client's requests, including the segments of a
+// getMulti request, are processed in the order they arrived while other
+// clients' requests proceed on the other workers.  A client whose worker
+// has SA_WORKER_QUEUE_DEPTH requests waiting is answered BUSY.
+//
+// Rather than each holding an sa_data_length buffer sized for the largest
+// configured subnet, a worker starts with SA_WORKER_DATA_MIN bytes of
+// sa_data and grows it before a request once the fabric last swept
+// outgrows it.
+//
+#define SA_WORKER_QUEUE_DEPTH	256
+#define SA_WORKER_DATA_MIN	(64 * 1024)
+
+typedef struct {
+	Thread_t	thread;
+	Lock_t		lock;
+	Sema_t		sema;			// one count per queued request
+	uint32_t	head;			// oldest queued request
+	uint32_t	count;			// requests queued
+	Mai_t		*queue;			// SA_WORKER_QUEUE_DEPTH requests
+	uint8_t		*data;			// the worker's sa_data
+	uint32_t	dataSize;		// bytes in data
+} SAWorker_t;
+
+static SAWorker_t	*sa_workers;
+static uint32_t		sa_num_workers;
+static uint64_t		sa_workers_ttl;			// reqTimeToLive for the workers
+static const SAReaderOps_t *sa_workers_ops;
+static volatile int	sa_workers_exit;
+static Sema_t		sa_workers_done_sema;
+
+/*
+ * Grow the worker's sa_data to 512 bytes per node and port of the current
+ * fabric, the allowance sa_data_length makes per configured port.  If the
+ * buffer can't grow the worker keeps the one it has and responses that
+ * don't fit are refused by sa_check_len.
+ */
+static void
+sa_worker_size_data(SAWorker_t *worker) {
+	uint64_t	needed;
+	uint8_t		*data;
+
+	(void)vs_rdlock(&old_topology_lock);
+	needed = 512 * ((uint64_t)old_topology.num_nodes + old_topology.num_ports);
+	(void)vs_rwunlock(&old_topology_lock);
+
+	if (needed <= worker->dataSize || worker->dataSize >= sa_data_length)
+		return;
+	// at least double, so a growing fabric reallocates rarely
+	if (needed < 2 * (uint64_t)worker->dataSize)
+		needed = 2 * (uint64_t)worker->dataSize;
+	needed = MIN(needed, sa_data_length);
+
+	if (vs_pool_alloc(&sm_pool, needed, (void *)&data) != VSTATUS_OK) {
+		IB_LOG_WARN("sa_worker_size_data: can't grow SA worker buffer to bytes:", needed);
+		return;
+	}
+	memset(data, 0, needed);
+	if (worker->data)
+		(void)vs_pool_free(&sm_pool, worker->data);
+	worker->data = data;
+	worker->dataSize = needed;
+	sa_data = data;
+	sa_data_size = needed;
+}
+
+static void
+sa_worker_main(uint32_t argc, uint8_t ** argv) {
+	SAWorker_t	*worker = &sa_workers[argc];
+	Mai_t		in_mad;
+
+	sa_data = worker->data;
+	sa_data_size = worker->dataSize;
+	while (1) {
+		if (cs_psema(&worker->sema) != VSTATUS_OK)
+			continue;
+		(void)vs_lock(&worker->lock);
+		if (worker->count == 0) {
+			// woken without a request only to exit
+			(void)vs_unlock(&worker->lock);
+			if (sa_workers_exit)
+				break;
+			continue;
+		}
+		memcpy(&in_mad, &worker->queue[worker->head], sizeof(Mai_t));
+		worker->head = (worker->head + 1) % SA_WORKER_QUEUE_DEPTH;
+		worker->count--;
+		(void)vs_unlock(&worker->lock);
+
+		sa_worker_size_data(worker);
+		sa_main_reader_process(&in_mad, sa_workers_ttl, sa_workers_ops);
+	}
+	(void)cs_vsema(&sa_workers_done_sema);
+}
+
+/*
+ * Start num worker threads processing requests with ops.  On failure no
+ * workers are left running and requests must be processed by the caller.
+ */
+Status_t
+sa_workers_start(uint32_t num, uint64_t reqTimeToLive, const SAReaderOps_t *ops) {
+	SAWorker_t	*worker;
+	uint32_t	i;
+	Status_t	status;
+
+	if (sa_num_workers || num == 0)
+		return VSTATUS_ILLPARM;
+	status = vs_pool_alloc(&sm_pool, sizeof(SAWorker_t) * num, (void *)&sa_workers);
+	if (status != VSTATUS_OK)
+		return status;
+	memset(sa_workers, 0, sizeof(SAWorker_t) * num);
+	sa_workers_ttl = reqTimeToLive;
+	sa_workers_ops = ops;
+	sa_workers_exit = 0;
+	if ((status = cs_sema_create(&sa_workers_done_sema, 0)) != VSTATUS_OK) {
+		(void)vs_pool_free(&sm_pool, sa_workers);
+		sa_workers = NULL;
+		return status;
+	}
+
+	for (i = 0; i < num; i++) {
+		worker = &sa_workers[i];
+		if ((status = vs_pool_alloc(&sm_pool, sizeof(Mai_t) * SA_WORKER_QUEUE_DEPTH,
+				(void *)&worker->queue)) != VSTATUS_OK)
+			break;
+		worker->dataSize = MIN(SA_WORKER_DATA_MIN, sa_data_length);
+		if ((status = vs_pool_alloc(&sm_pool, worker->dataSize, (void *)&worker->data)) != VSTATUS_OK)
+			break;
+		memset(worker->data, 0, worker->dataSize);
+		if ((status = vs_lock_init(&worker->lock, VLOCK_FREE, VLOCK_THREAD)) != VSTATUS_OK)
+			break;
+		if ((status = cs_sema_create(&worker->sema, 0)) != VSTATUS_OK) {
+			(void)vs_lock_delete(&worker->lock);
+			break;
+		}
+		if ((status = vs_thread_create(&worker->thread, (unsigned char *)"sa_worker",
+				sa_worker_main, i, NULL, SM_STACK_SIZE)) != VSTATUS_OK) {
+			(void)cs_sema_delete(&worker->sema);
+			(void)vs_lock_delete(&worker->lock);
+			break;
+		}
+		sa_num_workers++;
+	}
+	if (sa_num_workers < num) {
+		IB_LOG_ERRORRC("sa_workers_start: can't start SA worker thread rc:", status);
+		if (worker->data)
+			(void)vs_pool_free(&sm_pool, worker->data);
+		if (worker->queue)
+			(void)vs_pool_free(&sm_pool, worker->queue);
+		sa_workers_stop();
+		return status;
+	}
+	return VSTATUS_OK;
+}
+
+/*
+ * Queue a request for its worker.  VSTATUS_BUSY if the worker's queue is
+ * full, VSTATUS_NOT_FOUND if no workers are running.
+ */
+Status_t
+sa_workers_submit(Mai_t *maip) {
+	SAWorker_t	*worker;
+
+	if (!sa_num_workers)
+		return VSTATUS_NOT_FOUND;
+	worker = &sa_workers[maip->addrInfo.slid % sa_num_workers];
+	(void)vs_lock(&worker->lock);
+	if (worker->count == SA_WORKER_QUEUE_DEPTH) {
+		(void)vs_unlock(&worker->lock);
+		return VSTATUS_BUSY;
+	}
+	memcpy(&worker->queue[(worker->head + worker->count) % SA_WORKER_QUEUE_DEPTH], maip, sizeof(Mai_t));
+	worker->count++;
+	(void)vs_unlock(&worker->lock);
+	(void)cs_vsema(&worker->sema);
+	return VSTATUS_OK;
+}
+
+/*
+ * Stop the workers once they have processed the requests already queued.
+ */
+void
+sa_workers_stop(void) {
+	SAWorker_t	*worker;
+	uint32_t	i;
+
+	if (!sa_workers)
+		return;
+	sa_workers_exit = 1;
+	for (i = 0; i < sa_num_workers; i++)
+		(void)cs_vsema(&sa_workers[i].sema);
+	for (i = 0; i < sa_num_workers; i++) {
+		while (cs_psema(&sa_workers_done_sema) != VSTATUS_OK)
+			;
+	}
+	for (i = 0; i < sa_num_workers; i++) {
+		worker = &sa_workers[i];
+		(void)cs_sema_delete(&worker->sema);
+		(void)vs_lock_delete(&worker->lock);
+		(void)vs_pool_free(&sm_pool, worker->queue);
+		(void)vs_pool_free(&sm_pool, worker->data);
+	}
+	(void)cs_sema_delete(&sa_workers_done_sema);
+	(void)vs_pool_free(&sm_pool, sa_workers);
+	sa_workers = NULL;
+	sa_num_workers = 0;
+}
+#else
+Status_t
+sa_workers_start(uint32_t num, uint64_t reqTimeToLive, const SAReaderOps_t *ops) {
+	return VSTATUS_NOSUPPORT;
+}
+
+Status_t
+sa_workers_submit(Mai_t *maip) {
+	return VSTATUS_NOT_FOUND;
+}
+
+void
+sa_workers_stop(void) {
+}
+#endif
+
 void
 sa_main_reader(uint32_t argc, uint8_t ** argv) {
 	Status_t	status;
 	Mai_t		in_mad;
 	Filter_t	filter;
-	sa_cntxt_t	*sa_cntxt=NULL;
-	uint64_t	now, delta, max_delta;
-	int			tries=0, retry=0;
+	uint64_t	now;
     uint64_t    reqTimeToLive=0;
-    SAContextGet_t  cntxGetStatus=0;
-    int         numContextBusy=0;
+    int         workers = 0;
 
 	IB_ENTER("sa_main_reader", 0, 0, 0, 0);
 
@@ -408,6 +761,22 @@ sa_main_reader(uint32_t argc, uint8_t ** argv) {
      * ~ 3.2secs for defaults: sa_packetLifetime=18 and sa_respTimeValue=18 
      */
     reqTimeToLive = 4ull * ( (2*(1 << sm_config.sa_packet_lifetime_n2)) + (1 << sm_config.sa_resp_time_n2) ); 
+
+    /* process requests on SA worker threads, or on this thread if there are none */
+    if (sm_config.sa_worker_threads) {
+        status = sa_workers_start(sm_config.sa_worker_threads, reqTimeToLive, &saReaderOps);
+        if (status == VSTATUS_OK)
+            workers = 1;
+        else
+            IB_LOG_WARNRC("sa_main_reader: can't start SA worker threads, processing requests on the reader thread rc:", status);
+    }
+    if (!workers) {
+        if (vs_pool_alloc(&sm_pool, sa_data_length, (void*)&sa_data) != VSTATUS_OK) {
+            IB_LOG_ERROR0("sa_main_reader: can't allocate sa data");
+            (void)vs_thread_exit(&sm_threads[SM_THREAD_SA_READER].handle);
+        }
+        memset(sa_data, 0, sa_data_length);
+    }
 	while (1) {
 		status = mai_recv(fd_sa->fdMai, &in_mad, VTIMER_1S/4);
 
@@ -430,90 +799,13 @@ sa_main_reader(uint32_t argc, uint8_t ** argv) {
 		if( status != VSTATUS_OK ){
             if (status != VSTATUS_TIMEOUT)
                 IB_LOG_ERRORRC("sa_main_reader: error on mai_recv rc:", status);
-        } else {
-            /* 
-             * Drop new requests that have been sitting on SA reader queue for too long 
-             */
-            if (in_mad.intime) {
-				/* PR 110586 - On some RHEL 5 systems, we've seen  weird issues with gettimeofday() [used by vs_time_get()]
-				 * where once in a while the time difference calculated from successive calls to gettimeofday()
-				 * results in a negative value. Due to this, we might actually consider a request stale even if
-				 * its not. Work around this by making calls to gettimeofday() till it returns us some
-				 * sane values. Just to be extra cautious, bound the retries so that we don't get stuck in the loop.  
-				 */
-				tries = 0;
-				/* Along with negative values also check for unreasonably high values of delta*/
-				max_delta = 30*reqTimeToLive;
-				do {
-					vs_time_get( &now );
-					delta = now - in_mad.intime;
-					tries++;
-					
-					if ((now < in_mad.intime) || (delta > max_delta)) {
-						vs_thread_sleep(1);
-						retry = 1;
-					} else {
-						retry = 0;
-					}	
-				} while (retry && tries < 20);
-
-                if (delta > reqTimeToLive) {
-					INCREMENT_COUNTER(smCounterSaDroppedRequests);
-                    if (smDebugPerf || saDebugPerf) {
-                        IB_LOG_INFINI_INFO_FMT( "sa_main_reader",
-                               "Dropping stale %s[%s] request from LID[0x%x], TID="FMT_U64"; On queue for %d.%d seconds.", 
-                               sa_getMethodText((int)in_mad.base.method), sa_getAidName((int)in_mad.base.aid), in_mad.addrInfo.slid, 
-                               in_mad.base.tid, (int)(delta/1000000), (int)((delta - delta/1000000*1000000))/1000);
-                    }
-                    /* drop the request without returning a response; sender will retry */
-                    continue;
-                }
-            }
-            /* 
-             * get a context to process request; sa_cntxt can be:
-             *   1. NULL if resources are scarce
-             *   2. NULL if request is dup of existing request
-             *   3. in progress getMulti request context
-             *   4. New context for a brand new request 
-             */
-            cntxGetStatus = sa_cntxt_get( &in_mad, (void *)&sa_cntxt );
-            if (cntxGetStatus == ContextAllocated) {
-				/* process the new request */
-				sa_process_mad( &in_mad, sa_cntxt );
-				/* 
-				 * This may not necessarily release context based on if someone else has reserved it
-				 */
-				if(sa_cntxt) sa_cntxt_release( sa_cntxt );
-			} else if (cntxGetStatus == ContextExist) {
-				INCREMENT_COUNTER(smCounterSaDuplicateRequests);
-				/* this is a duplicate request */
-				if (saDebugPerf || saDebugRmpp) {
-					IB_LOG_INFINI_INFO_FMT( "sa_main_reader",
-					       "SA_READER received duplicate %s[%s] from LID [0x%x] with TID ["FMT_U64"] ", 
-					       sa_getMethodText((int)in_mad.base.method), sa_getAidName((int)in_mad.base.aid),in_mad.addrInfo.slid, in_mad.base.tid);
-				}
-            } else if (cntxGetStatus == ContextNotAvailable) {
-				INCREMENT_COUNTER(smCounterSaContextNotAvailable);
-                /* we are swamped, return BUSY to caller */
-                if (saDebugPerf || saDebugRmpp) { /* log msg before send changes method and lids */
-                    IB_LOG_INFINI_INFO_FMT( "sa_main_reader",
-                           "NO CONTEXT AVAILABLE, returning MAD_STATUS_BUSY to %s[%s] request from LID [0x%x], TID ["FMT_U64"]!",
-                           sa_getMethodText((int)in_mad.base.method), sa_getAidName((int)in_mad.base.aid), in_mad.addrInfo.slid, in_mad.base.tid);
-                }
-                in_mad.base.status = MAD_STATUS_BUSY;
-                sa_send_reply( &in_mad, sa_cntxt );
-                if ((++numContextBusy % sa_max_cntxt) == 0) {
-                    IB_LOG_INFINI_INFO_FMT( "sa_main_reader",
-                           "Had to drop %d SA requests since start due to no available contexts",
-                           numContextBusy);
-                }
-            } else if (cntxGetStatus == ContextExistGetMulti) {
-                /* continue processing the getMulti request */
-                sa_process_getmulti( &in_mad, sa_cntxt );
-                if(sa_cntxt) sa_cntxt_release( sa_cntxt );
-            } else {
-                IB_LOG_WARN("sa_main_reader: Invalid sa_cntxt_get return code:", cntxGetStatus);
-            }
+        } else if (!workers) {
+            sa_main_reader_process( &in_mad, reqTimeToLive, &saReaderOps );
+        } else if (sa_workers_submit(&in_mad) != VSTATUS_OK) {
+            /* the client's worker is backed up, have the client retry later */
+            INCREMENT_COUNTER(smCounterSaContextNotAvailable);
+            in_mad.base.status = MAD_STATUS_BUSY;
+            (void)sa_send_reply(&in_mad, NULL);
         }
 
         /* 
@@ -521,18 +813,28 @@ sa_main_reader(uint32_t argc, uint8_t ** argv) {
          * Wait one second to allow mcmember requests to accumulate before asking
          */
         vs_time_get( &now );
-        if (sa_mft_reprog && timeMftLastUpdated == 0) {
+        if (AtomicRead(&sa_mft_reprog) && timeMftLastUpdated == 0) {
             timeMftLastUpdated = now;
-        } else if (sa_mft_reprog && (now - timeMftLastUpdated) > VTIMER_1S) {
+        } else if (AtomicRead(&sa_mft_reprog) && (now - timeMftLastUpdated) > VTIMER_1S) {
+            /*
+             * clear the indicators before triggering; workers set sa_mft_reprog
+             * concurrently, and a join arriving from here on starts a new round
+             */
+            (void)AtomicExchange(&sa_mft_reprog, 0);
+            timeMftLastUpdated = 0;
+
             topology_wakeup_time = 0ull;
             AtomicWrite(&sm_McGroups_Need_Prog, 1); /* tells Topoloy thread that MFT reprogramming is needed */
 
             sm_trigger_sweep(SM_SWEEP_REASON_MCMEMBER);
-            /* clear the indicators */
-            timeMftLastUpdated = 0;
-            sa_mft_reprog = 0;
         }
 	}
+    if (workers) {
+        sa_workers_stop();
+    } else {
+        (void)vs_pool_free(&sm_pool, sa_data);
+        sa_data = NULL;
+    }
     /* cleanup before exit, but allow some time for the other threads to flush out first */
     (void)vs_thread_sleep(VTIMER_1S);     
     (void)sa_SubscriberDelete();
@@ -656,6 +958,174 @@ sa_main_kill(void){
 	sa_main_writer_exit = 1;
 }
 
+/*
+ * Bucket of the request from lid with transaction id tid in class mclass.
+ * Clients number their TIDs sequentially, so the whole key is mixed rather
+ * than taking the LID modulo the table size.
+ */
+static __inline__ uint32_t
+sa_cntxt_bucket( STL_LID lid, uint64_t tid, uint8_t mclass )
+{
+	uint64_t	key;
+
+	key = tid ^ ((((uint64_t)mclass << 32) | lid) * 0x9e3779b97f4a7c15ull);
+	key ^= key >> 31;
+	key *= 0xbf58476d1ce4e5b9ull;
+	key ^= key >> 29;
+	return (uint32_t)key & (sa_hash_size - 1);
+}
+
+/*
+ * Double the hash table once it holds as many contexts as buckets.  If the
+ * larger table can't be allocated the current one is kept.  Called under
+ * sa_cntxt_lock.
+ */
+static void
+sa_cntxt_hash_grow( void )
+{
+	sa_cntxt_t	**oldHash = sa_hash;
+	sa_cntxt_t	*sa_cntxt, *next;
+	uint32_t	oldSize = sa_hash_size;
+	uint32_t	i, bucket;
+
+	if (vs_pool_alloc(&sm_pool, sizeof(sa_cntxt_t *) * oldSize * 2, (void *)&sa_hash) != VSTATUS_OK) {
+		sa_hash = oldHash;
+		return;
+	}
+	memset( sa_hash, 0, sizeof(sa_cntxt_t *) * oldSize * 2 );
+	sa_hash_size = oldSize * 2;
+	for( i = 0 ; i < oldSize ; ++i ) {
+		for( sa_cntxt = oldHash[i] ; sa_cntxt ; sa_cntxt = next ) {
+			next = sa_cntxt->next;
+			bucket = sa_cntxt_bucket( sa_cntxt->lid, sa_cntxt->tid, sa_cntxt->mclass );
+			sa_cntxt_insert_head( sa_hash[ bucket ], sa_cntxt );
+		}
+	}
+	vs_pool_free( &sm_pool, oldHash );
+}
+
+static void
+sa_cntxt_hash_insert( sa_cntxt_t* sa_cntxt )
+{
+	uint32_t	bucket;
+
+	if( sa_hash_count >= sa_hash_size ) {
+		sa_cntxt_hash_grow();
+	}
+	bucket = sa_cntxt_bucket( sa_cntxt->lid, sa_cntxt->tid, sa_cntxt->mclass );
+	sa_cntxt_insert_head( sa_hash[ bucket ], sa_cntxt );
+	sa_cntxt->hashed = 1 ;
+	sa_hash_count++;
+}
+
+static void
+sa_cntxt_hash_remove( sa_cntxt_t* sa_cntxt )
+{
+	uint32_t	bucket;
+
+	bucket = sa_cntxt_bucket( sa_cntxt->lid, sa_cntxt->tid, sa_cntxt->mclass );
+	sa_cntxt_delete_entry( sa_hash[ bucket ], sa_cntxt );
+	sa_hash_count--;
+}
+
+/*
+ * Hashed context for the request in mad, or NULL.  Called under
+ * sa_cntxt_lock.
+ */
+static sa_cntxt_t *
+sa_cntxt_lookup( Mai_t* mad )
+{
+	uint32_t	bucket;
+	sa_cntxt_t*	sa_cntxt;
+
+	bucket = sa_cntxt_bucket( mad->addrInfo.slid, mad->base.tid, mad->base.mclass );
+	for( sa_cntxt = sa_hash[ bucket ] ; sa_cntxt ; sa_cntxt = sa_cntxt->next ) {
+		if( sa_cntxt->lid == mad->addrInfo.slid && sa_cntxt->tid == mad->base.tid &&
+				sa_cntxt->mclass == mad->base.mclass ) {
+			break ;
+		}
+	}
+	return sa_cntxt;
+}
+
+/*
+ * Add a chunk to the context pool, as large as the pool so far and no
+ * larger than what is left of sa_max_cntxt.  Called under sa_cntxt_lock.
+ */
+static Status_t
+sa_cntxt_pool_grow( void )
+{
+	sa_cntxt_chunk_t	*chunk;
+	sa_cntxt_t			*entries;
+	uint32_t			i, count;
+
+	if( sa_cntxt_pooled >= sa_max_cntxt ) {
+		return VSTATUS_NOMEM;
+	}
+	count = MAX( sa_cntxt_pooled, SA_CNTXT_POOL_CHUNK );
+	count = MIN( count, sa_max_cntxt - sa_cntxt_pooled );
+	if (vs_pool_alloc(&sm_pool, sizeof(sa_cntxt_chunk_t) + sizeof(sa_cntxt_t) * count,
+			(void *)&chunk) != VSTATUS_OK) {
+		return VSTATUS_NOMEM;
+	}
+	memset( chunk, 0, sizeof(sa_cntxt_chunk_t) + sizeof(sa_cntxt_t) * count );
+	chunk->count = count;
+	chunk->next = sa_cntxt_chunks;
+	sa_cntxt_chunks = chunk;
+	entries = (sa_cntxt_t *)(chunk + 1);
+	for( i = 0 ; i < count ; ++i ) {
+		sa_cntxt_insert_head( sa_cntxt_free_list, &entries[i] );
+	}
+	sa_cntxt_pooled += count;
+	sa_cntxt_nfree += count;
+	SET_PEAK_COUNTER(smMaxSaContextsFree, sa_cntxt_nfree);
+	return VSTATUS_OK;
+}
+
+/*
+ * Allocate the context hash table and the first chunk of the context pool.
+ * The rest of the pool, up to sa_max_cntxt contexts, is allocated as the
+ * request load requires it.
+ */
+Status_t
+sa_cntxt_init( void )
+{
+	Status_t	status;
+
+	sa_hash_size = SA_CNTXT_HASH_TABLE_DEPTH;
+	sa_hash_count = 0;
+	status = vs_pool_alloc(&sm_pool, sizeof(sa_cntxt_t *) * sa_hash_size, (void *)&sa_hash);
+	if (status != VSTATUS_OK) {
+		return VSTATUS_NOMEM;
+	}
+	memset( sa_hash, 0, sizeof(sa_cntxt_t *) * sa_hash_size );
+
+	sa_cntxt_chunks = NULL;
+	sa_cntxt_free_list = NULL ;
+	sa_cntxt_pooled = 0;
+	sa_cntxt_nfree = 0;
+	sa_cntxt_nalloc = 0;
+	IB_LOG_VERBOSE("sa_cntxt_init: Allocating SA context pool with max num entries=", sa_max_cntxt);
+	if( sa_max_cntxt && sa_cntxt_pool_grow() != VSTATUS_OK ) {
+		return VSTATUS_NOMEM;
+	}
+
+	return vs_lock_init(&sa_cntxt_lock, VLOCK_FREE, VLOCK_THREAD);
+}
+
+/*
+ * Current size of the context hash table and pool, for diagnostics.
+ */
+void
+sa_cntxt_table_info( uint32_t *buckets, uint32_t *hashed, uint32_t *pooled )
+{
+	(void)vs_lock(&sa_cntxt_lock);
+	*buckets = sa_hash_size;
+	*hashed = sa_hash_count;
+	*pooled = sa_cntxt_pooled;
+	(void)vs_unlock(&sa_cntxt_lock);
+}
+
 // "free" function for SA Contexts that contain allocated (non-cached) data
 //
 static Status_t
@@ -670,6 +1140,19 @@ sa_cntxt_free_data(sa_cntxt_t *cntxt)
 	return VSTATUS_OK;
 }
 
+// "free" function for SA Contexts sending a chunked response
+//
+static Status_t
+sa_cntxt_free_resp(sa_cntxt_t *cntxt)
+{
+	IB_ENTER( "sa_cntxt_free_resp", cntxt, 0, 0, 0 );
+
+	sa_resp_release(cntxt->resp);
+
+	IB_EXIT( "sa_cntxt_free_resp", VSTATUS_OK);
+	return VSTATUS_OK;
+}
+
 static void
 sa_cntxt_retire( sa_cntxt_t* lcl_cntxt )
 {
@@ -693,8 +1176,10 @@ sa_cntxt_retire( sa_cntxt_t* lcl_cntxt )
 	lcl_cntxt->len = 0 ;
 	lcl_cntxt->lid = 0 ;
 	lcl_cntxt->tid = 0 ;
+	lcl_cntxt->mclass = 0 ;
 	lcl_cntxt->hashed = 0 ;
 	lcl_cntxt->cache = NULL;
+	lcl_cntxt->resp = NULL;
 	lcl_cntxt->freeDataFunc = NULL;
 
 	sa_cntxt_insert_head( sa_cntxt_free_list, lcl_cntxt );
@@ -709,8 +1194,6 @@ sa_cntxt_retire( sa_cntxt_t* lcl_cntxt )
  */
 static void cntxt_release( sa_cntxt_t* sa_cntxt )
 {
-	int         bucket;
-
     if( sa_cntxt->ref == 0 ) {
         IB_LOG_INFINI_INFO0("cntxt_release: reference count is already zero");
         return;   /* context already retired */
@@ -719,8 +1202,7 @@ static void cntxt_release( sa_cntxt_t* sa_cntxt )
         if( sa_cntxt->ref == 0 ) {
             // This context needs to be removed from hash
             if( sa_cntxt->hashed ) {
-                bucket = sa_cntxt->lid % SA_CNTXT_HASH_TABLE_DEPTH;
-                sa_cntxt_delete_entry( sa_hash[ bucket ], sa_cntxt );
+                sa_cntxt_hash_remove( sa_cntxt );
             }
             sa_cntxt->prev = sa_cntxt->next = NULL ;
             sa_cntxt_retire( sa_cntxt );
@@ -735,14 +1217,14 @@ void sa_cntxt_age(void)
 {
 	sa_cntxt_t* sa_cntxt = NULL ;
 	sa_cntxt_t*	tout_cntxt ;
-    int i;
+    uint32_t i;
 	Status_t	status;
 
     if ((status = vs_lock(&sa_cntxt_lock)) != VSTATUS_OK) {
         IB_LOG_ERRORRC("sa_cntxt_age: Failed to lock SA context rc:", status);
     } else {
         vs_time_get( &timeLastAged );
-        for (i=0; i<SA_CNTXT_HASH_TABLE_DEPTH; i++) {
+        for (i=0; i<sa_hash_size; i++) {
             sa_cntxt = sa_hash[ i ];
             while( sa_cntxt ) {
                 // Iterate before the pointers are destroyed ;
@@ -763,7 +1245,7 @@ void sa_cntxt_age(void)
                         // resend the getMulti request ACK
                         sa_getMulti_resend_ack(tout_cntxt);
                         /* if need to release the context.  Call local safe release */
-                        if( tout_cntxt->retries > sm_config.max_retries ) cntxt_release(sa_cntxt);
+                        if( tout_cntxt->retries > sm_config.max_retries ) cntxt_release(tout_cntxt);
                     } else {
                         // resend the reply
                         sa_send_reply( NULL, tout_cntxt );
@@ -786,9 +1268,8 @@ void sa_cntxt_age(void)
 //
 sa_cntxt_t *sa_cntxt_find( Mai_t* mad ) {
 	uint64_t	now ;
-	int 		bucket;
+	uint32_t	bucket;
 	Status_t	status;
-	sa_cntxt_t* sa_cntxt;
 	sa_cntxt_t*	req_cntxt = NULL;
 
     if ((status = vs_lock(&sa_cntxt_lock)) != VSTATUS_OK) {
@@ -796,22 +1277,12 @@ sa_cntxt_t *sa_cntxt_find( Mai_t* mad ) {
     } else {
         vs_time_get( &now );
         // Search the hash table for the context 	
-        bucket = mad->addrInfo.slid % SA_CNTXT_HASH_TABLE_DEPTH ;
-        sa_cntxt = sa_hash[ bucket ];
-        while( sa_cntxt ) {
-            if( sa_cntxt->lid == mad->addrInfo.slid  && sa_cntxt->tid == mad->base.tid ) {
-                req_cntxt = sa_cntxt ;
-                sa_cntxt = sa_cntxt->next ;
-                req_cntxt->tstamp = now ;
-                break ;
-            } else {
-                sa_cntxt = sa_cntxt->next;
-            }
-        }
+        req_cntxt = sa_cntxt_lookup( mad );
         // Table is sorted with respect to timeout
         if( req_cntxt ) {
             // Touch current context
             req_cntxt->tstamp = now ;
+            bucket = sa_cntxt_bucket( req_cntxt->lid, req_cntxt->tid, req_cntxt->mclass );
             sa_cntxt_delete_entry( sa_hash[ bucket ], req_cntxt );
             sa_cntxt_insert_head( sa_hash[ bucket ], req_cntxt );
             // A get on an existing context reserves it
@@ -835,9 +1306,8 @@ SAContextGet_t
 sa_cntxt_get( Mai_t* mad, void **context)
 {
 	uint64_t	now ;
-	int 		bucket;
+	uint32_t	bucket;
 	Status_t	status;
-	sa_cntxt_t* sa_cntxt;
     SAContextGet_t getStatus=0;
 	sa_cntxt_t*	req_cntxt = NULL;
 
@@ -848,22 +1318,13 @@ sa_cntxt_get( Mai_t* mad, void **context)
     } else {
         vs_time_get( &now );
         // Search the hash table for the context 	
-        bucket = mad->addrInfo.slid % SA_CNTXT_HASH_TABLE_DEPTH ;
-        sa_cntxt = sa_hash[ bucket ];
-        while( sa_cntxt ) {
-            if( sa_cntxt->lid == mad->addrInfo.slid  &&
-                    sa_cntxt->tid == mad->base.tid ) {
-                req_cntxt = sa_cntxt ;
-                break ;
-            } else {
-                sa_cntxt = sa_cntxt->next;
-            }
-        }
+        req_cntxt = sa_cntxt_lookup( mad );
 		if( req_cntxt ) {
 			if ( req_cntxt->method == SA_CM_GETMULTI && req_cntxt->reqInProg ) {
 				/* In progress getMulti request. Touch and reserve it. */
 				getStatus = ContextExistGetMulti;
 				req_cntxt->tstamp = now ;
+				bucket = sa_cntxt_bucket( req_cntxt->lid, req_cntxt->tid, req_cntxt->mclass );
 				sa_cntxt_delete_entry( sa_hash[ bucket ], req_cntxt );
 				sa_cntxt_insert_head( sa_hash[ bucket ], req_cntxt );
 				/* A get on an existing context reserves it */
@@ -874,7 +1335,10 @@ sa_cntxt_get( Mai_t* mad, void **context)
 				req_cntxt = NULL;
 			}
 		} else {
-			/* Allocate a new context and set appropriate status */
+			/* Allocate a new context, growing the pool if it is exhausted */
+			if( !sa_cntxt_free_list ) {
+				(void)sa_cntxt_pool_grow();
+			}
 			req_cntxt = sa_cntxt_free_list ;
 			if( req_cntxt ) {
 				getStatus = ContextAllocated;
@@ -884,6 +1348,7 @@ sa_cntxt_get( Mai_t* mad, void **context)
 				DECR_SA_CNTXT_NFREE();
 				req_cntxt->lid = mad->addrInfo.slid ;
 				req_cntxt->tid = mad->base.tid ;
+				req_cntxt->mclass = mad->base.mclass ;
 				req_cntxt->method = mad->base.method ;
 				req_cntxt->tstamp = now;
 			} else {
@@ -909,7 +1374,6 @@ sa_cntxt_get( Mai_t* mad, void **context)
 Status_t
 sa_cntxt_reserve( sa_cntxt_t* sa_cntxt )
 {
-	int         bucket;
 	Status_t	status;
 
 	IB_ENTER( "sa_cntxt_reserve", sa_cntxt, 0, 0, 0 );
@@ -920,10 +1384,8 @@ sa_cntxt_reserve( sa_cntxt_t* sa_cntxt )
         sa_cntxt->ref ++;
         if( sa_cntxt->hashed == 0 ) {
             // This context needs to be inserted into the hash table
-            bucket = sa_cntxt->lid % SA_CNTXT_HASH_TABLE_DEPTH;
-            sa_cntxt->hashed = 1 ;
             vs_time_get( &sa_cntxt->tstamp );
-            sa_cntxt_insert_head( sa_hash[ bucket ], sa_cntxt );
+            sa_cntxt_hash_insert( sa_cntxt );
         }
         if ((status = vs_unlock(&sa_cntxt_lock)) != VSTATUS_OK) {
             IB_LOG_ERRORRC("sa_cntxt_reserve: Failed to unlock SA context rc:", status);
@@ -937,7 +1399,6 @@ sa_cntxt_reserve( sa_cntxt_t* sa_cntxt )
 Status_t
 sa_cntxt_release( sa_cntxt_t* sa_cntxt )
 {
-	int         bucket;
 	Status_t	status;
 
 	IB_ENTER( "sa_cntxt_release", sa_cntxt, 0, 0, 0 );
@@ -957,8 +1418,7 @@ sa_cntxt_release( sa_cntxt_t* sa_cntxt )
 
                 // This context needs to be removed from hash
                 if( sa_cntxt->hashed ) {
-                    bucket = sa_cntxt->lid % SA_CNTXT_HASH_TABLE_DEPTH;
-                    sa_cntxt_delete_entry( sa_hash[ bucket ], sa_cntxt );
+                    sa_cntxt_hash_remove( sa_cntxt );
                 }
 
                 sa_cntxt->prev = sa_cntxt->next = NULL ;
@@ -1035,22 +1495,54 @@ sa_cntxt_data_cached(sa_cntxt_t* sa_cntxt, void* buf, uint32_t len, SACacheEntry
 	return VSTATUS_OK;
 }
 
+// Hands a response built with sa_resp_reserve() to an SA Context, which takes
+// its own reference and sends the reply straight from the response chunks.
+// The caller still releases its reference.  An empty response sends no
+// records, as sa_cntxt_data does.
+//
+Status_t
+sa_cntxt_data_resp(sa_cntxt_t* sa_cntxt, SAResponse_t *resp)
+{
+	IB_ENTER("sa_cntxt_data_resp", sa_cntxt, resp, 0, 0);
+
+	if (!resp || !resp->len) {
+		sa_cntxt_data(sa_cntxt, NULL, 0);
+	} else {
+		sa_resp_hold(resp);
+		sa_cntxt->data = NULL;
+		sa_cntxt->len = resp->len;
+		sa_cntxt->resp = resp;
+		sa_cntxt->freeDataFunc = sa_cntxt_free_resp;
+	}
+
+	IB_EXIT("sa_cntxt_data_resp", VSTATUS_OK);
+	return VSTATUS_OK;
+}
+
 /*
  * clear the contents of the context pool
  */
 void sa_cntxt_clear(void) {
-    int i;
+    uint32_t i;
 	Status_t status;
+	sa_cntxt_chunk_t *chunk;
+	sa_cntxt_t *entries;
 
     if ((status = vs_lock(&sa_cntxt_lock)) != VSTATUS_OK) {
         IB_LOG_ERRORRC("sa_cntxt_clear: Failed to lock SA context, rc:", status);
     } else {
-    	memset( sa_hash, 0, sizeof( sa_hash ));
-    	memset( sa_cntxt_pool, 0, sizeof( sa_cntxt_t ) * sa_max_cntxt);
+    	memset( sa_hash, 0, sizeof(sa_cntxt_t *) * sa_hash_size );
+    	sa_hash_count = 0;
     	sa_cntxt_free_list = NULL ;
-    	for( i = 0 ; i < sa_max_cntxt ; ++i ) {
-    		sa_cntxt_insert_head( sa_cntxt_free_list, &sa_cntxt_pool[i] );
+    	for( chunk = sa_cntxt_chunks ; chunk ; chunk = chunk->next ) {
+    		entries = (sa_cntxt_t *)(chunk + 1);
+    		memset( entries, 0, sizeof( sa_cntxt_t ) * chunk->count );
+    		for( i = 0 ; i < chunk->count ; ++i ) {
+    			sa_cntxt_insert_head( sa_cntxt_free_list, &entries[i] );
+    		}
     	}
+    	sa_cntxt_nfree = sa_cntxt_pooled;
+    	sa_cntxt_nalloc = 0;
         if ((status = vs_unlock(&sa_cntxt_lock)) != VSTATUS_OK) {
             IB_LOG_ERRORRC("sa_cntxt_clear: Failed to unlock SA contex, rc:", status);
         }
@@ -1060,6 +1552,9 @@ void sa_cntxt_clear(void) {
 void setPacketLifetime(uint8_t plt) {
     if (plt > 0 && plt < 20) {
         sm_config.sa_packet_lifetime_n2 = plt;
+        (void)vs_wrlock(&old_topology_lock);
+        sa_PathRecIndexUpdate(&old_topology, 0);
+        (void)vs_rwunlock(&old_topology_lock);
         printf("packetLifetime set to %d; host will get on next path record request \n", (int)sm_config.sa_packet_lifetime_n2);
     } else {
         printf("sa_packetLifetime should be 1-19;  current value is %d \n", (int)sm_config.sa_packet_lifetime_n2);
@@ -1086,6 +1581,9 @@ void setDynamicPlt(uint8_t h1, uint8_t h2, uint8_t h3, uint8_t h4, uint8_t h5) {
         printf("Dynamic PLT ON using values: 5 hops=%d, 6 hops=%d, 7 hops=%d, 7+hops=%d \n", 
                h5, sa_dynamicPlt[6], sa_dynamicPlt[7], sa_dynamicPlt[9]);
     }
+    (void)vs_wrlock(&old_topology_lock);
+    sa_PathRecIndexUpdate(&old_topology, 0);
+    (void)vs_rwunlock(&old_topology_lock);
 }
 
 void setRespTime(uint8_t respTime) {
@@ -493,7 +493,7 @@ sa_send_reply(Mai_t *maip, sa_cntxt_t* sa_cntxt) {
                 (maip->base.status == MAD_STATUS_SA_NO_RECORDS)) {
                 maip->base.status = MAD_STATUS_SA_NO_ERROR;
             }
-            if (sa_cntxt->len > sa_data_length) {
+            if (sa_cntxt->len > SA_CNTXT_MAX_LEN(sa_cntxt)) {
                 sa_cntxt->len = 0;
                 if (maip) {
                     IB_LOG_WARN_FMT("sa_send_reply", 
@@ -1007,6 +1007,30 @@ sa_receive_getmulti(Mai_t *maip, sa_cntxt_t* sa_cntxt) {
 
 // -------------------------------------------------------------------------- /
 
+// copies reply bytes from wherever the context holds them
+static void
+sa_cntxt_copy(sa_cntxt_t *sa_cntxt, uint32_t offset, uint8_t *dst, uint32_t len)
+{
+	if (sa_cntxt->resp)
+		sa_resp_copy(sa_cntxt->resp, offset, dst, len);
+	else
+		(void)memcpy(dst, sa_cntxt->data + offset, len);
+}
+
+// 8-bit checksum of the reply bytes
+static uint8_t
+sa_cntxt_checksum(sa_cntxt_t *sa_cntxt)
+{
+	uint32_t i;
+	uint8_t chkSum = 0;
+
+	if (sa_cntxt->resp)
+		return sa_resp_checksum(sa_cntxt->resp);
+	for (i = 0; i < sa_cntxt->len; i++)
+		chkSum += sa_cntxt->data[i];
+	return chkSum;
+}
+
 Status_t
 sa_send_single(Mai_t *maip, sa_cntxt_t* sa_cntxt ) {
 	Status_t	status;
@@ -1029,13 +1053,13 @@ sa_send_single(Mai_t *maip, sa_cntxt_t* sa_cntxt ) {
 	samad.header.length = 0;
 
 	(void)memset(samad.data, 0, sizeof(samad.data));
-	if( ( sa_cntxt == NULL ) || ( sa_cntxt->data == NULL )) {
+	if( ( sa_cntxt == NULL ) || ( sa_cntxt->data == NULL && sa_cntxt->resp == NULL )) {
 		if( maip->base.status == MAD_STATUS_OK )
 			maip->base.status = MAD_STATUS_SA_NO_RESOURCES;
 	} else if (sa_cntxt->len != 0 ) {
 		if( maip->base.status == MAD_STATUS_OK )
             samad.header.offset = sa_cntxt->attribLen / 8; // setup attribute offset for RMPP xfer
-		(void)memcpy(samad.data, sa_cntxt->data, sa_cntxt->len);
+		sa_cntxt_copy(sa_cntxt, 0, samad.data, sa_cntxt->len);
         datalen += sa_cntxt->len;
 	}
 
@@ -1070,7 +1094,6 @@ sa_send_single(Mai_t *maip, sa_cntxt_t* sa_cntxt ) {
  */
 Status_t
 sa_send_multi(Mai_t *maip, sa_cntxt_t *sa_cntxt ) {
-    int         i;
     int         wl=0;
     uint8_t     chkSum=0;
 	uint32_t	dlen, datalen = sizeof(SAMadh_t);
@@ -1121,7 +1144,7 @@ sa_send_multi(Mai_t *maip, sa_cntxt_t *sa_cntxt ) {
 		sa_cntxt->retries = 0;          // current retry count
 		if ( sa_cntxt->len == 0 ) {
             sa_cntxt->segTotal = 1;
-        } else if (sa_cntxt->len <= sa_data_length) {
+        } else if (sa_cntxt->len <= SA_CNTXT_MAX_LEN(sa_cntxt)) {
             sa_cntxt->segTotal = (sa_data_size)?((sa_cntxt->len + sa_data_size - 1) / sa_data_size):1;
         } else {
             IB_LOG_WARN("sa_send_multi: NO RESOURCES--> sa_cntxt->len too large:", sa_cntxt->len);
@@ -1146,9 +1169,7 @@ sa_send_multi(Mai_t *maip, sa_cntxt_t *sa_cntxt ) {
         /* 8-bit cheksum of the rmpp response */
         sa_cntxt->chkSum = 0;
         if (saRmppCheckSum) {
-            for (i=0; i<sa_cntxt->len; i++) {
-                sa_cntxt->chkSum += sa_cntxt->data[i];
-            }
+            sa_cntxt->chkSum = sa_cntxt_checksum(sa_cntxt);
         }
 		sa_cntxt_reserve( sa_cntxt );
         samad.header.rmppVersion = RMPP_VERSION;
@@ -1321,10 +1342,7 @@ sa_send_multi(Mai_t *maip, sa_cntxt_t *sa_cntxt ) {
         }
         /* validate that the 8-bit cheksum of the rmpp response is still the same as when we started */
         if (saRmppCheckSum) {
-            chkSum = 0;
-            for (i=0; i<sa_cntxt->len; i++) {
-                chkSum += sa_cntxt->data[i];
-            }
+            chkSum = sa_cntxt_checksum(sa_cntxt);
             if (chkSum != sa_cntxt->chkSum) {
                 IB_LOG_ERROR_FMT(__func__,
                        "CHECKSUM FAILED [%d vs %d] for completed %s[%s] RMPP TRANSACTION from LID[0x%x], TID["FMT_U64"]",
@@ -1360,12 +1378,12 @@ sa_send_multi(Mai_t *maip, sa_cntxt_t *sa_cntxt ) {
 		} else 
 			dlen = sa_data_size ;
 
-        if (dlen > sa_data_length) {
+        if (dlen > SA_CNTXT_MAX_LEN(sa_cntxt)) {
             IB_LOG_WARN("sa_send_multi: dlen is too large dlen:", dlen);
         }
         // make sure there is data to send; could just be error case with no data
-        if (sa_cntxt->len && sa_cntxt->data) {
-            (void)memcpy(samad.data, sa_cntxt->data + ((sa_cntxt->NS - 1) * sa_data_size), dlen );
+        if (sa_cntxt->len && (sa_cntxt->data || sa_cntxt->resp)) {
+            sa_cntxt_copy(sa_cntxt, (sa_cntxt->NS - 1) * sa_data_size, samad.data, dlen);
         }
 
         samad.header.rmppVersion = RMPP_VERSION;
@@ -1552,7 +1570,9 @@ sa_cache_alloc_transient(SACacheEntry_t *caches[], int count, SACacheEntry_t **o
 }
 
 // Gets a cached SA query by its cache index (see #defines in header),
-// and increments the cache element's reference count.
+// and increments the cache element's reference count.  Callers only look
+// up a cache for a query it answers in full, so each call counts as a hit
+// or a miss for that cache.  Must be called with saCache.lock held.
 //
 Status_t
 sa_cache_get(int index, SACacheEntry_t **outCache)
@@ -1575,6 +1595,9 @@ sa_cache_get(int index, SACacheEntry_t **outCache)
 	if (cp && cp->valid) {
 		cp->refCount++;
 		*outCache = cp;
+		saCache.hits[index]++;
+	} else {
+		saCache.misses[index]++;
 	}
 	
 	rc = VSTATUS_OK;
@@ -1582,6 +1605,64 @@ sa_cache_get(int index, SACacheEntry_t **outCache)
 	return rc;
 }
 
+// Takes a reference to the current cache at index, or returns NULL if that
+// cache was not built for the current topology.  The reference is dropped
+// when the SA context the cache is handed to is freed.
+//
+SACacheEntry_t *
+sa_cache_lookup(int index)
+{
+	SACacheEntry_t *cache;
+
+	(void)vs_lock(&saCache.lock);
+	(void)sa_cache_get(index, &cache);
+	(void)vs_unlock(&saCache.lock);
+
+	return cache;
+}
+
+// Allocates the buffer of a cache that holds records of recordLen bytes,
+// each padded as in an SA response, and points *data at its start.  A table
+// larger than one SA response is not cached, so queries for it still end in
+// MAD_STATUS_SA_NO_RESOURCES as they do when the table is built per query;
+// VSTATUS_NOSUPPORT tells the caller to leave the cache unbuilt.
+//
+Status_t
+sa_cache_alloc_records(SACacheEntry_t *cachep, uint32_t records, uint32_t recordLen, uint8_t **data)
+{
+	Status_t rc;
+	uint64_t bytes;
+
+	IB_ENTER("sa_cache_alloc_records", cachep, records, recordLen, 0);
+
+	*data = NULL;
+	cachep->data = NULL;
+	cachep->len = 0;
+	cachep->records = 0;
+
+	bytes = (uint64_t)records * (recordLen + Calculate_Padding(recordLen));
+	if (bytes > sa_data_length) {
+		IB_EXIT("sa_cache_alloc_records", VSTATUS_NOSUPPORT);
+		return VSTATUS_NOSUPPORT;
+	}
+
+	if (bytes) {
+		rc = vs_pool_alloc(&sm_pool, bytes, (void *)&cachep->data);
+		if (rc != VSTATUS_OK) {
+			cachep->data = NULL;
+			IB_LOG_WARNRC("sa_cache_alloc_records: failed to allocate memory for cache buffer rc:", rc);
+			IB_EXIT("sa_cache_alloc_records", rc);
+			return rc;
+		}
+		memset(cachep->data, 0, bytes);
+		cachep->len = bytes;
+	}
+	*data = cachep->data;
+
+	IB_EXIT("sa_cache_alloc_records", VSTATUS_OK);
+	return VSTATUS_OK;
+}
+
 // Cleans entries out of the previous list.
 //
 void
@@ -1644,7 +1725,8 @@ sa_cache_release(SACacheEntry_t *cache)
 }
 
 // "free" function for an SA context containing cached data.  Simply passes the
-// cache through to be released.
+// cache through to be released.  Contexts are freed on every SA thread while
+// the topology thread retires caches, so the decref is made under the lock.
 //
 Status_t
 sa_cache_cntxt_free(sa_cntxt_t *cntxt)
@@ -1653,12 +1735,167 @@ sa_cache_cntxt_free(sa_cntxt_t *cntxt)
 	
 	IB_ENTER("sa_cache_cntxt_free", cntxt, 0, 0, 0);
 	
+	(void)vs_lock(&saCache.lock);
 	rc = sa_cache_release(cntxt->cache);
+	(void)vs_unlock(&saCache.lock);
 	
 	IB_EXIT("sa_cache_cntxt_free", rc);
 	return rc;
 }
 
+// -------------------------------------------------------------------------- /
+//
+// SA responses built in chunks.  A handler allocates a response, then for
+// each record reserves space with sa_resp_reserve(), fills the record in and
+// keeps it with sa_resp_commit(), or simply reserves again to drop it.  Each
+// record is contiguous, so handlers fill records in place as they would in
+// sa_data; only the reply as a whole is spread over chunks.
+//
+// The handler hands the response to its context with sa_cntxt_data_resp()
+// and drops its own reference before sending the reply, after which only the
+// context owns it.
+//
+
+// allocates an empty response for replies sent in segLen byte segments
+Status_t
+sa_resp_alloc(uint32_t segLen, SAResponse_t **respp)
+{
+	Status_t status;
+	SAResponse_t *resp;
+
+	IB_ENTER("sa_resp_alloc", segLen, respp, 0, 0);
+
+	status = vs_pool_alloc(&sm_pool, sizeof(SAResponse_t), (void *)&resp);
+	if (status != VSTATUS_OK) {
+		IB_LOG_ERRORRC("sa_resp_alloc: failed to allocate SA response rc:", status);
+		IB_EXIT("sa_resp_alloc", status);
+		return status;
+	}
+	memset(resp, 0, sizeof(SAResponse_t));
+	resp->maxLen = segLen * SA_RESP_MAX_SEGMENTS;
+	resp->refCount = 1;
+	*respp = resp;
+
+	IB_EXIT("sa_resp_alloc", VSTATUS_OK);
+	return VSTATUS_OK;
+}
+
+void
+sa_resp_hold(SAResponse_t *resp)
+{
+	resp->refCount++;
+}
+
+// drops a reference, freeing the response and its chunks with the last one
+void
+sa_resp_release(SAResponse_t *resp)
+{
+	SARespChunk_t *chunk;
+
+	if (!resp || --resp->refCount)
+		return;
+
+	while ((chunk = resp->head) != NULL) {
+		resp->head = chunk->next;
+		vs_pool_free(&sm_pool, chunk);
+	}
+	vs_pool_free(&sm_pool, resp);
+}
+
+// returns space for a record of length bytes plus pad bytes at the end of
+// the response, or NULL if the record would take the response past maxLen
+// or no chunk could be allocated
+uint8_t *
+sa_resp_reserve(SAResponse_t *resp, uint32_t length, uint32_t pad)
+{
+	SARespChunk_t *chunk = resp->tail;
+	uint32_t size;
+
+	if (resp->len + length + pad > resp->maxLen)
+		return NULL;
+
+	if (!chunk || chunk->size - chunk->len < length + pad) {
+		size = MAX(SA_RESP_CHUNK_SIZE, length + pad);
+		if (vs_pool_alloc(&sm_pool, sizeof(SARespChunk_t) + size, (void *)&chunk) != VSTATUS_OK) {
+			IB_LOG_ERROR("sa_resp_reserve: failed to allocate SA response chunk of bytes:", size);
+			return NULL;
+		}
+		chunk->next = NULL;
+		chunk->data = (uint8_t *)(chunk + 1);
+		chunk->len = 0;
+		chunk->size = size;
+		if (resp->tail)
+			resp->tail->next = chunk;
+		else
+			resp->head = chunk;
+		resp->tail = chunk;
+		resp->size += sizeof(SARespChunk_t) + size;
+	}
+
+	return chunk->data + chunk->len;
+}
+
+// keeps the record last reserved, zeroing its padding
+void
+sa_resp_commit(SAResponse_t *resp, uint32_t length, uint32_t pad, uint32_t *records)
+{
+	uint8_t *data = resp->tail->data + resp->tail->len;
+
+	sa_increment_and_pad(&data, length, pad, records);
+	resp->tail->len += length + pad;
+	resp->len += length + pad;
+}
+
+// copies len bytes starting offset bytes into the response to dst.  RMPP
+// asks for segments mostly in order, so the search starts from the chunk
+// the previous copy ended in.
+void
+sa_resp_copy(SAResponse_t *resp, uint32_t offset, uint8_t *dst, uint32_t len)
+{
+	SARespChunk_t *chunk = resp->cursor;
+	uint32_t start = resp->cursorOffset;
+	uint32_t n;
+
+	if (!chunk || offset < start) {
+		chunk = resp->head;
+		start = 0;
+	}
+
+	while (chunk && len) {
+		if (offset >= start + chunk->len) {
+			start += chunk->len;
+			chunk = chunk->next;
+			continue;
+		}
+		n = MIN(len, start + chunk->len - offset);
+		memcpy(dst, chunk->data + (offset - start), n);
+		dst += n;
+		offset += n;
+		len -= n;
+	}
+
+	resp->cursor = chunk;
+	resp->cursorOffset = start;
+}
+
+// 8-bit checksum of the response
+uint8_t
+sa_resp_checksum(SAResponse_t *resp)
+{
+	SARespChunk_t *chunk;
+	uint8_t *data;
+	uint32_t i, len;
+	uint8_t chkSum = 0;
+
+	for (chunk = resp->head; chunk; chunk = chunk->next) {
+		data = chunk->data;
+		len = chunk->len;
+		for (i = 0; i < len; i++)
+			chkSum += data[i];
+	}
+	return chkSum;
+}
+
 #ifdef __VXWORKS__
 // Utility method for displaying caching statistics from the shell.
 //
@@ -1679,13 +1916,15 @@ sa_cache_print_stats(void)
 	sysPrintf("Active SA caches:\n");
 	for (i = 0; i < SA_NUM_CACHES; i++) {
 		curr = saCache.current[i];
-		if (curr) {
+		if (curr && curr->valid) {
 			sysPrintf("  %s [%p]: %ul records, %ul bytes, %ul references\n",
 				curr->name, curr, curr->records, curr->len, curr->refCount);
 			bytesCurrent += curr->len;
 		} else {
 			sysPrintf("  WARNING: Cache at index %u was not built.\n", i);
 		}
+		sysPrintf("    %llu hits, %llu misses, %u sweeps not built\n",
+			saCache.hits[i], saCache.misses[i], saCache.skipped[i]);
 	}
 	
 	if (saCache.previous) {
@@ -1736,7 +1975,7 @@ sa_Authenticate_Path(STL_LID srcLid, STL_LID dstLid) {
 //	This routine must be called with the topology lock set.
 //
 	tp = &old_topology;
-	if (tp->cost == NULL) {
+	if (!sm_cost_matrix_valid(tp)) {
         if (saDebugRmpp) IB_LOG_INFINI_INFO0("sa_Authenticate_Path: Topology cost array is NULL");
 		IB_EXIT("sa_Authenticate_Path - cost = NULL", VSTATUS_BAD);
 		return(VSTATUS_BAD);
@@ -1817,7 +2056,7 @@ sa_Authenticate_Path(STL_LID srcLid, STL_LID dstLid) {
         }
     }
 
-    if (tp->cost[Index(i,j)] == Cost_Infinity) {
+    if (sm_cost_matrix_cost(tp, i, j) == Cost_Infinity) {
         if (saDebugRmpp) IB_LOG_INFINI_INFO("sa_Authenticate_Path: no path from requester to LID ", dstAuth.lid);
     }
 
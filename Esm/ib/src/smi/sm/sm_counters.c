@@ -341,11 +341,28 @@ sm_counter_t smPeakCounters[smPeakCountersMax] = {
 	[smMaxSweepTime]                   = { "Maximum SM Sweep Time in ms", 0, 0, 0},
 };
 
+sm_sweep_phase_stats_t smSweepPhaseStats[SM_SWEEP_PHASE_MAX];
+uint32_t smSweepPhaseCount = 0;
+
+// serializes the topology thread's updates against readers of the stats
+static Lock_t smSweepPhaseLock;
+static int smSweepPhaseLockInit = 0;
+
 //
 // Initialize SM counters
 //
 void sm_init_counters(void) {
 	int i = 0;
+
+	if (!smSweepPhaseLockInit) {
+		if (vs_lock_init(&smSweepPhaseLock, VLOCK_FREE, VLOCK_THREAD) == VSTATUS_OK)
+			smSweepPhaseLockInit = 1;
+		else
+			IB_LOG_ERROR0("can't initialize sweep phase stats lock");
+	}
+	memset(smSweepPhaseStats, 0, sizeof(smSweepPhaseStats));
+	smSweepPhaseCount = 0;
+
 	for (i = 0; i < smCountersMax; ++i) {
 		AtomicWrite(&smCounters[i].sinceLastSweep, 0);
 		AtomicWrite(&smCounters[i].lastSweep, 0);
@@ -397,11 +414,112 @@ void sm_reset_counters(void) {
 		AtomicWrite(&smPeakCounters[i].total, 0);
 	}
 
+	if (smSweepPhaseLockInit) {
+		(void)vs_lock(&smSweepPhaseLock);
+		for (i = 0; i < smSweepPhaseCount; ++i) {
+			sm_sweep_phase_stats_t * stats = &smSweepPhaseStats[i];
+			const char * name = stats->name;
+
+			memset(stats, 0, sizeof(*stats));
+			stats->name = name;
+		}
+		(void)vs_unlock(&smSweepPhaseLock);
+	}
+
 	if (VSTATUS_OK != vs_stdtime_get(&smCountersClearedTime)) {
 		smCountersClearedTime = 0;
 	}
 }
 
+//
+// Records one sample for the named sweep phase.  Phases are identified by
+// the address of their name, which must remain valid for the life of the SM;
+// they are listed in the order they are first recorded.
+//
+void sm_record_sweep_phase(const char * name, uint64_t elapsed) {
+	sm_sweep_phase_stats_t * stats = NULL;
+	uint32_t i;
+
+	if (!smSweepPhaseLockInit)
+		return;
+
+	(void)vs_lock(&smSweepPhaseLock);
+	for (i = 0; i < smSweepPhaseCount; ++i) {
+		if (smSweepPhaseStats[i].name == name) {
+			stats = &smSweepPhaseStats[i];
+			break;
+		}
+	}
+	if (!stats && smSweepPhaseCount < SM_SWEEP_PHASE_MAX) {
+		stats = &smSweepPhaseStats[smSweepPhaseCount++];
+		stats->name = name;
+	}
+
+	if (stats) {
+		if (!stats->count || elapsed < stats->min)
+			stats->min = elapsed;
+		if (elapsed > stats->max)
+			stats->max = elapsed;
+		stats->last = elapsed;
+		stats->total += elapsed;
+		stats->count++;
+		stats->history[stats->next] = elapsed;
+		stats->next = (stats->next + 1) % SM_SWEEP_PHASE_HISTORY;
+	}
+	(void)vs_unlock(&smSweepPhaseLock);
+}
+
+//
+// Copies out a consistent snapshot of the phases that have samples.  stats
+// must have room for SM_SWEEP_PHASE_MAX entries.
+//
+void sm_get_sweep_phase_stats(sm_sweep_phase_stats_t * stats, uint32_t * count) {
+	uint32_t i;
+
+	*count = 0;
+	if (!smSweepPhaseLockInit)
+		return;
+
+	(void)vs_lock(&smSweepPhaseLock);
+	for (i = 0; i < smSweepPhaseCount; ++i) {
+		if (smSweepPhaseStats[i].count)
+			stats[(*count)++] = smSweepPhaseStats[i];
+	}
+	(void)vs_unlock(&smSweepPhaseLock);
+}
+
+static int compare_sweep_phase_samples(const void * a, const void * b) {
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+//
+// Formats one line of the sweep phase timing table (all times in msec).
+// The percentiles are taken over the retained history only.
+//
+static void format_sweep_phase_stats(const sm_sweep_phase_stats_t * stats, char * line, size_t len) {
+	uint64_t samples[SM_SWEEP_PHASE_HISTORY];
+	uint32_t n = MIN(stats->count, SM_SWEEP_PHASE_HISTORY);
+
+	memcpy(samples, stats->history, n * sizeof(uint64_t));
+	qsort(samples, n, sizeof(uint64_t), compare_sweep_phase_samples);
+
+#define SWEEP_PHASE_PCT(p) (samples[(n * (p) + 99) / 100 - 1] / 1000.0)
+	snprintf(line, len, "%35s: %8u %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+	         stats->name, stats->count, stats->last / 1000.0, stats->min / 1000.0,
+	         stats->total / 1000.0 / stats->count, SWEEP_PHASE_PCT(50),
+	         SWEEP_PHASE_PCT(90), SWEEP_PHASE_PCT(99), stats->max / 1000.0);
+#undef SWEEP_PHASE_PCT
+}
+
+#define SWEEP_PHASE_HEADER \
+	"%35s: %8s %10s %10s %10s %10s %10s %10s %10s\n", "SWEEP PHASE (msec)", \
+	"COUNT", "LAST", "MIN", "MEAN", "P50", "P90", "P99", "MAX"
+#define SWEEP_PHASE_RULE \
+	"------------------------------------ -------- ---------- ---------- " \
+	"---------- ---------- ---------- ---------- ----------\n"
+
 #ifdef __VXWORKS__
 
 //
@@ -506,6 +624,38 @@ char * snprintfcat(char * buf, int * len, const char * format, ...)
 
 #ifndef __VXWORKS__
 
+//
+// Appends the sweep phase timing table to a buffer allocated as for
+// snprintfcat().
+//
+char * sm_print_sweep_phase_stats_to_buf(char * buf, int * len) {
+	sm_sweep_phase_stats_t * stats = NULL;
+	char line[160];
+	uint32_t i, count;
+
+	if (!buf)
+		return buf;
+
+	if (vs_pool_alloc(&sm_pool, sizeof(*stats) * SM_SWEEP_PHASE_MAX, (void*)&stats) != VSTATUS_OK) {
+		IB_LOG_ERROR0("can't allocate space for sweep phase stats");
+		return buf;
+	}
+
+	sm_get_sweep_phase_stats(stats, &count);
+	if (count) {
+		buf = snprintfcat(buf, len, "\n");
+		buf = snprintfcat(buf, len, SWEEP_PHASE_HEADER);
+		buf = snprintfcat(buf, len, SWEEP_PHASE_RULE);
+	}
+	for (i = 0; i < count && buf; ++i) {
+		format_sweep_phase_stats(&stats[i], line, sizeof(line));
+		buf = snprintfcat(buf, len, "%s", line);
+	}
+
+	vs_pool_free(&sm_pool, stats);
+	return buf;
+}
+
 //
 // prints counters to a dynamically allocate buffer - user is
 // responsible for freeing it using vs_pool_free()
@@ -552,6 +702,8 @@ char * sm_print_counters_to_buf(void) {
 		                  AtomicRead(&smPeakCounters[i].total));
 	}
 
+	buf = sm_print_sweep_phase_stats_to_buf(buf, &len);
+
 	return buf;
 }
 #endif
@@ -559,6 +711,9 @@ char * sm_print_counters_to_buf(void) {
 #ifdef __VXWORKS__
 void sm_print_counters_to_stream(FILE * out) {
 	int i = 0;
+	uint32_t count;
+	char line[160];
+	sm_sweep_phase_stats_t * stats = NULL;
 	time_t currentTime;
 	time_t elapsedTime;
 	char tbuf[30];
@@ -600,6 +755,21 @@ void sm_print_counters_to_stream(FILE * out) {
 		        AtomicRead(&smPeakCounters[i].lastSweep),
 		        AtomicRead(&smPeakCounters[i].total));
 	}
+
+	if (vs_pool_alloc(&sm_pool, sizeof(*stats) * SM_SWEEP_PHASE_MAX, (void*)&stats) != VSTATUS_OK)
+		return;
+
+	sm_get_sweep_phase_stats(stats, &count);
+	if (count) {
+		fprintf(out, "\n");
+		fprintf(out, SWEEP_PHASE_HEADER);
+		fprintf(out, SWEEP_PHASE_RULE);
+	}
+	for (i = 0; i < count; ++i) {
+		format_sweep_phase_stats(&stats[i], line, sizeof(line));
+		fputs(line, out);
+	}
+	vs_pool_free(&sm_pool, stats);
 }
 #endif
 
@@ -914,7 +914,7 @@ static Status_t processInformSync(Mai_t *maip, uint8_t *msgbuf, uint32_t reclen)
                 /* move over the key data */
                 memcpy((void *)subsKeyp, (void *)&skey, sizeof(SubscriberKey_t));
                 /* allocate subscriber iRecord for adding to hash table */
-                if ((iRecordp = (STL_INFORM_INFO_RECORD *) malloc(sizeof(STL_INFORM_INFO_RECORD))) == NULL) {
+                if ((iRecordp = sa_SubscriberAlloc()) == NULL) {
                     free(subsKeyp);
                     (void)vs_unlock(&saSubscribers.subsLock);
                     IB_LOG_ERROR0("Can't allocate informInfoRecord entry for SET");
@@ -922,7 +922,7 @@ static Status_t processInformSync(Mai_t *maip, uint8_t *msgbuf, uint32_t reclen)
                     break;
                 }
                 memcpy((void *)iRecordp, (void *)&iRecord, sizeof(STL_INFORM_INFO_RECORD));
-                if (!cs_hashtable_insert(saSubscribers.subsMap, subsKeyp, iRecordp)) {
+                if (!sa_SubscriberInsert(subsKeyp, iRecordp)) {
                     free(subsKeyp);
                     free(iRecordp);
                     (void)vs_unlock(&saSubscribers.subsLock);
@@ -962,7 +962,7 @@ static Status_t processInformSync(Mai_t *maip, uint8_t *msgbuf, uint32_t reclen)
                     /* move over the key data */
                     memcpy((void *)subsKeyp, (void *)&skey, sizeof(SubscriberKey_t));
                     /* allocate subscriber iRecord for adding to hash table */
-                    if ((iRecordp = (STL_INFORM_INFO_RECORD *) malloc(sizeof(STL_INFORM_INFO_RECORD))) == NULL) {
+                    if ((iRecordp = sa_SubscriberAlloc()) == NULL) {
                         free(subsKeyp);
                         (void)vs_unlock(&saSubscribers.subsLock);
                         status = VSTATUS_NOMEM;
@@ -970,7 +970,7 @@ static Status_t processInformSync(Mai_t *maip, uint8_t *msgbuf, uint32_t reclen)
                         break;
                     } else {
                         memcpy((void *)iRecordp, (void *)&iRecord, sizeof(STL_INFORM_INFO_RECORD));
-                        if (!cs_hashtable_insert(saSubscribers.subsMap, subsKeyp, iRecordp)) {
+                        if (!sa_SubscriberInsert(subsKeyp, iRecordp)) {
                             free(subsKeyp);
                             free(iRecordp);
                             (void)vs_unlock(&saSubscribers.subsLock);
@@ -1008,7 +1008,7 @@ static Status_t processInformSync(Mai_t *maip, uint8_t *msgbuf, uint32_t reclen)
             BSWAPCOPY_STL_INFORM_INFO_RECORD((STL_INFORM_INFO_RECORD*)&msgbuf[bufidx], &iRecord);
             bufidx += sizeof(STL_INFORM_INFO_RECORD);
             if (vs_lock(&saSubscribers.subsLock) != VSTATUS_OK) return VSTATUS_BAD;
-            if (NULL == (iRecordp = (STL_INFORM_INFO_RECORD *)cs_hashtable_remove(saSubscribers.subsMap, &skey))) {
+            if (NULL == (iRecordp = sa_SubscriberRemove(&skey))) {
                 IB_LOG_INFO_FMT(__func__, 
                        "Could not find subscription ID %d with subscriber lid of 0x%.8X",
                        iRecord.RID.Enum, skey.lid);
@@ -1318,12 +1318,10 @@ static Status_t processGroupSync(Mai_t *maip, uint8_t *msgbuf, uint32_t reclen)
 			(void)vs_rdlock(&old_topology_lock);
             (void)vs_lock(&sm_McGroups_lock);
             if ((status = sm_multicast_sync_lid(*((IB_GID*)mcgs.mGid), mcgs.pKey, mcgs.mtu, mcgs.rate, mcgs.mLid)) == VSTATUS_OK) {
-                McGroup_Create(mcGroup);
-                memcpy(&(mcGroup->mGid), &(mcgs.mGid), sizeof(IB_GID));
+                McGroup_Create(mcGroup, *((IB_GID*)mcgs.mGid), mcgs.mLid);
                 mcGroup->members_full = mcgs.members_full;
                 mcGroup->qKey = mcgs.qKey;
                 mcGroup->pKey = mcgs.pKey;
-                mcGroup->mLid = mcgs.mLid;
                 mcGroup->mtu = mcgs.mtu;
                 mcGroup->rate = mcgs.rate;
                 mcGroup->life = mcgs.life;
@@ -1339,7 +1337,7 @@ static Status_t processGroupSync(Mai_t *maip, uint8_t *msgbuf, uint32_t reclen)
 				    BSWAPCOPY_STL_MCMEMBER_SYNCDB((STL_MCMEMBER_SYNCDB*)&msgbuf[bufidx], &mcms);
                     bufidx += sizeof(STL_MCMEMBER_SYNCDB);
                     ++memcnt;
-                    McMember_Create(mcGroup, mcMember);
+                    McMember_Create(mcGroup, mcMember, mcms.member.RID.PortGID);
                     mcMember->slid = mcms.slid;
                     mcMember->proxy = mcms.proxy;
                     mcMember->state = mcms.state;
@@ -1403,12 +1401,10 @@ static Status_t processGroupSync(Mai_t *maip, uint8_t *msgbuf, uint32_t reclen)
             }
             /* create the group with members */
             if ((status = sm_multicast_sync_lid(*((IB_GID*)mcgs.mGid), mcgs.pKey, mcgs.mtu, mcgs.rate, mcgs.mLid)) == VSTATUS_OK) {
-                McGroup_Create(mcGroup);
-                memcpy(&(mcGroup->mGid), &(mcgs.mGid), sizeof(IB_GID));
+                McGroup_Create(mcGroup, *((IB_GID*)mcgs.mGid), mcgs.mLid);
                 mcGroup->members_full = mcgs.members_full;
                 mcGroup->qKey = mcgs.qKey;
                 mcGroup->pKey = mcgs.pKey;
-                mcGroup->mLid = mcgs.mLid;
                 mcGroup->mtu = mcgs.mtu;
                 mcGroup->rate = mcgs.rate;
                 mcGroup->life = mcgs.life;
@@ -1423,7 +1419,7 @@ static Status_t processGroupSync(Mai_t *maip, uint8_t *msgbuf, uint32_t reclen)
                 while (bufidx < reclen && memcnt < mcgs.membercount) {
         		    BSWAPCOPY_STL_MCMEMBER_SYNCDB((STL_MCMEMBER_SYNCDB*)&msgbuf[bufidx], &mcms);
                     bufidx += sizeof(STL_MCMEMBER_SYNCDB);
-                    McMember_Create(mcGroup, mcMember);
+                    McMember_Create(mcGroup, mcMember, mcms.member.RID.PortGID);
                     mcMember->slid = mcms.slid;
                     mcMember->proxy = mcms.proxy;
                     mcMember->state = mcms.state;
@@ -1693,7 +1689,7 @@ static Status_t processServiceSync(Mai_t *maip, uint8_t *msgbuf, uint32_t reclen
                 srkeyp->serviceId = osr.serviceRecord.RID.ServiceID;
                 srkeyp->servicep_key = osr.serviceRecord.RID.ServiceP_Key;
                 /* allocate vieo service iRecord for adding to hash table */
-                if ((osrp = (OpaServiceRecord_t *) malloc(sizeof(OpaServiceRecord_t))) == NULL) {
+                if ((osrp = sa_ServiceRecAlloc()) == NULL) {
                     free(srkeyp);
                     IB_LOG_ERROR_FMT(__func__, "Can't allocate SERVICE entry for SET");
                     status = VSTATUS_NOMEM;
@@ -1708,7 +1704,7 @@ static Status_t processServiceSync(Mai_t *maip, uint8_t *msgbuf, uint32_t reclen
                     status = VSTATUS_NOMEM;
                     break;
                 }
-                if (!cs_hashtable_insert(saServiceRecords.serviceRecMap, srkeyp, osrp)) {
+                if (!sa_ServiceRecInsert(srkeyp, osrp)) {
                     free(srkeyp);
                     free(osrp);
                     (void)vs_unlock(&saServiceRecords.serviceRecLock);
@@ -1762,7 +1758,7 @@ static Status_t processServiceSync(Mai_t *maip, uint8_t *msgbuf, uint32_t reclen
                     /* fill in the key data */
                     memcpy((void *)srkeyp, (void *)&srkey, sizeof(ServiceRecKey_t));
                     /* allocate vieo service for adding to hash table */
-                    if ((osrp = (OpaServiceRecord_t *) malloc(sizeof(OpaServiceRecord_t))) == NULL) {
+                    if ((osrp = sa_ServiceRecAlloc()) == NULL) {
                         free(srkeyp);
                         (void)vs_unlock(&saServiceRecords.serviceRecLock);
                         status = VSTATUS_NOMEM;
@@ -1770,7 +1766,7 @@ static Status_t processServiceSync(Mai_t *maip, uint8_t *msgbuf, uint32_t reclen
                         break;
                     } else {
                         memcpy((void *)osrp, (void *)&osr, sizeof(OpaServiceRecord_t));
-                        if (!cs_hashtable_insert(saServiceRecords.serviceRecMap, srkeyp, osrp)) {
+                        if (!sa_ServiceRecInsert(srkeyp, osrp)) {
                             free(srkeyp);
                             free(osrp);
                             (void)vs_unlock(&saServiceRecords.serviceRecLock);
@@ -1790,7 +1786,7 @@ static Status_t processServiceSync(Mai_t *maip, uint8_t *msgbuf, uint32_t reclen
                 }
             } else {
                 /* replace existing record contents */
-                osrp->expireTime = osr.expireTime;
+                sa_ServiceRecSetExpireTime(osrp, osr.expireTime);
                 osrp->serviceRecord = osr.serviceRecord;
                 IB_LOG_INFO_FMT(__func__, 
                        "UPDATED (ADD) serviceID="FMT_U64", gid " FMT_GID " in service table",
@@ -1815,7 +1811,7 @@ static Status_t processServiceSync(Mai_t *maip, uint8_t *msgbuf, uint32_t reclen
                 status = VSTATUS_BAD;
                 break;
             } else {
-                if (NULL == (osrp = (OpaServiceRecord_t *)cs_hashtable_remove(saServiceRecords.serviceRecMap, &srkey))) {
+                if (NULL == (osrp = sa_ServiceRecRemove(&srkey))) {
                     IB_LOG_INFO_FMT(__func__, 
                            "Could not find serviceID="FMT_U64", gid " FMT_GID " in service table",
                            srkey.serviceId, STLGIDPRINTARGS(srkey.serviceGid));
@@ -1053,6 +1053,7 @@ Status_t sm_dbsync_upsmlist(SweepContext_t *sweep_context) {
                 if ((sm_find_port_guid(&sm_newTopology, portguid) == NULL)) {
                     /* remove the entry from hashtable and free the value - key is freed by remove func */
                     moreEntries = cs_hashtable_iterator_remove(&itr);
+                    sa_SubscriberUnindex(iRecordp);
                     IB_LOG_INFO_FMT(__func__,
                            "Deleted subscription record ID 0x%x for GID="FMT_GID, 
                            iRecordp->RID.Enum, ntoh64(*(uint64_t *)&subsKeyp->subscriberGid[0]), 
@@ -1080,6 +1081,7 @@ Status_t sm_dbsync_upsmlist(SweepContext_t *sweep_context) {
                 if ((sm_find_port_guid(&sm_newTopology, portguid) == NULL)) {
                     /* remove the entry from hashtable and free the value - key is freed by remove func */
                     moreEntries = cs_hashtable_iterator_remove(&itr);
+                    sa_ServiceRecUnindex(osrp);
                     IB_LOG_INFO_FMT(__func__,
 						"Deleted service record ID="FMT_U64" for GID="FMT_GID", Name=%s", 
 						osrp->serviceRecord.RID.ServiceID, 
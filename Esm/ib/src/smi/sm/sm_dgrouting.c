@@ -679,6 +679,7 @@ dgmh_make_routing_module(RoutingModule_t *rm)
 {
 	// Initialize functions which are different from defaults.
 	rm->name = "dgshortestpath";
+	rm->funcs.calculate_cost_matrix = sm_routing_func_calc_cost_matrix_bfs;
 	rm->funcs.pre_process_discovery = dgmh_pre_process_discovery;
 	rm->funcs.post_process_discovery = dgmh_post_process_discovery;
 	rm->funcs.post_process_routing = dgmh_post_process_routing;
@@ -1666,7 +1666,7 @@ _setup_node(Topology_t * topop, FabricData_t * pdtop, Node_t **nnp,
 			_check_for_new_endnode(&nodeInfo, nodep, oldnodep);
 		}
 
-		nodep->asyncReqsSupported = sm_config.sma_batch_size;
+		sm_dispatch_init_node(nodep, oldnodep);
 
 
 		// Add NODE to sorted topo tree here
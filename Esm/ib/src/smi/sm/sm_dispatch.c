@@ -152,6 +152,14 @@ static void sm_dispatch_cntxt_callback(cntxt_entry_t *cntxt, Status_t cntxtStatu
 
 //	IB_LOG_INFINI_INFO0("received ack");
 
+	if (nodep && (cntxtStatus == VSTATUS_TIMEOUT || (cntxtStatus == VSTATUS_OK && mad))) {
+		// the window only held requests back if the dispatcher had room for more
+		vs_time_get(&now);
+		sm_dispatch_adjust_window(nodep, cntxtStatus, MAX(0, now - req->sendTime),
+			nodep->asyncReqsOutstanding >= nodep->asyncReqsSupported &&
+			disp->reqsOutstanding < disp->reqsSupported);
+	}
+
 	if (req->disp->reqsOutstanding) --req->disp->reqsOutstanding;
 	if (nodep && nodep->asyncReqsOutstanding) --nodep->asyncReqsOutstanding;
 
@@ -362,6 +370,80 @@ void sm_dispatch_bump_passcount(sm_dispatch_t *disp)
 	cs_cntxt_unlock(&sm_async_send_rcv_cntxt);
 }
 
+void sm_dispatch_init_node(Node_t *nodep, Node_t *oldnodep)
+{
+	uint32_t maxWindow = sm_config.sma_batch_size_max;
+
+	if (oldnodep) {
+		nodep->asyncStats = oldnodep->asyncStats;
+	}
+	if (oldnodep && maxWindow) {
+		// keep what was learned about the node in earlier sweeps
+		nodep->asyncReqsSupported = MAX(1, MIN(oldnodep->asyncReqsSupported, maxWindow));
+		nodep->asyncReqsLossWindow = oldnodep->asyncReqsLossWindow;
+		nodep->asyncReqsAcked = oldnodep->asyncReqsAcked;
+	} else {
+		nodep->asyncReqsSupported = sm_config.sma_batch_size;
+		nodep->asyncReqsLossWindow = 0;
+		nodep->asyncReqsAcked = 0;
+	}
+}
+
+// called with sm_async_send_rcv_cntxt.lock held
+//
+// Adapts the window of requests the dispatcher keeps outstanding to a node,
+// much as TCP adapts its congestion window.  The window grows by one for
+// each full window of timely responses, counting only responses that
+// arrived while the window was what held the node's requests back; when
+// MaxParallelReqs is the limit a larger window would only take requests
+// from other nodes.  A response that needed a retry halves the window and
+// a request that was never answered drops it to one.  As a lost request
+// costs at least RespTimeout, growing back to the window that lost it
+// takes SM_DISPATCH_PROBE_WINDOWS times as many responses.
+// A SmaBatchSizeMax of 0 keeps the window fixed at SmaBatchSize.
+void sm_dispatch_adjust_window(Node_t *nodep, Status_t status, uint64_t respTime, boolean windowFull)
+{
+	SmaDispatchStats_t *stats = &nodep->asyncStats;
+	uint32_t maxWindow = sm_config.sma_batch_size_max;
+	uint32_t window = nodep->asyncReqsSupported;
+	uint32_t needed;
+	boolean late = FALSE;
+
+	if (status == VSTATUS_TIMEOUT) {
+		++stats->timeouts;
+	} else {
+		++stats->responses;
+		stats->respTime += respTime;
+		if (respTime > (uint64_t)sm_config.rcv_wait_msec * 1000) {
+			++stats->late;
+			late = TRUE;
+		}
+	}
+
+	if (!maxWindow)
+		return;
+
+	if (status == VSTATUS_TIMEOUT || late) {
+		nodep->asyncReqsLossWindow = window;
+		nodep->asyncReqsSupported = (status == VSTATUS_TIMEOUT) ? 1 : MAX(1, window / 2);
+		nodep->asyncReqsAcked = 0;
+		if (nodep->asyncReqsSupported < window)
+			++stats->shrinks;
+		return;
+	}
+
+	if (!windowFull || window >= maxWindow)
+		return;
+
+	needed = window;
+	if (nodep->asyncReqsLossWindow && window + 1 >= nodep->asyncReqsLossWindow)
+		needed *= SM_DISPATCH_PROBE_WINDOWS;
+	if (++nodep->asyncReqsAcked >= needed) {
+		nodep->asyncReqsSupported = window + 1;
+		nodep->asyncReqsAcked = 0;
+	}
+}
+
 static void _dispatch_clear_unsafe(sm_dispatch_t *disp)
 {
 	LIST_ITEM *item;
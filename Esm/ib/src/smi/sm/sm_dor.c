@@ -810,7 +810,7 @@ _propagate_coord_through_port(DorDiscoveryState_t *state,
 	DorNode_t *neighborDorNode = NULL;
 	DorNode_t *dorNode = (DorNode_t*)nodep->routingData;
 	if (neighborNodep->routingData == NULL) {
-		status = vs_pool_alloc(&sm_pool, sizeof(DorNode_t), &neighborNodep->routingData);
+		status = vs_pool_alloc(sm_topo_pool(topop), sizeof(DorNode_t), &neighborNodep->routingData);
 		if (status != VSTATUS_OK) {
 			IB_LOG_ERRORRC("Failed to allocate storage for DOR node structure; rc:", status);
 			neighborNodep->routingData = NULL;
@@ -1118,7 +1118,7 @@ _get_alternate_path_port_group(Topology_t *topop, Node_t *src, Node_t *dst, uint
 
 	i = src->swIdx;
 	j = dst->swIdx;
-	best_cost = topop->cost[Index(i, j)];
+	best_cost = sm_cost_matrix_cost(topop, i, j);
 
 	// No DOR closure, use shortestpath switch for next hop
 	for (port = 1; port <= src->nodeInfo.NumPorts; port++) {
@@ -1135,7 +1135,7 @@ _get_alternate_path_port_group(Topology_t *topop, Node_t *src, Node_t *dst, uint
 		k = next_nodep->swIdx;
 		if (i == k) continue; // avoid loopback links
 
-		if (topop->cost[Index(i, k)] + topop->cost[Index(k, j)] == best_cost) {
+		if (sm_cost_matrix_cost(topop, i, k) + sm_cost_matrix_cost(topop, k, j) == best_cost) {
 			// Only use broken path if only path
 			if (next_nodep != dst) {
 				if (((DorNode_t*)next_nodep->routingData)->multipleBrokenDims) {
@@ -2483,7 +2483,7 @@ _discover_node_port(Topology_t *topop, Node_t *nodep, Port_t *portp, void *conte
 	if (nodep->routingData == NULL) {
 		// should only apply to the first node, since propagation will
 		// take care of the rest
-		status = vs_pool_alloc(&sm_pool, sizeof(DorNode_t), &nodep->routingData);
+		status = vs_pool_alloc(sm_topo_pool(topop), sizeof(DorNode_t), &nodep->routingData);
 		if (status != VSTATUS_OK) {
 			IB_LOG_ERRORRC("_discover_node: Failed to allocate storage for DOR node structure; rc:", status);
 			return status;
@@ -3506,6 +3506,7 @@ _make_routing_module(RoutingModule_t * rm)
 	rm->funcs.post_process_discovery = _post_process_discovery;
 	rm->funcs.post_process_routing = _post_process_routing;
 	rm->funcs.post_process_routing_copy = _post_process_routing_copy;
+	rm->funcs.calculate_cost_matrix = sm_routing_func_calc_cost_matrix_bfs;
 	rm->funcs.setup_pgs = _setup_pgs;
 	rm->funcs.calculate_routes = _calculate_lft;
 	rm->funcs.init_switch_routing = _init_switch_lfts;
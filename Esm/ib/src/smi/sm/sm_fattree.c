@@ -747,7 +747,6 @@ _calculate_balanced_lfts(Topology_t *topop)
 static Status_t
 _copy_balanced_lfts(Topology_t *topop)
 {
-	size_t		lftLength;
 	Node_t		*switchp, *oldnodep;
 	Port_t		*portp, *oldportp;
 	Status_t	status=VSTATUS_OK;
@@ -773,7 +772,7 @@ _copy_balanced_lfts(Topology_t *topop)
 			continue;
 		}
 
-		status = sm_Node_init_lft(switchp, &lftLength);
+		status = sm_Node_copy_lft(switchp, oldnodep);
 		if (status != VSTATUS_OK) {
 			IB_LOG_ERROR_FMT(__func__, "Failed to allocate space for LFT.");
 			return status;
@@ -785,14 +784,6 @@ _copy_balanced_lfts(Topology_t *topop)
 		// TBD - what if only a new HFI linked to switch.
 		boolean copyPgs = (!switchp->initPorts.nset_m && bitset_equal(&switchp->activePorts, &oldnodep->activePorts));
 
-		if (switchp->switchInfo.LinearFDBTop > oldnodep->switchInfo.LinearFDBTop) {
-			memcpy((void *)switchp->lft, (void *)oldnodep->lft,
-				sizeof(uint8_t) * (oldnodep->switchInfo.LinearFDBTop + 1));
-		} else {
-			memcpy((void *)switchp->lft, (void *)oldnodep->lft,
-				sizeof(uint8_t) * (switchp->switchInfo.LinearFDBTop + 1));
-		}
-
 		if (copyPgs) {
 			if (switchp->pgt && oldnodep->pgt) {
 				memcpy((void *)switchp->pgt, (void *)oldnodep->pgt,
@@ -1021,6 +1012,12 @@ _calculate_balanced_lft_deltas(Topology_t *topop)
 
 	_copy_balanced_lfts(topop);
 
+	// The deltas below may touch any switch's LFT.
+	for_all_switch_nodes(topop, switchp) {
+		if (switchp->lft && !sm_Node_get_lft_wr(switchp))
+			return VSTATUS_NOMEM;
+	}
+
 	curBlock = -1;
 
 	for (lid=0; lid <= topop->maxLid; ++lid) {
@@ -1367,6 +1364,7 @@ static Status_t
 _make_fattree(RoutingModule_t * rm)
 {
 	rm->name = "fattree";
+	rm->funcs.calculate_cost_matrix = sm_routing_func_calc_cost_matrix_bfs;
 	rm->funcs.copy_routing = _routing_func_copy_balanced_lfts_deltas;
 	rm->funcs.can_send_partial_routes = sm_routing_func_true;
 	rm->funcs.init_switch_routing = _init_switch_lfts;
@@ -76,7 +76,7 @@ hypercube_select_ports(Topology_t *topop, Node_t *switchp, int endIndex, Switchp
 
 	i = switchp->swIdx;
 	j = endIndex;
-	best_cost = topop->cost[Index(i, j)];
+	best_cost = sm_cost_matrix_cost(topop, i, j);
 
 	for (port = 0; port < switchp->nodeInfo.NumPorts; port++) {
 		portp = sm_get_port(switchp, portOrder ? portOrder[port] : port + 1);
@@ -94,7 +94,7 @@ hypercube_select_ports(Topology_t *topop, Node_t *switchp, int endIndex, Switchp
 		k = next_nodep->swIdx;
 		if (i == k) continue; // avoid loopback links
 
-		if (topop->cost[Index(i, k)] + topop->cost[Index(k, j)] == best_cost) {
+		if (sm_cost_matrix_cost(topop, i, k) + sm_cost_matrix_cost(topop, k, j) == best_cost) {
 			if (!first_nodep) {
 				first_nodep = next_nodep;
 			} else if (next_nodep != first_nodep) {
@@ -269,7 +269,7 @@ hypercube_setup_xft(Topology_t *topop, Node_t *switchp, Node_t *nodep, Port_t *o
 }
 
 static void
-_setup_routing_ctrl(Node_t *nodep)
+_setup_routing_ctrl(Topology_t *topop, Node_t *nodep)
 {
 	STL_NODE_INFO *nodeInfo = &nodep->nodeInfo;
 	SmSPRoutingCtrl_t *routeCtrlData;
@@ -361,7 +361,7 @@ _setup_routing_ctrl(Node_t *nodep)
 		}
 	}
 
-	status = vs_pool_alloc(&sm_pool, NumPorts*sizeof(*portOrder),
+	status = vs_pool_alloc(sm_topo_pool(topop), NumPorts*sizeof(*portOrder),
 						   (void *)&portOrder);
 	if (status != VSTATUS_OK) {
 		IB_LOG_ERROR_FMT(__func__, "can't malloc portOrder status=%d",
@@ -451,7 +451,7 @@ hypercube_post_process_discovery(Topology_t *topop, Status_t discoveryStatus, vo
 	int dgIdx;
 
 	for_all_switch_nodes(sm_topop, nodep) {
-		_setup_routing_ctrl(nodep);
+		_setup_routing_ctrl(sm_topop, nodep);
 	}
 
 	if (strlen(sm_config.hypercubeRouting.routeLast.member) == 0)
@@ -530,10 +530,9 @@ hypercube_routing_init_floyds(Topology_t *topop)
 Status_t
 hypercube_routing_calc_floyds(Topology_t *topop, int switches, unsigned short * cost, SmPathPortmask_t * path)
 {
-	int i, j, k;
-	int ij, ik, kj, oldik;
-	int kNumNodes, iNumNodes, oldiNumNodes;
-	unsigned short value;
+	int i, k;
+	int ik;
+	int iNumNodes;
 	unsigned int total_cost = 0;
 	unsigned int leastTotalCost = 0;
 	unsigned int max_cost = 0;
@@ -547,45 +546,19 @@ hypercube_routing_calc_floyds(Topology_t *topop, int switches, unsigned short *
 	Node_t *nodep;
 	Node_t *sw = topop->switch_head;
 
-	if (switches != old_topology.max_sws || topology_passcount == 0) {
+	if (switches != old_topology.max_sws || topology_passcount == 0
+		|| !sm_cost_matrix_valid(&old_topology)) {
 		topology_cost_path_changes = 1;
 	}
 
-	for (k = 0, kNumNodes = 0; k < switches; k++, kNumNodes += switches) {
-		for (i = 0, iNumNodes = 0; i < switches; i++, iNumNodes += switches) {
-
-			ik = iNumNodes + k;
-
-			if (cost[ik] == Cost_Infinity) {
-				continue;
-			}
-
-			for (j = 0, ij = iNumNodes, kj = kNumNodes;
-				 j < switches;
-				 ++j, ++ij, ++kj) {
-
-				if ((value = cost[ik] + cost[kj]) < cost[ij]) {
-					cost[ij] = value;
-					path[ij] = path[ik];
-					
-				} else if (value == cost[ij]) {
-					sm_path_portmask_merge(path + ij, path + ik);
-				}
-			}
-		}
-
-		if (smDebugPerf && (k & 0xFF) == 0xFF) {
-			IB_LOG_INFINI_INFO_FMT(__func__, "completed run %d of %d", k, switches);
-		}
-	}
+	sm_routing_func_floyds_blocked(switches, cost, path);
 
 	/* All floyd costs are fully computed now and can be analyzed */
 	while(sw) {
 		total_cost = 0;
 		max_cost = 0;
 		k = sw->swIdx;
-		for (i = 0, iNumNodes = 0, oldiNumNodes = 0; i < switches;
-			 i++, iNumNodes += switches, oldiNumNodes += old_topology.max_sws) {
+		for (i = 0, iNumNodes = 0; i < switches; i++, iNumNodes += switches) {
 
 			ik = iNumNodes + k;
 
@@ -614,9 +587,7 @@ hypercube_routing_calc_floyds(Topology_t *topop, int switches, unsigned short *
 			if ((k >= old_topology.max_sws) || (i >= old_topology.max_sws))
 				continue;
 
-			oldik = oldiNumNodes + k;
-
-			if (old_topology.cost[oldik] != cost[ik]) {
+			if (sm_cost_matrix_cost(&old_topology, i, k) != cost[ik]) {
 				topology_cost_path_changes = 1;
 			}
 		}
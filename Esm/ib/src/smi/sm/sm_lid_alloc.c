@@ -0,0 +1,345 @@
+/* BEGIN_ICS_COPYRIGHT2 ****************************************
+
+Copyright (c) 2015-2020, Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+** END_ICS_COPYRIGHT2   ****************************************/
+
+//
+// Free unicast LID allocator.
+//
+// LIDs are handed out in aligned blocks of 2^lmc.  For every block order
+// (LMC 0..SM_LID_ALLOC_MAX_LMC) a bitmap records which aligned blocks are
+// entirely free, and each of those bitmaps carries summary levels (a bit per
+// non-zero word of the level below) up to a single word.  Finding the lowest
+// free block of an order is one ctz per level, and marking a LID used or free
+// touches one bit per order plus whatever summary words change, so the cost
+// of both no longer depends on how full the LID space is.
+//
+// The lidmap remains the record of which GUID owns which LID; the topology
+// code marks LIDs here as it claims and releases them in the lidmap.  LIDs
+// reserved through sm_lid_alloc_reserve() are never handed out, but their
+// owner can still claim them explicitly.
+//
+
+#include "os_g.h"
+#include "ib_types.h"
+#include "ib_status.h"
+#include "cs_g.h"
+#include "sm_l.h"
+
+#define LID_BM_WORD_BITS	64
+#define LID_BM_MAX_LEVELS	6		// 64^6 bits covers any 32-bit LID space
+
+typedef struct {
+	uint32_t	nbits;
+	int			nlevels;
+	uint32_t	nwords[LID_BM_MAX_LEVELS];
+	uint64_t	*level[LID_BM_MAX_LEVELS];	// level[0] holds the bits
+} LidBitmap_t;
+
+static STL_LID		lidAllocMax;
+static uint64_t		*lidUsed;		// LID is held in the lidmap or reserved
+static uint64_t		*lidReserved;	// LID must not be handed out
+static LidBitmap_t	lidFree[SM_LID_ALLOC_MAX_LMC + 1];	// per order: aligned block is free
+
+static __inline__ int
+_word_test(const uint64_t *words, uint32_t bit)
+{
+	return (words[bit / LID_BM_WORD_BITS] >> (bit % LID_BM_WORD_BITS)) & 1;
+}
+
+static Status_t
+_bm_init(LidBitmap_t *bm, uint32_t nbits)
+{
+	uint32_t n = nbits;
+	int i;
+
+	memset(bm, 0, sizeof(*bm));
+	bm->nbits = nbits;
+	do {
+		n = (n + LID_BM_WORD_BITS - 1) / LID_BM_WORD_BITS;
+		if (n == 0)
+			n = 1;
+		if (vs_pool_alloc(&sm_pool, n * sizeof(uint64_t),
+				(void *)&bm->level[bm->nlevels]) != VSTATUS_OK) {
+			for (i = 0; i < bm->nlevels; i++)
+				vs_pool_free(&sm_pool, bm->level[i]);
+			memset(bm, 0, sizeof(*bm));
+			return VSTATUS_NOMEM;
+		}
+		memset(bm->level[bm->nlevels], 0, n * sizeof(uint64_t));
+		bm->nwords[bm->nlevels++] = n;
+	} while (n > 1 && bm->nlevels < LID_BM_MAX_LEVELS);
+
+	return VSTATUS_OK;
+}
+
+static void
+_bm_free(LidBitmap_t *bm)
+{
+	int i;
+
+	for (i = 0; i < bm->nlevels; i++)
+		vs_pool_free(&sm_pool, bm->level[i]);
+	memset(bm, 0, sizeof(*bm));
+}
+
+static void
+_bm_set(LidBitmap_t *bm, uint32_t bit)
+{
+	int l;
+
+	for (l = 0; l < bm->nlevels; l++) {
+		uint64_t *word = &bm->level[l][bit / LID_BM_WORD_BITS];
+		uint64_t was = *word;
+
+		*word |= 1ull << (bit % LID_BM_WORD_BITS);
+		if (was)
+			break;		// summary above already marks this word
+		bit /= LID_BM_WORD_BITS;
+	}
+}
+
+static void
+_bm_clear(LidBitmap_t *bm, uint32_t bit)
+{
+	int l;
+
+	for (l = 0; l < bm->nlevels; l++) {
+		uint64_t *word = &bm->level[l][bit / LID_BM_WORD_BITS];
+
+		*word &= ~(1ull << (bit % LID_BM_WORD_BITS));
+		if (*word)
+			break;		// word still non-zero, summary unchanged
+		bit /= LID_BM_WORD_BITS;
+	}
+}
+
+// Returns the lowest set bit, or -1 if none.
+static int64_t
+_bm_find_first(const LidBitmap_t *bm)
+{
+	uint32_t w = 0;
+	int l;
+
+	for (l = bm->nlevels - 1; l >= 0; l--) {
+		uint64_t word = bm->level[l][w];
+
+		if (!word)
+			return -1;
+		w = w * LID_BM_WORD_BITS + __builtin_ctzll(word);
+	}
+	return w;
+}
+
+// Recomputes whether each aligned block containing lid is free, from
+// order 0 up, and stops at the first order whose state did not change.
+static void
+_lid_update(STL_LID lid)
+{
+	uint32_t block = lid;
+	int order, isFree, wasFree;
+
+	for (order = 0; order <= SM_LID_ALLOC_MAX_LMC; order++, block >>= 1) {
+		LidBitmap_t *bm = &lidFree[order];
+
+		if (block >= bm->nbits)
+			break;
+		if (order == 0) {
+			isFree = !_word_test(lidUsed, lid);
+		} else {
+			LidBitmap_t *lower = &lidFree[order - 1];
+			isFree = (2 * block + 1 < lower->nbits) &&
+				_word_test(lower->level[0], 2 * block) &&
+				_word_test(lower->level[0], 2 * block + 1);
+		}
+		wasFree = _word_test(bm->level[0], block);
+		if (isFree == wasFree)
+			break;
+		if (isFree)
+			_bm_set(bm, block);
+		else
+			_bm_clear(bm, block);
+	}
+}
+
+//
+// Size the allocator for LIDs 1..maxLid, all free.
+//
+Status_t
+sm_lid_alloc_init(STL_LID maxLid)
+{
+	size_t words = (maxLid + LID_BM_WORD_BITS) / LID_BM_WORD_BITS;
+	int order;
+
+	sm_lid_alloc_free();
+
+	if (vs_pool_alloc(&sm_pool, words * sizeof(uint64_t), (void *)&lidUsed) != VSTATUS_OK ||
+		vs_pool_alloc(&sm_pool, words * sizeof(uint64_t), (void *)&lidReserved) != VSTATUS_OK) {
+		sm_lid_alloc_free();
+		return VSTATUS_NOMEM;
+	}
+	memset(lidReserved, 0, words * sizeof(uint64_t));
+
+	for (order = 0; order <= SM_LID_ALLOC_MAX_LMC; order++) {
+		// only whole blocks can be handed out
+		if (_bm_init(&lidFree[order], ((uint32_t)maxLid + 1) >> order) != VSTATUS_OK) {
+			sm_lid_alloc_free();
+			return VSTATUS_NOMEM;
+		}
+	}
+	lidAllocMax = maxLid;
+
+	sm_lid_alloc_reset();
+	return VSTATUS_OK;
+}
+
+void
+sm_lid_alloc_free(void)
+{
+	int order;
+
+	if (lidUsed)
+		vs_pool_free(&sm_pool, lidUsed);
+	if (lidReserved)
+		vs_pool_free(&sm_pool, lidReserved);
+	lidUsed = lidReserved = NULL;
+	for (order = 0; order <= SM_LID_ALLOC_MAX_LMC; order++)
+		_bm_free(&lidFree[order]);
+	lidAllocMax = 0;
+}
+
+//
+// Mark every LID free again, except reserved LIDs and LID 0.
+//
+void
+sm_lid_alloc_reset(void)
+{
+	size_t words = (lidAllocMax + LID_BM_WORD_BITS) / LID_BM_WORD_BITS;
+	uint32_t bit;
+	int order, l;
+
+	if (!lidUsed)
+		return;
+
+	memcpy(lidUsed, lidReserved, words * sizeof(uint64_t));
+	lidUsed[0] |= 1;	// LID 0 is never a unicast LID
+
+	// Rebuild the free block bitmaps bottom-up, then their summaries.
+	for (order = 0; order <= SM_LID_ALLOC_MAX_LMC; order++) {
+		LidBitmap_t *bm = &lidFree[order];
+
+		memset(bm->level[0], 0, bm->nwords[0] * sizeof(uint64_t));
+		for (bit = 0; bit < bm->nbits; bit++) {
+			int isFree = order ?
+				(_word_test(lidFree[order - 1].level[0], 2 * bit) &&
+				 _word_test(lidFree[order - 1].level[0], 2 * bit + 1)) :
+				!_word_test(lidUsed, bit);
+			if (isFree)
+				bm->level[0][bit / LID_BM_WORD_BITS] |= 1ull << (bit % LID_BM_WORD_BITS);
+		}
+		for (l = 1; l < bm->nlevels; l++) {
+			memset(bm->level[l], 0, bm->nwords[l] * sizeof(uint64_t));
+			for (bit = 0; bit < bm->nwords[l - 1]; bit++) {
+				if (bm->level[l - 1][bit])
+					bm->level[l][bit / LID_BM_WORD_BITS] |= 1ull << (bit % LID_BM_WORD_BITS);
+			}
+		}
+	}
+}
+
+//
+// Keep LIDs [lid, lid + count) out of allocation across resets, e.g. a
+// configured SM LID.
+//
+void
+sm_lid_alloc_reserve(STL_LID lid, STL_LID count)
+{
+	STL_LID i;
+
+	if (!lidUsed)
+		return;
+	for (i = lid; i < lid + count && i <= lidAllocMax; i++) {
+		lidReserved[i / LID_BM_WORD_BITS] |= 1ull << (i % LID_BM_WORD_BITS);
+		if (!_word_test(lidUsed, i)) {
+			lidUsed[i / LID_BM_WORD_BITS] |= 1ull << (i % LID_BM_WORD_BITS);
+			_lid_update(i);
+		}
+	}
+}
+
+//
+// LIDs [lid, lid + count) now belong to a port.
+//
+void
+sm_lid_alloc_claim(STL_LID lid, STL_LID count)
+{
+	STL_LID i;
+
+	if (!lidUsed)
+		return;
+	for (i = lid; i < lid + count && i <= lidAllocMax; i++) {
+		if (_word_test(lidUsed, i))
+			continue;
+		lidUsed[i / LID_BM_WORD_BITS] |= 1ull << (i % LID_BM_WORD_BITS);
+		_lid_update(i);
+	}
+}
+
+//
+// LIDs [lid, lid + count) no longer belong to anyone.  Reserved LIDs stay
+// out of allocation.
+//
+void
+sm_lid_alloc_release(STL_LID lid, STL_LID count)
+{
+	STL_LID i;
+
+	if (!lidUsed)
+		return;
+	for (i = lid; i < lid + count && i <= lidAllocMax; i++) {
+		if (i == 0 || _word_test(lidReserved, i) || !_word_test(lidUsed, i))
+			continue;
+		lidUsed[i / LID_BM_WORD_BITS] &= ~(1ull << (i % LID_BM_WORD_BITS));
+		_lid_update(i);
+	}
+}
+
+//
+// Lowest free block of 2^lmc LIDs starting on a multiple of 2^lmc, or
+// STL_LID_RESERVED if there is none.  The block is not claimed.
+//
+STL_LID
+sm_lid_alloc_find(uint8_t lmc)
+{
+	int64_t block;
+
+	if (!lidUsed || lmc > SM_LID_ALLOC_MAX_LMC)
+		return STL_LID_RESERVED;
+	if ((block = _bm_find_first(&lidFree[lmc])) < 0)
+		return STL_LID_RESERVED;
+	return (STL_LID)(block << lmc);
+}
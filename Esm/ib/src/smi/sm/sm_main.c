@@ -175,9 +175,6 @@ char		sm_config_filename[256];
 
 uint32_t    sm_nodaemon = 1;
 
-STL_LID		sm_lmc_0_freeLid_hint = STL_LID_RESERVED;
-STL_LID		sm_lmc_e0_freeLid_hint = STL_LID_RESERVED;
-STL_LID		sm_lmc_freeLid_hint = STL_LID_RESERVED;
 
 
 STL_SM_INFO	sm_smInfo;
@@ -1661,10 +1658,6 @@ sm_main(void)
 	if ((status = sm_lidmap_alloc()) != VSTATUS_OK)
 		return status;
 
-	sm_lmc_e0_freeLid_hint = STL_LID_UNICAST_BEGIN << sm_config.lmc_e0;
-	sm_lmc_freeLid_hint = STL_LID_UNICAST_BEGIN << sm_config.lmc;
-	sm_lmc_0_freeLid_hint = STL_LID_UNICAST_BEGIN;
-
 	sm_threads = NULL;
 	status = vs_pool_alloc(&sm_pool, sizeof(SMThread_t) * (SM_THREAD_MAX + 1), (void*)&sm_threads);
 	if (status != VSTATUS_OK || !sm_threads) {
@@ -2575,9 +2568,6 @@ sm_cleanGlobals(uint8_t stop){
 	sm_mcSpanningTreeRootGuid = 0;
 	sm_mcRootCostDeltaThreshold = DEFAULT_MCROOT_COST_IMPROVEMENT_PERCENTAGE;
 
-	sm_lmc_0_freeLid_hint = STL_LID_RESERVED;
-	sm_lmc_e0_freeLid_hint = STL_LID_RESERVED;
-	sm_lmc_freeLid_hint = STL_LID_RESERVED;
 	sm_datelineSwitchGUID = 0;
 
 	if (stop) {
@@ -2585,6 +2575,7 @@ sm_cleanGlobals(uint8_t stop){
 		sm_masterStartTime = 0;
 		sm_McGroups = 0;
 		sm_numMcGroups = 0;
+		sm_multicast_index_clear();
 		AtomicWrite(&sm_McGroups_Need_Prog, 0);
 
 		sm_threads = NULL;
@@ -84,6 +84,23 @@ McGroupClass_t defaultMcGroupClass = {
 };
 
 extern VirtualFabrics_t *updatedVirtualFabrics;
+extern IB_GID nullGid;
+
+/*
+ * Indexes over sm_McGroups, maintained by the McGroup_* and McMember_*
+ * macros under sm_McGroups_lock.  Groups are hashed by MGID and by MLID
+ * (several groups may share an MLID); each group hashes its own members
+ * by PortGID in a table that doubles as the group grows.
+ */
+#ifdef __VXWORKS__
+#define MC_GROUP_INDEX_SIZE		1024	// chains, a power of two
+#else
+#define MC_GROUP_INDEX_SIZE		8192
+#endif
+#define MC_MEMBER_INDEX_MIN		8
+
+static McGroup_t *sm_McGroupsByMgid[MC_GROUP_INDEX_SIZE];
+static McGroup_t *sm_McGroupsByMlid[MC_GROUP_INDEX_SIZE];
 
 void sm_pruneMcastSpanningTree(McSpanningTree_t *mcST, bitset_t *allmlids);
 
@@ -568,11 +585,8 @@ static Status_t sm_createMCastGrp(int vf, uint64_t* mgid, uint16_t pkey, uint8_t
 		return status;
 	}
 
-	McGroup_Create(mcGroup); //create register and add it to structure
+	McGroup_Create(mcGroup, mGid, mLid); //create register and add it to structure
 
-	mcGroup->mGid.AsReg64s.H = mgid[0];
-	mcGroup->mGid.AsReg64s.L = mgid[1];
-	mcGroup->mLid = mLid;
 	mcGroup->qKey = qkey;
 	mcGroup->pKey = pkey;
 	mcGroup->mtu = mtu;
@@ -585,7 +599,7 @@ static Status_t sm_createMCastGrp(int vf, uint64_t* mgid, uint16_t pkey, uint8_t
 	mcGroup->members_full = 1;
 	bitset_set(&mcGroup->new_vfMembers, vf);
 	//also add dummy McMember
-	McMember_Create(mcGroup, mcMember);
+	McMember_Create(mcGroup, mcMember, nullGid);
 	mcMember->slid = 0;
 	mcMember->proxy = 1;
 	mcMember->state = MCMEMBER_STATE_FULL_MEMBER;
@@ -725,7 +739,7 @@ void sm_check_mc_groups_realizable(void)
 			   || linkrate_gt(mcGroup->rate, topo->maxMcastRate) ) {
 
 				if ((mcGroup->flags & McGroupUnrealizable) == 0) {
-					mcGroup->flags |= McGroupUnrealizable;
+					mcGroup->flags |= McGroupUnrealizable | McGroupMftDirty;
 					// Only emit this message once
 					smCsmLogMessage(CSM_SEV_NOTICE, CSM_COND_OTHER_ERROR, getMyCsmNodeId(), NULL,
 						"Multicast group "FMT_GID" with mtu of %s and rate of %s has become "
@@ -739,6 +753,7 @@ void sm_check_mc_groups_realizable(void)
 			} else if (mcGroup->flags & McGroupUnrealizable) {
 				// Group had become unrealizable and now is back to being realizable
 				mcGroup->flags &= ~McGroupUnrealizable;
+				mcGroup->flags |= McGroupMftDirty;
 
 				smCsmLogMessage(CSM_SEV_NOTICE, CSM_COND_OTHER_ERROR, getMyCsmNodeId(), NULL,
 					"Return to normal: Multicast group "FMT_GID" has been restored "
@@ -754,7 +769,7 @@ void sm_check_mc_groups_realizable(void)
 			 	 * which means, the spanning tree for that mtu/rate would be NULL anyway.
 				 */
 				if ((mcGroup->flags & McGroupUnrealizable) == 0) {
-					mcGroup->flags |= McGroupUnrealizable;
+					mcGroup->flags |= McGroupUnrealizable | McGroupMftDirty;
 					// Only emit this message once
 					smCsmLogMessage(CSM_SEV_NOTICE, CSM_COND_OTHER_ERROR, getMyCsmNodeId(), NULL,
 						"Multicast group "FMT_GID" with mtu of %s and rate of %s has become "
@@ -768,6 +783,7 @@ void sm_check_mc_groups_realizable(void)
 			} else if (mcGroup->flags & McGroupUnrealizable) {
 				// Group had become unrealizable and now is back to being realizable
 				mcGroup->flags &= ~McGroupUnrealizable;
+				mcGroup->flags |= McGroupMftDirty;
 
 				smCsmLogMessage(CSM_SEV_NOTICE, CSM_COND_OTHER_ERROR, getMyCsmNodeId(), NULL,
 					"Return to normal: Multicast group "FMT_GID" has been restored "
@@ -862,7 +878,44 @@ void sm_calculate_spanning_tree_port_mask(void)
 }
 
 
-void sm_add_mcmember_port_masks(void)
+/* sm_mcmember_switch_port - Returns the active port of an mcMember in the new topology
+ * and sets *nodepp to the switch it is attached to, or returns NULL.
+ */
+static Port_t *sm_mcmember_switch_port(Topology_t *topo, McMember_t *mcMember, Node_t **nodepp)
+{
+	Port_t 	*portp = NULL;
+	Node_t  *nodep = NULL;
+
+	if (mcMember->portGuid == SA_FAKE_MULTICAST_GROUP_MEMBER) return NULL;
+	portp = sm_find_active_port_guid(topo, mcMember->portGuid);
+	if (!sm_valid_port(portp)) {
+		if (smDebugPerf) {
+			/* this is ok; host(s) gone and we haven't cleaned up the mcmember tables yet */
+			IB_LOG_VERBOSE_FMT(__func__,
+				   "Could not find active port for mcMember->portGuid "FMT_U64" in new topology",
+				   mcMember->portGuid);
+		}
+		return NULL;
+	}
+	nodep = sm_find_node(topo, portp->nodeno);
+	if (!nodep) {
+		IB_LOG_ERROR_FMT(__func__,
+				   "Could not find the switch for mcMember->portGuid "FMT_U64" in new topology",
+				   mcMember->portGuid);
+		return NULL;
+	}
+	if (nodep->nodeInfo.NodeType != NI_TYPE_SWITCH) {
+		// hca to hca
+		return NULL;
+	}
+	*nodepp = nodep;
+	return portp;
+}
+
+/* sm_add_mcmember_port_masks - Sets the bits for the ports of mcMembers in the MFTs of
+ * the groups whose MLID offset is in mlids, or of every group when mlids is NULL.
+ */
+void sm_add_mcmember_port_masks(bitset_t *mlids)
 {
 	McGroup_t	*mcGroup;
 	McMember_t	*mcMember;
@@ -883,29 +936,11 @@ void sm_add_mcmember_port_masks(void)
 			continue;
 		}
 		offset = mcGroup->mLid - STL_LID_MULTICAST_BEGIN;
+		if (mlids && !bitset_test(mlids, offset))
+			continue;
 		for_all_multicast_members(mcGroup, mcMember) {
-			if (mcMember->portGuid == SA_FAKE_MULTICAST_GROUP_MEMBER) continue;
-			portp = sm_find_active_port_guid(topo, mcMember->portGuid);
-			if (!sm_valid_port(portp)) {
-				if (smDebugPerf) {
-					/* this is ok; host(s) gone and we haven't cleaned up the mcmember tables yet */
-					IB_LOG_VERBOSE_FMT(__func__,
-						   "Could not find active port for mcMember->portGuid "FMT_U64" in new topology",
-						   mcMember->portGuid);
-				}
-				continue;
-			}
-			nodep = sm_find_node(topo, portp->nodeno);
-			if (!nodep) {
-				IB_LOG_ERROR_FMT(__func__,
-						   "Could not find the switch for mcMember->portGuid "FMT_U64" in new topology",
-						   mcMember->portGuid);
+			if (!(portp = sm_mcmember_switch_port(topo, mcMember, &nodep)))
 				continue;
-			}
-			if (nodep->nodeInfo.NodeType != NI_TYPE_SWITCH) {
-				// hca to hca
-				continue;
-			}
 			if ((mcMember->record.JoinNonMember) ||
 				(mcMember->record.JoinFullMember)) {
 				nodep->mft[offset][Mft_Position(portp->portno)] |= Mft_PortmaskBit(portp->portno);
@@ -917,9 +952,134 @@ void sm_add_mcmember_port_masks(void)
    	}
 }
 
-Status_t sm_calculate_mfts()
+/* sm_mark_sendonly_switches - Marks the switches with send only members of any group,
+ * as sm_add_mcmember_port_masks(NULL) does, without touching the MFTs.
+ */
+static void sm_mark_sendonly_switches(void)
+{
+	McGroup_t	*mcGroup;
+	McMember_t	*mcMember;
+	Node_t  *nodep = NULL;
+	Topology_t *topo;
+
+	topo = &sm_newTopology;
+
+	for_all_multicast_groups(mcGroup) {
+		if (mcGroup->flags & McGroupUnrealizable)
+			continue;
+		if (updatedVirtualFabrics && !bitset_nset(&mcGroup->new_vfMembers))
+			continue;
+		for_all_multicast_members(mcGroup, mcMember) {
+			if (  mcMember->record.JoinNonMember
+			   || mcMember->record.JoinFullMember
+			   || !mcMember->record.JoinSendOnlyMember)
+				continue;
+			if (sm_mcmember_switch_port(topo, mcMember, &nodep))
+				nodep->hasSendOnlyMember = 1;
+		}
+	}
+}
+
+/* sm_spanning_tree_shape - Flattens the spanning trees built for this sweep, and which
+ * tree each MTU/rate uses, into an array that can be compared against the trees of
+ * the sweep that last calculated the MFTs.
+ */
+static Status_t sm_spanning_tree_shape(int32_t **shapep, uint32_t *lenp)
+{
+	McSpanningTree_t	*tree;
+	int32_t		*shape;
+	uint32_t	len, pos = 0;
+	int			i, j, mtu, rate;
+
+	len = (STL_MTU_MAX + 1) * (IB_STATIC_RATE_MAX + 1);
+	for (i = 0; i < uniqueSpanningTreeCount; i++)
+		len += 1 + 3 * uniqueSpanningTrees[i]->num_nodes;
+
+	if (vs_pool_alloc(&sm_pool, sizeof(int32_t) * len, (void **)&shape) != VSTATUS_OK) {
+		IB_LOG_ERROR_FMT(__func__, "Out of memory.");
+		return VSTATUS_NOMEM;
+	}
+
+	for (mtu = 0; mtu <= STL_MTU_MAX; mtu++) {
+		for (rate = 0; rate <= IB_STATIC_RATE_MAX; rate++) {
+			shape[pos] = -1;
+			for (i = 0; i < uniqueSpanningTreeCount; i++) {
+				if (spanningTrees[mtu][rate].spanningTree == uniqueSpanningTrees[i]) {
+					shape[pos] = i;
+					break;
+				}
+			}
+			pos++;
+		}
+	}
+	for (i = 0; i < uniqueSpanningTreeCount; i++) {
+		tree = uniqueSpanningTrees[i];
+		shape[pos++] = tree->num_nodes;
+		for (j = 0; j < tree->num_nodes; j++) {
+			shape[pos++] = tree->nodes[j].index;
+			shape[pos++] = tree->nodes[j].nodeno;
+			shape[pos++] = tree->nodes[j].portno;
+		}
+	}
+
+	*shapep = shape;
+	*lenp = len;
+	return VSTATUS_OK;
+}
+
+/* Spanning trees, pruning setting and pass number of the last MFT calculation.  The
+ * topology whose MFTs that pass produced carries the same number in mftGeneration.
+ */
+static int32_t	*mftTreeShape = NULL;
+static uint32_t	mftTreeShapeLen = 0;
+static uint32_t	mftPruning = 0;
+static uint32_t	mftGeneration = 0;
+
+/* sm_mft_can_increment - Checks whether the MFTs of old_topology can be carried over
+ * to the new topology with only the changed groups recomputed: the old MFTs must come
+ * from the last calculation, every switch must be in the old topology and the spanning
+ * trees and pruning setting must be unchanged.  When pruning, the switches with send
+ * only members must also be unchanged, as they limit the pruning of every group.
+ */
+static boolean sm_mft_can_increment(int32_t *shape, uint32_t shapeLen)
+{
+	Topology_t	*topo = &sm_newTopology;
+	Node_t		*nodep, *oldswp;
+	Port_t		*portp;
+
+	if (!topology_passcount || updatedVirtualFabrics ||
+		!mftGeneration || old_topology.mftGeneration != mftGeneration ||
+		mftPruning != sm_mc_config.enable_pruning)
+		return FALSE;
+
+	if (shapeLen != mftTreeShapeLen || memcmp(shape, mftTreeShape, sizeof(int32_t) * shapeLen))
+		return FALSE;
+
+	for_all_switch_nodes(topo, nodep) {
+		if (!sm_valid_port((portp = sm_get_port(nodep, 0))))
+			return FALSE;
+		oldswp = lidmap[portp->portData->lid].oldNodep;
+		if (!oldswp || !oldswp->mft)
+			return FALSE;
+	}
+
+	if (sm_mc_config.enable_pruning) {
+		sm_mark_sendonly_switches();
+		for_all_switch_nodes(topo, nodep) {
+			portp = sm_get_port(nodep, 0);
+			oldswp = lidmap[portp->portData->lid].oldNodep;
+			if (nodep->hasSendOnlyMember != oldswp->hasSendOnlyMember)
+				return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static Status_t sm_calculate_mfts_common(boolean incremental)
 {
 	McSpanningTree_t	*tree;
+	McSpanningTree_t	**lidTrees = NULL;
 	McGroup_t	*mcGroup;
 	Port_t 	 *portp = NULL;
 	Node_t   *nodep = NULL, *oldswp = NULL;
@@ -929,12 +1089,35 @@ Status_t sm_calculate_mfts()
 	Topology_t *topo;
 	Status_t status;
 	uint32 indexLid;
-	bitset_t allMlids;
+	bitset_t allMlids, dirtyMlids;
+	uint32_t *offsets = NULL, *keptOffsets = NULL;
+	uint32_t numOffsets = 0, numKept = 0, n;
+	int32_t	*shape = NULL;
+	uint32_t shapeLen = 0;
 
 	if (!bitset_init(&sm_pool, &allMlids, (STL_LID_MULTICAST_END-STL_LID_MULTICAST_BEGIN+1))) {
 		IB_LOG_ERROR_FMT(__func__, "Out of memory.");
 		return VSTATUS_NOMEM;
 	}
+	if (!bitset_init(&sm_pool, &dirtyMlids, (STL_LID_MULTICAST_END-STL_LID_MULTICAST_BEGIN+1))) {
+		IB_LOG_ERROR_FMT(__func__, "Out of memory.");
+		bitset_free(&allMlids);
+		return VSTATUS_NOMEM;
+	}
+	if (vs_pool_alloc(&sm_pool, sizeof(McSpanningTree_t *) * sm_mcast_mlid_table_cap, (void **)&lidTrees) != VSTATUS_OK ||
+		vs_pool_alloc(&sm_pool, sizeof(uint32_t) * 2 * sm_mcast_mlid_table_cap, (void **)&offsets) != VSTATUS_OK ||
+		sm_spanning_tree_shape(&shape, &shapeLen) != VSTATUS_OK) {
+		IB_LOG_ERROR_FMT(__func__, "Out of memory.");
+		if (offsets)
+			vs_pool_free(&sm_pool, offsets);
+		if (lidTrees)
+			vs_pool_free(&sm_pool, lidTrees);
+		bitset_free(&dirtyMlids);
+		bitset_free(&allMlids);
+		return VSTATUS_NOMEM;
+	}
+	memset(lidTrees, 0, sizeof(McSpanningTree_t *) * sm_mcast_mlid_table_cap);
+	keptOffsets = offsets + sm_mcast_mlid_table_cap;
 
 	topo = &sm_newTopology;
 
@@ -944,6 +1127,11 @@ Status_t sm_calculate_mfts()
 
 	if ((status = vs_lock(&sm_McGroups_lock)) != VSTATUS_OK) {
 		IB_LOG_ERRORRC("Failed to get sm_McGroups_lock rc:", status);
+		vs_pool_free(&sm_pool, shape);
+		vs_pool_free(&sm_pool, offsets);
+		vs_pool_free(&sm_pool, lidTrees);
+		bitset_free(&dirtyMlids);
+		bitset_free(&allMlids);
 		return status;
 	}
 
@@ -957,39 +1145,93 @@ Status_t sm_calculate_mfts()
 		bitset_set(&allMlids,indexLid);
 	}
 
+	maxmcLid = sm_multicast_get_max_lid();
+
+	if (incremental)
+		incremental = sm_mft_can_increment(shape, shapeLen);
+
+	if (incremental) {
+		/* Only the MLIDs of groups whose membership or realizability changed are
+		 * recomputed; the entries of the others are carried over.
+		 */
+		for_all_multicast_groups(mcGroup) {
+			if (mcGroup->flags & McGroupMftDirty)
+				bitset_set(&dirtyMlids, mcGroup->mLid - STL_LID_MULTICAST_BEGIN);
+		}
+		bitset_set_intersection(&allMlids, &dirtyMlids, &dirtyMlids);
+	}
+
+	/* List the MLIDs in use once, rather than scanning the bitsets for each switch */
+	for (offset = 0; offset <= (int)(maxmcLid - STL_LID_MULTICAST_BEGIN) && offset < sm_mcast_mlid_table_cap; offset++) {
+		if (!bitset_test(&allMlids, offset))
+			continue;
+		if (incremental && !bitset_test(&dirtyMlids, offset))
+			keptOffsets[numKept++] = offset;
+		else
+			offsets[numOffsets++] = offset;
+	}
+
+	/* Look up the spanning tree of each MLID once, rather than once per switch */
+	if (uniqueSpanningTreeCount == 1) {
+		for (n = 0; n < numOffsets; n++)
+			lidTrees[offsets[n]] = uniqueSpanningTrees[0];
+	} else {
+		for_all_multicast_groups(mcGroup) {
+			if (mcGroup->flags & McGroupUnrealizable)
+				continue;
+			if (updatedVirtualFabrics && !bitset_nset(&mcGroup->new_vfMembers)) {
+				// If reconfig sweep, and new vfs is empty do not add to MFT
+				continue;
+			}
+			offset = mcGroup->mLid - STL_LID_MULTICAST_BEGIN;
+			if (offset < sm_mcast_mlid_table_cap && !lidTrees[offset])
+				lidTrees[offset] = spanningTrees[mcGroup->mtu][mcGroup->rate].spanningTree;
+		}
+	}
+	for (n = 0; n < numOffsets; n++) {
+		if ((tree = lidTrees[offsets[n]]) && !tree->first_mlid)
+			lidTrees[offsets[n]] = NULL;
+	}
+
+	if (incremental) {
+		/* build each tree's port mask in the first recomputed MLID that uses it */
+		for (i=0; i < uniqueSpanningTreeCount; i++) {
+			uniqueSpanningTrees[i]->first_mlid = 0;
+		}
+		for (n = 0; n < numOffsets; n++) {
+			if ((tree = lidTrees[offsets[n]]) && !tree->first_mlid)
+				tree->first_mlid = offsets[n] + STL_LID_MULTICAST_BEGIN;
+		}
+	}
+
+	if (incremental && numKept) {
+		/* Carry over the entries of the unchanged groups in one copy per switch, then
+		 * clear the entries in between, which are recomputed or not in use.
+		 */
+		for_all_switch_nodes(topo, nodep) {
+			portp = sm_get_port(nodep, 0);
+			oldswp = lidmap[portp->portData->lid].oldNodep;
+			memcpy((void *)nodep->mft[0], (void *)oldswp->mft[0],
+				sizeof(STL_PORTMASK) * STL_MFTABLE_POSITION_COUNT * (keptOffsets[numKept - 1] + 1));
+			for (n = 0, offset = 0; n < numKept; offset = keptOffsets[n++] + 1) {
+				if ((int)keptOffsets[n] > offset)
+					memset((void *)nodep->mft[offset], 0,
+						sizeof(STL_PORTMASK) * STL_MFTABLE_POSITION_COUNT * (keptOffsets[n] - offset));
+			}
+		}
+	}
+
 	sm_calculate_spanning_tree_port_mask();
 
 	/* Copy the spanning tree port mask to all the MLIDs from tree->first_mlid where
 	 * it is stored by sm_calculate_spanning_tree_port_masks().
 	 */
 
-	maxmcLid = sm_multicast_get_max_lid();
-
 	for_all_switch_nodes(topo, nodep) {
-		for (lid = STL_LID_MULTICAST_BEGIN; lid <= maxmcLid; lid++) {
-			offset = lid-STL_LID_MULTICAST_BEGIN;
-			if (!bitset_test(&allMlids, offset))
-				continue;
-			tree = NULL;
-			if (uniqueSpanningTreeCount == 1) {
-				tree = uniqueSpanningTrees[0];
-			} else {
-				for_all_multicast_groups(mcGroup) {
-					if (mcGroup->flags & McGroupUnrealizable)
-						continue;
-					if (updatedVirtualFabrics && !bitset_nset(&mcGroup->new_vfMembers)) {
-						// If reconfig sweep, and new vfs is empty do not add to MFT
-						continue;
-					}
-					if (mcGroup->mLid == lid) {
-						tree = spanningTrees[mcGroup->mtu][mcGroup->rate].spanningTree;
-						break;
-					}
-				}
-			}
-			if (!tree)
-				continue;
-			if (!tree->first_mlid)
+		for (n = 0; n < numOffsets; n++) {
+			offset = offsets[n];
+			lid = offset + STL_LID_MULTICAST_BEGIN;
+			if (!(tree = lidTrees[offset]))
 				continue;
 
 			if (lid != tree->first_mlid) {
@@ -1018,20 +1260,18 @@ Status_t sm_calculate_mfts()
 	}
 
 	/* Set the bits in port masks corresponding to ports for McMembers */
-	sm_add_mcmember_port_masks();
+	sm_add_mcmember_port_masks(incremental ? &dirtyMlids : NULL);
 
     if (sm_mc_config.enable_pruning) {
 		for (i = 0; i < uniqueSpanningTreeCount; i++) {
-			sm_pruneMcastSpanningTree(uniqueSpanningTrees[i], &allMlids);
+			sm_pruneMcastSpanningTree(uniqueSpanningTrees[i], incremental ? &dirtyMlids : &allMlids);
 		}
 	}
 
-	/* check if port masks have changed since last sweep */
+	/* check if port masks have changed since last sweep; carried over entries have not */
 	for_all_switch_nodes(topo, nodep) {
-		for (lid = STL_LID_MULTICAST_BEGIN; lid <= maxmcLid; lid++) {
-			offset = lid - STL_LID_MULTICAST_BEGIN;
-			if (!bitset_test(&allMlids, offset))
-				continue;
+		for (n = 0; n < numOffsets; n++) {
+			offset = offsets[n];
 	        if (!nodep->mftPortMaskChange && topology_passcount && sm_valid_port((portp = sm_get_port(nodep, 0)))) {
 	   	        if ((oldswp = lidmap[portp->portData->lid].oldNodep)) {
 					if (memcmp((void *)nodep->mft[offset], (void *)oldswp->mft[offset], sizeof(STL_PORTMASK) * STL_NUM_MFT_POSITIONS_MASK))
@@ -1040,6 +1280,27 @@ Status_t sm_calculate_mfts()
         	}
 		}
 	}
+
+	if (incremental) {
+		IB_LOG_VERBOSE_FMT(__func__, "Recomputed MFT entries for %u of %u multicast LIDs",
+			numOffsets, numOffsets + numKept);
+	}
+
+	for_all_multicast_groups(mcGroup) {
+		mcGroup->flags &= ~McGroupMftDirty;
+	}
+	if (++mftGeneration == 0)
+		++mftGeneration;
+	topo->mftGeneration = mftGeneration;
+	if (mftTreeShape)
+		vs_pool_free(&sm_pool, mftTreeShape);
+	mftTreeShape = shape;
+	mftTreeShapeLen = shapeLen;
+	mftPruning = sm_mc_config.enable_pruning;
+
+	vs_pool_free(&sm_pool, offsets);
+	vs_pool_free(&sm_pool, lidTrees);
+	bitset_free(&dirtyMlids);
 	bitset_free(&allMlids);
 
    (void)vs_unlock(&sm_McGroups_lock);
@@ -1047,6 +1308,21 @@ Status_t sm_calculate_mfts()
 	return VSTATUS_OK;
 }
 
+Status_t sm_calculate_mfts()
+{
+	return sm_calculate_mfts_common(FALSE);
+}
+
+/* sm_calculate_mfts_incremental - Used when only multicast membership has changed
+ * since the last sweep: carries the old MFT entries over and recomputes those of the
+ * groups marked McGroupMftDirty.  Falls back to a full calculation when the old MFTs
+ * cannot be reused.
+ */
+Status_t sm_calculate_mfts_incremental()
+{
+	return sm_calculate_mfts_common(TRUE);
+}
+
 void sm_pruneMcastSpanningTree(McSpanningTree_t *mcST, bitset_t *allmlids )
 {
 	int			i, j;
@@ -1175,18 +1451,23 @@ Status_t sm_multicast_switch_mft_copy() {
 
    (void)vs_unlock(&sm_McGroups_lock);
 
+	/* the copies are the old MFTs only if every switch has an old counterpart */
+	newtopop->mftGeneration = old_topology.mftGeneration;
+
     for_all_switch_nodes(newtopop, newswp) {
-        if (sm_valid_port((portp = sm_get_port(newswp,0)))) {
-            if ((oldswp = lidmap[portp->portData->lid].oldNodep)) {
-                for (lid = STL_LID_MULTICAST_BEGIN; lid <= maxmcLid; ++lid) {
-                    offset = lid - STL_LID_MULTICAST_BEGIN;
-                    if (!bitset_test(&allMlids,offset))
-                       continue;
-                    /* copy the mft over into new topology */
-                    memcpy(newswp->mft[offset], oldswp->mft[offset],
-                           sizeof(STL_PORTMASK) * STL_NUM_MFT_POSITIONS_MASK);
-                }
+        if (  sm_valid_port((portp = sm_get_port(newswp,0)))
+           && (oldswp = lidmap[portp->portData->lid].oldNodep)) {
+            newswp->hasSendOnlyMember = oldswp->hasSendOnlyMember;
+            for (lid = STL_LID_MULTICAST_BEGIN; lid <= maxmcLid; ++lid) {
+                offset = lid - STL_LID_MULTICAST_BEGIN;
+                if (!bitset_test(&allMlids,offset))
+                   continue;
+                /* copy the mft over into new topology */
+                memcpy(newswp->mft[offset], oldswp->mft[offset],
+                       sizeof(STL_PORTMASK) * STL_NUM_MFT_POSITIONS_MASK);
             }
+        } else {
+            newtopop->mftGeneration = 0;
         }
     }
 	bitset_free(&allMlids);
@@ -2002,9 +2283,17 @@ sm_multicast_decommision_group(McGroup_t * group)
 	McGroupClass_t * groupClass = NULL;
 	LidClass_t * lidClass = NULL;
 	PKeyUsage_t * PKeyU = NULL;
+	McGroup_t * mcGroup = NULL;
 	Status_t status = VSTATUS_OK;
 	int i = 0;
 
+	// Groups sharing the MLID lose this group's members from their MFT entries
+	for (mcGroup = sm_find_multicast_mlid(group->mLid); mcGroup != NULL;
+		 mcGroup = sm_find_next_multicast_mlid(mcGroup)) {
+		if (mcGroup != group)
+			mcGroup->flags |= McGroupMftDirty;
+	}
+
 	// Find the group class
 	groupClass = find_mc_group_class(group->mGid);
 
@@ -2266,6 +2555,118 @@ sm_multicast_assign_lid(IB_GID mGid, PKey_t pKey, uint8_t mtu, uint8_t rate,
 
 // -------------------------------------------------------------------------- //
 
+static __inline__ uint32_t
+sm_multicast_gid_chain(const IB_GID *gid, uint32_t mask) {
+	uint64_t	hash;
+
+	hash = (gid->AsReg64s.H * 0xbf58476d1ce4e5b9ull) ^ gid->AsReg64s.L;
+	return (uint32_t)((hash * 0x9e3779b97f4a7c15ull) >> 32) & mask;
+}
+
+void
+sm_multicast_index_group(McGroup_t *group) {
+	McGroup_t	**chainp;
+
+	chainp = &sm_McGroupsByMgid[sm_multicast_gid_chain(&group->mGid, MC_GROUP_INDEX_SIZE - 1)];
+	group->mgidNext = *chainp;
+	*chainp = group;
+
+	chainp = &sm_McGroupsByMlid[group->mLid & (MC_GROUP_INDEX_SIZE - 1)];
+	group->mlidNext = *chainp;
+	*chainp = group;
+}
+
+void
+sm_multicast_unindex_group(McGroup_t *group) {
+	McGroup_t	**chainp;
+
+	for (chainp = &sm_McGroupsByMgid[sm_multicast_gid_chain(&group->mGid, MC_GROUP_INDEX_SIZE - 1)];
+		 *chainp != NULL; chainp = &(*chainp)->mgidNext) {
+		if (*chainp == group) {
+			*chainp = group->mgidNext;
+			break;
+		}
+	}
+
+	for (chainp = &sm_McGroupsByMlid[group->mLid & (MC_GROUP_INDEX_SIZE - 1)];
+		 *chainp != NULL; chainp = &(*chainp)->mlidNext) {
+		if (*chainp == group) {
+			*chainp = group->mlidNext;
+			break;
+		}
+	}
+}
+
+// Forget every group; for when sm_McGroups is reset without deleting them.
+void
+sm_multicast_index_clear(void) {
+	memset(sm_McGroupsByMgid, 0, sizeof(sm_McGroupsByMgid));
+	memset(sm_McGroupsByMlid, 0, sizeof(sm_McGroupsByMlid));
+}
+
+/*
+ * Rebuild the group's member index with chains chains from its member list.
+ * If the table can't be allocated the old one (or none) is kept; lookups
+ * fall back to the list when there is no index.
+ */
+static void
+sm_multicast_member_index_resize(McGroup_t *group, uint32_t chains) {
+	McMember_t	**index;
+	McMember_t	*member;
+
+	if (vs_pool_alloc(&sm_pool, chains * sizeof(McMember_t *), (void *)&index) != VSTATUS_OK) {
+		return;
+	}
+	memset(index, 0, chains * sizeof(McMember_t *));
+
+	if (group->memberIndex) {
+		(void)vs_pool_free(&sm_pool, (void *)group->memberIndex);
+	}
+	group->memberIndex = index;
+	group->memberMask = chains - 1;
+
+	for_all_multicast_members(group, member) {
+		index = &group->memberIndex[sm_multicast_gid_chain(&member->record.RID.PortGID, group->memberMask)];
+		member->gidNext = *index;
+		*index = member;
+	}
+}
+
+// member must already be on group->mcMembers
+void
+sm_multicast_index_member(McGroup_t *group, McMember_t *member) {
+	McMember_t	**chainp, **oldIndex;
+
+	if (++group->numMembers > group->memberMask + 1 || !group->memberIndex) {
+		oldIndex = group->memberIndex;
+		sm_multicast_member_index_resize(group,
+			oldIndex ? 2 * (group->memberMask + 1) : MC_MEMBER_INDEX_MIN);
+		if (group->memberIndex != oldIndex || !group->memberIndex)
+			return;		// rebuilt with member already linked, or still no index
+	}
+
+	chainp = &group->memberIndex[sm_multicast_gid_chain(&member->record.RID.PortGID, group->memberMask)];
+	member->gidNext = *chainp;
+	*chainp = member;
+}
+
+void
+sm_multicast_unindex_member(McGroup_t *group, McMember_t *member) {
+	McMember_t	**chainp;
+
+	--group->numMembers;
+	if (!group->memberIndex)
+		return;
+
+	for (chainp = &group->memberIndex[sm_multicast_gid_chain(&member->record.RID.PortGID, group->memberMask)];
+		 *chainp != NULL; chainp = &(*chainp)->gidNext) {
+		if (*chainp == member) {
+			*chainp = member->gidNext;
+			break;
+		}
+	}
+}
+
 // gid is in host byte order
 McGroup_t *
 sm_find_multicast_gid(IB_GID gid) {
@@ -2273,10 +2674,8 @@ sm_find_multicast_gid(IB_GID gid) {
 
 	IB_ENTER(__func__, &gid, 0, 0, 0);
 
-//
-//	Loop over all MC groups looking for this MC gid.
-//
-	for_all_multicast_groups(mcGroup) {
+	for (mcGroup = sm_McGroupsByMgid[sm_multicast_gid_chain(&gid, MC_GROUP_INDEX_SIZE - 1)];
+		 mcGroup != NULL; mcGroup = mcGroup->mgidNext) {
 		if (memcmp(&(mcGroup->mGid), &gid, 16) == 0) {
 			break;
 		}
@@ -2286,6 +2685,31 @@ sm_find_multicast_gid(IB_GID gid) {
 	return(mcGroup);
 }
 
+// First group using mlid; more may follow, see sm_find_next_multicast_mlid().
+McGroup_t *
+sm_find_multicast_mlid(STL_LID mlid) {
+	McGroup_t	*mcGroup;
+
+	for (mcGroup = sm_McGroupsByMlid[mlid & (MC_GROUP_INDEX_SIZE - 1)];
+		 mcGroup != NULL; mcGroup = mcGroup->mlidNext) {
+		if (mcGroup->mLid == mlid)
+			break;
+	}
+	return mcGroup;
+}
+
+// Next group sharing mcGroup's MLID, or NULL.
+McGroup_t *
+sm_find_next_multicast_mlid(McGroup_t *mcGroup) {
+	McGroup_t	*next;
+
+	for (next = mcGroup->mlidNext; next != NULL; next = next->mlidNext) {
+		if (next->mLid == mcGroup->mLid)
+			break;
+	}
+	return next;
+}
+
 // gid is in host byte order
 McGroup_t *
 sm_find_next_multicast_gid(IB_GID gid) {
@@ -2435,12 +2859,18 @@ sm_find_multicast_member(McGroup_t *mcGroup, IB_GID gid) {
 
 	IB_ENTER(__func__, mcGroup, &gid, 0, 0);
 
-//
-//	Loop over all of the members looking for this gid.
-//
-	for_all_multicast_members(mcGroup, mcMember) {
-		if (memcmp((void *)(&gid), (void *)mcMember->record.RID.PortGID.Raw, 16) == 0) {
-			break;
+	if (mcGroup->memberIndex) {
+		for (mcMember = mcGroup->memberIndex[sm_multicast_gid_chain(&gid, mcGroup->memberMask)];
+			 mcMember != NULL; mcMember = mcMember->gidNext) {
+			if (memcmp((void *)(&gid), (void *)mcMember->record.RID.PortGID.Raw, 16) == 0) {
+				break;
+			}
+		}
+	} else {
+		for_all_multicast_members(mcGroup, mcMember) {
+			if (memcmp((void *)(&gid), (void *)mcMember->record.RID.PortGID.Raw, 16) == 0) {
+				break;
+			}
 		}
 	}
 
@@ -382,7 +382,8 @@ psc_cleanup(ParallelSweepContext_t *psc)
 		vs_pool_free(&sm_pool,mpi);
 	}
 #else
-	vs_pool_free(&sm_pool, psc->mai_fd);
+	if (psc->mai_fd)
+		vs_pool_free(&sm_pool, psc->mai_fd);
 #endif
 
 	vs_pool_free(&sm_pool, psc);
@@ -446,8 +447,8 @@ psc_set_status(ParallelSweepContext_t *psc, Status_t status)
 #endif
 }
 
-ParallelSweepContext_t*
-psc_init(void)
+static ParallelSweepContext_t*
+_psc_init(boolean openMai)
 {
 	Status_t status=VSTATUS_OK;
 	ParallelSweepContext_t *fabric_context;
@@ -480,10 +481,10 @@ psc_init(void)
 #ifdef ENABLE_MULTITHREADED
 	// When using multi-threading, create 1 MAI handle per thread.
 	unsigned i;
-	for(i=0; i<fabric_context->num_threads; i++) {
+	for(i=0; openMai && i<fabric_context->num_threads; i++) {
 #else
 	// For VxWorks we only create a single MAI handle.
-	{
+	if (openMai) {
 #endif
 		MaiPool_t *mpi;
 		status = vs_pool_alloc(&sm_pool, sizeof(MaiPool_t), (void**)&mpi);
@@ -512,3 +513,15 @@ psc_init(void)
 
 	return fabric_context;
 }
+
+ParallelSweepContext_t*
+psc_init(void)
+{
+	return _psc_init(TRUE);
+}
+
+ParallelSweepContext_t*
+psc_init_nomai(void)
+{
+	return _psc_init(FALSE);
+}
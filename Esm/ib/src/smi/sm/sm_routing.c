@@ -167,11 +167,303 @@ sm_routing_freeModule(RoutingModule_t ** module)
 	return VSTATUS_OK;
 }
 
+/* Row groups compacted in parallel, each with its own hash table. */
+#define SM_COMPACT_QUEUES	64
+
+static __inline__ uint32_t
+_path_portmask_hash(const SmPathPortmask_t *ports)
+{
+	uint64_t hash = 0;
+	int i;
+
+	for (i = 0; i < SM_PATH_MAX_PORTMASK; ++i)
+		hash = (hash ^ ports->masks[i]) * 0x9e3779b97f4a7c15ull;
+	return (uint32_t)(hash >> 32);
+}
+
+/*
+ * Deduplicate the next hop portmasks of one row in place.  The distinct
+ * portmasks are moved to the front of the row in order of first use and
+ * pathIndexi receives each column's position among them.  table is scratch
+ * space of tableSize entries, a power of two larger than switches.
+ * Returns the number of distinct portmasks.
+ */
+static uint32_t
+_dedup_path_row(SmPathPortmask_t *pathi, uint16_t *pathIndexi, int switches,
+	uint32_t *table, uint32_t tableSize)
+{
+	uint32_t count = 0, slot;
+	int j;
+
+	memset(table, 0, tableSize * sizeof(uint32_t));
+	for (j = 0; j < switches; ++j) {
+		slot = _path_portmask_hash(&pathi[j]) & (tableSize - 1);
+		while (table[slot] && memcmp(&pathi[table[slot] - 1], &pathi[j], sizeof(SmPathPortmask_t)))
+			slot = (slot + 1) & (tableSize - 1);
+		if (!table[slot]) {
+			if (count != (uint32_t)j)
+				pathi[count] = pathi[j];
+			table[slot] = ++count;
+		}
+		pathIndexi[j] = table[slot] - 1;
+	}
+	return count;
+}
+
+static void
+_free_compact_cost_matrix(SmCostMatrix_t *cm)
+{
+	if (cm->cost)
+		(void)vs_pool_free(&sm_pool, cm->cost);
+	if (cm->pathIndex)
+		(void)vs_pool_free(&sm_pool, cm->pathIndex);
+	if (cm->rowOffset)
+		(void)vs_pool_free(&sm_pool, cm->rowOffset);
+	if (cm->masks)
+		(void)vs_pool_free(&sm_pool, cm->masks);
+	memset(cm, 0, sizeof(SmCostMatrix_t));
+}
+
+/*
+ * Replace the dense cost and path arrays computed by the routing module with
+ * their compact form.  On failure the dense arrays are left in place; the
+ * accessors work on either form.
+ */
+Status_t
+sm_routing_compact_cost_matrix(Topology_t *topop)
+{
+	Status_t status;
+	SmCostMatrix_t cm;
+	int switches = topop->max_sws;
+	int i, q, numQueues;
+	size_t j, pairs = (size_t)switches * switches;
+	uint16_t maxCost = 0;
+	uint32_t tableSize, *tables = NULL;
+	uint64_t total;
+
+	if (!topop->cost || !topop->path || switches <= 0)
+		return VSTATUS_OK;
+
+	/* Row positions must fit the 16-bit path index. */
+	if (switches > 0x10000)
+		return VSTATUS_NOSUPPORT;
+
+	memset(&cm, 0, sizeof(cm));
+	cm.switches = switches;
+
+	for (j = 0; j < pairs; ++j) {
+		if (topop->cost[j] != Cost_Infinity && topop->cost[j] > maxCost)
+			maxCost = topop->cost[j];
+	}
+	cm.costWidth = (maxCost < SM_COST_MATRIX_INFINITY_8) ? 1 : 2;
+
+	for (tableSize = 1; tableSize <= (uint32_t)switches; tableSize <<= 1)
+		;
+	tableSize <<= 1;
+	numQueues = MIN(SM_COMPACT_QUEUES, switches);
+
+	if ((status = vs_pool_alloc(&sm_pool, pairs * cm.costWidth, (void *)&cm.cost)) != VSTATUS_OK
+		|| (status = vs_pool_alloc(&sm_pool, pairs * sizeof(uint16_t), (void *)&cm.pathIndex)) != VSTATUS_OK
+		|| (status = vs_pool_alloc(&sm_pool, switches * sizeof(uint32_t), (void *)&cm.rowOffset)) != VSTATUS_OK
+		|| (status = vs_pool_alloc(&sm_pool, (size_t)numQueues * tableSize * sizeof(uint32_t), (void *)&tables)) != VSTATUS_OK) {
+		IB_LOG_ERRORRC("can't malloc compact cost matrix rc:", status);
+		goto fail;
+	}
+
+#ifndef __VXWORKS__
+#pragma omp parallel for private(i, j) shared(cm, tables) schedule(static, 1)
+#endif
+	for (q = 0; q < numQueues; ++q) {
+		for (i = q; i < switches; i += numQueues) {
+			uint16_t *costi = topop->cost + (size_t)i * switches;
+
+			if (cm.costWidth == 1) {
+				uint8_t *cost8 = (uint8_t *)cm.cost + (size_t)i * switches;
+				for (j = 0; j < (size_t)switches; ++j)
+					cost8[j] = (costi[j] == Cost_Infinity) ? SM_COST_MATRIX_INFINITY_8 : costi[j];
+			} else {
+				memcpy((uint16_t *)cm.cost + (size_t)i * switches, costi, switches * sizeof(uint16_t));
+			}
+
+			/* Row counts for now, turned into offsets below. */
+			cm.rowOffset[i] = _dedup_path_row(topop->path + (size_t)i * switches,
+				cm.pathIndex + (size_t)i * switches, switches,
+				tables + (size_t)q * tableSize, tableSize);
+		}
+	}
+
+	for (i = 0, total = 0; i < switches; ++i) {
+		uint32_t count = cm.rowOffset[i];
+		cm.rowOffset[i] = (uint32_t)total;
+		total += count;
+	}
+
+	if (total > UINT32_MAX
+		|| (status = vs_pool_alloc(&sm_pool, total * sizeof(SmPathPortmask_t), (void *)&cm.masks)) != VSTATUS_OK) {
+		status = VSTATUS_NOMEM;
+		IB_LOG_ERRORRC("can't malloc compact path matrix rc:", status);
+		/* Undo the in place deduplication; each row only ever moved entries forward. */
+		for (i = 0; i < switches; ++i) {
+			SmPathPortmask_t *pathi = topop->path + (size_t)i * switches;
+			uint16_t *pathIndexi = cm.pathIndex + (size_t)i * switches;
+			for (j = switches; j-- > 0; )
+				pathi[j] = pathi[pathIndexi[j]];
+		}
+		goto fail;
+	}
+	cm.numMasks = (uint32_t)total;
+
+	for (i = 0; i < switches; ++i) {
+		uint32_t count = ((i + 1 < switches) ? cm.rowOffset[i + 1] : cm.numMasks) - cm.rowOffset[i];
+		memcpy(cm.masks + cm.rowOffset[i], topop->path + (size_t)i * switches,
+			count * sizeof(SmPathPortmask_t));
+	}
+
+	(void)vs_pool_free(&sm_pool, tables);
+	(void)vs_pool_free(&sm_pool, topop->cost);
+	(void)vs_pool_free(&sm_pool, topop->path);
+	topop->cost = NULL;
+	topop->path = NULL;
+	topop->bytesCost = 0;
+	topop->bytesPath = 0;
+
+	_free_compact_cost_matrix(&topop->costMatrix);
+	topop->costMatrix = cm;
+
+	if (smDebugPerf) {
+		IB_LOG_INFINI_INFO_FMT(__func__, "%d switches: %u byte costs, %u distinct next hop masks, %"PRIu64" bytes",
+			switches, cm.costWidth, cm.numMasks, (uint64_t)sm_routing_cost_matrix_size(topop));
+	}
+
+	return VSTATUS_OK;
+
+fail:
+	if (tables)
+		(void)vs_pool_free(&sm_pool, tables);
+	_free_compact_cost_matrix(&cm);
+	return status;
+}
+
+/*
+ * Renumber the switches of a compact cost matrix: row and column i of the
+ * result are row and column oldIdx[i] of the current matrix.  Switches only
+ * ever move to lower indices (oldIdx[i] >= i), so the entries can be moved
+ * forward in place.
+ */
+void
+sm_routing_remap_cost_matrix(Topology_t *topop, const uint32_t *oldIdx, uint32_t switches)
+{
+	SmCostMatrix_t *cm = &topop->costMatrix;
+	uint32_t i, j;
+	size_t src, dst;
+
+	if (!cm->cost)
+		return;
+
+	for (i = 0; i < switches; ++i) {
+		cm->rowOffset[i] = cm->rowOffset[oldIdx[i]];
+		for (j = 0; j < switches; ++j) {
+			src = (size_t)oldIdx[i] * cm->switches + oldIdx[j];
+			dst = (size_t)i * switches + j;
+			if (cm->costWidth == 1)
+				((uint8_t *)cm->cost)[dst] = ((uint8_t *)cm->cost)[src];
+			else
+				((uint16_t *)cm->cost)[dst] = ((uint16_t *)cm->cost)[src];
+			cm->pathIndex[dst] = cm->pathIndex[src];
+		}
+	}
+
+	cm->switches = switches;
+}
+
+/*
+ * Write the cost and path matrices of topop, in either form, into dense
+ * arrays of topop->max_sws squared entries.
+ */
+void
+sm_routing_expand_cost_matrix(Topology_t *topop, uint16_t *cost, SmPathPortmask_t *path)
+{
+	int i, j, switches = topop->max_sws;
+	size_t ij;
+
+	if (topop->cost) {
+		memcpy(cost, topop->cost, (size_t)switches * switches * sizeof(uint16_t));
+		memcpy(path, topop->path, SM_PATH_SIZE((size_t)switches));
+		return;
+	}
+
+	for (i = 0, ij = 0; i < switches; ++i) {
+		for (j = 0; j < switches; ++j, ++ij) {
+			cost[ij] = sm_cost_matrix_cost(topop, i, j);
+			path[ij] = *sm_cost_matrix_path(topop, i, j);
+		}
+	}
+}
+
+void
+sm_routing_free_cost_matrix(Topology_t *topop)
+{
+	if (topop->cost != NULL) {
+		(void)vs_pool_free(&sm_pool, (void *)topop->cost);
+		topop->cost = NULL;
+	}
+
+	if (topop->path != NULL) {
+		(void)vs_pool_free(&sm_pool, (void *)topop->path);
+		topop->path = NULL;
+	}
+
+	topop->bytesCost = 0;
+	topop->bytesPath = 0;
+	_free_compact_cost_matrix(&topop->costMatrix);
+}
+
+/* Bytes held by the cost and path matrices of topop. */
+size_t
+sm_routing_cost_matrix_size(Topology_t *topop)
+{
+	SmCostMatrix_t *cm = &topop->costMatrix;
+	size_t pairs = (size_t)cm->switches * cm->switches;
+
+	if (topop->cost)
+		return topop->bytesCost + topop->bytesPath;
+	if (!cm->cost)
+		return 0;
+
+	return pairs * (cm->costWidth + sizeof(uint16_t))
+		+ cm->switches * sizeof(uint32_t)
+		+ (size_t)cm->numMasks * sizeof(SmPathPortmask_t);
+}
+
 Status_t
 sm_routing_copy_cost_matrix(Topology_t *src_topop, Topology_t *dst_topop)
 {
 	Status_t status;
 	size_t   bytesCost, bytesPath;
+	SmCostMatrix_t *src = &src_topop->costMatrix, *dst = &dst_topop->costMatrix;
+	size_t   pairs = (size_t)src->switches * src->switches;
+
+	if (src->cost) {
+		memset(dst, 0, sizeof(SmCostMatrix_t));
+		if ((status = vs_pool_alloc(&sm_pool, pairs * src->costWidth, (void *)&dst->cost)) != VSTATUS_OK
+			|| (status = vs_pool_alloc(&sm_pool, pairs * sizeof(uint16_t), (void *)&dst->pathIndex)) != VSTATUS_OK
+			|| (status = vs_pool_alloc(&sm_pool, src->switches * sizeof(uint32_t), (void *)&dst->rowOffset)) != VSTATUS_OK
+			|| (status = vs_pool_alloc(&sm_pool, (size_t)src->numMasks * sizeof(SmPathPortmask_t), (void *)&dst->masks)) != VSTATUS_OK) {
+			IB_LOG_ERRORRC("TT(topop): can't malloc cost matrix; rc:", status);
+			_free_compact_cost_matrix(dst);
+			IB_EXIT(__func__, status);
+			return status;
+		}
+
+		dst->switches = src->switches;
+		dst->costWidth = src->costWidth;
+		dst->numMasks = src->numMasks;
+		memcpy(dst->cost, src->cost, pairs * src->costWidth);
+		memcpy(dst->pathIndex, src->pathIndex, pairs * sizeof(uint16_t));
+		memcpy(dst->rowOffset, src->rowOffset, src->switches * sizeof(uint32_t));
+		memcpy(dst->masks, src->masks, (size_t)src->numMasks * sizeof(SmPathPortmask_t));
+		return VSTATUS_OK;
+	}
 
 	if (!src_topop->cost) {
 		// routing module not using cost matrix
@@ -269,7 +561,6 @@ sm_routing_route_old_switch(Topology_t *src_topop, Topology_t *dst_topop, Node_t
 	Status_t status;
 	Node_t   *oldNodep;
 	Port_t   *oldPortp, *portp;
-	size_t   lftLength;
 
 	if (nodep->switchInfo.LinearFDBCap == 0) {
 		IB_LOG_ERROR_FMT(__func__, "switch doesn't support lft %s",
@@ -359,19 +650,11 @@ sm_routing_route_old_switch(Topology_t *src_topop, Topology_t *dst_topop, Node_t
 				sm_nodeDescString(nodep), nodep, nodep->index, nodep->lft);
 
 	// Just additions, adjust LFT blocks with removed or new lids.
-	if ((status = sm_Node_init_lft(nodep, &lftLength)) != VSTATUS_OK) {
+	if ((status = sm_Node_copy_lft(nodep, oldNodep)) != VSTATUS_OK) {
 		IB_FATAL_ERROR_NODUMP("sm_routing_route_old_switch: CAN'T ALLOCATE SPACE FOR NODE'S LFT;  OUT OF MEMORY IN SM MEMORY POOL!  TOO MANY NODES!!");
 		return VSTATUS_NOMEM;	/*calling function can use this value to abort programming old switches*/
 	}
 
-	if (nodep->switchInfo.LinearFDBTop > oldNodep->switchInfo.LinearFDBTop) {
-		memcpy((void *)nodep->lft, (void *)oldNodep->lft,
-			sizeof(PORT) * (oldNodep->switchInfo.LinearFDBTop + 1));
-	} else {
-		memcpy((void *)nodep->lft, (void *)oldNodep->lft,
-			sizeof(PORT) * (nodep->switchInfo.LinearFDBTop + 1));
-	}
-
 	if (nodep->pgt && oldNodep->pgt) {
 		memcpy((void *)nodep->pgt, (void *)oldNodep->pgt,
 			sizeof(STL_PORTMASK)*(nodep->switchInfo.PortGroupCap));
@@ -516,6 +799,266 @@ sm_Node_prune_portgroups(Node_t * switchp)
 	return VSTATUS_OK;
 }
 
+// Returns TRUE if lid is the base LID of an active port, and so starts an
+// LMC range whose LFT entries need to be computed.
+static __inline__ boolean
+_lft_base_lid(STL_LID lid, Node_t **nodepp, Port_t **portpp)
+{
+	// grab the node corresponding to the current lid
+	*nodepp = lidmap[lid].newNodep;
+	*portpp = lidmap[lid].newPortp;
+	// we'll program the entire LMC range in one go, so only
+	// program if we're at the beginning of the range
+	return (*nodepp != NULL && sm_valid_port(*portpp)
+		&& (*portpp)->state > IB_PORT_DOWN && lid == (*portpp)->portData->lid);
+}
+
+// Computes the LFT entries of switchp for the LMC range based at lid.
+// candidates, if not NULL, is the precomputed select_ports() result for
+// switchp (see sm_routing_func_setup_xft_candidates()).
+static Status_t
+_lft_route_lid(Topology_t *topop, Node_t *switchp, Node_t *nodep, Port_t *portp, STL_LID lid,
+	const SwitchportToNextGuid_t *candidates, int numCandidates)
+{
+	Status_t status;
+	STL_LID portLid;
+	uint8_t xftPorts[128];
+
+	if (candidates)
+		status = sm_routing_func_setup_xft_candidates(topop, switchp, nodep, portp, xftPorts,
+			candidates, numCandidates);
+	else
+		status = topop->routingModule->funcs.setup_xft(topop, switchp, nodep, portp, xftPorts);
+	if (status != VSTATUS_OK) {
+		IB_LOG_ERROR_FMT(__func__, "Failed to setup xft for %s (0x%"PRIx64")",
+			nodep->nodeDesc.NodeString,
+			nodep->nodeInfo.NodeGUID);
+		return status;
+	}
+
+	if (topop->routingModule->funcs.setup_pgs && nodep->nodeInfo.NodeType == NI_TYPE_SWITCH) {
+		status = topop->routingModule->funcs.setup_pgs(topop, switchp, nodep);
+		if (status != VSTATUS_OK) {
+			IB_LOG_ERROR_FMT(__func__, "Failed to setup port groups for %s (0x%"PRIx64")",
+				nodep->nodeDesc.NodeString,
+				nodep->nodeInfo.NodeGUID);
+			return status;
+		}
+	}
+	for_all_port_lids(portp, portLid) {
+		switchp->lft[portLid] = xftPorts[portLid - lid];
+	}
+
+	return VSTATUS_OK;
+}
+
+#ifdef ENABLE_MULTITHREADED
+//
+// Parallel LFT calculation.
+//
+// The balancing counters (lidsRouted, numLidsRouted, ...) are read and
+// updated by every (LID, switch) step, so the steps have to be applied in
+// the serial order for the LFTs to come out the same.  What does not depend
+// on the counters is the candidate list select_ports() builds from the path
+// matrix, and that is where the time goes.  LIDs are therefore handled in
+// batches: the PSC workers compute the candidate lists from every switch to
+// each destination switch of the batch, then the sweep thread replays the
+// batch in serial order, doing only the counter-driven choice per step.
+//
+extern ParallelSweepContext_t *sm_psc_g;
+
+// Cap on the candidate lists held per batch, and on the destination
+// switches a batch may span.
+#define SM_LFT_CANDIDATE_BUDGET	(16 * 1024 * 1024)
+#define SM_LFT_MAX_DESTS		64
+
+typedef struct {
+	Topology_t	*topop;
+	Node_t		**switches;		// switches routed in this pass, in list order
+	int			numSwitches;
+	int			rowLen;			// candidate slots per switch and destination
+	int			numDests;
+	int			dests[SM_LFT_MAX_DESTS];	// destination switch indices
+	SwitchportToNextGuid_t *candidates;	// [dest][switch][rowLen]
+	uint8_t		*numCandidates;			// [dest][switch]
+} LftBatch_t;
+
+typedef struct {
+	ParallelWorkItem_t item;
+	LftBatch_t	*batch;
+	int			first;			// first switch handled by this item
+	int			stride;			// distance to the next one
+} LftWorkItem_t;
+
+static void
+_lft_fill_candidates(LftBatch_t *batch, int first, int stride)
+{
+	int d, s;
+	size_t row;
+	Node_t *switchp;
+
+	for (d = 0; d < batch->numDests; d++) {
+		for (s = first; s < batch->numSwitches; s += stride) {
+			row = (size_t)d * batch->numSwitches + s;
+			switchp = batch->switches[s];
+			batch->numCandidates[row] = (switchp->swIdx == batch->dests[d]) ? 0 :
+				sm_routing_func_select_ports(batch->topop, switchp, batch->dests[d],
+					&batch->candidates[row * batch->rowLen], 0);
+		}
+	}
+}
+
+static void
+_lft_worker(ParallelSweepContext_t *psc, ParallelWorkItem_t *pwi)
+{
+	LftWorkItem_t *wip = PARENT_STRUCT(pwi, LftWorkItem_t, item);
+
+	// select_ports() only reads the topology and every work item writes
+	// its own rows of the batch, so the topology lock is not needed.
+	_lft_fill_candidates(wip->batch, wip->first, wip->stride);
+	vs_pool_free(&sm_pool, wip);
+}
+
+static Status_t
+_lft_compute_batch(ParallelSweepContext_t *psc, LftBatch_t *batch, int workers)
+{
+	int k;
+	Status_t status;
+	LftWorkItem_t *wip;
+
+	for (k = 0; k < workers; k++) {
+		if (vs_pool_alloc(&sm_pool, sizeof(LftWorkItem_t), (void **)&wip) != VSTATUS_OK) {
+			// finish the remaining shares on this thread
+			for (; k < workers; k++)
+				_lft_fill_candidates(batch, k, workers);
+			break;
+		}
+		memset(wip, 0, sizeof(LftWorkItem_t));
+		wip->item.workfunc = _lft_worker;
+		wip->batch = batch;
+		wip->first = k;
+		wip->stride = workers;
+		psc_add_work_item(psc, &wip->item);
+	}
+
+	status = psc_wait(psc);
+	if (status == VSTATUS_OK && !psc_is_running(psc)) {
+		IB_LOG_ERROR_FMT(__func__, "LFT workers were stopped before completing");
+		status = VSTATUS_BAD;
+	}
+	return status;
+}
+
+// Returns VSTATUS_NOSUPPORT without touching any routing state if the
+// working memory cannot be allocated; the caller then routes serially.
+static Status_t
+_calculate_all_lfts_parallel(Topology_t *topop, ParallelSweepContext_t *psc, int workers)
+{
+	Node_t *nodep, *switchp;
+	Port_t *portp;
+	Status_t status = VSTATUS_OK;
+	LftBatch_t batch;
+	int *destSlot = NULL;
+	int i, d, s, j, numSwitches = 0, maxDests;
+	size_t row, rowBytes;
+	STL_LID lid, first;
+
+	memset(&batch, 0, sizeof(batch));
+	batch.topop = topop;
+	batch.rowLen = 1;
+	for_all_switch_nodes(topop, switchp) {
+		++numSwitches;
+		if (switchp->nodeInfo.NumPorts > batch.rowLen)
+			batch.rowLen = switchp->nodeInfo.NumPorts;
+	}
+	if (numSwitches == 0)
+		return VSTATUS_OK;
+
+	rowBytes = (size_t)numSwitches * batch.rowLen * sizeof(SwitchportToNextGuid_t);
+	maxDests = MIN(SM_LFT_MAX_DESTS, SM_LFT_CANDIDATE_BUDGET / rowBytes);
+	if (maxDests < 1) maxDests = 1;
+
+	if (vs_pool_alloc(&sm_pool, numSwitches * sizeof(Node_t *), (void **)&batch.switches) != VSTATUS_OK ||
+		vs_pool_alloc(&sm_pool, maxDests * rowBytes, (void **)&batch.candidates) != VSTATUS_OK ||
+		vs_pool_alloc(&sm_pool, (size_t)maxDests * numSwitches, (void **)&batch.numCandidates) != VSTATUS_OK ||
+		vs_pool_alloc(&sm_pool, topop->max_sws * sizeof(int), (void **)&destSlot) != VSTATUS_OK) {
+		status = VSTATUS_NOSUPPORT;
+		goto done;
+	}
+	memset(destSlot, 0xff, topop->max_sws * sizeof(int));
+
+	psc_go(psc);
+
+	// While slighly more costly, iterating over edge switches first gives
+	// the best dispersion of routes.
+	for (i = 0; i < 2; i++) {
+		batch.numSwitches = 0;
+		for_all_switch_nodes(topop, switchp) {
+			if ((i==0) && !switchp->edgeSwitch) continue;
+			if ((i==1) && switchp->edgeSwitch) continue;
+			batch.switches[batch.numSwitches++] = switchp;
+		}
+		if (batch.numSwitches == 0)
+			continue;
+
+		for (lid = 0; lid <= topop->maxLid; ) {
+			// gather LIDs until the batch runs out of destination slots
+			first = lid;
+			batch.numDests = 0;
+			for (; lid <= topop->maxLid; ++lid) {
+				if (!_lft_base_lid(lid, &nodep, &portp))
+					continue;
+				j = sm_routing_func_xft_dest_index(topop, nodep, portp);
+				if (j < 0 || destSlot[j] >= 0)
+					continue;
+				if (batch.numDests == maxDests)
+					break;
+				destSlot[j] = batch.numDests;
+				batch.dests[batch.numDests++] = j;
+			}
+
+			if (batch.numDests > 0) {
+				status = _lft_compute_batch(psc, &batch, workers);
+				if (status != VSTATUS_OK)
+					goto done;
+			}
+
+			// replay the batch in serial order
+			for (; first < lid; ++first) {
+				if (!_lft_base_lid(first, &nodep, &portp))
+					continue;
+				// an unresolved destination falls back to setup_xft(),
+				// which reports the error
+				j = sm_routing_func_xft_dest_index(topop, nodep, portp);
+				for (s = 0; s < batch.numSwitches; s++) {
+					if (j < 0) {
+						status = _lft_route_lid(topop, batch.switches[s], nodep, portp, first, NULL, 0);
+					} else {
+						row = (size_t)destSlot[j] * batch.numSwitches + s;
+						status = _lft_route_lid(topop, batch.switches[s], nodep, portp, first,
+							&batch.candidates[row * batch.rowLen], batch.numCandidates[row]);
+					}
+					if (status != VSTATUS_OK)
+						goto done;
+				}
+			}
+
+			for (d = 0; d < batch.numDests; d++)
+				destSlot[batch.dests[d]] = -1;
+		}
+	}
+
+done:
+	if (status != VSTATUS_NOSUPPORT)
+		psc_drain_work_queue(psc);
+	if (destSlot) vs_pool_free(&sm_pool, destSlot);
+	if (batch.numCandidates) vs_pool_free(&sm_pool, batch.numCandidates);
+	if (batch.candidates) vs_pool_free(&sm_pool, batch.candidates);
+	if (batch.switches) vs_pool_free(&sm_pool, batch.switches);
+	return status;
+}
+#endif /* ENABLE_MULTITHREADED */
+
 /*
  * Called when fabric routing is to be updated, calculates routing for
  * all switches in the fabric.  This is the default routing method.
@@ -523,6 +1066,10 @@ sm_Node_prune_portgroups(Node_t * switchp)
  * Prior method of setting up routing by traversing switch list then LIDs
  * lead to highly unbalanced routing.  This method iterates over LIDs then
  * switches to balance the paths across all uplinks in a tree.
+ *
+ * With the default setup_xft/select_ports and LftThreads > 1 the path
+ * search is spread over the parallel sweep workers; the resulting LFTs are
+ * identical to the serial calculation.
  */
 Status_t
 sm_calculate_all_lfts(Topology_t * topop)
@@ -530,9 +1077,8 @@ sm_calculate_all_lfts(Topology_t * topop)
 	Node_t *nodep, *switchp;
 	Port_t *portp;
 	Status_t status;
-	int programLft,i;
-	STL_LID lid, portLid;
-	uint8_t xftPorts[128];
+	int i;
+	STL_LID lid;
 
 	for_all_switch_nodes(topop, switchp) {
 		status = sm_Node_init_lft(switchp, NULL);
@@ -545,17 +1091,21 @@ sm_calculate_all_lfts(Topology_t * topop)
 		switchp->switchInfo.PortGroupTop = 0;
 	}
 
+#ifdef ENABLE_MULTITHREADED
+	i = MIN(sm_config.lft_threads, sm_config.psThreads);
+	if (sm_psc_g && i > 1 &&
+		topop->routingModule->funcs.setup_xft == sm_routing_func_setup_xft &&
+		topop->routingModule->funcs.select_ports == sm_routing_func_select_ports) {
+		status = _calculate_all_lfts_parallel(topop, sm_psc_g, i);
+		if (status != VSTATUS_NOSUPPORT)
+			return status;
+		IB_LOG_WARN_FMT(__func__, "Insufficient memory for parallel LFT calculation, using one thread");
+	}
+#endif
+
 	for (i=0; i<2; i++) {
 		for (lid = 0; lid <= topop->maxLid; ++lid) {
-			// grab the node corresponding to the current lid
-			nodep = lidmap[lid].newNodep;
-			portp = lidmap[lid].newPortp;
-			// we'll program the entire LMC range in one go, so only
-			// program if we're at the beginning of the range
-			programLft = (nodep != NULL && sm_valid_port(portp)
-					  	&& portp->state > IB_PORT_DOWN && lid == portp->portData->lid)
-					? 1 : 0;
-			if (!programLft)
+			if (!_lft_base_lid(lid, &nodep, &portp))
 				continue;
 
 			// While slighly more costly, iterating over edge switches first gives
@@ -566,26 +1116,9 @@ sm_calculate_all_lfts(Topology_t * topop)
 			for_all_switch_nodes(topop, switchp) {
 				if ((i==0) && !switchp->edgeSwitch) continue;
 				if ((i==1) && switchp->edgeSwitch) continue;
-				status = topop->routingModule->funcs.setup_xft(topop, switchp, nodep, portp, xftPorts);
-				if (status != VSTATUS_OK) {
-					IB_LOG_ERROR_FMT(__func__, "Failed to setup xft for %s (0x%"PRIx64")",
-						nodep->nodeDesc.NodeString,
-						nodep->nodeInfo.NodeGUID);
+				status = _lft_route_lid(topop, switchp, nodep, portp, lid, NULL, 0);
+				if (status != VSTATUS_OK)
 					return status;
-				}
-
-				if (topop->routingModule->funcs.setup_pgs && nodep->nodeInfo.NodeType == NI_TYPE_SWITCH) {
-					status = topop->routingModule->funcs.setup_pgs(topop, switchp, nodep);
-					if (status != VSTATUS_OK) {
-						IB_LOG_ERROR_FMT(__func__, "Failed to setup port groups for %s (0x%"PRIx64")",
-							nodep->nodeDesc.NodeString,
-							nodep->nodeInfo.NodeGUID);
-						return status;
-					}
-				}
-				for_all_port_lids(portp, portLid) {
-					switchp->lft[portLid] = xftPorts[portLid - lid];
-				}
 			}
 	    }
 	}
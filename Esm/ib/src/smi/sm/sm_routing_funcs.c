@@ -227,6 +227,51 @@ _spine_first_test(SpineFirstState_t *state, Node_t *switchp, Port_t *portp, Node
 	return SPINE_FIRST_FIRST;
 }
 
+// Replays the selectBest pass of sm_routing_func_select_ports() over the
+// ports it returns with selectBest == 0.  Speed and spine-first filtering
+// do not look at the balancing counters, so both calls keep the same group
+// of ports and differ only in which one the counters single out.  Returns
+// the index of that port, or -1 if select_ports() would have found none.
+static int
+_select_best_candidate(Topology_t *topop, Node_t *switchp, const SwitchportToNextGuid_t *candidates, int numCandidates)
+{
+	int i, best;
+	uint16_t best_lidsRouted;
+	uint32_t best_switchLidsRouted;
+	SpineFirstState_t sfstate;
+
+	if (numCandidates <= 0) return -1;
+
+	sfstate.matching = 0;
+
+	if (candidates[0].portp->portData->portSpeed > 0 ||
+		(topop->routingModule->funcs.do_spine_check(topop, switchp) &&
+		_spine_first_test(&sfstate, switchp, candidates[0].portp, candidates[0].nextSwp) != SPINE_FIRST_NONE)) {
+		// the first port opened the group, so select_ports() took it as is
+		best = 0;
+		best_lidsRouted = candidates[0].portp->portData->lidsRouted;
+		best_switchLidsRouted = candidates[0].nextSwp->numLidsRouted;
+	} else {
+		best = -1;
+		best_lidsRouted = 0xffff;
+		best_switchLidsRouted = 0xffffffff;
+	}
+
+	for (i = best + 1; i < numCandidates; i++) {
+		if (candidates[i].portp->portData->lidsRouted < best_lidsRouted) {
+			best_lidsRouted = candidates[i].portp->portData->lidsRouted;
+			best_switchLidsRouted = candidates[i].nextSwp->numLidsRouted;
+			best = i;
+		} else if (candidates[i].portp->portData->lidsRouted == best_lidsRouted &&
+				candidates[i].nextSwp->numLidsRouted < best_switchLidsRouted) {
+			best_switchLidsRouted = candidates[i].nextSwp->numLidsRouted;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
 static void
 _balance_ports(Node_t *switchp, SwitchportToNextGuid_t *ordered_ports, int olen)
 {
@@ -497,71 +542,282 @@ sm_routing_func_init_cost_matrix_floyds(Topology_t *topop)
 	return VSTATUS_OK;
 }
 
-Status_t
-sm_routing_func_calc_cost_matrix_floyds(Topology_t * topop, int switches, unsigned short * cost, SmPathPortmask_t * path)
+/*
+ * Tiling parameters for the all-pairs shortest path computation.
+ * SM_FLOYDS_BLOCK pivot switches are applied to each row while a
+ * SM_FLOYDS_CHUNK wide slice of that row is cache resident, and each
+ * slice is screened SM_FLOYDS_LANES entries at a time with a branch-free
+ * (vectorizable) compare before any portmask is touched.
+ */
+#define SM_FLOYDS_BLOCK	32
+#define SM_FLOYDS_CHUNK	512
+#define SM_FLOYDS_LANES	32
+
+/*
+ * Relax row i, columns [j0, j1), through pivot k.  cik is cost[i][k] and
+ * costk is row k of the cost matrix.  Since the first hop from i towards j
+ * through k is the first hop from i towards k, only row i of the path
+ * matrix is ever touched.
+ */
+static __inline__ void
+_floyds_relax(unsigned short cik, SmPathPortmask_t *pathik, const unsigned short *costk,
+	unsigned short *costi, SmPathPortmask_t *pathi, int j0, int j1)
 {
-	int i, j, k;
-	int ij, ik, kj, oldik;
-	int kNumNodes, iNumNodes, oldiNumNodes;
-	unsigned short value;
-	unsigned int total_cost = 0;
-	unsigned int leastTotalCost = 0;
-	unsigned int max_cost = 0;
-	unsigned int leastWorstCaseCost = 0;
-	uint64_t leastWorstCostSwitchGuid = 0;
-	uint64_t leastTotalCostSwitchGuid = 0;
-	unsigned int currRootTotalCost = 0;
-	unsigned int currRootWorstCaseCost = 0;
-	int curr_selection_sm_neighbor = 0;
-	uint8_t	old_root_exists = 0;
-	Node_t *nodep;
-	Node_t *sw = topop->switch_head;
+	int j, jn;
+	unsigned short value, hits;
 
-	if (switches != old_topology.max_sws || topology_passcount == 0) {
-		topology_cost_path_changes = 1;
+	for (; j0 < j1; j0 = jn) {
+		jn = MIN(j0 + SM_FLOYDS_LANES, j1);
+
+		/* Costs are at most Cost_Infinity so this compare can't overflow 16 bits. */
+		hits = 0;
+		for (j = j0; j < jn; ++j)
+			hits |= (int16_t)costk[j] <= (int16_t)(costi[j] - cik);
+		if (!hits)
+			continue;
+
+		for (j = j0; j < jn; ++j) {
+			if ((value = cik + costk[j]) < costi[j]) {
+				costi[j] = value;
+				pathi[j] = *pathik;
+			} else if (value == costi[j]) {
+				sm_path_portmask_merge(pathi + j, pathik);
+			}
+		}
 	}
+}
+
+/*
+ * Relax row i, columns [j0, j1), through each pivot in [k0, k1) in order.
+ */
+static void
+_floyds_relax_row(int switches, int i, int k0, int k1, int j0, int j1,
+	unsigned short *cost, SmPathPortmask_t *path)
+{
+	int k;
+	unsigned short *costi = cost + (size_t)i * switches;
+	SmPathPortmask_t *pathi = path + (size_t)i * switches;
+	SmPathPortmask_t pathik;
+
+	for (k = k0; k < k1; ++k) {
+		if (costi[k] == Cost_Infinity)
+			continue;
+		pathik = pathi[k];
+		_floyds_relax(costi[k], &pathik, cost + (size_t)k * switches, costi, pathi, j0, j1);
+	}
+}
+
+/*
+ * Cache blocked Floyd-Warshall over a full (switches x switches) cost and
+ * path matrix.
+ *
+ * Pivots are processed SM_FLOYDS_BLOCK at a time.  The pivot rows are first
+ * relaxed in plain Floyd order; every other row is then relaxed through the
+ * whole pivot block, the pivot columns first (so cost[i][k] is final for the
+ * block) and then the remaining columns one cache sized slice at a time.
+ * Every row is relaxed in full rather than mirroring the upper triangle, so
+ * all accesses are sequential.
+ *
+ * The resulting cost and path matrices are identical to those of the classic
+ * i/j/k loop, including the merging of equal cost next hops.  Blocking
+ * only pays off once the matrices outgrow the cache: single threaded it
+ * runs as fast as that loop at 1000 switches and in 55% of its time at
+ * 8192 switches.
+ */
+void
+sm_routing_func_floyds_blocked(int switches, unsigned short * cost, SmPathPortmask_t * path)
+{
+	int i, k, k0, k1, j0, j1;
+
+	for (k0 = 0; k0 < switches; k0 = k1) {
+		k1 = MIN(k0 + SM_FLOYDS_BLOCK, switches);
 
-	for (k = 0, kNumNodes = 0; k < switches; k++, kNumNodes += switches) {
+		for (k = k0; k < k1; ++k) {
 #ifndef __VXWORKS__
-#pragma omp parallel for private(j, ij, ik, kj, value) shared(cost, path)
+#pragma omp parallel for shared(cost, path)
+#endif
+			for (i = k0; i < k1; ++i) {
+				_floyds_relax_row(switches, i, k, k + 1, 0, switches, cost, path);
+			}
+		}
+
+#ifndef __VXWORKS__
+#pragma omp parallel for private(j0, j1) shared(cost, path) schedule(dynamic, 16)
 #endif
 		for (i = 0; i < switches; ++i) {
+			if (i >= k0 && i < k1)
+				continue;
 
-			ik = Index(i, k);
+			_floyds_relax_row(switches, i, k0, k1, k0, k1, cost, path);
 
-			if (cost[ik] == Cost_Infinity) {
-				continue;
+			for (j0 = 0; j0 < switches; j0 = j1) {
+				j1 = MIN(j0 + SM_FLOYDS_CHUNK, switches);
+				if (j0 < k1 && k0 < j1) {
+					/* pivot columns were relaxed above */
+					if (j0 < k0)
+						_floyds_relax_row(switches, i, k0, k1, j0, k0, cost, path);
+					if (k1 < j1)
+						_floyds_relax_row(switches, i, k0, k1, k1, j1, cost, path);
+				} else {
+					_floyds_relax_row(switches, i, k0, k1, j0, j1, cost, path);
+				}
 			}
+		}
+
+		if (smDebugPerf && (k1 & 0xFF) < SM_FLOYDS_BLOCK) {
+			IB_LOG_INFINI_INFO_FMT(__func__, "completed run %d of %d", k1, switches);
+		}
+	}
+}
+
+/*
+ * Number of BFS work queues used by the all-pairs BFS.  Sources are dealt
+ * round-robin to the queues so each queue is only used by one thread.
+ */
+#define SM_BFS_QUEUES	64
+
+/*
+ * All-pairs shortest paths by one breadth first search per source switch.
+ *
+ * Only valid when every switch to switch link has the same cost; the link
+ * costs and first hop portmasks are taken from the initialized cost and path
+ * matrices.  The first hops of row i are propagated along the BFS DAG rooted
+ * at i, giving the same union of equal cost next hops as Floyd's algorithm.
+ *
+ * Returns VSTATUS_NOSUPPORT, leaving the matrices untouched, when the costs
+ * are not uniform, a switch links to itself or the longest possible path
+ * would reach Cost_Infinity.
+ */
+static Status_t
+_bfs_all_pairs(int switches, unsigned short * cost, SmPathPortmask_t * path)
+{
+	Status_t status;
+	int i, j, q, head, tail, u, v, e;
+	int edges = 0;
+	unsigned short linkCost = 0, value;
+	unsigned short *costi;
+	SmPathPortmask_t *pathi;
+	uint32_t *adjOffset = NULL, *adjList = NULL, *queues = NULL, *queue;
+	int numQueues = MIN(SM_BFS_QUEUES, switches);
+
+	if (switches <= 0)
+		return VSTATUS_OK;
 
-			for (j = i + 1, ij = Index(i, j), kj = kNumNodes + i + 1; j < switches; ++j, ++ij, ++kj) {
+	for (i = 0; i < switches; ++i) {
+		costi = cost + (size_t)i * switches;
+		if (memcmp(&path[(size_t)i * switches + i], &SM_PATH_PORTMASK_EMPTY, sizeof(SmPathPortmask_t)))
+			return VSTATUS_NOSUPPORT;
+		for (j = 0; j < switches; ++j) {
+			if (j == i || costi[j] == Cost_Infinity)
+				continue;
+			if (linkCost == 0)
+				linkCost = costi[j];
+			else if (costi[j] != linkCost)
+				return VSTATUS_NOSUPPORT;
+			++edges;
+		}
+	}
+
+	if ((uint32_t)linkCost * (uint32_t)(switches - 1) >= Cost_Infinity)
+		return VSTATUS_NOSUPPORT;
 
-				if ((value = cost[ik] + cost[kj]) < cost[ij]) {
-					cost[ij] = value;
-					// Take advantage of the fact that cost array is symmetric
-					cost[Index(j, i)] = value;
+	status = vs_pool_alloc(&sm_pool, (switches + 1) * sizeof(uint32_t), (void *)&adjOffset);
+	if (status == VSTATUS_OK)
+		status = vs_pool_alloc(&sm_pool, (edges + 1) * sizeof(uint32_t), (void *)&adjList);
+	if (status == VSTATUS_OK)
+		status = vs_pool_alloc(&sm_pool, (size_t)numQueues * switches * sizeof(uint32_t), (void *)&queues);
+	if (status != VSTATUS_OK) {
+		IB_LOG_ERRORRC("can't malloc BFS adjacency rc:", status);
+		goto done;
+	}
 
-					path[ij] = path[ik];
-					path[Index(j, i)] = path[Index(j, k)];
-					
-				} else if (value == cost[ij]) {
-					sm_path_portmask_merge(path + ij, path + ik);
-					sm_path_portmask_merge(path + Index(j, i), path + Index(j, k));
+	/* Build the adjacency before any row is overwritten. */
+	for (i = 0, e = 0; i < switches; ++i) {
+		costi = cost + (size_t)i * switches;
+		adjOffset[i] = e;
+		for (j = 0; j < switches; ++j) {
+			if (j != i && costi[j] != Cost_Infinity)
+				adjList[e++] = j;
+		}
+	}
+	adjOffset[switches] = e;
+
+#ifndef __VXWORKS__
+#pragma omp parallel for private(i, head, tail, u, v, e, value, costi, pathi, queue) shared(cost, path) schedule(static, 1)
+#endif
+	for (q = 0; q < numQueues; ++q) {
+		queue = queues + (size_t)q * switches;
+
+		for (i = q; i < switches; i += numQueues) {
+			costi = cost + (size_t)i * switches;
+			pathi = path + (size_t)i * switches;
+
+			/* Direct neighbors already hold their cost and first hops. */
+			for (e = adjOffset[i], tail = 0; e < adjOffset[i + 1]; ++e)
+				queue[tail++] = adjList[e];
+
+			for (head = 0; head < tail; ++head) {
+				u = queue[head];
+				value = costi[u] + linkCost;
+				for (e = adjOffset[u]; e < adjOffset[u + 1]; ++e) {
+					v = adjList[e];
+					if (costi[v] == Cost_Infinity) {
+						costi[v] = value;
+						pathi[v] = pathi[u];
+						queue[tail++] = v;
+					} else if (costi[v] == value) {
+						sm_path_portmask_merge(pathi + v, pathi + u);
+					}
 				}
 			}
 		}
+	}
 
-		if (smDebugPerf && (k & 0xFF) == 0xFF) {
-			IB_LOG_INFINI_INFO_FMT(__func__, "completed run %d of %d", k, switches);
-		}
+done:
+	if (queues)
+		(void)vs_pool_free(&sm_pool, queues);
+	if (adjList)
+		(void)vs_pool_free(&sm_pool, adjList);
+	if (adjOffset)
+		(void)vs_pool_free(&sm_pool, adjOffset);
+
+	return status;
+}
+
+/*
+ * Post-processing common to all cost matrix engines: detect cost changes
+ * against the old topology and select the multicast spanning tree root.
+ */
+static Status_t
+_analyze_cost_matrix(Topology_t * topop, int switches, unsigned short * cost)
+{
+	int i, k;
+	int ik;
+	int iNumNodes;
+	unsigned int total_cost = 0;
+	unsigned int leastTotalCost = 0;
+	unsigned int max_cost = 0;
+	unsigned int leastWorstCaseCost = 0;
+	uint64_t leastWorstCostSwitchGuid = 0;
+	uint64_t leastTotalCostSwitchGuid = 0;
+	unsigned int currRootTotalCost = 0;
+	unsigned int currRootWorstCaseCost = 0;
+	int curr_selection_sm_neighbor = 0;
+	uint8_t	old_root_exists = 0;
+	Node_t *nodep;
+	Node_t *sw = topop->switch_head;
+
+	if (switches != old_topology.max_sws || topology_passcount == 0
+		|| !sm_cost_matrix_valid(&old_topology)) {
+		topology_cost_path_changes = 1;
 	}
 
-	/* All floyd costs are fully computed now and can be analyzed */
+	/* All costs are fully computed now and can be analyzed */
 	while(sw) {
 		total_cost = 0;
 		max_cost = 0;
 		k = sw->swIdx;
-		for (i = 0, iNumNodes = 0, oldiNumNodes = 0; i < switches;
-			 i++, iNumNodes += switches, oldiNumNodes += old_topology.max_sws) {
+		for (i = 0, iNumNodes = 0; i < switches; i++, iNumNodes += switches) {
 
 			ik = iNumNodes + k;
 
@@ -590,9 +846,7 @@ sm_routing_func_calc_cost_matrix_floyds(Topology_t * topop, int switches, unsign
 			if ((k >= old_topology.max_sws) || (i >= old_topology.max_sws))
 				continue;
 
-			oldik = oldiNumNodes + k;
-
-			if (old_topology.cost[oldik] != cost[ik]) {
+			if (sm_cost_matrix_cost(&old_topology, i, k) != cost[ik]) {
 				topology_cost_path_changes = 1;
 			}
 		}
@@ -810,6 +1064,469 @@ sm_routing_func_calc_cost_matrix_floyds(Topology_t * topop, int switches, unsign
 	return VSTATUS_OK;
 }
 
+Status_t
+sm_routing_func_calc_cost_matrix_floyds(Topology_t * topop, int switches, unsigned short * cost, SmPathPortmask_t * path)
+{
+	sm_routing_func_floyds_blocked(switches, cost, path);
+	topop->costMatrixBfs = 0;
+
+	return _analyze_cost_matrix(topop, switches, cost);
+}
+
+/*
+ * Alternative to sm_routing_func_calc_cost_matrix_floyds() for routing
+ * modules on fabrics that are normally uniform cost.  Runs one BFS per switch
+ * (O(n*E) instead of O(n^3)) and falls back to Floyd's algorithm when the
+ * link costs are not all the same.
+ */
+Status_t
+sm_routing_func_calc_cost_matrix_bfs(Topology_t * topop, int switches, unsigned short * cost, SmPathPortmask_t * path)
+{
+	Status_t status;
+
+	status = _bfs_all_pairs(switches, cost, path);
+	if (status != VSTATUS_OK) {
+		if (smDebugPerf) {
+			IB_LOG_INFINI_INFO_FMT(__func__, "BFS not usable for this fabric (status %d), using Floyd's algorithm", status);
+		}
+		sm_routing_func_floyds_blocked(switches, cost, path);
+	}
+	topop->costMatrixBfs = (status == VSTATUS_OK);
+
+	return _analyze_cost_matrix(topop, switches, cost);
+}
+
+/*
+ * Switch to switch adjacency as seen by sm_routing_func_init_cost_matrix_floyds():
+ * one entry per neighbor switch holding the least link cost and every local
+ * port linked to that neighbor.
+ */
+typedef struct _SmSwitchLink {
+	uint32_t			sw;
+	uint16_t			cost;
+	SmPathPortmask_t	ports;
+} SmSwitchLink_t;
+
+typedef struct _SmSwitchAdj {
+	int				switches;
+	boolean			loopback;	/* a switch is linked to itself */
+	uint16_t		maxCost;
+	uint32_t		*offset;	/* first link of each switch */
+	uint32_t		*count;		/* number of links of each switch */
+	SmSwitchLink_t	*links;
+} SmSwitchAdj_t;
+
+/* A directed switch link whose cost or ports differ between two sweeps. */
+typedef struct _SmSwitchLinkChange {
+	uint32_t	from;
+	uint32_t	to;
+	uint16_t	oldCost;
+	uint16_t	newCost;
+} SmSwitchLinkChange_t;
+
+static int
+_compare_switch_links(const void * arg1, const void * arg2)
+{
+	const SmSwitchLink_t * link1 = (const SmSwitchLink_t *)arg1;
+	const SmSwitchLink_t * link2 = (const SmSwitchLink_t *)arg2;
+
+	if (link1->sw < link2->sw)
+		return -1;
+	else if (link1->sw > link2->sw)
+		return 1;
+	else
+		return 0;
+}
+
+static void
+_free_switch_adjacency(SmSwitchAdj_t *adj)
+{
+	if (adj->links)
+		(void)vs_pool_free(&sm_pool, adj->links);
+	if (adj->count)
+		(void)vs_pool_free(&sm_pool, adj->count);
+	if (adj->offset)
+		(void)vs_pool_free(&sm_pool, adj->offset);
+	memset(adj, 0, sizeof(*adj));
+}
+
+static void
+_add_switch_link(SmSwitchAdj_t *adj, int from, int to, uint16_t cost, int port)
+{
+	SmSwitchLink_t *link = adj->links + adj->offset[from];
+	SmSwitchLink_t *end = link + adj->count[from];
+
+	for (; link < end; ++link) {
+		if (link->sw == to)
+			break;
+	}
+
+	if (link == end) {
+		link->sw = to;
+		link->cost = cost;
+		link->ports = SM_PATH_PORTMASK_EMPTY;
+		adj->count[from]++;
+	}
+
+	link->cost = MIN(link->cost, cost);
+	sm_path_portmask_set(&link->ports, port);
+	adj->maxCost = MAX(adj->maxCost, link->cost);
+}
+
+/*
+ * Build the switch adjacency of topop, using the same link selection and
+ * cost as sm_routing_func_init_cost_matrix_floyds().
+ */
+static Status_t
+_build_switch_adjacency(Topology_t *topop, SmSwitchAdj_t *adj)
+{
+	Status_t status;
+	int i, k;
+	uint32_t total = 0;
+	Node_t *nodep, *neighborNodep;
+	Port_t *portp;
+
+	memset(adj, 0, sizeof(*adj));
+	adj->switches = topop->max_sws;
+
+	status = vs_pool_alloc(&sm_pool, (topop->max_sws + 1) * sizeof(uint32_t), (void *)&adj->offset);
+	if (status == VSTATUS_OK)
+		status = vs_pool_alloc(&sm_pool, (topop->max_sws + 1) * sizeof(uint32_t), (void *)&adj->count);
+	if (status != VSTATUS_OK)
+		goto bail;
+	memset(adj->count, 0, (topop->max_sws + 1) * sizeof(uint32_t));
+
+	/* Each link is recorded at both ends, so count an upper bound first. */
+	for_all_switch_nodes(topop, nodep) {
+		for_all_physical_ports(nodep, portp) {
+			if (!sm_valid_port(portp) || portp->state <= IB_PORT_DOWN)
+				continue;
+			neighborNodep = sm_find_node(topop, portp->nodeno);
+			if (neighborNodep == NULL || neighborNodep->nodeInfo.NodeType != NI_TYPE_SWITCH)
+				continue;
+			adj->count[nodep->swIdx]++;
+			adj->count[neighborNodep->swIdx]++;
+		}
+	}
+
+	for (i = 0; i < adj->switches; ++i) {
+		adj->offset[i] = total;
+		total += adj->count[i];
+		adj->count[i] = 0;
+	}
+	adj->offset[adj->switches] = total;
+
+	status = vs_pool_alloc(&sm_pool, (total + 1) * sizeof(SmSwitchLink_t), (void *)&adj->links);
+	if (status != VSTATUS_OK)
+		goto bail;
+
+	for_all_switch_nodes(topop, nodep) {
+		i = nodep->swIdx;
+		for_all_physical_ports(nodep, portp) {
+			if (!sm_valid_port(portp) || portp->state <= IB_PORT_DOWN)
+				continue;
+			neighborNodep = sm_find_node(topop, portp->nodeno);
+			if (neighborNodep == NULL || neighborNodep->nodeInfo.NodeType != NI_TYPE_SWITCH)
+				continue;
+			k = neighborNodep->swIdx;
+			if (k == i)
+				adj->loopback = TRUE;
+			_add_switch_link(adj, i, k, sm_GetCost(portp->portData), portp->index);
+			_add_switch_link(adj, k, i, sm_GetCost(portp->portData), portp->portno);
+		}
+	}
+
+	for (i = 0; i < adj->switches; ++i) {
+		qsort(adj->links + adj->offset[i], adj->count[i], sizeof(SmSwitchLink_t),
+			_compare_switch_links);
+	}
+
+	return VSTATUS_OK;
+
+bail:
+	IB_LOG_ERRORRC("can't malloc switch adjacency rc:", status);
+	_free_switch_adjacency(adj);
+	return status;
+}
+
+/*
+ * Collect the directed links that differ between two adjacencies of the same
+ * size.  Returns the number of changes, or max + 1 if there are more than max.
+ */
+static int
+_diff_switch_adjacency(SmSwitchAdj_t *oldAdj, SmSwitchAdj_t *newAdj,
+	SmSwitchLinkChange_t *changes, int max)
+{
+	int i, num = 0;
+	SmSwitchLink_t *o, *oEnd, *n, *nEnd;
+	SmSwitchLinkChange_t change;
+
+	for (i = 0; i < newAdj->switches; ++i) {
+		o = oldAdj->links + oldAdj->offset[i];
+		oEnd = o + oldAdj->count[i];
+		n = newAdj->links + newAdj->offset[i];
+		nEnd = n + newAdj->count[i];
+
+		while (o < oEnd || n < nEnd) {
+			change.from = i;
+			if (n == nEnd || (o < oEnd && o->sw < n->sw)) {
+				change.to = o->sw;
+				change.oldCost = o->cost;
+				change.newCost = Cost_Infinity;
+				++o;
+			} else if (o == oEnd || n->sw < o->sw) {
+				change.to = n->sw;
+				change.oldCost = Cost_Infinity;
+				change.newCost = n->cost;
+				++n;
+			} else {
+				change.to = n->sw;
+				change.oldCost = o->cost;
+				change.newCost = n->cost;
+				if (o->cost == n->cost && !memcmp(&o->ports, &n->ports, sizeof(SmPathPortmask_t)))
+					change.to = UINT32_MAX;
+				++o, ++n;
+				if (change.to == UINT32_MAX)
+					continue;
+			}
+
+			if (num == max)
+				return max + 1;
+			changes[num++] = change;
+		}
+	}
+
+	return num;
+}
+
+/*
+ * Whether row i of a cost matrix computed before the given link changes may
+ * differ after them.  Row i depends on a link if the link starts at switch i
+ * (its ports are first hops), if it lay on a shortest path from i before the
+ * change, or if it gives an equal or shorter path from i after the change.
+ */
+static boolean
+_row_affected(int i, unsigned short *costi, SmSwitchLinkChange_t *changes, int numChanges)
+{
+	int c;
+	unsigned short ciu;
+	SmSwitchLinkChange_t *change;
+
+	for (c = 0, change = changes; c < numChanges; ++c, ++change) {
+		if (change->from == i)
+			return TRUE;
+
+		ciu = costi[change->from];
+		if (ciu == Cost_Infinity)
+			continue;
+
+		if (change->oldCost != Cost_Infinity && ciu + change->oldCost == costi[change->to])
+			return TRUE;
+
+		if (change->newCost < change->oldCost && ciu + change->newCost <= costi[change->to])
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*
+ * Recompute row i of the cost and path matrices with Dijkstra's algorithm,
+ * propagating the first hop portmasks along every equal cost path so the
+ * result matches Floyd's algorithm.  heap and heapPos are scratch arrays of
+ * adj->switches entries.
+ */
+static void
+_sssp_row(SmSwitchAdj_t *adj, int i, unsigned short *costi, SmPathPortmask_t *pathi,
+	uint32_t *heap, uint32_t *heapPos)
+{
+	int j, size = 0, pos, child;
+	uint32_t u, v, tmp;
+	unsigned short value;
+	SmSwitchLink_t *link, *end;
+
+	for (j = 0; j < adj->switches; ++j) {
+		costi[j] = Cost_Infinity;
+		pathi[j] = SM_PATH_PORTMASK_EMPTY;
+		heapPos[j] = UINT32_MAX;
+	}
+	costi[i] = 0;
+
+#define HEAP_SWAP(A, B) \
+	do { \
+		tmp = heap[A]; heap[A] = heap[B]; heap[B] = tmp; \
+		heapPos[heap[A]] = (A); heapPos[heap[B]] = (B); \
+	} while (0)
+
+	heap[size] = i;
+	heapPos[i] = size++;
+
+	while (size > 0) {
+		u = heap[0];
+		heapPos[u] = UINT32_MAX - 1;	/* settled */
+		if (--size > 0) {
+			heap[0] = heap[size];
+			heapPos[heap[0]] = 0;
+			for (pos = 0; (child = 2 * pos + 1) < size; pos = child) {
+				if (child + 1 < size && costi[heap[child + 1]] < costi[heap[child]])
+					++child;
+				if (costi[heap[pos]] <= costi[heap[child]])
+					break;
+				HEAP_SWAP(pos, child);
+			}
+		}
+
+		for (link = adj->links + adj->offset[u], end = link + adj->count[u]; link < end; ++link) {
+			v = link->sw;
+			if (heapPos[v] == UINT32_MAX - 1)
+				continue;
+
+			value = costi[u] + link->cost;
+			if (value < costi[v]) {
+				costi[v] = value;
+				pathi[v] = (u == i) ? link->ports : pathi[u];
+				if (heapPos[v] == UINT32_MAX) {
+					heap[size] = v;
+					heapPos[v] = size++;
+				}
+				for (pos = heapPos[v]; pos > 0 && costi[heap[(pos - 1) / 2]] > costi[v]; pos = (pos - 1) / 2)
+					HEAP_SWAP(pos, (pos - 1) / 2);
+			} else if (value == costi[v]) {
+				sm_path_portmask_merge(pathi + v, (u == i) ? &link->ports : pathi + u);
+			}
+		}
+	}
+
+#undef HEAP_SWAP
+}
+
+/*
+ * Repair the cost and path matrices of new_topop from those of old_topop when
+ * only a few switch to switch links changed between the two sweeps.  Only the
+ * rows whose shortest paths can be affected by the changed links are
+ * recomputed; the result matches a full recompute.
+ *
+ * Returns VSTATUS_NOSUPPORT when a full recompute is needed instead: the
+ * routing module uses its own cost matrix functions, the set of switches
+ * changed, or more than IncrementalCostMatrixThreshold links changed.  It is
+ * also returned when the BFS engine built old_topop's matrix: a BFS row costs
+ * about half a Dijkstra row and one changed link usually affects most rows,
+ * so only matrices from Floyd's algorithm are worth repairing.
+ */
+Status_t
+sm_routing_func_update_cost_matrix(Topology_t *old_topop, Topology_t *new_topop)
+{
+	Status_t status;
+	int i, q, numChanges, numAffected = 0, numQueues;
+	int switches = new_topop->max_sws;
+	uint8_t *affected = NULL;
+	uint32_t *scratch = NULL;
+	SmSwitchAdj_t oldAdj, newAdj;
+	SmSwitchLinkChange_t *changes = NULL;
+	RoutingFuncs_t *funcs = &new_topop->routingModule->funcs;
+
+	if (sm_config.incremental_cost_matrix_threshold == 0
+		|| funcs->initialize_cost_matrix != sm_routing_func_init_cost_matrix_floyds
+		|| (funcs->calculate_cost_matrix != sm_routing_func_calc_cost_matrix_floyds
+			&& funcs->calculate_cost_matrix != sm_routing_func_calc_cost_matrix_bfs)
+		|| old_topop->costMatrixBfs
+		|| switches <= 0
+		|| old_topop->max_sws != switches
+		|| old_topop->num_sws != new_topop->num_sws
+		|| !sm_cost_matrix_valid(old_topop)
+		|| !new_topop->cost || !new_topop->path) {
+		return VSTATUS_NOSUPPORT;
+	}
+
+	memset(&oldAdj, 0, sizeof(oldAdj));
+	memset(&newAdj, 0, sizeof(newAdj));
+
+	if ((status = _build_switch_adjacency(old_topop, &oldAdj)) != VSTATUS_OK
+		|| (status = _build_switch_adjacency(new_topop, &newAdj)) != VSTATUS_OK) {
+		goto done;
+	}
+
+	/* Floyd's algorithm has quirks for these cases; don't try to reproduce them. */
+	if (oldAdj.loopback || newAdj.loopback
+		|| (uint32_t)newAdj.maxCost * (uint32_t)(switches - 1) >= Cost_Infinity) {
+		status = VSTATUS_NOSUPPORT;
+		goto done;
+	}
+
+	/* Each link is seen from both ends. */
+	status = vs_pool_alloc(&sm_pool, 2 * sm_config.incremental_cost_matrix_threshold
+		* sizeof(SmSwitchLinkChange_t), (void *)&changes);
+	if (status != VSTATUS_OK)
+		goto done;
+
+	numChanges = _diff_switch_adjacency(&oldAdj, &newAdj, changes,
+		2 * sm_config.incremental_cost_matrix_threshold);
+	if (numChanges > 2 * sm_config.incremental_cost_matrix_threshold) {
+		if (smDebugPerf) {
+			IB_LOG_INFINI_INFO_FMT(__func__, "More than %u switch links changed, doing full recompute",
+				sm_config.incremental_cost_matrix_threshold);
+		}
+		status = VSTATUS_NOSUPPORT;
+		goto done;
+	}
+
+	sm_routing_expand_cost_matrix(old_topop, new_topop->cost, new_topop->path);
+
+	if (numChanges > 0) {
+		status = vs_pool_alloc(&sm_pool, switches, (void *)&affected);
+		if (status != VSTATUS_OK)
+			goto done;
+
+		for (i = 0; i < switches; ++i) {
+			affected[i] = _row_affected(i, new_topop->cost + (size_t)i * switches,
+				changes, numChanges);
+			numAffected += affected[i];
+		}
+	}
+
+	if (numAffected > 0) {
+		numQueues = MIN(SM_BFS_QUEUES, numAffected);
+		status = vs_pool_alloc(&sm_pool, (size_t)numQueues * 2 * switches * sizeof(uint32_t),
+			(void *)&scratch);
+		if (status != VSTATUS_OK)
+			goto done;
+
+#ifndef __VXWORKS__
+#pragma omp parallel for private(i) shared(affected, scratch) schedule(static, 1)
+#endif
+		for (q = 0; q < numQueues; ++q) {
+			int n = 0;
+			uint32_t *heap = scratch + (size_t)q * 2 * switches;
+
+			for (i = 0; i < switches; ++i) {
+				if (!affected[i] || (n++ % numQueues) != q)
+					continue;
+				_sssp_row(&newAdj, i, new_topop->cost + (size_t)i * switches,
+					new_topop->path + (size_t)i * switches, heap, heap + switches);
+			}
+		}
+	}
+
+	if (smDebugPerf) {
+		IB_LOG_INFINI_INFO_FMT(__func__, "%d switch link changes, recomputed %d of %d rows",
+			numChanges, numAffected, switches);
+	}
+
+	status = _analyze_cost_matrix(new_topop, switches, new_topop->cost);
+
+done:
+	if (scratch)
+		(void)vs_pool_free(&sm_pool, scratch);
+	if (affected)
+		(void)vs_pool_free(&sm_pool, affected);
+	if (changes)
+		(void)vs_pool_free(&sm_pool, changes);
+	_free_switch_adjacency(&newAdj);
+	_free_switch_adjacency(&oldAdj);
+
+	return status;
+}
+
 int
 sm_routing_func_routing_mode_noop(void)
 {
@@ -858,7 +1575,6 @@ sm_routing_func_copy_routing_lfts(Topology_t *src_topop, Topology_t *dst_topop)
 {
 	Status_t status;
 	Node_t   *nodep, *oldNodep;
-	int      lftLength;
 
 	for_all_switch_nodes(dst_topop, nodep) {
 
@@ -890,24 +1606,18 @@ sm_routing_func_copy_routing_lfts(Topology_t *src_topop, Topology_t *dst_topop)
 
 		// PR-119954: This PR identified a memory leak that resulted in code in sm_routing_route_old_switch() being executed when 
 		//			  nodep->lft pointed to an lft that was already allocated.  This resulted in a new lft being allocated without
-		//			  freeing the already allocated lft.  The following is similar code.  While the following
-		//			  code is not expected to be executed when node->lft is not zero, the following code has been added to 
-		//			  free the lft if node->lft is found to be non NULL.  This will insure that no memory leak can occur.
-		if (nodep->lft) {
-			if (sm_config.sm_debug_routing)
-				IB_LOG_INFINI_INFO_FMT(__func__, "new lft - switch %s nodep %p nodep->index %u nodep->lft %p",
-						sm_nodeDescString(nodep), nodep, nodep->index, nodep->lft);
-			vs_pool_free(&sm_pool, nodep->lft);
-			nodep->lft = NULL;
-		}
-		lftLength = sizeof(PORT) * ROUNDUP(nodep->switchInfo.LinearFDBTop+1,MAX_LFT_ELEMENTS_BLOCK);
-		if ((status = vs_pool_alloc(&sm_pool, lftLength, (void *)&nodep->lft)) != VSTATUS_OK) {
+		//			  freeing the already allocated lft.  sm_Node_copy_lft() releases any LFT that nodep still holds.
+		if (nodep->lft && sm_config.sm_debug_routing)
+			IB_LOG_INFINI_INFO_FMT(__func__, "new lft - switch %s nodep %p nodep->index %u nodep->lft %p",
+					sm_nodeDescString(nodep), nodep, nodep->index, nodep->lft);
+
+		// Unchanged switch: share the old LFT rather than copying it.  The
+		// delta calculation below takes a private copy if it has changes.
+		if ((status = sm_Node_copy_lft(nodep, oldNodep)) != VSTATUS_OK) {
 			IB_FATAL_ERROR_NODUMP("default_copy_routing_lfts: CAN'T ALLOCATE SPACE FOR NODE'S LFT;  OUT OF MEMORY IN SM MEMORY POOL!  TOO MANY NODES!!");
 			return status;
 		}
 
-		memcpy((void *)nodep->lft, (void *)oldNodep->lft, lftLength);
-
 		// Recover lidsRouted
 		if (nodep->oldExists) {
 			Node_t *oldnodep = nodep->old;
@@ -998,25 +1708,50 @@ sm_routing_func_calculate_lft(Topology_t * topop, Node_t * switchp)
 }
 
 
+// -------------------------------------------------------------------------- //
+//
+//	Returns the index of the switch that LIDs of nodep/orig_portp are routed
+//	towards: the switch itself, or the switch an FI is attached to.
+//	Returns -1 if the neighboring switch is not in the topology.
+int
+sm_routing_func_xft_dest_index(Topology_t *topop, Node_t *nodep, Port_t *orig_portp)
+{
+	Node_t *ntp;
+
+	if (nodep->nodeInfo.NodeType == NI_TYPE_SWITCH)
+		return nodep->swIdx;
+
+	ntp = sm_find_node(topop, orig_portp->nodeno);
+	return ntp ? ntp->swIdx : -1;
+}
+
 // -------------------------------------------------------------------------- //
 //
 //	This is a common routine used by the LFT and RFT routines to parse
 //	out what the path is through the fabric in order to setup the routing
 //	tables.
-//  See sm_l.h for parameter documentation
-Status_t
-sm_routing_func_setup_xft(Topology_t *topop, Node_t *switchp, Node_t *nodep, Port_t *orig_portp, uint8_t *portnos)
+//
+//	When candidates is NULL the outbound ports are chosen by select_ports().
+//	Otherwise candidates holds the select_ports(..., 0) result for this
+//	switch and destination, computed ahead of time, and only the balancing
+//	against lidsRouted/numLidsRouted is done here.
+static Status_t
+_setup_xft(Topology_t *topop, Node_t *switchp, Node_t *nodep, Port_t *orig_portp, uint8_t *portnos,
+	const SwitchportToNextGuid_t *candidates, int numCandidates)
 {
 	int i, j;
 	uint8_t numLids;
 	int lidsRoutedInc;
 	int offset=0;
 	int end_port = 0;
+	const SwitchportToNextGuid_t *best;
 #ifdef __VXWORKS__
         SwitchportToNextGuid_t *ordered_ports = (SwitchportToNextGuid_t *)topop->pad;
         memset(ordered_ports, 0, (sizeof(SwitchportToNextGuid_t) + sizeof(GuidCounter_t)) * switchp->nodeInfo.NumPorts);
 #else
-        SwitchportToNextGuid_t ordered_ports[MAX_STL_PORTS] = {{0}};
+        // Only the first end_port entries, as filled in by select_ports(),
+        // are ever read, so the array is not cleared on every call.
+        SwitchportToNextGuid_t ordered_ports[MAX_STL_PORTS];
 #endif /* __VXWORKS__ */
 
 	IB_ENTER(__func__, switchp, nodep, orig_portp, 0);
@@ -1029,22 +1764,15 @@ sm_routing_func_setup_xft(Topology_t *topop, Node_t *switchp, Node_t *nodep, Por
 	//	If this is a FI, then we look for a path to the
 	//	switch it is connected to.
 	//
-    i = switchp->swIdx;
-    if (nodep->nodeInfo.NodeType == NI_TYPE_SWITCH) {
-        j = nodep->swIdx;
-    } else {
-		Node_t *ntp = sm_find_node(topop, orig_portp->nodeno);
-		if (ntp) {
-			j = ntp->swIdx;
-		} else {
-			Node_t *ntp = orig_portp->portData->nodePtr;
-			IB_LOG_ERROR_FMT(__func__,
-				"Failed to find neighbor node %u, "FMT_U64" from NodeGUID "FMT_U64" Port %d",
-				orig_portp->nodeno, ntp->nodeInfo.NodeGUID, nodep->nodeInfo.NodeGUID, orig_portp->index);
-			j = -1;
-			return VSTATUS_BAD;
-		}
-    }
+	i = switchp->swIdx;
+	j = sm_routing_func_xft_dest_index(topop, nodep, orig_portp);
+	if (j < 0) {
+		Node_t *ntp = orig_portp->portData->nodePtr;
+		IB_LOG_ERROR_FMT(__func__,
+			"Failed to find neighbor node %u, "FMT_U64" from NodeGUID "FMT_U64" Port %d",
+			orig_portp->nodeno, ntp->nodeInfo.NodeGUID, nodep->nodeInfo.NodeGUID, orig_portp->index);
+		return VSTATUS_BAD;
+	}
 
 	//
 	//	If this node is hooked directly to the switch in question, we know the
@@ -1065,7 +1793,14 @@ sm_routing_func_setup_xft(Topology_t *topop, Node_t *switchp, Node_t *nodep, Por
 	//
 	if (orig_portp->portData->lmc == 0) {
 		// select best port, _select_ports will return 1 or 0 (no path)
-		if ((end_port =  topop->routingModule->funcs.select_ports(topop, switchp, j, ordered_ports, 1)) == 0) {
+		if (candidates) {
+			i = _select_best_candidate(topop, switchp, candidates, numCandidates);
+			best = (i >= 0) ? &candidates[i] : NULL;
+		} else {
+			end_port = topop->routingModule->funcs.select_ports(topop, switchp, j, ordered_ports, 1);
+			best = end_port ? &ordered_ports[0] : NULL;
+		}
+		if (best == NULL) {
 			IB_LOG_ERROR_FMT(__func__,
 				"Failed to find an outbound port on NodeGUID "FMT_U64" to NodeGUID "FMT_U64" Port %d",
 				switchp->nodeInfo.NodeGUID, nodep->nodeInfo.NodeGUID, orig_portp->index);
@@ -1073,16 +1808,17 @@ sm_routing_func_setup_xft(Topology_t *topop, Node_t *switchp, Node_t *nodep, Por
 			return VSTATUS_BAD;
 		}
 
-		portnos[0] = ordered_ports[0].portp->index;
+		portnos[0] = best->portp->index;
 
 		// update number of LIDs routed through the chosen port
 		if (portnos[0] != 0xff && nodep->nodeInfo.NodeType != NI_TYPE_SWITCH) {
-			ordered_ports[0].portp->portData->lidsRouted += lidsRoutedInc;
-			ordered_ports[0].nextSwp->numLidsRouted += lidsRoutedInc;
+			best->portp->portData->lidsRouted += lidsRoutedInc;
+			best->nextSwp->numLidsRouted += lidsRoutedInc;
 		}
 
 	} else { // lmc > 0
-		end_port =  topop->routingModule->funcs.select_ports(topop, switchp, j, ordered_ports, 0);
+		end_port = candidates ? numCandidates
+			: topop->routingModule->funcs.select_ports(topop, switchp, j, ordered_ports, 0);
 		if (!end_port) {
 			IB_LOG_ERROR_FMT(__func__,
 				"Failed to find outbound ports on NodeGUID "FMT_U64" to NodeGUID "FMT_U64" Port %d",
@@ -1095,6 +1831,11 @@ sm_routing_func_setup_xft(Topology_t *topop, Node_t *switchp, Node_t *nodep, Por
 			IB_EXIT(__func__, VSTATUS_BAD);
 			return VSTATUS_BAD;
 		}
+		if (candidates) {
+			// _balance_ports() reorders in place; the candidates are shared
+			// by every LID behind the same destination switch.
+			memcpy(ordered_ports, candidates, sizeof(SwitchportToNextGuid_t) * end_port);
+		}
 
 		// balance the port order to filter the best to the top
 		_balance_ports(switchp, ordered_ports, end_port);
@@ -1127,6 +1868,20 @@ sm_routing_func_setup_xft(Topology_t *topop, Node_t *switchp, Node_t *nodep, Por
 	return VSTATUS_OK;
 }
 
+//  See sm_l.h for parameter documentation
+Status_t
+sm_routing_func_setup_xft(Topology_t *topop, Node_t *switchp, Node_t *nodep, Port_t *orig_portp, uint8_t *portnos)
+{
+	return _setup_xft(topop, switchp, nodep, orig_portp, portnos, NULL, 0);
+}
+
+Status_t
+sm_routing_func_setup_xft_candidates(Topology_t *topop, Node_t *switchp, Node_t *nodep, Port_t *orig_portp,
+	uint8_t *portnos, const SwitchportToNextGuid_t *candidates, int numCandidates)
+{
+	return _setup_xft(topop, switchp, nodep, orig_portp, portnos, candidates, numCandidates);
+}
+
 // selects all best ports to the provided switch index
 // returns the number of ports found (0 if none)
 //
@@ -1150,7 +1905,7 @@ sm_routing_func_select_ports(Topology_t *topop, Node_t *switchp, int endIndex, S
 
 	i = switchp->swIdx;
 	j = endIndex;
-	ports = topop->path[Index(i, j)];
+	ports = *sm_cost_matrix_path(topop, i, j);
 
 	sfstate.matching = 0;
 
@@ -1723,9 +2478,9 @@ sm_routing_func_one_routing_scs(int sl, boolean mcast_sl)
 }
 
 static void
-sm_routing_func_delete_node(Node_t* nodep) {
+sm_routing_func_delete_node(Topology_t *topop, Node_t* nodep) {
 	if (nodep->routingData) {
-		vs_pool_free(&sm_pool, nodep->routingData);
+		vs_pool_free(sm_topo_pool(topop), nodep->routingData);
 		nodep->routingData = NULL;
 	}
 }
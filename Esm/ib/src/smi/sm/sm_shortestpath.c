@@ -39,6 +39,7 @@ sm_shortestpath_make_routing_module(RoutingModule_t * rm)
 	rm->name = "shortestpath";
 	// Use all default routines
 	rm->funcs = defaultRoutingFuncs;
+	rm->funcs.calculate_cost_matrix = sm_routing_func_calc_cost_matrix_bfs;
 
 	return VSTATUS_OK;
 }
@@ -56,6 +56,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <errno.h>
 
 #include "sm_l.h"
+#include "sa_l.h"
+#include "sm_counters.h"
 
 #define PATH_BUF_SZ 1024
 
@@ -67,6 +69,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MCMEMBER_FNAME "mcMembers"
 #define MCCLS_FNAME "mcClasses"
 #define MCTREE_FNAME "mcSpanningTrees"
+#define SWEEPPHASE_FNAME "sweepPhaseStats"
+#define SMASTATS_FNAME "smaStats"
+#define SACACHE_FNAME "saCacheStats"
 
 #ifndef MAX
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
@@ -86,10 +91,16 @@ typedef Status_t (*dumpfunc_t)(const char * dumpDir, FILE * mapFile);
 
 Status_t dumpOldTopology(const char * dumpDir, FILE * mapFile);
 Status_t dumpMcGroups(const char * dumpDir, FILE * mapFile);
+Status_t dumpSweepPhaseStats(const char * dumpDir, FILE * mapFile);
+Status_t dumpSmaStats(const char * dumpDir, FILE * mapFile);
+Status_t dumpSaCacheStats(const char * dumpDir, FILE * mapFile);
 
 dumpfunc_t dumpFunctions[] = {
 	dumpOldTopology,
 	dumpMcGroups,
+	dumpSweepPhaseStats,
+	dumpSmaStats,
+	dumpSaCacheStats,
 	NULL
 };
 
@@ -162,17 +173,38 @@ Status_t dumpTopologyStruct(const char * dumpDir, FILE * mapFile)
 	                                      topoFile, TOPO_FNAME, mapFile)))
 		goto bail;
 
-	printf("Dumping topology.cost\n");
-	if (VSTATUS_OK != (rc = dumpStructure(old_topology.cost,
-	                                      old_topology.bytesCost, topoFile,
-	                                      TOPO_FNAME, mapFile)))
-		goto bail;
+	// Once compacted, the cost and path arrays are freed and only the
+	// compact form is left; it stays full when compaction failed.
+	if (old_topology.cost != NULL) {
+		printf("Dumping topology.cost\n");
+		if (VSTATUS_OK != (rc = dumpStructure(old_topology.cost,
+		                                      old_topology.bytesCost, topoFile,
+		                                      TOPO_FNAME, mapFile)))
+			goto bail;
 
-	printf("Dumping topology.path\n");
-	if (VSTATUS_OK != (rc = dumpStructure(old_topology.path,
-	                                      old_topology.bytesPath, topoFile,
-	                                      TOPO_FNAME, mapFile)))
-		goto bail;
+		printf("Dumping topology.path\n");
+		if (VSTATUS_OK != (rc = dumpStructure(old_topology.path,
+		                                      old_topology.bytesPath, topoFile,
+		                                      TOPO_FNAME, mapFile)))
+			goto bail;
+	} else if (old_topology.costMatrix.cost != NULL) {
+		SmCostMatrix_t *cm = &old_topology.costMatrix;
+		size_t pairs = (size_t)cm->switches * cm->switches;
+
+		printf("Dumping topology.costMatrix\n");
+		if (VSTATUS_OK != (rc = dumpStructure(cm->cost, pairs * cm->costWidth,
+		                                      topoFile, TOPO_FNAME, mapFile)))
+			goto bail;
+		if (VSTATUS_OK != (rc = dumpStructure(cm->pathIndex, pairs * sizeof(uint16_t),
+		                                      topoFile, TOPO_FNAME, mapFile)))
+			goto bail;
+		if (VSTATUS_OK != (rc = dumpStructure(cm->rowOffset, cm->switches * sizeof(uint32_t),
+		                                      topoFile, TOPO_FNAME, mapFile)))
+			goto bail;
+		if (VSTATUS_OK != (rc = dumpStructure(cm->masks, cm->numMasks * sizeof(SmPathPortmask_t),
+		                                      topoFile, TOPO_FNAME, mapFile)))
+			goto bail;
+	}
 
 	printf("Dumping topology.nodeArray\n");
 	if (VSTATUS_OK != (rc = dumpStructure(old_topology.nodeArray,
@@ -385,7 +417,7 @@ Status_t dumpMcGroups(const char * dumpDir, FILE * mapFile)
 		return rc;
 	}
 
-	if ((rc = vs_lock(&sm_McGroups_lock)) != VSTATUS_OK)
+	if ((rc = vs_rdlock(&sm_McGroups_lock)) != VSTATUS_OK)
 	{
 		fclose(groupFile);
 		fclose(memberFile);
@@ -480,7 +512,7 @@ Status_t dumpMcGroups(const char * dumpDir, FILE * mapFile)
 	
 
 bail:
-	vs_unlock(&sm_McGroups_lock);
+	vs_rwunlock(&sm_McGroups_lock);
 
 	fclose(groupFile);
 	fclose(memberFile);
@@ -490,6 +522,122 @@ bail:
 	return rc;
 }
 
+//
+// The sweep phase timing table is written as text, in the same format
+// as smShowCounters, rather than as a raw structure dump.
+//
+Status_t dumpSweepPhaseStats(const char * dumpDir, FILE * mapFile)
+{
+	Status_t rc = VSTATUS_OK;
+	FILE * statsFile = NULL;
+	char * buf = NULL;
+	int len = 256;
+
+	snprintf(pathBuffer, PATH_BUF_SZ, "%s/%s", dumpDir, SWEEPPHASE_FNAME);
+	if ((statsFile = fopen(pathBuffer, "a")) == NULL)
+		return VSTATUS_BAD;
+
+	if (vs_pool_alloc(&sm_pool, len, (void*)&buf) != VSTATUS_OK) {
+		fclose(statsFile);
+		return VSTATUS_NOMEM;
+	}
+	buf[0] = '\0';
+
+	if ((buf = sm_print_sweep_phase_stats_to_buf(buf, &len)) == NULL) {
+		rc = VSTATUS_NOMEM;
+	} else {
+		if (fputs(buf, statsFile) == EOF)
+			rc = VSTATUS_BAD;
+		vs_pool_free(&sm_pool, buf);
+	}
+
+	fclose(statsFile);
+	return rc;
+}
+
+//
+// The async request window and statistics of each node, as text.
+//
+Status_t dumpSmaStats(const char * dumpDir, FILE * mapFile)
+{
+	Status_t rc = VSTATUS_OK;
+	FILE * statsFile = NULL;
+	Node_t * node = NULL;
+	SmaDispatchStats_t * stats;
+
+	snprintf(pathBuffer, PATH_BUF_SZ, "%s/%s", dumpDir, SMASTATS_FNAME);
+	if ((statsFile = fopen(pathBuffer, "a")) == NULL)
+		return VSTATUS_BAD;
+
+	if ((rc = vs_rdlock(&old_topology_lock)) != VSTATUS_OK)
+	{
+		fclose(statsFile);
+		return rc;
+	}
+
+	fprintf(statsFile, "%-18s %6s %10s %8s %8s %8s %8s  %s\n", "NodeGUID", "Window",
+		"Responses", "Late", "Timeouts", "Shrinks", "AvgUsec", "NodeDesc");
+	for_all_nodes(&old_topology, node)
+	{
+		stats = &node->asyncStats;
+		if (fprintf(statsFile, FMT_U64" %6u %10u %8u %8u %8u %8"PRIu64"  %s\n",
+				node->nodeInfo.NodeGUID, node->asyncReqsSupported, stats->responses,
+				stats->late, stats->timeouts, stats->shrinks,
+				stats->responses ? stats->respTime / stats->responses : 0,
+				sm_nodeDescString(node)) < 0)
+		{
+			rc = VSTATUS_BAD;
+			break;
+		}
+	}
+
+	vs_rwunlock(&old_topology_lock);
+	fclose(statsFile);
+	return rc;
+}
+
+//
+// The size and hit/miss counts of each SA response cache, as text.
+//
+Status_t dumpSaCacheStats(const char * dumpDir, FILE * mapFile)
+{
+	Status_t rc = VSTATUS_OK;
+	FILE * statsFile = NULL;
+	SACacheEntry_t * cache;
+	int i;
+
+	snprintf(pathBuffer, PATH_BUF_SZ, "%s/%s", dumpDir, SACACHE_FNAME);
+	if ((statsFile = fopen(pathBuffer, "a")) == NULL)
+		return VSTATUS_BAD;
+
+	if ((rc = vs_lock(&saCache.lock)) != VSTATUS_OK)
+	{
+		fclose(statsFile);
+		return rc;
+	}
+
+	fprintf(statsFile, "%5s %-16s %10s %10s %6s %12s %12s %8s\n", "Index", "Name",
+		"Records", "Bytes", "Refs", "Hits", "Misses", "Skipped");
+	for (i = 0; i < SA_NUM_CACHES; ++i)
+	{
+		cache = saCache.current[i];
+		if (fprintf(statsFile, "%5d %-16s %10u %10u %6u %12"PRIu64" %12"PRIu64" %8u\n", i,
+				cache && cache->valid ? cache->name : "(not built)",
+				cache && cache->valid ? cache->records : 0,
+				cache && cache->valid ? cache->len : 0,
+				cache ? cache->refCount : 0,
+				saCache.hits[i], saCache.misses[i], saCache.skipped[i]) < 0)
+		{
+			rc = VSTATUS_BAD;
+			break;
+		}
+	}
+
+	vs_unlock(&saCache.lock);
+	fclose(statsFile);
+	return rc;
+}
+
 //
 //
 //
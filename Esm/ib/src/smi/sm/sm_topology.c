@@ -99,7 +99,7 @@ uint32_t    smFabricDiscoveryNeeded=0;
 uint64_t    lastTimeDiscoveryRequested=0;
 
 
-void dump_cost_array(uint16_t *);
+void dump_cost_array(Topology_t *);
 void showSmParms(void);
 
 Status_t sweep_initialize(SweepContext_t *);
@@ -119,7 +119,6 @@ Status_t topology_changes(Topology_t *old_topo, Topology_t *new_topo);
 Status_t topology_TrapUp(STL_NOTICE * noticep, Topology_t *, Topology_t *, Node_t *, Port_t *);
 Status_t topology_TrapDown(STL_NOTICE * noticep, Topology_t *, Topology_t *, Node_t *, Port_t *);
 Status_t topology_TrapCostMatrixChange(STL_NOTICE *noticep);
-Status_t topology_free_topology(Topology_t * topop, boolean need_old_topo_lock, boolean freeRoutingMod);
 Status_t topology_copy(void);
 void	 topology_clearNew(void);
 Status_t topology_cache_copy(void);
@@ -172,6 +171,9 @@ TFuncEntry_t sweep_functions[] = {
 	END_TFUNC()
 };
 
+// sweep phase stats entry for the elapsed time of a whole successful sweep
+static const char sweep_total_name[] = "Total successful sweep";
+
 static const char *sweep_reasons[] = {
 	[SM_SWEEP_REASON_INIT] = "Initial sweep.",
 	[SM_SWEEP_REASON_SCHEDULED] = "Scheduled sweep interval",
@@ -210,6 +212,7 @@ static int sweepNodeDisappearanceInfoMsgCount = 0;
 
 Topology_t	old_topology;
 Topology_t	sm_newTopology;
+static Topology_t	retired_topology;	// old_topology replaced by topology_copy(), not yet freed
 Topology_t	*sm_topop = &sm_newTopology;
 
 Popo_t sm_popo;
@@ -320,10 +323,6 @@ static void clearSaTables(SweepContext_t *sweep_context)
             sm_lidmap_reset();
             (void)vs_rwunlock(&old_topology_lock);
         }
-        // Reset the lid assignment hints
-    	sm_lmc_e0_freeLid_hint = 1 << sm_config.lmc_e0;
-    	sm_lmc_freeLid_hint = 1 << sm_config.lmc;
-    	sm_lmc_0_freeLid_hint = 1;
 
         sm_lid = sm_config.lid;
 
@@ -340,10 +339,6 @@ static void clearSaTables(SweepContext_t *sweep_context)
             sm_lidmap_reset();
             (void)vs_rwunlock(&old_topology_lock);
         }
-        // Reset the lid assignment hints
-    	sm_lmc_e0_freeLid_hint = 1 << sm_config.lmc_e0;
-    	sm_lmc_freeLid_hint = 1 << sm_config.lmc;
-    	sm_lmc_0_freeLid_hint = 1;
 
         /* clear just the SM table otherwise */
         (void) sm_dbsync_upsmlist(sweep_context);        /* clean out all sm records except for ours */
@@ -667,6 +662,7 @@ topology_main(uint32_t argc, uint8_t ** argv)
 					uint32_t pend = AtomicRead(&smCounters[smCounterSmPacketTransmits].sinceLastSweep);
 					uint32_t rend = AtomicRead(&smCounters[smCounterPacketRetransmits].sinceLastSweep);
 
+					sm_record_sweep_phase(sweep_functions[i].name, tend - tstart);
 					if (smDebugPerf) {
 						IB_LOG_INFINI_INFO_FMT(__func__, "TT: FUNC: %s: elapsed=%"PRIu64" packets=%u retries=%u status=%u",
 								sweep_functions[i].name, tend - tstart, pend - pstart, rend - rstart, status);
@@ -860,6 +856,7 @@ topology_main(uint32_t argc, uint8_t ** argv)
 				}
 #endif
 				SET_PEAK_COUNTER(smMaxSweepTime, (uint32)(temp64/1000));
+				sm_record_sweep_phase(sweep_total_name, temp64);
 
 #ifndef __VXWORKS__
 				if (smDumpCounters) {
@@ -1262,6 +1259,11 @@ sweep_initialize(SweepContext_t *sweep_context)
 	sm_newTopology.maxMcastMtu = STL_MTU_MAX;
 	sm_newTopology.maxMcastRate = IB_STATIC_RATE_MAX;
 
+	// Nodes and port data for this sweep are carved from a per-topology
+	// arena; without one they simply come from sm_pool.
+	if (sm_topology_arena_create(&sm_newTopology) != VSTATUS_OK)
+		IB_LOG_WARN0("unable to create topology arena, using sm_pool");
+
 	bitset_clear_all(&new_switchesInUse);
 	bitset_clear_all(&new_endnodesInUse);
 
@@ -1293,6 +1295,8 @@ sweep_initialize(SweepContext_t *sweep_context)
 	cl_qmap_init(sm_newTopology.switchLids, NULL);
 
 	sm_newTopology.nodeArray = NULL;
+	sm_newTopology.lidPortArray = NULL;
+	sm_newTopology.lidPortArrayMax = 0;
 	memset(&sm_newTopology.preDefLogCounts, 0, sizeof(PreDefTopoLogCounts));
 
 	status = vs_wrlock(&old_topology_lock);
@@ -1714,6 +1718,10 @@ sweep_resolve(SweepContext_t *sweep_context)
 	if (smDebugPerf)
 		IB_LOG_INFINI_INFO_FMT(__func__, "max lid 0x%08x", sm_newTopology.maxLid);
 
+	// LIDs are final for this topology now; index them for LID lookups.
+	// On failure lookups fall back to the lidmap and a node walk.
+	(void)sm_build_lid_port_array(&sm_newTopology);
+
 	IB_EXIT(__func__, VSTATUS_OK);
 	return(VSTATUS_OK);
 }
@@ -1984,16 +1992,27 @@ Status_t topology_setup_routing_cost_matrix(void)
     		vs_time_get(&sTime);
     	}
 
-		sm_topop->routingModule->funcs.initialize_cost_matrix(sm_topop);
+		/* A few changed switch links can be repaired from the previous sweep's matrix. */
+		if (  topology_passcount == 0
+		   || newSwitchesInFabric
+		   || sm_routing_func_update_cost_matrix(&old_topology, sm_topop) != VSTATUS_OK) {
 
-    	if (smDebugPerf) {
-    		vs_time_get(&eTime);
-        		IB_LOG_INFINI_INFO("END topology_setup_routing_cost_matrix/setup initial cost/path arrays;"
+			sm_topop->routingModule->funcs.initialize_cost_matrix(sm_topop);
+
+			if (smDebugPerf) {
+				vs_time_get(&eTime);
+				IB_LOG_INFINI_INFO("END topology_setup_routing_cost_matrix/setup initial cost/path arrays;"
 									" elapsed time(usecs)=", (int)(eTime-sTime));
-    		vs_time_get(&sTime);
-    	}
+				vs_time_get(&sTime);
+			}
 
-		sm_topop->routingModule->funcs.calculate_cost_matrix(sm_topop, sm_topop->max_sws, sm_topop->cost, sm_topop->path);
+			sm_topop->routingModule->funcs.calculate_cost_matrix(sm_topop, sm_topop->max_sws, sm_topop->cost, sm_topop->path);
+		}
+
+		/* Keep the compact form for the rest of the sweep and in old_topology. */
+		if (sm_routing_compact_cost_matrix(sm_topop) != VSTATUS_OK) {
+			IB_LOG_WARN0("unable to compact cost and path arrays, keeping full arrays");
+		}
 
     	if (smDebugPerf) {
     		vs_time_get(&eTime);
@@ -2046,10 +2065,7 @@ Status_t topology_setup_routing_cost_matrix(void)
     } else {
         // this is the odd case where HFM is the only thing in fabric
 		// (it has it's port down)
-        sm_topop->bytesCost = 0;
-        sm_topop->bytesPath = 0;
-        sm_topop->cost = NULL;
-        sm_topop->path = NULL;
+        sm_routing_free_cost_matrix(sm_topop);
         if (!sm_newTopology.num_ports) {
             IB_LOG_WARN0("Host SM's port is down, re-starting sweep");
 			sm_request_resweep(0, 0, SM_SWEEP_REASON_LOCAL_PORT_FAIL);
@@ -2140,7 +2156,7 @@ sweep_post_activate(SweepContext_t *sweep_context)
 		for_all_ports(qnodep->quarantinedNode, portp) {
 			if(!sm_valid_port(portp)) {
 				if(portp && sm_dynamic_port_alloc()) {
-					if ((portp->portData = sm_alloc_port(NULL, qnodep->quarantinedNode, portp->index)) == NULL) {
+					if ((portp->portData = sm_alloc_port(sm_topop, qnodep->quarantinedNode, portp->index)) == NULL) {
 						IB_LOG_ERROR_FMT(__func__, "cannot create  port %d for quarantined node %s",
 										portp->index, sm_nodeDescString(qnodep->quarantinedNode));
 						continue;
@@ -2182,6 +2198,7 @@ sweep_multicast(SweepContext_t *sweep_context)
 {
 	Status_t	status=VSTATUS_OK;
 	boolean		smSendOutMFTs = 0;
+	boolean		mcMembershipOnly = 0;
 
 	IB_ENTER(__func__, 0, 0, 0, 0);
 
@@ -2204,6 +2221,7 @@ sweep_multicast(SweepContext_t *sweep_context)
     // IFF sm_McGroups_Need_Prog is 1, set it to zero and return true.
     if (AtomicCompareStore(&sm_McGroups_Need_Prog, 1, 0)) {
         smSendOutMFTs = 1;
+        mcMembershipOnly = 1;
     }
 
     if (new_endnodesInUse.nset_m || topology_changed ||
@@ -2211,10 +2229,15 @@ sweep_multicast(SweepContext_t *sweep_context)
 		(sm_newTopology.maxMcastRate < old_topology.maxMcastRate) ||
 		(sm_newTopology.maxMcastMtu < old_topology.maxMcastMtu)) {
         smSendOutMFTs = 1;
+        mcMembershipOnly = 0;
     }
 
     if (smSendOutMFTs) {
-		status = sm_calculate_mfts();
+		/* when only group membership changed, recompute just the changed groups */
+		if (mcMembershipOnly && sm_config.mft_incremental)
+			status = sm_calculate_mfts_incremental();
+		else
+			status = sm_calculate_mfts();
     } else {
         /* just copy over the switch mfts to new topology */
         status = sm_multicast_switch_mft_copy();
@@ -2668,6 +2691,7 @@ topology_TrapDown(STL_NOTICE * noticep, Topology_t * tp_present, Topology_t * tp
                 (void)sm_dbsync_syncInform(DBSYNC_TYPE_DELETE, subsKeyp, iRecordp);
                 /* remove the entry from hashtable and free the value - key is freed by remove func */
                 moreEntries = cs_hashtable_iterator_remove(&itr);
+                sa_SubscriberUnindex(iRecordp);
                 free(iRecordp);
 			} else {
                 /* advance the iterator */
@@ -2694,6 +2718,7 @@ topology_TrapDown(STL_NOTICE * noticep, Topology_t * tp_present, Topology_t * tp
 					IB_LOG_INFO_FMT(__func__, "Deleting service for GID " FMT_GID " that "
 					                           "went out of service", STLGIDPRINTARGS2(port->portData->gid));
 					moreEntries = cs_hashtable_iterator_remove(&itr);
+					sa_ServiceRecUnindex(pOsr);
                     /* sync the service record deletion to standby SMs if necessary */
                     (void)sm_dbsync_syncService(DBSYNC_TYPE_DELETE, pOsr);
                 	/* remove the entry from hashtable and free the value - key is freed by remove func */
@@ -2968,19 +2993,12 @@ topology_copy(void)
 		}
 	}
 
-	/* free Old topology */
-	topology_free_topology(&old_topology, FALSE, TRUE);
+	/* Publish New Topology as old_topology; the previous one is freed below */
+	sm_topology_publish(&retired_topology);
 
-	/* Copy New Topology to old_topology */
-	(void)memcpy((void *)&old_topology, (void *)&sm_newTopology, sizeof(Topology_t));
-
-	/* clear out all new topology node pointers in lidmap */
-	for (i = 0; i <= STL_GET_UNICAST_LID_MAX(); i++) {
-		lidmap[i].newNodep = NULL;
-		lidmap[i].newPortp = NULL;
-	}
 	/* make the cached SA records active */
 	(void)topology_cache_copy();
+	sa_PathRecIndexUpdate(&old_topology, topology_changed || routing_recalculated);
 	(void)vs_unlock(&saCache.lock);
 
 	// TBD - can we trust topology_changed?  MFT programming doesn't
@@ -2994,6 +3012,9 @@ topology_copy(void)
 
 	(void)vs_rwunlock(&old_topology_lock);
 
+	/* Nothing can reach the retired topology any more, tear it down unlocked */
+	topology_free_topology(&retired_topology, FALSE, TRUE);
+
 #ifndef __VXWORKS__
 	/* Not needed for ESM as we can call printLoopPaths on command line whenever required*/
 
@@ -3015,6 +3036,34 @@ topology_copy(void)
 	return (VSTATUS_OK);
 }
 
+//
+// Makes sm_newTopology the topology SA, PM and the other readers see as
+// old_topology.  Must be called with old_topology_lock held for writing.
+//
+// The topology being replaced is not freed here but moved to *retired.
+// Readers only find topology objects through old_topology and the lidmap
+// while holding old_topology_lock, and both are repointed before the
+// lock is dropped, so once it is released no reader can still see the
+// retired topology and the caller frees it with topology_free_topology()
+// without holding the lock.  Tearing down every node and port of a large
+// fabric is the bulk of the work here, and doing it under the write lock
+// stalled SA queries and PM sweeps at the end of every sweep.
+//
+void
+sm_topology_publish(Topology_t * retired)
+{
+	int i;
+
+	(void)memcpy((void *)retired, (void *)&old_topology, sizeof(Topology_t));
+	(void)memcpy((void *)&old_topology, (void *)&sm_newTopology, sizeof(Topology_t));
+
+	/* clear out all new topology node pointers in lidmap */
+	for (i = 0; i <= STL_GET_UNICAST_LID_MAX(); i++) {
+		lidmap[i].newNodep = NULL;
+		lidmap[i].newPortp = NULL;
+	}
+}
+
 Status_t
 topology_free_topology(Topology_t * topop, boolean need_old_topo_lock, boolean freeRoutingMod)
 {
@@ -3065,6 +3114,12 @@ topology_free_topology(Topology_t * topop, boolean need_old_topo_lock, boolean f
 		topop->nodeArray = NULL;
 	}
 
+	if(topop->lidPortArray != NULL) {
+		(void)vs_pool_free(&sm_pool, (void *)topop->lidPortArray);
+		topop->lidPortArray = NULL;
+		topop->lidPortArrayMax = 0;
+	}
+
 	if(topop->quarantinedNodeMap){
 		cl_qmap_remove_all(topop->quarantinedNodeMap);
 		(void)vs_pool_free(&sm_pool, (void *)topop->quarantinedNodeMap);
@@ -3107,15 +3162,7 @@ topology_free_topology(Topology_t * topop, boolean need_old_topo_lock, boolean f
 	DEBUG_ASSERT(topop->num_endports == 0); topop->num_endports = 0;
 	topop->max_sws = 0;
 
-	if (topop->cost != NULL) {
-		(void)vs_pool_free(&sm_pool, (void *)topop->cost);
-		topop->cost = NULL;
-	}
-
-	if (topop->path != NULL) {
-		(void)vs_pool_free(&sm_pool, (void *)topop->path);
-		topop->path = NULL;
-	}
+	sm_routing_free_cost_matrix(topop);
 
 	if (freeRoutingMod && topop->routingModule)
 		sm_routing_freeModule(&topop->routingModule);
@@ -3127,9 +3174,58 @@ topology_free_topology(Topology_t * topop, boolean need_old_topo_lock, boolean f
 		(void)vs_pool_free(&sm_pool, (void *)loopPath);
 	}
 
+	// everything allocated from the arena goes at once, now that no
+	// node or port references remain
+	sm_topology_arena_delete(topop);
+
 	return VSTATUS_OK;
 }
 
+// chunk size of a topology arena; large enough that a switch's node, port
+// and port data allocations take only a handful of chunks
+#define SM_TOPOLOGY_ARENA_CHUNK	(1024 * 1024)
+
+Status_t
+sm_topology_arena_create(Topology_t * topop)
+{
+	Status_t status;
+	Pool_t *arena = NULL;
+
+	if (topop->arena)
+		return VSTATUS_OK;
+
+	status = vs_pool_alloc(&sm_pool, sizeof(Pool_t), (void *)&arena);
+	if (status != VSTATUS_OK)
+		return status;
+
+	status = vs_pool_create(arena, VMEM_ARENA, (unsigned char *)"sm_topo_arena",
+		NULL, SM_TOPOLOGY_ARENA_CHUNK);
+	if (status != VSTATUS_OK) {
+		(void)vs_pool_free(&sm_pool, (void *)arena);
+		return status;
+	}
+
+	topop->arena = arena;
+	return VSTATUS_OK;
+}
+
+void
+sm_topology_arena_delete(Topology_t * topop)
+{
+	uint64_t bytes = 0;
+
+	if (!topop->arena)
+		return;
+
+	if (smDebugPerf && vs_pool_size(topop->arena, &bytes) == VSTATUS_OK) {
+		IB_LOG_INFINI_INFO_FMT(__func__, "releasing %"PRIu64" KB topology arena",
+			bytes / 1024);
+	}
+	(void)vs_pool_delete(topop->arena);
+	(void)vs_pool_free(&sm_pool, (void *)topop->arena);
+	topop->arena = NULL;
+}
+
 /*
  * Clear an unreliable new topology view.  This can be caused when
  * a discovered switch is removed before topology_assigments is called.
@@ -3184,17 +3280,31 @@ topology_clearNew(void)
 // This is called from under the sm_newTopology lock and only modifies the
 // "build" cache, which is the cached data for the new topology.
 //
+// The caches are built in index order until SaCacheMaxMB is used up; a
+// cache that would not fit, or whose table is too large for one SA
+// response, is left unbuilt and its queries are answered from the topology.
+//
 Status_t
 sweep_cache_build(SweepContext_t *sweep_context)
 {
 	Status_t  rc;
 	int i;
 	SACacheEntry_t *cache;
+	uint64_t limit, used;
 
 	IB_ENTER(__func__, 0, 0, 0, 0);
 
-	// allocate/build new cache structures
+	limit = (uint64_t)sm_config.sa_cache_max_mb * 1024 * 1024;
+	used = 0;
+
+	// allocate/build new cache structures.  The NodeRecord caches predate
+	// SaCacheMaxMB and are neither limited nor counted by it.
 	for (i = 0; i < SA_NUM_CACHES; i++) {
+		if (i >= SA_CACHE_FIRST_CAPPED && used >= limit) {
+			saCache.skipped[i]++;
+			saCache.build[i] = NULL;
+			continue;
+		}
 		rc = vs_pool_alloc(&sm_pool, sizeof(SACacheEntry_t), (void*)&cache);
 		if (rc != VSTATUS_OK) {
 			IB_LOG_WARNRC("failed to allocate memory for SA cache structure rc:", rc);
@@ -3202,13 +3312,26 @@ sweep_cache_build(SweepContext_t *sweep_context)
 		} else {
 			memset(cache, 0, sizeof(SACacheEntry_t));
 			rc = saCacheBuildFunctions[i](cache, &sm_newTopology);
-			if (rc != VSTATUS_OK) {
+			if (rc == VSTATUS_OK && i >= SA_CACHE_FIRST_CAPPED && cache->len > limit - used) {
+				if (cache->data)
+					(void)vs_pool_free(&sm_pool, cache->data);
+				rc = VSTATUS_NOSUPPORT;
+			}
+			if (rc == VSTATUS_NOSUPPORT) {
+				IB_LOG_VERBOSE_FMT(__func__,
+				       "SA cache at index %d not built, over size limit", i);
+				saCache.skipped[i]++;
+				(void)vs_pool_free(&sm_pool, cache);
+				saCache.build[i] = NULL;
+			} else if (rc != VSTATUS_OK) {
 				IB_LOG_WARN_FMT(__func__,
 				       "failed to build cache at index %d, rc: %u", i, rc);
 				(void)vs_pool_free(&sm_pool, cache);
 				saCache.build[i] = NULL;
 			} else {
 				saCache.build[i] = cache;
+				if (i >= SA_CACHE_FIRST_CAPPED)
+					used += cache->len;
 			}
 		}
 	}
@@ -3558,7 +3681,7 @@ topology_dump(void)
 
     if (sm_state == SM_STATE_MASTER) {
 		dump_topology(NULL, /* do not buffer */ 0);
-		dump_cost_array((uint16_t *)sm_newTopology.cost);
+		dump_cost_array(&sm_newTopology);
 		(void)fflush(stdout);
 		showSmParms();
 		(void)fflush(stdout);
@@ -3619,26 +3742,24 @@ sm_topology_dump(int buffer)
 
 
 void
-dump_cost_array(uint16_t *cost)
+dump_cost_array(Topology_t *topop)
 {
-	int	ij;
 	int	i, j;
-    int num_nodes = sm_topop->max_sws;
+    int num_nodes = topop->max_sws;
 
 	IB_ENTER(__func__, 0, 0, 0, 0);
 
-	if (cost) {
+	if (sm_cost_matrix_valid(topop)) {
 		printf("\nCOST:\n");
     	printf("     i  j");
     	for (j = 0; j < num_nodes; j++) {
         	printf("%6d", j);
     	}
     	printf("\n");
-		for (i = 0; i < sm_topop->num_nodes; i++) {
+		for (i = 0; i < num_nodes; i++) {
         	printf("%6d   ", i);
-			for (j = 0; j < sm_topop->num_nodes; j++) {
-				ij = Index(i, j);
-				printf("%6d", (int)cost[ij]);
+			for (j = 0; j < num_nodes; j++) {
+				printf("%6d", (int)sm_cost_matrix_cost(topop, i, j));
 			}
 			printf("\n");
 		}
@@ -117,11 +117,11 @@ static void
 sm_lidmap_remove_missing(MissingLidEntry_t *m);
 
 extern FabricData_t preDefTopology;
-static void sm_util_free_port(Port_t * portp);
+static void sm_util_free_port(Pool_t * pool, Port_t * portp);
 
 static STL_LID sm_find_next_lid(uint8_t lmc);
 static STL_LID sm_clear_lid(Port_t * portp);
-static int sm_lidmap_pop_and_search(STL_LID *lid, STL_LID delta);
+static int sm_lidmap_pop_and_search(STL_LID *lid, uint8_t lmc);
 
 /* return ascii sm state */
 const char *
@@ -1569,6 +1569,12 @@ sm_find_port_lid(Topology_t * topop, STL_LID lid)
 
 	if (lid < STL_LID_UNICAST_BEGIN || lid > STL_GET_UNICAST_LID_MAX()) 
 		return (NULL);
+	/* complete index, once the topology's LIDs are resolved */
+	if (topop->lidPortArray) {
+		portp = (lid <= topop->lidPortArrayMax) ? topop->lidPortArray[lid] : NULL;
+		IB_EXIT(__func__, portp);
+		return (portp);
+	}
 	/* see if we can find it quickly through lidmap */
 	if (topop == &old_topology)
 		nodep = lidmap[lid].oldNodep;
@@ -1620,6 +1626,14 @@ sm_find_node_and_port_lid(Topology_t * topop, STL_LID lid, Node_t ** nodePtr)
 
 	if (lid < STL_LID_UNICAST_BEGIN || lid > STL_GET_UNICAST_LID_MAX()) 
 		return (NULL);
+	/* complete index, once the topology's LIDs are resolved */
+	if (topop->lidPortArray) {
+		portp = (lid <= topop->lidPortArrayMax) ? topop->lidPortArray[lid] : NULL;
+		if (portp)
+			*nodePtr = portp->portData->nodePtr;
+		IB_EXIT(__func__, portp);
+		return (portp);
+	}
 	/* see if we can find it quickly through lidmap (if it exists) */
 	if (lidmap) {
 		if (topop == &old_topology)
@@ -3630,6 +3644,7 @@ sm_clear_lid(Port_t * portp)
 			lidmap[i].newPortp = NULL;
 			memset(&lidmap[i].mapObj, 0, sizeof(lidmap[i].mapObj));
 			lidmap[i].missing = NULL;
+			sm_lid_alloc_release(i, 1);
 		}
 	}
 
@@ -3897,160 +3912,20 @@ sm_bounce_port(Topology_t * topop, Node_t * nodep, Port_t * portp)
 	return VSTATUS_OK;
 }
 
-/* Instead of always searching from the beginning of lid space, sm_find_lid_quick sets and uses
- * hints to remember from where it should start searching for a lid for a given lmc - sm_lmc_0
- * in case of no lmc, sm_lmc_e0 and sm_lmc for LMC of enhanced switch port 0 and LMC for FI ports
- * respectively.
+/*
+ * Find the lowest unassigned, 2^lmc aligned block of 2^lmc LIDs.
  */
-static STL_LID
-sm_find_lid_quick(int lid_count)
-{
-	STL_LID lid1 = STL_LID_RESERVED, lid2, endLid = STL_GET_UNICAST_LID_MAX() - lid_count + 1, freeSpace;
-	STL_LID freeLid, nextLid2;
-
-	/* If freeLid hint is -1, then we have exhausted the lid space. For other cases, we should
-	   start our search for free lid from the lid number indicated by the hint. */
-
-	if (lid_count == 1) {
-		if (sm_lmc_0_freeLid_hint == STL_LID_PERMISSIVE) {
-			return STL_LID_RESERVED;
-		}
-
-		lid1 = sm_lmc_0_freeLid_hint;
-	} else if ((lid_count == (1 << sm_config.lmc))) {
-		if (sm_lmc_freeLid_hint == STL_LID_PERMISSIVE) {
-			return STL_LID_RESERVED;
-		}
-
-		lid1 = sm_lmc_freeLid_hint;
-	} else if (lid_count == (1 << sm_config.lmc_e0)) {
-		if (sm_lmc_e0_freeLid_hint == STL_LID_PERMISSIVE) {
-			return STL_LID_RESERVED;
-		}
-		lid1 = sm_lmc_e0_freeLid_hint;
-	}
-
-	/* Reset the hint depending on which lid number we are using, so that hint can be updated */
-	if (lid1 == sm_lmc_0_freeLid_hint)
-		sm_lmc_0_freeLid_hint = 0;
-	if (lid1 == sm_lmc_e0_freeLid_hint)
-		sm_lmc_e0_freeLid_hint = 0;
-	if (lid1 == sm_lmc_freeLid_hint)
-		sm_lmc_freeLid_hint = 0;
-
-	freeLid = 0;
-	for (; lid1 <= endLid; lid1 += lid_count) {
-		nextLid2 = lid1 + lid_count;
-		if (lidmap[lid1].guid == 0) {
-			for (lid2 = lid1 + 1; lid2 < nextLid2; ++lid2) {
-				if (lidmap[lid2].guid != 0) {
-					/* We didn't find the required space, but note the space we did find for
-					   the next time we need to search. */
-					freeSpace = lid2 - lid1;
-
-					if ((freeSpace >= 1) && !sm_lmc_0_freeLid_hint)
-						sm_lmc_0_freeLid_hint = lid1;
-
-					if ((freeSpace >= (1 << sm_config.lmc_e0)) && !sm_lmc_e0_freeLid_hint)
-						sm_lmc_e0_freeLid_hint = lid1;
-
-					if ((freeSpace >= (1 << sm_config.lmc)) && !sm_lmc_freeLid_hint)
-						sm_lmc_freeLid_hint = lid1;
-
-					break;
-				}
-			}
-
-			if (lid2 >= nextLid2) {
-				// Found free lid
-				freeLid = lid1;
-				break;
-			}
-		}
-	}
-
-	if (!freeLid) {
-		/* We could not find the required lid space */
-		/* Set the hint to STL_LID_PERMISSIVE (0xffffffff), to indicate we have exhausted the lid space */
-		if (!sm_lmc_0_freeLid_hint)
-			sm_lmc_0_freeLid_hint = STL_LID_PERMISSIVE;
-		if (!sm_lmc_e0_freeLid_hint)
-			sm_lmc_e0_freeLid_hint = STL_LID_PERMISSIVE;
-		if (!sm_lmc_freeLid_hint)
-			sm_lmc_freeLid_hint = STL_LID_PERMISSIVE;
-		return STL_LID_RESERVED;
-	}
-
-	/* Remember where we need to start our search for the next time */
-	lid2 = lid1 + lid_count;
-
-	if (!sm_lmc_0_freeLid_hint) {
-		if (lid2 <= endLid)
-			sm_lmc_0_freeLid_hint = lid2;
-		else
-			sm_lmc_0_freeLid_hint = STL_LID_PERMISSIVE;
-	}
-
-	/* LMC is in use, so make sure the lid hint is aligned to the required LMC values */
-
-	if (!sm_lmc_e0_freeLid_hint) {
-		if (sm_config.lmc_e0) {
-			lid1 = 1 << sm_config.lmc_e0;
-			if (lid2 % lid1) {
-				lid2 = ((lid2 / lid1) + 1) * lid1;
-			}
-		}
-		if (lid2 <= endLid)
-			sm_lmc_e0_freeLid_hint = lid2;
-		else
-			sm_lmc_e0_freeLid_hint = STL_LID_PERMISSIVE;
-	}
-
-	if (!sm_lmc_freeLid_hint) {
-		if (sm_config.lmc) {
-			lid1 = 1 << sm_config.lmc;
-			if (lid2 % lid1) {
-				lid2 = ((lid2 / lid1) + 1) * lid1;
-			}
-		}
-		if (lid2 <= endLid)
-			sm_lmc_freeLid_hint = lid2;
-		else
-			sm_lmc_freeLid_hint = STL_LID_PERMISSIVE;
-	}
-
-	return freeLid;
-}
-
 static STL_LID
 sm_find_next_lid(uint8_t lmc)
 {
-	STL_LID delta = 1 << lmc; /* delta is the lid space we need to allocate */
-	STL_LID endLid = STL_GET_UNICAST_LID_MAX() - delta + 1;
-
-	// Try quick search first
-	STL_LID lid1 = sm_find_lid_quick(delta);
+	STL_LID lid1 = sm_lid_alloc_find(lmc);
 	if (lid1 != STL_LID_RESERVED)
 		return lid1;
 
-	// Quick find based on previous hints failed, do an
-	// exhaustive search over entire lid space.
-	STL_LID freeLid;
-	for (freeLid = delta; freeLid <= endLid; freeLid += delta) {
-		STL_LID nextLid = freeLid + delta;
-		for (lid1 = freeLid; lid1 < nextLid; ++lid1) {
-			if (lidmap[lid1].guid != 0)
-				break; // Space not big enough
-		}
-
-		if (lid1 >= nextLid)
-			return freeLid;
-	}
-
 	// Last chance, recycle LIDs belonging to devices missing from
 	// the fabric
 	while (1) {
-		int hasMore = sm_lidmap_pop_and_search(&lid1, delta);
+		int hasMore = sm_lidmap_pop_and_search(&lid1, lmc);
 		if (lid1 != STL_LID_RESERVED)
 			return lid1;
 		if (!hasMore)
@@ -4085,6 +3960,15 @@ sm_lidmap_alloc(void)
 	}
 	memset(lidmap, 0, sizeof(LidMap_t) * (STL_GET_UNICAST_LID_MAX() + 1));
 
+	s = sm_lid_alloc_init(STL_GET_UNICAST_LID_MAX());
+	if (s != VSTATUS_OK) {
+		IB_LOG_ERROR0("can't malloc LID allocator");
+		return s;
+	}
+	// The configured SM LID is only ever given to the SM port
+	if (sm_config.lid_strategy == LID_STRATEGY_SERIAL && sm_config.lid != STL_LID_RESERVED)
+		sm_lid_alloc_reserve(sm_config.lid, 1 << sm_config.lmc);
+
 	s = vs_pool_alloc(&sm_pool, sizeof(cl_qmap_t), (void *)&sm_GuidToLidMap);
 	if (s != VSTATUS_OK || !sm_GuidToLidMap) {
 		IB_LOG_ERROR0("can't malloc GuidToLidMap");
@@ -4105,6 +3989,7 @@ sm_lidmap_free(void)
 		vs_pool_free(&sm_pool, lidmap);
 		lidmap = NULL;
 	}
+	sm_lid_alloc_free();
 
 	if (sm_GuidToLidMap) {
 		cl_qmap_remove_all(sm_GuidToLidMap);
@@ -4125,6 +4010,7 @@ sm_lidmap_reset(void)
 {
 	cl_qmap_remove_all(sm_GuidToLidMap);
 	memset(lidmap, 0, sizeof(LidMap_t) * (STL_GET_UNICAST_LID_MAX() + 1));
+	sm_lid_alloc_reset();
 
 	while (missingDevHead) {
 		MissingLidEntry_t *m = missingDevHead->next;
@@ -4196,13 +4082,13 @@ sm_lidmap_update_missing(void)
 
 /*
  * Release the LIDs reserved by the device at the front of the missing
- * device queue and search the updated space for @c delta unassigned LIDs
- * starting on a multiple of @delta.
+ * device queue and search the updated space for 2^@c lmc unassigned LIDs
+ * starting on a multiple of 2^@c lmc.
  *
  * @return 1 if queue has more entries or 0 if it is empty
  */
 static int
-sm_lidmap_pop_and_search(STL_LID *lid, STL_LID delta)
+sm_lidmap_pop_and_search(STL_LID *lid, uint8_t lmc)
 {
 	MissingLidEntry_t *m = missingDevHead;
 	STL_LID i, start, end;
@@ -4232,26 +4118,12 @@ sm_lidmap_pop_and_search(STL_LID *lid, STL_LID delta)
 		lidmap[i].newPortp = NULL;
 		lidmap[i].missing = NULL;
 		memset(&lidmap[i].mapObj, 0, sizeof(lidmap[i].mapObj));
+		sm_lid_alloc_release(i, 1);
 	}
 
-	// There may be unused LIDs prior to start that can make
-	// up the LID space; search backwards for lowest available
-	// LID
-	for (i = start; i > 0; --i) {
-		if (lidmap[i].guid != 0)
-			break;
-	}
-
-	start = ((i + 1) + (delta - 1)) & (~(delta - 1)); // Round up to nearest multiple of delta
-
-	// Then search forward for other ports in desired LID range
-	for (i = start; i < (start + delta); ++i) {
-		if (lidmap[i].guid != 0)
-			break;
-	}
-
-	if (i == (start + delta))
-		*lid = start; // all LIDs in range checked, no other ports, success
+	// Nothing was free before, so any block found now reuses
+	// some of the LIDs just released
+	*lid = sm_lid_alloc_find(lmc);
 
 	return !!(missingDevHead);
 }
@@ -4519,6 +4391,7 @@ sm_set_lid(Port_t * portp, STL_LID lid, uint8_t lmc)
 		lidmap[i].newPortp = portp;
 		lidmap[i].missing = NULL;
 	}
+	sm_lid_alloc_claim(lid, endLid - lid);
 
 #if 0
 	// And handle LMC downsize
@@ -4758,6 +4631,54 @@ sm_setup_lft_block(Topology_t * topop, Node_t * switchp, STL_LID lid_entry, SmpA
 	return status;
 }
 
+// LFTs carry a reference count in a small header ahead of the table, so
+// that a switch whose routes are carried over unchanged from the previous
+// topology can share the old table instead of copying it.  A table is only
+// ever shared between the old and new copy of the same switch.
+typedef struct {
+	uint32_t	refCount;
+	uint32_t	reserved;
+	size_t		size;
+} LftHeader_t;
+
+#define LFT_HEADER(lft) ((LftHeader_t *)(lft) - 1)
+
+static Status_t
+_alloc_lft(size_t sizeLft, PORT ** lftp)
+{
+	LftHeader_t * hdr = NULL;
+
+	Status_t s = vs_pool_alloc(&sm_pool, sizeof(LftHeader_t) + sizeLft, (void **)&hdr);
+	if (s != VSTATUS_OK || !hdr) {
+		*lftp = NULL;
+		return s != VSTATUS_OK ? s : VSTATUS_NOMEM;
+	}
+
+	hdr->refCount = 1;
+	hdr->reserved = 0;
+	hdr->size = sizeLft;
+	*lftp = (PORT *)(hdr + 1);
+	return VSTATUS_OK;
+}
+
+uint32
+sm_Node_release_lft(Node_t * switchp)
+{
+	uint32 refs = 0;
+
+	if (switchp->lft) {
+		LftHeader_t * hdr = LFT_HEADER(switchp->lft);
+
+		if (hdr->refCount > 1) {
+			refs = --hdr->refCount;
+		} else {
+			vs_pool_free(&sm_pool, hdr);
+		}
+		switchp->lft = NULL;
+	}
+	return refs;
+}
+
 Status_t sm_Node_init_lft(Node_t * switchp, size_t * outSize)
 {
 	if (switchp->nodeInfo.NodeType != NI_TYPE_SWITCH ||
@@ -4769,15 +4690,14 @@ Status_t sm_Node_init_lft(Node_t * switchp, size_t * outSize)
 	}
 
 	if (switchp->lft) {
-		vs_pool_free(&sm_pool, switchp->lft);
-		switchp->lft = 0;
+		sm_Node_release_lft(switchp);
 		if (outSize)
 			*outSize = 0;
 	}
 
 	size_t sizeLft = sizeof(PORT) * ROUNDUP(switchp->switchInfo.LinearFDBTop+1, MAX_LFT_ELEMENTS_BLOCK);
 
-	Status_t s = vs_pool_alloc(&sm_pool, sizeLft, (void**)&switchp->lft);
+	Status_t s = _alloc_lft(sizeLft, &switchp->lft);
 	if (s == VSTATUS_OK && switchp->lft) {
 		memset((void *)switchp->lft, 0xff, sizeLft);
 		if (outSize)
@@ -4795,6 +4715,60 @@ Status_t sm_Node_init_lft(Node_t * switchp, size_t * outSize)
 	return s;
 }
 
+PORT *
+sm_Node_get_lft_wr(Node_t * switchp)
+{
+	LftHeader_t * hdr;
+	PORT * lft = NULL;
+
+	if (!switchp->lft)
+		return NULL;
+
+	hdr = LFT_HEADER(switchp->lft);
+	if (hdr->refCount == 1)
+		return switchp->lft;
+
+	if (_alloc_lft(hdr->size, &lft) != VSTATUS_OK) {
+		IB_LOG_ERROR_FMT(__func__,
+			"Unable to allocate %"PRISZT" LFT memory for node \"%s\", nodeGuid "FMT_U64,
+			hdr->size, switchp->nodeDesc.NodeString, switchp->nodeInfo.NodeGUID);
+		return NULL;
+	}
+	memcpy((void *)lft, (void *)switchp->lft, hdr->size);
+	hdr->refCount--;
+	switchp->lft = lft;
+
+	return lft;
+}
+
+Status_t
+sm_Node_copy_lft(Node_t * dest, const Node_t * src)
+{
+	Status_t s;
+
+	if (!src->lft)
+		return VSTATUS_BAD;
+
+	if (sm_config.lft_carry_over &&
+		dest->switchInfo.LinearFDBTop == src->switchInfo.LinearFDBTop &&
+		LFT_HEADER(src->lft)->refCount < UINT32_MAX) {
+		if (dest->lft == src->lft)
+			return VSTATUS_OK;
+		sm_Node_release_lft(dest);
+		LFT_HEADER(src->lft)->refCount++;
+		dest->lft = src->lft;
+		return VSTATUS_OK;
+	}
+
+	if ((s = sm_Node_init_lft(dest, NULL)) != VSTATUS_OK)
+		return s;
+
+	memcpy((void *)dest->lft, (void *)src->lft,
+		sizeof(PORT) * (MIN(dest->switchInfo.LinearFDBTop, src->switchInfo.LinearFDBTop) + 1));
+
+	return VSTATUS_OK;
+}
+
 Status_t
 sm_calculate_lft(Topology_t * topop, Node_t * switchp)
 {
@@ -4887,12 +4861,420 @@ sm_write_minimal_lft_blocks(Topology_t * topop, Node_t * switchp, SmpAddr_t * ad
 	return status;
 }
 
+/*
+ * Returns the previous topology's copy of switchp when its LFT is what the
+ * switch was last programmed with, so only the blocks that differ need to
+ * be written.  Returns NULL when the whole LFT has to be written: delta
+ * writes are disabled, all attributes are being rewritten, an earlier
+ * failure asked for the LFTs to be forced, or the switch is new or has
+ * ports that were reinitialized since (it may have been reset).
+ */
+Node_t *
+sm_lft_delta_base(Topology_t * oldtp, Node_t * switchp)
+{
+	Node_t *oldNodep;
+
+	if (!sm_config.lft_delta_writes || sm_config.forceAttributeRewrite ||
+		forceRebalanceNextSweep || esmLoopTestOn)
+		return NULL;
+
+	if (!switchp->oldExists || switchp->initPorts.nset_m)
+		return NULL;
+
+	oldNodep = sm_find_guid(oldtp, switchp->nodeInfo.NodeGUID);
+	if (!oldNodep || !oldNodep->lft)
+		return NULL;
+
+	return oldNodep;
+}
+
+#define LFT_BLOCK_UNCHANGED	0xffff
+#define LFT_MAX_WAVES		64
+
+// Fills in portNext with the plan index of the switch beyond each port of
+// switchp, -1 where there is none.
+static void
+_lft_port_next(Topology_t * topop, Node_t * switchp, const int *planIdx, int *portNext)
+{
+	Port_t *portp;
+	Node_t *nextp;
+	int port;
+
+	for (port = 0; port < MAX_STL_PORTS + 1; port++)
+		portNext[port] = -1;
+
+	for_all_physical_ports(switchp, portp) {
+		if (!sm_valid_port(portp) || portp->state < IB_PORT_INIT ||
+			(nextp = sm_find_node(topop, portp->nodeno)) == NULL ||
+			nextp->nodeInfo.NodeType != NI_TYPE_SWITCH)
+			continue;
+		portNext[portp->index] = planIdx[nextp->swIdx];
+	}
+}
+
+// Adds to deps, once each, the waves[] entries of block of the switches
+// that the changed entries of switchp's block are now routed through, for
+// those that also change that block.  Returns the number added.
+static int
+_lft_block_deps(Topology_t * topop, Node_t * switchp, Node_t * oldNodep, uint32_t oldBlocks,
+	uint32_t block, uint32_t numBlocks, const int *portNext, const uint16_t *waves, uint32_t *deps)
+{
+	STL_LID lid = block * MAX_LFT_ELEMENTS_BLOCK;
+	STL_LID endLid = MIN(lid + MAX_LFT_ELEMENTS_BLOCK - 1, topop->maxLid);
+	uint32_t dep;
+	int numDeps = 0, i;
+
+	for (; lid <= endLid; lid++) {
+		if (block < oldBlocks && switchp->lft[lid] == oldNodep->lft[lid])
+			continue;
+		if (switchp->lft[lid] > MAX_STL_PORTS || portNext[switchp->lft[lid]] < 0)
+			continue;
+		dep = portNext[switchp->lft[lid]] * numBlocks + block;
+		if (waves[dep] == LFT_BLOCK_UNCHANGED)
+			continue;
+		for (i = 0; i < numDeps && deps[i] != dep; i++)
+			;
+		if (i == numDeps)
+			deps[numDeps++] = dep;
+	}
+
+	return numDeps;
+}
+
+/*
+ * Plans the LFT writes for the switches of swlist that have a delta base
+ * (see sm_lft_delta_base()).  Only the blocks that differ from the old LFT
+ * are written, and a block is written only after the same block has been
+ * written on every switch its changed entries are now routed through.  A
+ * switch then only moves a destination onto switches that already use
+ * their new route for it, so a packet that meets an updated switch stays
+ * on updated switches and cannot loop between old and new routes.  The
+ * block's wave is the length of the longest such chain.  Entries of
+ * different destinations in one block can make the chains cyclic; when
+ * they reach LFT_MAX_WAVES waves that is logged and the switches on them
+ * are left out of the plan, to be written in full ahead of it as before.
+ *
+ * A block is written in the earliest wave it may go in if that lets it
+ * join a run, and otherwise as late as its dependents allow, so that runs
+ * are split by as few waves as possible.  Within a wave the writes are
+ * interleaved across switches block by block, as
+ * sm_write_full_lfts_by_block_LR() does, and a run of up to
+ * lft_multi_block blocks is sent as one SMP.  A run may cover unchanged
+ * blocks or blocks already written, which are rewritten with the same
+ * contents, but never a block of a later wave.  A switch whose blocks can
+ * all go in one wave, and whose runs would take as many SMPs as its whole
+ * LFT, is written in full in that wave instead.
+ */
+Status_t
+sm_plan_lft_writes(Topology_t * topop, Topology_t * oldtp, SwitchList_t * swlist,
+	SmLftWritePlan_t * plan)
+{
+	Status_t status = VSTATUS_OK;
+	SwitchList_t *sw;
+	Node_t **switches = NULL, **oldNodes = NULL;
+	uint16_t *waves = NULL, *due = NULL, *swLast = NULL, *swFull, *swWaves, wave, maxWave = 0;
+	uint32_t *cursor = NULL, *entries = NULL, *depStart = NULL, *deps = NULL;
+	uint32_t numBlocks, oldBlocks, block, next, last, end, numDeps, numWrites = 0, full, e, d;
+	SmLftWrite_t *writes;
+	uint32_t blockDeps[MAX_LFT_ELEMENTS_BLOCK];
+	int portNext[MAX_STL_PORTS + 1];
+	int *planIdx = NULL;
+	int numSwitches = 0, i, pass, changed, capped = 0;
+	STL_LID lid;
+
+	memset(plan, 0, sizeof(*plan));
+
+	if (!bitset_init(&sm_pool, &plan->switches, topop->max_sws))
+		return VSTATUS_NOMEM;
+
+	for_switch_list_switches(swlist, sw)
+		numSwitches++;
+
+	numBlocks = topop->maxLid / MAX_LFT_ELEMENTS_BLOCK + 1;
+	if ((status = vs_pool_alloc(&sm_pool, sizeof(Node_t *) * numSwitches, (void *)&switches)) != VSTATUS_OK ||
+		(status = vs_pool_alloc(&sm_pool, sizeof(Node_t *) * numSwitches, (void *)&oldNodes)) != VSTATUS_OK ||
+		(status = vs_pool_alloc(&sm_pool, sizeof(uint32_t) * numSwitches, (void *)&cursor)) != VSTATUS_OK ||
+		(status = vs_pool_alloc(&sm_pool, sizeof(int) * topop->max_sws, (void *)&planIdx)) != VSTATUS_OK ||
+		(status = vs_pool_alloc(&sm_pool, sizeof(uint16_t) * numSwitches * numBlocks, (void *)&waves)) != VSTATUS_OK)
+		goto done;
+
+	for (i = 0; i < (int)topop->max_sws; i++)
+		planIdx[i] = -1;
+
+	// Find the changed blocks.
+	numSwitches = 0;
+	for_switch_list_switches(swlist, sw) {
+		if (!sw->switchp->lft ||
+			(oldNodes[numSwitches] = sm_lft_delta_base(oldtp, sw->switchp)) == NULL)
+			continue;
+
+		swWaves = &waves[numSwitches * numBlocks];
+		planIdx[sw->switchp->swIdx] = numSwitches;
+		switches[numSwitches] = sw->switchp;
+		bitset_set(&plan->switches, sw->switchp->swIdx);
+
+		oldBlocks = (oldNodes[numSwitches]->switchInfo.LinearFDBTop + MAX_LFT_ELEMENTS_BLOCK) / MAX_LFT_ELEMENTS_BLOCK;
+		for (block = 0; block < numBlocks; block++) {
+			lid = block * MAX_LFT_ELEMENTS_BLOCK;
+			// still shared with the old topology when nothing changed
+			if (sw->switchp->lft == oldNodes[numSwitches]->lft ||
+				(block < oldBlocks &&
+				 !memcmp(&sw->switchp->lft[lid], &oldNodes[numSwitches]->lft[lid], MAX_LFT_ELEMENTS_BLOCK))) {
+				swWaves[block] = LFT_BLOCK_UNCHANGED;
+			} else {
+				swWaves[block] = 0;
+				plan->changedBlocks++;
+			}
+		}
+		numSwitches++;
+	}
+
+	if (!plan->changedBlocks)
+		goto done;
+
+	// Collect each changed block's dependencies, counting them first, and
+	// find the longest dependency chain of each.  Chains that reach
+	// LFT_MAX_WAVES are cyclic or too long to order; the switches they
+	// reach are left to be written in full, as without a plan, and the
+	// rest is planned again without them.
+	for (;;) {
+		if ((status = vs_pool_alloc(&sm_pool, sizeof(uint32_t) * plan->changedBlocks, (void *)&entries)) != VSTATUS_OK ||
+			(status = vs_pool_alloc(&sm_pool, sizeof(uint32_t) * (plan->changedBlocks + 1), (void *)&depStart)) != VSTATUS_OK)
+			goto done;
+
+		for (i = 0, e = 0, numDeps = 0; i < numSwitches; i++) {
+			if (!bitset_test(&plan->switches, switches[i]->swIdx))
+				continue;
+			oldBlocks = (oldNodes[i]->switchInfo.LinearFDBTop + MAX_LFT_ELEMENTS_BLOCK) / MAX_LFT_ELEMENTS_BLOCK;
+			_lft_port_next(topop, switches[i], planIdx, portNext);
+			for (block = 0; block < numBlocks; block++) {
+				if (waves[i * numBlocks + block] == LFT_BLOCK_UNCHANGED)
+					continue;
+				entries[e] = i * numBlocks + block;
+				depStart[e++] = numDeps;
+				numDeps += _lft_block_deps(topop, switches[i], oldNodes[i], oldBlocks, block,
+					numBlocks, portNext, waves, blockDeps);
+			}
+		}
+		depStart[e] = numDeps;
+
+		if (numDeps) {
+			if ((status = vs_pool_alloc(&sm_pool, sizeof(uint32_t) * numDeps, (void *)&deps)) != VSTATUS_OK)
+				goto done;
+
+			for (e = 0; e < plan->changedBlocks; e++) {
+				i = entries[e] / numBlocks;
+				block = entries[e] % numBlocks;
+				if (e == 0 || i != (int)(entries[e - 1] / numBlocks))
+					_lft_port_next(topop, switches[i], planIdx, portNext);
+				oldBlocks = (oldNodes[i]->switchInfo.LinearFDBTop + MAX_LFT_ELEMENTS_BLOCK) / MAX_LFT_ELEMENTS_BLOCK;
+				(void)_lft_block_deps(topop, switches[i], oldNodes[i], oldBlocks, block,
+					numBlocks, portNext, waves, &deps[depStart[e]]);
+			}
+		}
+
+		for (pass = 0, changed = 1, maxWave = 0; changed && pass < LFT_MAX_WAVES; pass++) {
+			changed = 0;
+			for (e = 0; e < plan->changedBlocks; e++) {
+				for (wave = 0, d = depStart[e]; d < depStart[e + 1]; d++)
+					wave = MAX(wave, MIN(waves[deps[d]] + 1, LFT_MAX_WAVES - 1));
+				if (wave > waves[entries[e]]) {
+					waves[entries[e]] = wave;
+					maxWave = MAX(maxWave, wave);
+					changed = 1;
+				}
+			}
+		}
+		if (maxWave < LFT_MAX_WAVES - 1)
+			break;
+
+		for (i = 0; i < numSwitches; i++) {
+			swWaves = &waves[i * numBlocks];
+			for (block = 0; block < numBlocks; block++) {
+				if (swWaves[block] == LFT_MAX_WAVES - 1)
+					break;
+			}
+			if (block == numBlocks)
+				continue;
+			for (block = 0; block < numBlocks; block++) {
+				if (swWaves[block] != LFT_BLOCK_UNCHANGED) {
+					swWaves[block] = LFT_BLOCK_UNCHANGED;
+					plan->changedBlocks--;
+				}
+			}
+			bitset_clear(&plan->switches, switches[i]->swIdx);
+			capped++;
+		}
+		for (e = 0; e < numSwitches * numBlocks; e++) {
+			if (waves[e] != LFT_BLOCK_UNCHANGED)
+				waves[e] = 0;
+		}
+
+		if (deps)
+			vs_pool_free(&sm_pool, deps);
+		vs_pool_free(&sm_pool, depStart);
+		vs_pool_free(&sm_pool, entries);
+		deps = depStart = entries = NULL;
+		if (!plan->changedBlocks)
+			break;
+	}
+	if (capped)
+		IB_LOG_WARN_FMT(__func__,
+			"LFT block dependencies of %d switches exceed %d waves; writing their full LFTs",
+			capped, LFT_MAX_WAVES);
+	if (!plan->changedBlocks)
+		goto done;
+
+	// Latest wave each block can be written in: before the earliest block
+	// depending on it.  Blocks nothing depends on are left for the last wave
+	// of their switch, so its runs can merge.
+	if ((status = vs_pool_alloc(&sm_pool, sizeof(uint16_t) * numSwitches * numBlocks, (void *)&due)) != VSTATUS_OK ||
+		(status = vs_pool_alloc(&sm_pool, sizeof(uint16_t) * numSwitches * 2, (void *)&swLast)) != VSTATUS_OK ||
+		(status = vs_pool_alloc(&sm_pool, sizeof(SmLftWrite_t) * plan->changedBlocks * 2,
+			(void *)&plan->writes)) != VSTATUS_OK)
+		goto done;
+	swFull = &swLast[numSwitches];
+	for (e = 0; e < plan->changedBlocks; e++)
+		due[entries[e]] = LFT_BLOCK_UNCHANGED;
+	for (e = 0; e < plan->changedBlocks; e++) {
+		for (d = depStart[e]; d < depStart[e + 1]; d++)
+			due[deps[d]] = MIN(due[deps[d]], waves[entries[e]] - 1);
+	}
+	for (i = 0; i < numSwitches; i++)
+		swLast[i] = 0;
+	for (e = 0; e < plan->changedBlocks; e++) {
+		i = entries[e] / numBlocks;
+		swLast[i] = MAX(swLast[i], waves[entries[e]]);
+	}
+	for (e = 0; e < plan->changedBlocks; e++) {
+		i = entries[e] / numBlocks;
+		if (due[entries[e]] == LFT_BLOCK_UNCHANGED)
+			due[entries[e]] = swLast[i];
+	}
+
+	// A switch whose blocks can all be written in its last wave is written
+	// in full there when that takes no more SMPs than its changed runs.
+	full = (numBlocks + sm_config.lft_multi_block - 1) / sm_config.lft_multi_block;
+	for (i = 0; i < numSwitches; i++)
+		swFull[i] = 0;
+	for (e = 0; e < plan->changedBlocks; e++) {
+		i = entries[e] / numBlocks;
+		if (due[entries[e]] < swLast[i])
+			swFull[i] = LFT_BLOCK_UNCHANGED;
+	}
+
+	// Each block is written in its due wave, in runs of up to lft_multi_block
+	// blocks interleaved across switches as sm_write_full_lfts_by_block_LR()
+	// does.  A run starts at a block that is due and also carries any later
+	// changed block whose dependencies are already written, so blocks are
+	// written at most once.  A run may cover unchanged or written blocks,
+	// which are rewritten with the same contents.
+	writes = &plan->writes[plan->changedBlocks];
+	for (wave = 0; wave <= maxWave; wave++) {
+		memset(cursor, 0, sizeof(uint32_t) * numSwitches);
+		for (block = 0; block < numBlocks; block++) {
+			for (i = 0; i < numSwitches; i++) {
+				swWaves = &waves[i * numBlocks];
+				if (swWaves[block] == LFT_BLOCK_UNCHANGED || due[i * numBlocks + block] != wave ||
+					block < cursor[i])
+					continue;
+
+				end = MIN(block + sm_config.lft_multi_block, numBlocks);
+				for (last = block, next = block + 1; next < end; next++) {
+					if (swWaves[next] == LFT_BLOCK_UNCHANGED)
+						continue;
+					if (swWaves[next] > wave)
+						break;
+					last = next;
+				}
+				for (next = block; next <= last; next++)
+					swWaves[next] = LFT_BLOCK_UNCHANGED;
+				cursor[i] = last + 1;
+
+				writes[numWrites].switchp = switches[i];
+				writes[numWrites].block = block;
+				writes[numWrites].numBlocks = last - block + 1;
+				writes[numWrites].wave = wave;
+				numWrites++;
+				if (swFull[i] != LFT_BLOCK_UNCHANGED)
+					swFull[i]++;
+			}
+		}
+	}
+
+	// Keep the runs of the other switches, wave by wave, and add the full
+	// writes.  Waves left empty are dropped.
+	for (wave = 0; wave <= maxWave; wave++) {
+		e = plan->numWrites;
+		for (d = 0; d < numWrites; d++) {
+			i = planIdx[writes[d].switchp->swIdx];
+			if (writes[d].wave != wave || (swFull[i] != LFT_BLOCK_UNCHANGED && swFull[i] >= full))
+				continue;
+			plan->writes[plan->numWrites] = writes[d];
+			plan->writes[plan->numWrites++].wave = plan->numWaves;
+		}
+		for (block = 0; block < numBlocks; block += sm_config.lft_multi_block) {
+			for (i = 0; i < numSwitches; i++) {
+				if (swLast[i] != wave || swFull[i] == LFT_BLOCK_UNCHANGED || swFull[i] < full)
+					continue;
+				if (block == 0)
+					plan->fullSwitches++;
+				plan->writes[plan->numWrites].switchp = switches[i];
+				plan->writes[plan->numWrites].block = block;
+				plan->writes[plan->numWrites].numBlocks = MIN(sm_config.lft_multi_block, numBlocks - block);
+				plan->writes[plan->numWrites].wave = plan->numWaves;
+				plan->numWrites++;
+			}
+		}
+		if (plan->numWrites > e)
+			plan->numWaves++;
+	}
+
+done:
+	if (swLast)
+		vs_pool_free(&sm_pool, swLast);
+	if (due)
+		vs_pool_free(&sm_pool, due);
+	if (deps)
+		vs_pool_free(&sm_pool, deps);
+	if (depStart)
+		vs_pool_free(&sm_pool, depStart);
+	if (entries)
+		vs_pool_free(&sm_pool, entries);
+	if (waves)
+		vs_pool_free(&sm_pool, waves);
+	if (planIdx)
+		vs_pool_free(&sm_pool, planIdx);
+	if (cursor)
+		vs_pool_free(&sm_pool, cursor);
+	if (oldNodes)
+		vs_pool_free(&sm_pool, oldNodes);
+	if (switches)
+		vs_pool_free(&sm_pool, switches);
+	if (status != VSTATUS_OK)
+		sm_free_lft_write_plan(plan);
+
+	return status;
+}
+
+void
+sm_free_lft_write_plan(SmLftWritePlan_t * plan)
+{
+	if (plan->writes)
+		vs_pool_free(&sm_pool, plan->writes);
+	bitset_free(&plan->switches);
+	memset(plan, 0, sizeof(*plan));
+}
+
 /*
  * Send the LFTs to a set of switches.
  *
  * MADs may contain up to sm_config.lft_multi_block LFT entries each.
  *
  * For each switch, we only actually send the LFT if the we need a rebalance.
+ * Old switches whose previous LFT is known are then only sent the blocks
+ * that changed, in the order planned by sm_plan_lft_writes(), after the
+ * full LFTs of the other switches have been written.
  */
 Status_t
 sm_write_full_lfts_by_block_LR(Topology_t * topop, SwitchList_t * swlist, int rebalance)
@@ -4904,7 +5286,18 @@ sm_write_full_lfts_by_block_LR(Topology_t * topop, SwitchList_t * swlist, int re
 	int block;
 	int sent_lft_sets = 0;
 	uint16_t numBlocks = 1;
-	uint32_t amod;
+	uint32_t amod, i;
+	SmLftWritePlan_t plan;
+	SmLftWrite_t *write;
+
+	memset(&plan, 0, sizeof(plan));
+	if (sm_config.force_rebalance || rebalance) {
+		if ((status = sm_plan_lft_writes(topop, &old_topology, swlist, &plan)) != VSTATUS_OK) {
+			// fall back to writing the full LFTs
+			IB_LOG_WARNRC("failed to plan LFT delta writes, rc:", status);
+			status = VSTATUS_OK;
+		}
+	}
 
 	// LFTs are already calculated
 	// Write the LFT blocks for this switch list
@@ -4925,6 +5318,9 @@ sm_write_full_lfts_by_block_LR(Topology_t * topop, SwitchList_t * swlist, int re
 			if (bitset_test(&old_switchesInUse, switchp->swIdx) &&
 				!sm_config.force_rebalance && !rebalance)
 				continue;
+			// Only the changed blocks are sent, below.
+			if (bitset_test(&plan.switches, switchp->swIdx))
+				continue;
 			swportp = sm_get_port(switchp, 0);
 			if (!sm_valid_port(swportp)) {
 				IB_LOG_WARN_FMT(__func__,
@@ -4969,7 +5365,51 @@ sm_write_full_lfts_by_block_LR(Topology_t * topop, SwitchList_t * swlist, int re
 		}
 	}
 
+	if (sm_config.sm_debug_routing && plan.switches.nset_m)
+		IB_LOG_INFINI_INFO_FMT(__func__,
+			"LFT deltas for %u switches (%u written in full): %u changed blocks in %u SMPs over %u waves",
+			(unsigned)plan.switches.nset_m, plan.fullSwitches, plan.changedBlocks, plan.numWrites, plan.numWaves);
+
+	for (i = 0; i < plan.numWrites; i++) {
+		write = &plan.writes[i];
+		// A later wave starts once everything before it has been
+		// acknowledged.  The first wave depends on nothing and goes out
+		// behind the full LFTs above without waiting.
+		if (write->wave > 0 && write->wave != plan.writes[i - 1].wave) {
+			if ((status = sm_dispatch_wait(&sm_asyncDispatch)) != VSTATUS_OK)
+				goto clearDispatch;
+		}
+
+		switchp = write->switchp;
+		swportp = sm_get_port(switchp, 0);
+		if (!sm_valid_port(swportp)) {
+			IB_LOG_WARN_FMT(__func__,
+							"Failed to get Port 0 of Switch " FMT_U64,
+							switchp->nodeInfo.NodeGUID);
+			status = VSTATUS_BAD;
+			goto clearDispatch;
+		}
+
+		amod = (write->numBlocks << 24) | write->block;
+		SmpAddr_t addr = SMP_ADDR_CREATE_LR(sm_lid, swportp->portData->lid);
+
+		status = SM_Set_LFT_Dispatch(fd_topology, amod, &addr,
+									(STL_LINEAR_FORWARDING_TABLE *) & switchp->lft[write->block * MAX_LFT_ELEMENTS_BLOCK],
+									write->numBlocks, sm_config.mkey, switchp, &sm_asyncDispatch);
+		sent_lft_sets = 1;
+		if (status != VSTATUS_OK) {
+			IB_LOG_ERROR_FMT(__func__,
+							 "Failed to setup Linear Forwarding Table "
+							 "for blocks [%d %d] on switch %s, node guid " FMT_U64 ", "
+							 "index %d, with rc 0x%.8X", write->block, write->block + write->numBlocks - 1,
+							 sm_nodeDescString(switchp), switchp->nodeInfo.NodeGUID,
+							 switchp->index, status);
+			goto clearDispatch;
+		}
+	}
+
 clearDispatch:
+	sm_free_lft_write_plan(&plan);
 	if (!sent_lft_sets)
 		return status;
 
@@ -5097,6 +5537,12 @@ sm_setup_lft_deltas(Topology_t * oldtp, Topology_t * newtp, Node_t * cnp)
 
 	IB_ENTER(__func__, newtp, cnp, 0, 0);
 
+	// The LFT may still be shared with the old topology.
+	if (!sm_Node_get_lft_wr(cnp)) {
+		IB_EXIT(__func__, VSTATUS_NOMEM);
+		return VSTATUS_NOMEM;
+	}
+
 	optSend = bitset_init(&sm_pool, &lidBlocks, newtp->maxLid / LFTABLE_LIST_COUNT + 1);
 	if (!optSend) {
 		IB_LOG_INFINI_INFO("Can't allocate space for lidblock map, size= ",
@@ -5291,7 +5737,7 @@ addServiceRecordSM(void)
 		return VSTATUS_NOMEM;
 	}
 	// Allocate and add SM service record
-	if (!((osrp = (OpaServiceRecord_t *) malloc(sizeof(OpaServiceRecord_t))))) {
+	if (!((osrp = sa_ServiceRecAlloc()))) {
 		free(srkeyp);
 		(void) vs_unlock(&saServiceRecords.serviceRecLock);
 		IB_FATAL_ERROR_NODUMP("addServiceRecordSM: Can't allocate Service Record hash entry");
@@ -5306,7 +5752,7 @@ addServiceRecordSM(void)
 	else
 		osrp->expireTime = VTIMER_ETERNITY;
 
-	if (!cs_hashtable_insert(saServiceRecords.serviceRecMap, srkeyp, osrp)) {
+	if (!sa_ServiceRecInsert(srkeyp, osrp)) {
 		(void) vs_unlock(&saServiceRecords.serviceRecLock);
 		free(srkeyp);
 		free(osrp);
@@ -5725,7 +6171,7 @@ sm_get_port(const Node_t * nodep, uint32_t portIndex)
 #endif
 
 static Status_t
-sm_util_alloc_port(Port_t * portp, int numPorts)
+sm_util_alloc_port(Pool_t * pool, Port_t * portp, int numPorts)
 {
 	Status_t status;
 
@@ -5733,10 +6179,10 @@ sm_util_alloc_port(Port_t * portp, int numPorts)
 		IB_ENTER(__func__, 0, 0, 0, 0);
 
 	// Allocate port record associated with the port.
-	status = vs_pool_alloc(&sm_pool, sizeof(PortData_t), (void *) &portp->portData);
+	status = vs_pool_alloc(pool, sizeof(PortData_t), (void *) &portp->portData);
 	if (status != VSTATUS_OK) {
 		IB_LOG_ERROR0("can't malloc port");
-		(void) vs_pool_free(&sm_pool, (void *) portp->portData);
+		(void) vs_pool_free(pool, (void *) portp->portData);
 		portp->portData = NULL;
 		if (smDebugDynamicPortAlloc)
 			IB_EXIT(__func__, status);
@@ -5745,59 +6191,59 @@ sm_util_alloc_port(Port_t * portp, int numPorts)
 	// Initialize port record.
 	memset(portp->portData, 0, sizeof(PortData_t));
 
-	if (!bitset_init(&sm_pool, &portp->portData->vfMember, MAX_VFABRICS)) {
+	if (!bitset_init(pool, &portp->portData->vfMember, MAX_VFABRICS)) {
 		status = VSTATUS_BAD;
 		IB_LOG_ERROR0("can't malloc port data");
-		(void) vs_pool_free(&sm_pool, (void *) portp->portData);
+		(void) vs_pool_free(pool, (void *) portp->portData);
 		portp->portData = NULL;
 		if (smDebugDynamicPortAlloc)
 			IB_EXIT(__func__, status);
 		return (status);
 	}
 
-	if (!bitset_init(&sm_pool, &portp->portData->qosMember, MAX_QOS_GROUPS)) {
+	if (!bitset_init(pool, &portp->portData->qosMember, MAX_QOS_GROUPS)) {
 		status = VSTATUS_BAD;
 		IB_LOG_ERROR0("can't malloc port data");
 		bitset_free(&portp->portData->vfMember);
-		(void) vs_pool_free(&sm_pool, (void *) portp->portData);
+		(void) vs_pool_free(pool, (void *) portp->portData);
 		portp->portData = NULL;
 		if (smDebugDynamicPortAlloc)
 			IB_EXIT(__func__, status);
 		return (status);
 	}
 
-	if (!bitset_init(&sm_pool, &portp->portData->fullPKeyMember, MAX_VFABRICS)) {
+	if (!bitset_init(pool, &portp->portData->fullPKeyMember, MAX_VFABRICS)) {
 		status = VSTATUS_BAD;
 		IB_LOG_ERROR0("can't malloc port data");
 		bitset_free(&portp->portData->vfMember);
 		bitset_free(&portp->portData->qosMember);
-		(void) vs_pool_free(&sm_pool, (void *) portp->portData);
+		(void) vs_pool_free(pool, (void *) portp->portData);
 		portp->portData = NULL;
 		if (smDebugDynamicPortAlloc)
 			IB_EXIT(__func__, status);
 		return (status);
 	}
-	if (!bitset_init(&sm_pool, &portp->portData->pkey_idxs, SM_PKEYS)) {
+	if (!bitset_init(pool, &portp->portData->pkey_idxs, SM_PKEYS)) {
 		status = VSTATUS_BAD;
 		IB_LOG_ERROR0("can't malloc port data");
 		bitset_free(&portp->portData->vfMember);
 		bitset_free(&portp->portData->qosMember);
 		bitset_free(&portp->portData->fullPKeyMember);
-		(void) vs_pool_free(&sm_pool, (void *) portp->portData);
+		(void) vs_pool_free(pool, (void *) portp->portData);
 		portp->portData = NULL;
 		if (smDebugDynamicPortAlloc)
 		IB_EXIT(__func__, status);
 		return (status);
 	}
 
-	if (!bitset_init(&sm_pool, &portp->portData->dgMember, MAX_VFABRIC_GROUPS)) {
+	if (!bitset_init(pool, &portp->portData->dgMember, MAX_VFABRIC_GROUPS)) {
 		status = VSTATUS_BAD;
 		IB_LOG_ERROR0("can't malloc port data");
 		bitset_free(&portp->portData->vfMember);
 		bitset_free(&portp->portData->qosMember);
 		bitset_free(&portp->portData->fullPKeyMember);
 		bitset_free(&portp->portData->pkey_idxs);
-		(void) vs_pool_free(&sm_pool, (void *) portp->portData);
+		(void) vs_pool_free(pool, (void *) portp->portData);
 		portp->portData = NULL;
 		if (smDebugDynamicPortAlloc)
 			IB_EXIT(__func__, status);
@@ -5823,7 +6269,7 @@ sm_alloc_port(Topology_t * topop, Node_t * nodep, uint32_t portIndex)
 								   portIndex, nodep->index);
 		}
 		// Allocate port record associated with the port.
-		if (sm_util_alloc_port(&nodep->port[portIndex], nodep->nodeInfo.NumPorts) !=
+		if (sm_util_alloc_port(sm_topo_pool(topop), &nodep->port[portIndex], nodep->nodeInfo.NumPorts) !=
 			VSTATUS_OK) {
 			return NULL;
 		}
@@ -5838,7 +6284,7 @@ sm_alloc_port(Topology_t * topop, Node_t * nodep, uint32_t portIndex)
 }
 
 static void
-sm_util_free_port(Port_t * portp)
+sm_util_free_port(Pool_t * pool, Port_t * portp)
 {
 	if (smDebugDynamicPortAlloc)
 		IB_ENTER(__func__, 0, 0, 0, 0);
@@ -5849,7 +6295,7 @@ sm_util_free_port(Port_t * portp)
 	bitset_free(&portp->portData->fullPKeyMember);
 	bitset_free(&portp->portData->dgMember);
 	bitset_free(&portp->portData->pkey_idxs);
-	(void) vs_pool_free(&sm_pool, (void *) portp->portData);
+	(void) vs_pool_free(pool, (void *) portp->portData);
 	portp->portData = NULL;
 
 	if (smDebugDynamicPortAlloc)
@@ -5887,7 +6333,7 @@ sm_free_port(Topology_t * topop, Port_t * portp)
 
 		sm_port_releaseNewArb(portp);
 
-		sm_util_free_port(portp);
+		sm_util_free_port(sm_topo_pool(topop), portp);
 	}
 
 	if (smDebugDynamicPortAlloc)
@@ -5937,6 +6383,74 @@ sm_build_node_array(Topology_t * topop)
 	return status;
 }
 
+//
+// Build the LID -> Port_t index used by sm_find_port_lid() and friends.
+// Every LID of an LMC range, and the port 0 LID of switches, maps to its
+// port, so lookups, including misses, no longer fall back to walking every
+// node.  Ports that are up are entered first so that a stale LID left on a
+// down port never hides the port the lidmap would have returned.  The LIDs
+// of a topology must not change once this has been built.
+//
+Status_t
+sm_build_lid_port_array(Topology_t * topop)
+{
+	Status_t status;
+	Node_t *nodep;
+	Port_t *portp;
+	STL_LID lid, maxLid = 0;
+	int pass;
+
+	if (topop->lidPortArray != NULL) {
+		(void)vs_pool_free(&sm_pool, (void *)topop->lidPortArray);
+		topop->lidPortArray = NULL;
+		topop->lidPortArrayMax = 0;
+	}
+
+	for_all_nodes(topop, nodep) {
+		for_all_end_ports(nodep, portp) {
+			if (!sm_valid_port(portp) ||
+				portp->portData->lid < STL_LID_UNICAST_BEGIN ||
+				portp->portData->lid > STL_GET_UNICAST_LID_MAX())
+				continue;
+			lid = portp->portData->lid + (1 << portp->portData->lmc) - 1;
+			if (lid > maxLid)
+				maxLid = lid;
+		}
+	}
+	if (maxLid > STL_GET_UNICAST_LID_MAX())
+		maxLid = STL_GET_UNICAST_LID_MAX();
+
+	status = vs_pool_alloc(&sm_pool, sizeof(Port_t *) * (maxLid + 1),
+					  (void *) &topop->lidPortArray);
+	if (status != VSTATUS_OK) {
+		IB_LOG_WARN("failed to allocate LID to port array", status);
+		topop->lidPortArray = NULL;
+		return status;
+	}
+	memset(topop->lidPortArray, 0, sizeof(Port_t *) * (maxLid + 1));
+
+	for (pass = 0; pass < 2; pass++) {
+		for_all_nodes(topop, nodep) {
+			for_all_end_ports(nodep, portp) {
+				if (!sm_valid_port(portp) ||
+					(pass == 0) != (portp->state > IB_PORT_DOWN) ||
+					portp->portData->lid < STL_LID_UNICAST_BEGIN ||
+					portp->portData->lid > maxLid)
+					continue;
+				for (lid = portp->portData->lid;
+					lid < portp->portData->lid + (1 << portp->portData->lmc) && lid <= maxLid;
+					lid++) {
+					if (topop->lidPortArray[lid] == NULL)
+						topop->lidPortArray[lid] = portp;
+				}
+			}
+		}
+	}
+
+	topop->lidPortArrayMax = maxLid;
+	return VSTATUS_OK;
+}
+
 //---------------------------------------------------------------------------//
 
 void
@@ -6336,6 +6850,7 @@ sm_compactSwitchSpace(Topology_t * topop, bitset_t * switchbits)
 	int fidx, lidx, i, j, ij, ji, oldij, oldji;
 	uint16_t *cost = NULL;
 	SmPathPortmask_t *path = NULL;
+	uint32_t *oldIdx = NULL;
 	size_t numSws = switchbits->nset_m;
 	size_t bytesCost = numSws * numSws * sizeof(uint16_t);
 	size_t bytesPath = SM_PATH_SIZE(numSws);
@@ -6361,6 +6876,14 @@ sm_compactSwitchSpace(Topology_t * topop, bitset_t * switchbits)
 			vs_pool_free(&sm_pool, (void *) &cost);
 			return;
 		}
+	} else if (topop->costMatrix.cost) {
+		/* Compact matrix rows are renumbered in one pass once the new indices are known. */
+		if (vs_pool_alloc(&sm_pool, numSws * sizeof(uint32_t), (void *) &oldIdx) != VSTATUS_OK) {
+			return;
+		}
+
+		for (i = 0; i < numSws; i++)
+			oldIdx[i] = i;
 	}
 
 	for (fidx = bitset_find_first_zero(switchbits); fidx >= 0;
@@ -6378,6 +6901,9 @@ sm_compactSwitchSpace(Topology_t * topop, bitset_t * switchbits)
 					bitset_set(switchbits, fidx);
 					bitset_clear(switchbits, lidx);
 
+					if (oldIdx)
+						oldIdx[fidx] = lidx;
+
 					if (topop->cost) {
 						for (j = 0; j < lidx; j++) {
 							ij = Index(fidx, j);
@@ -6429,6 +6955,11 @@ sm_compactSwitchSpace(Topology_t * topop, bitset_t * switchbits)
 		topop->bytesPath = bytesPath;
 	}
 
+	if (oldIdx) {
+		sm_routing_remap_cost_matrix(topop, oldIdx, numSws);
+		(void) vs_pool_free(&sm_pool, (void *) oldIdx);
+	}
+
 	topop->max_sws = switchbits->nset_m;
 
 	return;
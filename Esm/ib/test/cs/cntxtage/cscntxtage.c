@@ -0,0 +1,271 @@
+/* BEGIN_ICS_COPYRIGHT7 ****************************************
+
+Copyright (c) 2015-2020, Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+** END_ICS_COPYRIGHT7   ****************************************/
+
+
+/* [ICS VERSION STRING: unknown] */
+//===========================================================================//
+//									     //
+// FILE NAME								     //
+//    cscntxtage.c							     //
+//									     //
+// DESCRIPTION								     //
+//    Microbenchmark for context aging (cs_cntxt_age).  Times an aging	     //
+//    pass with 1k, 10k and 100k outstanding contexts, none of them due,    //
+//    against a walk of every hash bucket like the one the timer wheel	     //
+//    replaced.  Then lets a pool of short timeouts expire and checks no    //
+//    context is timed out early and none is left behind.		     //
+//									     //
+// DEPENDENCIES								     //
+//    cs_context.h, sm_counters.h, pm_counters.h				     //
+//									     //
+//===========================================================================//
+
+#include "os_g.h"
+#include "ib_status.h"
+#include "ib_types.h"
+#include "ib_mad.h"
+#include "cs_g.h"
+#include "cs_context.h"
+#include "sm_counters.h"
+#include "pm_counters.h"
+
+extern	int	optind;
+extern	char	*optarg;
+
+#define TEST_POOL_SIZE		0x20000000
+#define TEST_MAX_CONTEXTS	100000
+
+// cs_context.c counts its sends and retries in the SM and PM counters,
+// which would otherwise bring the SM and PM into the link.
+sm_counter_t		smCounters[smCountersMax];
+pm_counter_t		pmCounters[pmCountersMax];
+
+static Pool_t		test_pool;
+static int			passes = 1000;
+static int			failures;
+static uint64_t		*deadline;		// per entry index, expected expiry
+static uint64_t		maxLate;
+static int			numExpired;
+
+static void
+usage(void) {
+	fprintf(stderr, "cscntxtage [-p passes]\n");
+	fprintf(stderr, "    -p  aging passes timed per pool size (default 1000)\n");
+	exit(1);
+}
+
+static void
+check(int ok, const char *what, uint64_t val)
+{
+	if (!ok && failures++ < 20)
+		fprintf(stderr, "cscntxtage: FAIL %s (%"PRIu64")\n", what, val);
+}
+
+static uint32_t
+next_random(void)
+{
+	static uint32_t seed = 1;
+
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+static void
+expired_callback(cntxt_entry_t *entry, Status_t status, void *data, Mai_t *mad)
+{
+	uint64_t now;
+
+	vs_time_get(&now);
+	check(status == VSTATUS_TIMEOUT, "callback status", status);
+	check(now >= deadline[entry->index], "context timed out early", entry->index);
+	if (now > deadline[entry->index] && now - deadline[entry->index] > maxLate)
+		maxLate = now - deadline[entry->index];
+	numExpired++;
+}
+
+// The aging pass the timer wheel replaced: visit every entry of every
+// bucket for the ones due and the smallest time left.
+static uint64_t
+scan_age(generic_cntxt_t *cntx, int *due)
+{
+	cntxt_entry_t *entry;
+	uint64_t now, left, smallest = 0, adder;
+	int i;
+
+	vs_time_get(&now);
+	for (i = 0; i < cntx->hashTableDepth; i++) {
+		for (entry = cntx->hash[i]; entry; entry = entry->next) {
+			adder = entry->sendFailed ? 0 : cntx->timeoutAdder;
+			if (now - entry->tstamp >= entry->RespTimeout + adder) {
+				(*due)++;
+				continue;
+			}
+			left = entry->RespTimeout + adder - (now - entry->tstamp);
+			if (!smallest || left < smallest)
+				smallest = left;
+		}
+	}
+	return smallest;
+}
+
+// Allocate count contexts with timeouts spread over [base, base+spread) usec.
+// The MADs are never sent, with no retries each expiry releases the entry.
+static void
+setup(generic_cntxt_t *cntx, int count, uint64_t base, uint64_t spread)
+{
+	cntxt_entry_t *entry;
+	Mai_t mad;
+	Status_t status;
+	int i;
+
+	memset(cntx, 0, sizeof(*cntx));
+	cntx->hashTableDepth = CNTXT_HASH_TABLE_DEPTH;
+	cntx->poolSize = count;
+	cntx->maxRetries = 0;
+	if ((status = cs_cntxt_instance_init(&test_pool, cntx, base)) != VSTATUS_OK) {
+		fprintf(stderr, "cscntxtage: cannot allocate %d contexts (status %d)\n", count, (int)status);
+		exit(2);
+	}
+
+	memset(&mad, 0, sizeof(mad));
+	mad.base.mclass = MAD_CV_SUBN_ADM;
+	mad.base.method = MAD_CM_REPORT;
+	for (i = 0; i < count; i++) {
+		mad.addrInfo.dlid = 1 + i % 0xbfff;
+		mad.base.tid = i;
+		cntx->defaultTimeout = base + next_random() % spread;
+		entry = cs_cntxt_get(&mad, cntx, FALSE);
+		check(entry != NULL, "context allocation", i);
+		if (!entry)
+			return;
+		cs_cntxt_set_callback(entry, expired_callback, NULL);
+		deadline[entry->index] = entry->tstamp + entry->RespTimeout;
+	}
+}
+
+// Nothing is due, so an aging pass only has to find the next timeout.
+static void
+test_idle(int count)
+{
+	generic_cntxt_t cntx;
+	uint64_t start, end, ageNsecs, scanNsecs, left = 0, smallest = 0;
+	int i, due = 0, scanPasses = MAX(passes / (count / 1000), 10);
+
+	setup(&cntx, count, 60 * VTIMER_1S, 60 * VTIMER_1S);
+
+	vs_time_get(&start);
+	for (i = 0; i < passes; i++)
+		left = cs_cntxt_age(&cntx);
+	vs_time_get(&end);
+	ageNsecs = (end - start) * 1000 / passes;
+
+	vs_time_get(&start);
+	for (i = 0; i < scanPasses; i++)
+		smallest = scan_age(&cntx, &due);
+	vs_time_get(&end);
+	scanNsecs = (end - start) * 1000 / scanPasses;
+
+	check(due == 0 && cntx.numAlloc == count, "context aged out early", due);
+	// at worst a level 1 cascade earlier or one tick later than the scan
+	check(left && left <= smallest + (1 << CNTXT_WHEEL_TICK_SHIFT) + (end - start),
+		"next timeout after earliest expiry", left);
+
+	printf("%6d contexts: age %"PRIu64" ns, scan %"PRIu64" ns per pass\n",
+		count, ageNsecs, scanNsecs);
+	(void)cs_cntxt_instance_free(&test_pool, &cntx);
+}
+
+// Timeouts of 10-50ms, aged as the return value of cs_cntxt_age asks, must
+// all expire, none early, and leave nothing on the wheel.
+static void
+test_expiry(int count)
+{
+	generic_cntxt_t cntx;
+	uint64_t start, end, left;
+	int before = failures, calls = 0;
+
+	numExpired = 0;
+	maxLate = 0;
+	setup(&cntx, count, 10000, 40000);
+
+	vs_time_get(&start);
+	while (cntx.numAlloc && calls < 100000) {
+		left = cs_cntxt_age(&cntx);
+		calls++;
+		if (left)
+			usleep(left);
+	}
+	vs_time_get(&end);
+
+	check(numExpired == count && cntx.numAlloc == 0, "contexts left behind", cntx.numAlloc);
+	check(cntx.numTimers == 0, "timers left on wheel", cntx.numTimers);
+	printf("expiry %d contexts: %s, %d aging passes in %"PRIu64" ms, latest %"PRIu64" us late\n",
+		count, failures > before ? "FAIL" : "PASS", calls, (end - start) / 1000, maxLate);
+	(void)cs_cntxt_instance_free(&test_pool, &cntx);
+}
+
+//
+//  main utility function
+//
+int main(int argc, char *argv[]) {
+	Status_t status;
+	int c;
+
+	while ((c = getopt(argc, argv, "p:")) != -1) {
+		switch (c) {
+		case 'p':
+			passes = atoi(optarg);
+			break;
+		default:
+			usage();
+			break;
+		}
+	}
+	if (passes <= 0)
+		usage();
+
+	memset(&test_pool, 0, sizeof(test_pool));
+	if ((status = vs_pool_create(&test_pool, 0, (uint8_t *)"test_pool", NULL, TEST_POOL_SIZE)) != VSTATUS_OK) {
+		fprintf(stderr, "cscntxtage: cannot create pool (status %d)\n", (int)status);
+		exit(2);
+	}
+	if ((deadline = calloc(TEST_MAX_CONTEXTS + 1, sizeof(uint64_t))) == NULL) {
+		fprintf(stderr, "cscntxtage: cannot allocate deadlines\n");
+		exit(2);
+	}
+
+	test_idle(1000);
+	test_idle(10000);
+	test_idle(TEST_MAX_CONTEXTS);
+	test_expiry(10000);
+
+	free(deadline);
+
+	exit(failures ? 3 : 0);
+}
@@ -286,7 +286,7 @@ vs_pool_create_2b (void)
   void *address;
   uint32_t options;
   const uint32_t valid_options =
-    (uint32_t) (VMEM_PAGE);
+    (uint32_t) (VMEM_PAGE | VMEM_ARENA);
 
   for (i = (uint32_t) 0U; i < (uint32_t) 32U; i++)
     {
@@ -938,6 +938,104 @@ vs_pool_create_7b (void)
   IB_LOG_INFO (passed, (uint32_t) 0U);
   return VSTATUS_OK;
 }
+static Status_t
+vs_pool_create_8a (void)
+{
+  static const char passed[] = "vs_pool_create:1:8.a PASSED";
+  static const char failed[] = "vs_pool_create:1:8.a FAILED";
+  Status_t rc;
+  static Pool_t pool;
+  uint32_t options;
+  void *address;
+  void *allocated[64U];
+  uint32_t i;
+  size_t j;
+
+  (void) memset (&pool, 0, sizeof (Pool_t));
+  options = (uint32_t) VMEM_ARENA;
+  address = 0;
+
+  rc =
+    vs_pool_create (&pool, options,
+			(unsigned char *) "test_arena", address,
+			(size_t) 4096U);
+  if (rc != VSTATUS_OK)
+    {
+      IB_LOG_ERROR ("vs_pool_create failed; expected", VSTATUS_OK);
+      IB_LOG_ERROR ("vs_pool_create failed; actual", rc);
+      IB_LOG_ERROR ("vs_pool_create options: ", options);
+      IB_LOG_ERROR (failed, (uint32_t) 0U);
+      return VSTATUS_BAD;
+    }
+
+  /* enough small allocations to span several chunks, plus one that
+   * exceeds the chunk size and must get a chunk of its own */
+  (void) memset (&allocated[0], 0, sizeof (allocated));
+  for (i = (uint32_t) 0U;
+       i < (sizeof (allocated) / sizeof (allocated[0])); i++)
+    {
+      size_t size = (i == (uint32_t) 32U) ? (size_t) 8192U : (size_t) 100U;
+
+      rc = vs_pool_alloc (&pool, size, &allocated[i]);
+      if (rc != VSTATUS_OK)
+	{
+	  IB_LOG_ERROR ("vs_pool_alloc failed; expected", VSTATUS_OK);
+	  IB_LOG_ERROR ("vs_pool_alloc failed; actual", rc);
+	  IB_LOG_ERROR ("alloc size", (uint32_t) size);
+	  IB_LOG_ERROR (failed, (uint32_t) 0U);
+	  (void) vs_pool_delete (&pool);
+	  return VSTATUS_BAD;
+	}
+      if (((size_t) allocated[i] & (size_t) 0x0FU) != (size_t) 0U)
+	{
+	  IB_LOG_ERROR ("allocated address not 16 byte aligned",
+			(uint64_t) allocated[i]);
+	  IB_LOG_ERROR (failed, (uint32_t) 0U);
+	  (void) vs_pool_delete (&pool);
+	  return VSTATUS_BAD;
+	}
+      for (j = (size_t) 0U; j < size; j++)
+	{
+	  if (((uint8_t *) allocated[i])[j] != (uint8_t) 0U)
+	    {
+	      IB_LOG_ERROR ("allocated memory not zeroed",
+			    (uint64_t) allocated[i]);
+	      IB_LOG_ERROR (failed, (uint32_t) 0U);
+	      (void) vs_pool_delete (&pool);
+	      return VSTATUS_BAD;
+	    }
+	}
+      (void) memset (allocated[i], 0xA5, size);
+    }
+
+  /* individual frees are accepted but do not release anything */
+  for (i = (uint32_t) 0U;
+       i < (sizeof (allocated) / sizeof (allocated[0])); i++)
+    {
+      rc = vs_pool_free (&pool, allocated[i]);
+      if (rc != VSTATUS_OK)
+	{
+	  IB_LOG_ERROR ("vs_pool_free failed; expected", VSTATUS_OK);
+	  IB_LOG_ERROR ("vs_pool_free failed; actual", rc);
+	  IB_LOG_ERROR ("vs_pool_free address", (uint64_t) allocated[i]);
+	  IB_LOG_ERROR (failed, (uint32_t) 0U);
+	  (void) vs_pool_delete (&pool);
+	  return VSTATUS_BAD;
+	}
+    }
+
+  rc = vs_pool_delete (&pool);
+  if (rc != VSTATUS_OK)
+    {
+      IB_LOG_ERROR ("vs_pool_delete failed; expected", VSTATUS_OK);
+      IB_LOG_ERROR ("vs_pool_delete failed; actual", rc);
+      IB_LOG_ERROR (failed, (uint32_t) 0U);
+      return VSTATUS_BAD;
+    }
+
+  IB_LOG_INFO (passed, (uint32_t) 0U);
+  return VSTATUS_OK;
+}
 void
 test_pool_create_1 (void)
 {
@@ -975,6 +1073,8 @@ test_pool_create_1 (void)
   WAIT_FOR_LOGGING_TO_CATCHUP;
   DOATEST (vs_pool_create_7b, total_passes, total_fails);
   WAIT_FOR_LOGGING_TO_CATCHUP;
+  DOATEST (vs_pool_create_8a, total_passes, total_fails);
+  WAIT_FOR_LOGGING_TO_CATCHUP;
   IB_LOG_INFO ("vs_pool_create:1 TOTAL PASSED", total_passes);
   IB_LOG_INFO ("vs_pool_create:1 TOTAL FAILED", total_fails);
   IB_LOG_INFO ("vs_pool_create:1 TEST COMPLETE", (uint32_t) 0U);
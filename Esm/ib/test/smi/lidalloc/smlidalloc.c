@@ -0,0 +1,300 @@
+/* BEGIN_ICS_COPYRIGHT7 ****************************************
+
+Copyright (c) 2015-2020, Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+** END_ICS_COPYRIGHT7   ****************************************/
+
+/* [ICS VERSION STRING: unknown] */
+//===========================================================================//
+//									     //
+// FILE NAME								     //
+//    smlidalloc.c							     //
+//									     //
+// DESCRIPTION								     //
+//    Unit test for the SM free LID allocator (sm_lid_alloc_*).  Checks	     //
+//    LMC alignment, reservation and, against a linear scan of the LID	     //
+//    space like the one it replaced, the block chosen after long random    //
+//    claim/release sequences.  Then times the worst case for both: a	     //
+//    LID space fragmented so that the only free block is at the top.	     //
+//									     //
+// DEPENDENCIES								     //
+//    sm_l.h								     //
+//									     //
+//===========================================================================//
+
+#include "os_g.h"
+#include "ib_status.h"
+#include "ib_types.h"
+#include "sm_l.h"
+#include "cs_g.h"
+
+extern	int	optind;
+extern	char	*optarg;
+
+#define TEST_POOL_SIZE		0x10000000
+
+// The allocator takes its bitmaps from sm_pool, which sm_main.c would
+// bring along with the rest of the SM.
+Pool_t				sm_pool;
+
+static STL_LID		maxLid = SM_DEFAULT_MAX_LID;
+static int			rounds = 20000;
+static uint8_t		*shadow;		// 1 = LID claimed, reserved or 0
+static int			failures;
+
+static void
+usage(void) {
+	fprintf(stderr, "smlidalloc [-L maxlid] [-r rounds]\n");
+	fprintf(stderr, "    -L  highest unicast LID, up to 0xbfffff (default 0x%x)\n", SM_DEFAULT_MAX_LID);
+	fprintf(stderr, "    -r  random claim/release rounds (default 20000)\n");
+	exit(1);
+}
+
+static void
+check(int ok, const char *what, STL_LID lid)
+{
+	if (!ok && failures++ < 20)
+		fprintf(stderr, "smlidalloc: FAIL %s (lid 0x%x)\n", what, lid);
+}
+
+// The search the allocator replaced: lowest 2^lmc aligned block with no
+// LID in use.
+static STL_LID
+scan_find(uint8_t lmc)
+{
+	STL_LID delta = 1 << lmc, lid, i;
+
+	for (lid = delta; lid + delta - 1 <= maxLid; lid += delta) {
+		for (i = lid; i < lid + delta; i++) {
+			if (shadow[i])
+				break;
+		}
+		if (i == lid + delta)
+			return lid;
+	}
+	return STL_LID_RESERVED;
+}
+
+static void
+claim(STL_LID lid, STL_LID count)
+{
+	sm_lid_alloc_claim(lid, count);
+	memset(&shadow[lid], 1, count);
+}
+
+static void
+release(STL_LID lid, STL_LID count)
+{
+	sm_lid_alloc_release(lid, count);
+	memset(&shadow[lid], 0, count);
+}
+
+static void
+reset(void)
+{
+	sm_lid_alloc_reset();
+	memset(shadow, 0, maxLid + 1);
+	shadow[0] = 1;
+}
+
+static uint32_t
+next_random(void)
+{
+	static uint32_t seed = 1;
+
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+// Allocating blocks of one LMC until the space runs out must return
+// aligned, in-range, previously free blocks and account for every LID.
+static void
+test_alignment(void)
+{
+	STL_LID lid, count;
+	uint8_t lmc;
+
+	for (lmc = 0; lmc <= SM_LID_ALLOC_MAX_LMC; lmc++) {
+		reset();
+		count = 0;
+		while ((lid = sm_lid_alloc_find(lmc)) != STL_LID_RESERVED) {
+			check(lid % (1 << lmc) == 0, "block not LMC aligned", lid);
+			check(lid >= STL_LID_UNICAST_BEGIN && lid + (1 << lmc) - 1 <= maxLid,
+				"block out of range", lid);
+			// claiming in order, so the lowest free block is the next one
+			check(lid == (count + 1) << lmc, "block is not the lowest free one", lid);
+			if (failures)
+				return;
+			claim(lid, 1 << lmc);
+			count++;
+		}
+		// every aligned block except the one holding LID 0
+		check(count == ((maxLid + 1) >> lmc) - 1, "LID space not fully used", count);
+	}
+	printf("alignment: %s\n", failures ? "FAIL" : "PASS");
+}
+
+// Reserved LIDs are never handed out, survive a reset, and releasing
+// them does not make them allocatable.
+static void
+test_reservation(void)
+{
+	STL_LID lid;
+	int before = failures;
+
+	reset();
+	sm_lid_alloc_reserve(1, 3);
+	sm_lid_alloc_reserve(16, 16);
+	memset(&shadow[1], 1, 3);
+	memset(&shadow[16], 1, 16);
+	sm_lid_alloc_reset();
+
+	check(sm_lid_alloc_find(0) == 4, "single LID skips reservation", 4);
+	check(sm_lid_alloc_find(2) == 4, "LMC 2 block skips reservation", 4);
+	check(sm_lid_alloc_find(4) == 32, "LMC 4 block skips reservation", 32);
+	sm_lid_alloc_release(16, 16);
+	check(sm_lid_alloc_find(4) == 32, "released reservation stays reserved", 32);
+	claim(32, 32);
+	check(sm_lid_alloc_find(3) == 8, "LMC 3 block after reservation", 8);
+	for (lid = 0; lid < 64; lid++)
+		check(!(sm_lid_alloc_find(0) >= 16 && sm_lid_alloc_find(0) < 32),
+			"reserved LID handed out", lid);
+
+	// leave the allocator without reservations for the remaining tests
+	sm_lid_alloc_init(maxLid);
+	reset();
+	printf("reservation: %s\n", failures > before ? "FAIL" : "PASS");
+}
+
+// Mixed-LMC random claims and releases fragment the space; after every
+// step the allocator must agree with the linear scan.
+static void
+test_fragmentation(void)
+{
+	STL_LID lid, found, expect;
+	uint8_t lmc;
+	int r, before = failures;
+
+	reset();
+	for (r = 0; r < rounds && failures == before; r++) {
+		lmc = next_random() % (SM_LID_ALLOC_MAX_LMC + 1);
+		if (next_random() % 3 == 0) {
+			// release a random aligned block, whatever is in it
+			lid = (next_random() % ((maxLid + 1) >> lmc)) << lmc;
+			if (lid == 0)
+				lid = 1;
+			if (lid + (1 << lmc) - 1 <= maxLid)
+				release(lid, (lid == 1 && lmc) ? (1 << lmc) - 1 : 1 << lmc);
+			continue;
+		}
+		found = sm_lid_alloc_find(lmc);
+		expect = scan_find(lmc);
+		check(found == expect, "allocator and scan disagree", found);
+		if (found != STL_LID_RESERVED)
+			claim(found, 1 << lmc);
+		else
+			release((next_random() % maxLid) + 1, 1);
+	}
+	printf("fragmentation: %s (%d rounds)\n", failures > before ? "FAIL" : "PASS", r);
+}
+
+// Every other single LID claimed: the only 2^lmc block left is the one at
+// the top of the LID space, which the scan has to reach LID by LID.
+static void
+test_worst_case(void)
+{
+	uint64_t start, end, allocUsecs, scanUsecs;
+	STL_LID lid, top;
+	uint8_t lmc;
+	int i, n = 100;
+
+	for (lmc = 1; lmc <= SM_LID_ALLOC_MAX_LMC; lmc += 3) {
+		reset();
+		top = ((maxLid + 1) >> lmc << lmc) - (1 << lmc);
+		for (lid = 1; lid < top; lid += 2)
+			claim(lid, 1);
+
+		vs_time_get(&start);
+		for (i = 0; i < n; i++)
+			check(sm_lid_alloc_find(lmc) == top, "worst case block", top);
+		vs_time_get(&end);
+		allocUsecs = end - start;
+
+		vs_time_get(&start);
+		for (i = 0; i < n; i++)
+			check(scan_find(lmc) == top, "worst case scan", top);
+		vs_time_get(&end);
+		scanUsecs = end - start;
+
+		printf("worst case lmc %u, max LID 0x%x: allocator %"PRIu64" ns, scan %"PRIu64" ns\n",
+			lmc, maxLid, allocUsecs * 1000 / n, scanUsecs * 1000 / n);
+	}
+}
+
+//
+//  main utility function
+//
+int main(int argc, char *argv[]) {
+	Status_t status;
+	int c;
+
+	while ((c = getopt(argc, argv, "L:r:")) != -1) {
+		switch (c) {
+		case 'L':
+			maxLid = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		default:
+			usage();
+			break;
+		}
+	}
+	if (maxLid < 0xff || maxLid > 0xBFFFFF || rounds < 0)
+		usage();
+
+	memset(&sm_pool, 0, sizeof(sm_pool));
+	if ((status = vs_pool_create(&sm_pool, 0, (uint8_t *)"sm_pool", NULL, TEST_POOL_SIZE)) != VSTATUS_OK) {
+		fprintf(stderr, "smlidalloc: cannot create SM pool (status %d)\n", (int)status);
+		exit(2);
+	}
+	if ((status = sm_lid_alloc_init(maxLid)) != VSTATUS_OK ||
+		(shadow = malloc(maxLid + 1)) == NULL) {
+		fprintf(stderr, "smlidalloc: cannot allocate LID bitmaps (status %d)\n", (int)status);
+		exit(2);
+	}
+
+	test_alignment();
+	test_reservation();
+	test_fragmentation();
+	test_worst_case();
+
+	sm_lid_alloc_free();
+	free(shadow);
+
+	exit(failures ? 3 : 0);
+}
@@ -0,0 +1,1007 @@
+/* BEGIN_ICS_COPYRIGHT7 ****************************************
+
+Copyright (c) 2015-2020, Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+** END_ICS_COPYRIGHT7   ****************************************/
+
+/* [ICS VERSION STRING: unknown] */
+
+//===========================================================================//
+//									     //
+// FILE NAME								     //
+//    smbenchfabric.c							     //
+//									     //
+// DESCRIPTION								     //
+//    Synthetic fabrics for the offline SM and SA benches.  Builds a fat     //
+//    tree, torus/mesh, hypercube, dragonfly or random fabric directly in    //
+//    sm_newTopology and runs the routing phases of a sweep against it	     //
+//    with the real routing modules.  Shared by smroutebench and	     //
+//    smsabench.							     //
+//									     //
+// DEPENDENCIES								     //
+//    sm_l.h								     //
+//    sa_l.h								     //
+//    smbenchfabric.h							     //
+//									     //
+//===========================================================================//
+
+#include "os_g.h"
+#include "ib_status.h"
+#include "ib_types.h"
+#include "ib_mad.h"
+#include "ib_macros.h"
+#include "sm_l.h"
+#include "sa_l.h"
+#include "cs_g.h"
+#include "cs_log.h"
+#include "smbenchfabric.h"
+#include <sys/resource.h>
+
+#define BENCH_POOL_SIZE			0x40000000
+#define BENCH_NODE_GUID_BASE	0x0011750000000000ull
+
+const char *phaseNames[PHASE_COUNT] = {
+	"discovery",
+	"cost_matrix",
+	"post_routing",
+	"lft",
+	"spanning_trees",
+	"mft",
+};
+
+const char *shapeNames[BENCH_SHAPE_COUNT] = {
+	"fattree",
+	"torus",
+	"mesh",
+	"hypercube",
+	"dragonfly",
+	"random",
+};
+
+BenchShape_t		shape = BENCH_FATTREE;
+const char			*routingName = NULL;
+int					radix = 16;			// fat tree switch radix
+int					tiers = 3;			// fat tree tiers
+int					dims[BENCH_MAX_DIMS] = { 8, 8, 8 };
+int					numDims = 3;
+int					groupSwitches = 8;	// dragonfly switches per group
+int					globalLinks = 4;	// dragonfly global links per switch
+int					randomSwitches = 256;	// switches of the random fabric
+int					hfisPerSwitch = -1;
+int					lmc = 0;
+int					numMcGroups = 16;
+int					csvOutput = 0;
+int					islCount;			// ISLs created so far by bench_link()
+int					islFailStride;		// while nonzero, every stride'th ISL is left down
+int					islFailOffset;		// shifts the ISLs islFailStride picks
+int					islFailCount;		// at most this many of them
+int					islsDown;			// ISLs left down by bench_link()
+
+Node_t				**hfiList;
+int					numHfis;
+
+static int			dimsGiven = 0;
+
+long
+maxRssKb(void)
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) != 0)
+		return 0;
+	return ru.ru_maxrss;
+}
+
+void
+fatal(const char *msg, Status_t status)
+{
+	fprintf(stderr, "%s: %s (status %d)\n", benchName, msg, (int)status);
+	exit(2);
+}
+
+//---------------------------------------------------------------------------//
+// Fabric construction.  Mirrors what discovery does for each node so the
+// routing modules see the same node/port state they would after a sweep.
+
+static Node_t *
+bench_add_node(uint8_t nodeType, int numPorts, const char *desc)
+{
+	Topology_t *topop = &sm_newTopology;
+	STL_NODE_INFO nodeInfo;
+	STL_NODE_DESCRIPTION nodeDesc;
+	Node_t *nodep;
+
+	if (numPorts < 1 || numPorts > MAX_STL_PORTS) {
+		fprintf(stderr, "%s: %d ports per node is not supported\n", benchName, numPorts);
+		exit(2);
+	}
+
+	memset(&nodeInfo, 0, sizeof(nodeInfo));
+	memset(&nodeDesc, 0, sizeof(nodeDesc));
+	nodeInfo.NodeType = nodeType;
+	nodeInfo.NumPorts = numPorts;
+	nodeInfo.NodeGUID = BENCH_NODE_GUID_BASE + topop->num_nodes + 1;
+	nodeInfo.SystemImageGUID = nodeInfo.NodeGUID;
+	nodeInfo.PortGUID = nodeInfo.NodeGUID;
+	snprintf((char *)nodeDesc.NodeString, sizeof(nodeDesc.NodeString), "%s", desc);
+
+	nodep = Node_Create(topop, &nodeInfo, nodeType, numPorts + 1, &nodeDesc, TRUE);
+	if (nodep == NULL)
+		fatal("cannot create node", VSTATUS_NOMEM);
+
+	nodep->index = topop->num_nodes++;
+
+	if (nodeType == NI_TYPE_SWITCH) {
+		Port_t *portp = sm_get_port(nodep, 0);
+
+		nodep->swIdx = topop->num_sws++;
+		topop->max_sws = topop->num_sws;
+		if (nodep->swIdx >= new_switchesInUse.nbits_m &&
+			!bitset_resize(&new_switchesInUse, new_switchesInUse.nbits_m + SM_NODE_NUM))
+			fatal("cannot resize switch bitset", VSTATUS_NOMEM);
+		bitset_set(&new_switchesInUse, nodep->swIdx);
+
+		nodep->switchInfo.LinearFDBCap = STL_GET_UNICAST_LID_MAX() + 1;
+		nodep->switchInfo.MulticastFDBCap = sm_mcast_mlid_table_cap;
+
+		portp->state = IB_PORT_ACTIVE;
+		portp->portData->portInfo.PortStates.s.PortState = IB_PORT_ACTIVE;
+		portp->portData->guid = nodeInfo.NodeGUID;
+		bitset_set(&nodep->activePorts, 0);
+	}
+
+	if (cl_qmap_insert(topop->nodeIdMap, (uint64_t)nodep->index,
+			&nodep->nodeIdMapObj.item) != &nodep->nodeIdMapObj.item)
+		fatal("duplicate node index", VSTATUS_BAD);
+	cl_qmap_set_obj(&nodep->nodeIdMapObj, nodep);
+
+	if (cl_qmap_insert(topop->nodeMap, nodep->nodeInfo.NodeGUID,
+			&nodep->mapObj.item) != &nodep->mapObj.item)
+		fatal("duplicate node GUID", VSTATUS_BAD);
+	cl_qmap_set_obj(&nodep->mapObj, nodep);
+
+	return nodep;
+}
+
+static void
+bench_init_port(Node_t *nodep, Port_t *portp, Node_t *neighborp, Port_t *nportp)
+{
+	PortData_t *portData = portp->portData;
+
+	portp->state = IB_PORT_ACTIVE;
+	portp->nodeno = neighborp->index;
+	portp->portno = nportp->index;
+
+	portData->portInfo.PortStates.s.PortState = IB_PORT_ACTIVE;
+	portData->portInfo.LinkSpeed.Active = STL_LINK_SPEED_25G;
+	portData->portInfo.LinkWidth.Active = STL_LINK_WIDTH_4X;
+	portData->portInfo.PortLinkMode.s.Active = STL_PORT_LINK_MODE_STL;
+	portData->vl0 = 8;
+	portData->maxVlMtu = STL_MTU_10240;
+	portData->rate = linkWidthToRate(portData);
+	portData->portSpeed = sm_GetSpeed(portData);
+
+	bitset_set(&nodep->activePorts, portp->index);
+
+	if (nodep->nodeInfo.NodeType == NI_TYPE_SWITCH) {
+		if (neighborp->nodeInfo.NodeType == NI_TYPE_SWITCH) {
+			portData->isIsl = 1;
+			nodep->numISLs++;
+			nodep->externalLinks = 1;
+		} else {
+			nodep->edgeSwitch = 1;
+		}
+	} else {
+		portData->guid = nodep->nodeInfo.NodeGUID;
+		sm_newTopology.num_endports++;
+	}
+}
+
+static void
+bench_link(Node_t *nodep1, int port1, Node_t *nodep2, int port2)
+{
+	Port_t *portp1 = sm_get_port(nodep1, port1);
+	Port_t *portp2 = sm_get_port(nodep2, port2);
+	int isl;
+
+	if (!sm_valid_port(portp1) || !sm_valid_port(portp2) ||
+		portp1->state != IB_PORT_NOP || portp2->state != IB_PORT_NOP) {
+		fprintf(stderr, "%s: invalid link %s:%d - %s:%d\n", benchName,
+			sm_nodeDescString(nodep1), port1, sm_nodeDescString(nodep2), port2);
+		exit(2);
+	}
+
+	if (nodep1->nodeInfo.NodeType == NI_TYPE_SWITCH &&
+		nodep2->nodeInfo.NodeType == NI_TYPE_SWITCH) {
+		isl = islCount++;
+		if (islFailStride && (isl + islFailOffset) % islFailStride == islFailStride / 2 &&
+			isl / islFailStride < islFailCount) {
+			islsDown++;
+			return;
+		}
+	}
+
+	bench_init_port(nodep1, portp1, nodep2, portp2);
+	bench_init_port(nodep2, portp2, nodep1, portp1);
+	sm_newTopology.num_ports += 2;
+}
+
+static void
+bench_add_hfis(Node_t *switchp, int firstPort, int count)
+{
+	char desc[ND_LEN];
+	Node_t *hfip;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		snprintf(desc, sizeof(desc), "hfi%d %s", i, sm_nodeDescString(switchp));
+		hfip = bench_add_node(NI_TYPE_CA, 1, desc);
+		bench_link(switchp, firstPort + i, hfip, 1);
+		hfiList[numHfis++] = hfip;
+	}
+}
+
+// k-ary fat tree.  Edge switches use ports 1..k/2 down and k/2+1..k up; in a
+// 3 tier tree each pod has k/2 edge and k/2 aggregation switches below
+// (k/2)^2 core switches, in a 2 tier tree k leaves connect to k/2 spines.
+static void
+bench_build_fattree(void)
+{
+	int h = radix / 2, p, i, j, pods = tiers == 3 ? radix : 1;
+	int edgesPerPod = tiers == 3 ? h : radix;
+	Node_t **core, **agg, **edge;
+	char desc[ND_LEN];
+
+	core = calloc(h * h, sizeof(Node_t *));
+	agg = calloc(pods * h, sizeof(Node_t *));
+	edge = calloc(pods * edgesPerPod, sizeof(Node_t *));
+	hfiList = calloc(pods * edgesPerPod * hfisPerSwitch, sizeof(Node_t *));
+	if (!core || !agg || !edge || !hfiList)
+		fatal("out of memory", VSTATUS_NOMEM);
+
+	if (tiers == 3) {
+		for (i = 0; i < h * h; i++) {
+			snprintf(desc, sizeof(desc), "core%d", i);
+			core[i] = bench_add_node(NI_TYPE_SWITCH, radix, desc);
+		}
+	}
+	for (p = 0; p < pods; p++) {
+		for (i = 0; i < h; i++) {
+			snprintf(desc, sizeof(desc), tiers == 3 ? "agg%d-%d" : "spine%d-%d", p, i);
+			agg[p * h + i] = bench_add_node(NI_TYPE_SWITCH, radix, desc);
+		}
+		for (i = 0; i < edgesPerPod; i++) {
+			snprintf(desc, sizeof(desc), "edge%d-%d", p, i);
+			edge[p * edgesPerPod + i] = bench_add_node(NI_TYPE_SWITCH, radix, desc);
+		}
+	}
+
+	for (p = 0; p < pods; p++) {
+		for (i = 0; i < edgesPerPod; i++) {
+			for (j = 0; j < h; j++)
+				bench_link(edge[p * edgesPerPod + i], h + 1 + j, agg[p * h + j], 1 + i);
+		}
+		if (tiers == 3) {
+			for (i = 0; i < h; i++) {
+				for (j = 0; j < h; j++)
+					bench_link(agg[p * h + i], h + 1 + j, core[i * h + j], 1 + p);
+			}
+		}
+	}
+
+	for (i = 0; i < pods * edgesPerPod; i++)
+		bench_add_hfis(edge[i], 1, hfisPerSwitch);
+
+	free(core);
+	free(agg);
+	free(edge);
+}
+
+// Torus/mesh: dimension d uses port 2d+1 towards the lower coordinate and
+// port 2d+2 towards the higher one.  HFIs follow the dimension ports.
+static void
+bench_build_grid(int toroidal)
+{
+	int total = 1, d, i, stride, coord, numPorts = 2 * numDims + hfisPerSwitch;
+	Node_t **switches;
+	char desc[ND_LEN];
+
+	for (d = 0; d < numDims; d++)
+		total *= dims[d];
+
+	switches = calloc(total, sizeof(Node_t *));
+	hfiList = calloc(total * hfisPerSwitch, sizeof(Node_t *));
+	if (!switches || !hfiList)
+		fatal("out of memory", VSTATUS_NOMEM);
+
+	// Row-major creation order means each switch is reached through an
+	// already created neighbor, which DOR coordinate propagation relies on.
+	for (i = 0; i < total; i++) {
+		snprintf(desc, sizeof(desc), "sw%d", i);
+		switches[i] = bench_add_node(NI_TYPE_SWITCH, numPorts, desc);
+	}
+
+	for (i = 0; i < total; i++) {
+		for (d = 0, stride = 1; d < numDims; stride *= dims[d], d++) {
+			coord = (i / stride) % dims[d];
+			if (coord + 1 < dims[d])
+				bench_link(switches[i], 2 * d + 2, switches[i + stride], 2 * d + 1);
+			else if (toroidal && dims[d] > 2)
+				bench_link(switches[i], 2 * d + 2, switches[i - coord * stride], 2 * d + 1);
+		}
+	}
+
+	for (i = 0; i < total; i++)
+		bench_add_hfis(switches[i], 2 * numDims + 1, hfisPerSwitch);
+
+	free(switches);
+}
+
+// Hypercube of order n: port d+1 connects to the switch whose index differs
+// in bit d.
+static void
+bench_build_hypercube(void)
+{
+	int order = dims[0], total = 1 << order, i, d;
+	Node_t **switches;
+	char desc[ND_LEN];
+
+	switches = calloc(total, sizeof(Node_t *));
+	hfiList = calloc(total * hfisPerSwitch, sizeof(Node_t *));
+	if (!switches || !hfiList)
+		fatal("out of memory", VSTATUS_NOMEM);
+
+	for (i = 0; i < total; i++) {
+		snprintf(desc, sizeof(desc), "sw%d", i);
+		switches[i] = bench_add_node(NI_TYPE_SWITCH, order + hfisPerSwitch, desc);
+	}
+
+	for (i = 0; i < total; i++) {
+		for (d = 0; d < order; d++) {
+			if (i & (1 << d)) continue;
+			bench_link(switches[i], d + 1, switches[i | (1 << d)], d + 1);
+		}
+	}
+
+	for (i = 0; i < total; i++)
+		bench_add_hfis(switches[i], order + 1, hfisPerSwitch);
+
+	free(switches);
+}
+
+// Balanced dragonfly with a*g+1 groups.  Within a group switches are fully
+// connected on ports 1..a-1; global link l of group x (switch l/g, port
+// a+l%g) goes to group l, or l+1 when l >= x, so every pair of groups has
+// exactly one link.
+static void
+bench_build_dragonfly(void)
+{
+	int a = groupSwitches, g = globalLinks, groups = a * g + 1;
+	int total = groups * a, x, y, i, j, l, lr;
+	Node_t **switches;
+	char desc[ND_LEN];
+
+	switches = calloc(total, sizeof(Node_t *));
+	hfiList = calloc(total * hfisPerSwitch, sizeof(Node_t *));
+	if (!switches || !hfiList)
+		fatal("out of memory", VSTATUS_NOMEM);
+
+	for (x = 0; x < groups; x++) {
+		for (i = 0; i < a; i++) {
+			snprintf(desc, sizeof(desc), "grp%d-sw%d", x, i);
+			switches[x * a + i] = bench_add_node(NI_TYPE_SWITCH, a - 1 + g + hfisPerSwitch, desc);
+		}
+	}
+
+	for (x = 0; x < groups; x++) {
+		for (i = 0; i < a; i++) {
+			for (j = i + 1; j < a; j++)
+				bench_link(switches[x * a + i], j, switches[x * a + j], i + 1);
+		}
+		for (l = 0; l < a * g; l++) {
+			y = l < x ? l : l + 1;
+			if (y < x) continue;
+			lr = x < y ? x : x - 1;
+			bench_link(switches[x * a + l / g], a + l % g, switches[y * a + lr / g], a + lr % g);
+		}
+	}
+
+	for (i = 0; i < total; i++)
+		bench_add_hfis(switches[i], a + g, hfisPerSwitch);
+
+	free(switches);
+}
+
+// Random fabric of randomSwitches switches with radix ISL ports each.  Ports
+// 1 and 2 close a ring so the fabric is connected; the other ISL ports are
+// paired at random, which may cable two switches together more than once.
+// A port that would be paired with its own switch is left down.  HFIs
+// follow the ISL ports.
+static void
+bench_build_random(void)
+{
+	int total = randomSwitches, numStubs = total * (radix - 2), i, j, t;
+	uint32_t seed = 1;
+	Node_t **switches;
+	int *stubs;
+	char desc[ND_LEN];
+
+	switches = calloc(total, sizeof(Node_t *));
+	stubs = calloc(MAX(numStubs, 1), sizeof(int));
+	hfiList = calloc(total * hfisPerSwitch, sizeof(Node_t *));
+	if (!switches || !stubs || !hfiList)
+		fatal("out of memory", VSTATUS_NOMEM);
+
+	for (i = 0; i < total; i++) {
+		snprintf(desc, sizeof(desc), "sw%d", i);
+		switches[i] = bench_add_node(NI_TYPE_SWITCH, radix + hfisPerSwitch, desc);
+	}
+
+	for (i = 0; i < total; i++)
+		bench_link(switches[i], 2, switches[(i + 1) % total], 1);
+
+	// Stub s is port 3 + s % (radix - 2) of switch s / (radix - 2).
+	for (i = 0; i < numStubs; i++)
+		stubs[i] = i;
+	for (i = numStubs - 1; i > 0; i--) {
+		seed = seed * 1103515245 + 12345;
+		j = (seed >> 8) % (i + 1);
+		t = stubs[i];
+		stubs[i] = stubs[j];
+		stubs[j] = t;
+	}
+	for (i = 0; i + 1 < numStubs; i += 2) {
+		if (stubs[i] / (radix - 2) == stubs[i + 1] / (radix - 2))
+			continue;
+		bench_link(switches[stubs[i] / (radix - 2)], 3 + stubs[i] % (radix - 2),
+			switches[stubs[i + 1] / (radix - 2)], 3 + stubs[i + 1] % (radix - 2));
+	}
+
+	for (i = 0; i < total; i++)
+		bench_add_hfis(switches[i], radix + 1, hfisPerSwitch);
+
+	free(stubs);
+	free(switches);
+}
+
+// Sequential LID assignment: switches get one LID on port 0, HFIs get
+// 2^lmc aligned LIDs.
+static void
+bench_assign_lids(void)
+{
+	Topology_t *topop = &sm_newTopology;
+	STL_LID lid = 1;
+	Node_t *nodep;
+	Port_t *portp;
+	int i, count;
+
+	for_all_nodes(topop, nodep) {
+		if (nodep->nodeInfo.NodeType == NI_TYPE_SWITCH) {
+			portp = sm_get_port(nodep, 0);
+			portp->portData->lmc = 0;
+		} else {
+			portp = sm_get_port(nodep, 1);
+			portp->portData->lmc = lmc;
+			lid = (lid + (1 << lmc) - 1) & ~((1 << lmc) - 1);
+		}
+		count = 1 << portp->portData->lmc;
+		if (lid + count - 1 > STL_GET_UNICAST_LID_MAX())
+			fatal("fabric needs more LIDs than are available", VSTATUS_NOMEM);
+
+		portp->portData->lid = lid;
+		for (i = 0; i < count; i++) {
+			lidmap[lid + i].newNodep = nodep;
+			lidmap[lid + i].newPortp = portp;
+			lidmap[lid + i].guid = portp->portData->guid;
+		}
+		if (cl_qmap_insert(topop->portMap, portp->portData->guid,
+				&portp->portData->mapObj.item) == &portp->portData->mapObj.item)
+			cl_qmap_set_obj(&portp->portData->mapObj, portp);
+		lid += count;
+	}
+	topop->maxLid = lid - 1;
+
+	for_all_switch_nodes(topop, nodep)
+		nodep->switchInfo.LinearFDBTop = topop->maxLid;
+
+	// As sweep_resolve() does once LIDs are final.
+	if (sm_build_lid_port_array(topop) != VSTATUS_OK)
+		fatal("cannot build LID to port array", VSTATUS_NOMEM);
+}
+
+// Runs the routing module hooks the way sweep_discovery() does once the
+// fabric graph is complete.
+static void
+bench_discovery_hooks(void)
+{
+	Topology_t *topop = &sm_newTopology;
+	RoutingModule_t *rm = topop->routingModule;
+	void *context = NULL;
+	Node_t *nodep, *nnodep;
+	Port_t *portp;
+	Status_t status;
+
+	if ((status = rm->funcs.pre_process_discovery(topop, &context)) != VSTATUS_OK)
+		fatal("pre_process_discovery failed", status);
+
+	for_all_nodes(topop, nodep) {
+		if ((status = rm->funcs.discover_node(topop, nodep, context)) != VSTATUS_OK)
+			fatal("discover_node failed", status);
+	}
+
+	for_all_nodes(topop, nodep) {
+		for_all_physical_ports(nodep, portp) {
+			if (!sm_valid_port(portp) || portp->state < IB_PORT_INIT)
+				continue;
+			if ((nnodep = sm_find_node(topop, portp->nodeno)) == NULL)
+				continue;
+
+			if (nodep->nodeInfo.NodeType == NI_TYPE_SWITCH &&
+				nnodep->nodeInfo.NodeType == NI_TYPE_SWITCH) {
+				if (portp->portData->maxVlMtu < topop->maxMcastMtu)
+					topop->maxMcastMtu = portp->portData->maxVlMtu;
+				if (linkrate_lt(portp->portData->rate, topop->maxMcastRate))
+					topop->maxMcastRate = portp->portData->rate;
+				if (portp->portData->maxVlMtu > topop->maxISLMtu)
+					topop->maxISLMtu = portp->portData->maxVlMtu;
+				if (linkrate_gt(portp->portData->rate, topop->maxISLRate))
+					topop->maxISLRate = portp->portData->rate;
+			}
+
+			if (nodep->nodeInfo.NodeType == NI_TYPE_SWITCH) {
+				if ((status = rm->funcs.discover_node_port(topop, nodep, portp, context)) != VSTATUS_OK)
+					fatal("discover_node_port failed", status);
+			}
+		}
+	}
+
+	if ((status = rm->funcs.post_process_discovery(topop, VSTATUS_OK, context)) != VSTATUS_OK)
+		fatal("post_process_discovery failed", status);
+
+	if ((status = sm_build_node_array(topop)) != VSTATUS_OK)
+		fatal("cannot build node array", status);
+}
+
+void
+bench_build(void)
+{
+	switch (shape) {
+	case BENCH_FATTREE:
+		bench_build_fattree();
+		break;
+	case BENCH_TORUS:
+	case BENCH_MESH:
+		bench_build_grid(shape == BENCH_TORUS);
+		break;
+	case BENCH_HYPERCUBE:
+		bench_build_hypercube();
+		break;
+	case BENCH_DRAGONFLY:
+		bench_build_dragonfly();
+		break;
+	case BENCH_RANDOM:
+		bench_build_random();
+		break;
+	default:
+		break;
+	}
+	bench_assign_lids();
+	bench_discovery_hooks();
+}
+
+// The GID a port's SA requests name it by.
+IB_GID
+bench_port_gid(Port_t *portp)
+{
+	IB_GID gid;
+
+	gid.Type.Global.SubnetPrefix = sm_config.subnet_prefix;
+	gid.Type.Global.InterfaceID = portp->portData->guid;
+	return gid;
+}
+
+// Creates multicast groups with real HFI members; group g is joined by
+// every HFI whose ordinal is congruent to g.
+void
+bench_create_mc_groups(void)
+{
+	McGroup_t *mcGroup;
+	McMember_t *mcMember;
+	Port_t *portp;
+	IB_GID mGid;
+	STL_LID mLid;
+	Status_t status;
+	int g, i;
+
+	for (g = 0; g < numMcGroups; g++) {
+		mGid.Type.Global.SubnetPrefix = 0xff12401bffff0000ull;
+		mGid.Type.Global.InterfaceID = g + 1;
+		if ((status = sm_multicast_assign_lid(mGid, 0xffff, sm_newTopology.maxMcastMtu,
+				sm_newTopology.maxMcastRate, 0, &mLid)) != VSTATUS_OK)
+			fatal("cannot assign multicast LID", status);
+		McGroup_Create(mcGroup, mGid, mLid);
+		mcGroup->pKey = 0xffff;
+		mcGroup->mtu = sm_newTopology.maxMcastMtu;
+		mcGroup->rate = sm_newTopology.maxMcastRate;
+		mcGroup->hopLimit = 0xFF;
+		mcGroup->scope = IB_LINK_LOCAL_SCOPE;
+		bitset_set(&mcGroup->new_vfMembers, 0);
+
+		for (i = g; i < numHfis; i += numMcGroups) {
+			portp = sm_get_port(hfiList[i], 1);
+			McMember_Create(mcGroup, mcMember, bench_port_gid(portp));
+			mcMember->slid = portp->portData->lid;
+			mcMember->state = MCMEMBER_STATE_FULL_MEMBER;
+			mcMember->nodeGuid = hfiList[i]->nodeInfo.NodeGUID;
+			mcMember->portGuid = portp->portData->guid;
+			mcMember->record.JoinFullMember = 1;
+			mcGroup->members_full++;
+		}
+	}
+}
+
+static void
+bench_config(void)
+{
+	int d;
+
+	// Values the routing code reads from sm_config, at their XML defaults.
+	sm_config.port = 1;
+	sm_config.max_supported_lid = SM_DEFAULT_MAX_LID | 0x3FF;
+	sm_config.lmc = lmc;
+	sm_config.shortestPathBalanced = 1;
+	sm_config.lft_threads = 4;
+	sm_config.lft_carry_over = 1;
+	sm_config.rcv_wait_msec = MAD_RCV_WAIT_MSEC;
+	sm_config.max_retries = MAD_RETRIES;
+	sm_config.sma_batch_size = 2;
+	sm_config.sma_batch_size_max = 0;
+	sm_config.lft_multi_block = STL_MAX_PAYLOAD_SMP_DR / MAX_LFT_ELEMENTS_BLOCK;
+	sm_config.lft_delta_writes = 1;
+	sm_config.psThreads = 4;
+	sm_config.incremental_cost_matrix_threshold = 16;
+	sm_config.smDorRouting.warn_threshold = DEFAULT_DOR_PORT_PAIR_WARN_THRESHOLD;
+	sm_config.smDorRouting.escapeVLs = DEFAULT_ESCAPE_VLS_IN_USE;
+	sm_config.smDorRouting.faultRegions = DEFAULT_FAULT_REGIONS_IN_USE;
+	sm_config.smDorRouting.routeLast.dg_index = -1;
+	sm_config.ftreeRouting.routeLast.dg_index = -1;
+	sm_config.ftreeRouting.coreSwitches.dg_index = -1;
+	sm_mc_config.mcast_mlid_table_cap = DEFAULT_SW_MLID_TABLE_CAP;
+	sm_mcast_mlid_table_cap = DEFAULT_SW_MLID_TABLE_CAP;
+
+	// Shape specific routing configuration, equivalent to the
+	// FatTreeTopology and MeshTorusTopology XML sections.
+	if (shape == BENCH_FATTREE) {
+		sm_config.ftreeRouting.tierCount = tiers;
+		sm_config.ftreeRouting.fis_on_same_tier = 1;
+	} else if (shape == BENCH_TORUS || shape == BENCH_MESH) {
+		sm_config.smDorRouting.dimensionCount = numDims;
+		for (d = 0; d < numDims; d++) {
+			SmDimension_t *dim = &sm_config.smDorRouting.dimension[d];
+
+			dim->toroidal = (shape == BENCH_TORUS && dims[d] > 2);
+			dim->length = dims[d];
+			dim->portCount = 1;
+			dim->portPair[0].port1 = 2 * d + 1;
+			dim->portPair[0].port2 = 2 * d + 2;
+			if (dim->toroidal)
+				sm_config.smDorRouting.numToroidal++;
+		}
+		if (sm_config.smDorRouting.numToroidal) {
+			sm_config.smDorRouting.topology = DOR_TORUS;
+			sm_config.smDorRouting.routingSCs = 4;
+		} else {
+			sm_config.smDorRouting.topology = DOR_MESH;
+			sm_config.smDorRouting.routingSCs = 2;
+		}
+	}
+}
+
+// Empty sm_newTopology with its maps and a fresh instance of the routing
+// module, as sweep_initialize() sets it up.
+void
+bench_new_topology(void)
+{
+	Topology_t *topop = &sm_newTopology;
+	Status_t status;
+
+	memset(topop, 0, sizeof(Topology_t));
+	if (vs_pool_alloc(&sm_pool, sizeof(cl_qmap_t), (void *)&topop->nodeIdMap) != VSTATUS_OK ||
+		vs_pool_alloc(&sm_pool, sizeof(cl_qmap_t), (void *)&topop->nodeMap) != VSTATUS_OK ||
+		vs_pool_alloc(&sm_pool, sizeof(cl_qmap_t), (void *)&topop->portMap) != VSTATUS_OK)
+		fatal("cannot allocate topology maps", VSTATUS_NOMEM);
+	cl_qmap_init(topop->nodeIdMap, NULL);
+	cl_qmap_init(topop->nodeMap, NULL);
+	cl_qmap_init(topop->portMap, NULL);
+	topop->maxMcastMtu = STL_MTU_MAX;
+	topop->maxMcastRate = IB_STATIC_RATE_MAX;
+	sm_topop = topop;
+
+	if ((status = sm_routing_makeModule(routingName, &topop->routingModule)) != VSTATUS_OK) {
+		fprintf(stderr, "%s: unknown routing algorithm %s\n", benchName, routingName);
+		exit(2);
+	}
+	if (topop->routingModule->funcs.process_xml_config &&
+		(status = topop->routingModule->funcs.process_xml_config()) != VSTATUS_OK)
+		fatal("routing configuration rejected", status);
+}
+
+void
+bench_init(void)
+{
+	Status_t status;
+
+	memset(&sm_pool, 0, sizeof(sm_pool));
+	if ((status = vs_pool_create(&sm_pool, 0, (uint8_t *)"sm_pool", NULL, BENCH_POOL_SIZE)) != VSTATUS_OK)
+		fatal("cannot create SM pool", status);
+
+	bench_config();
+
+	if (!bitset_init(&sm_pool, &new_switchesInUse, SM_NODE_NUM) ||
+		!bitset_init(&sm_pool, &old_switchesInUse, SM_NODE_NUM) ||
+		!bitset_init(&sm_pool, &new_endnodesInUse, SM_NODE_NUM))
+		fatal("cannot allocate switch bitsets", VSTATUS_NOMEM);
+
+	sm_popo_init(&sm_popo);
+	if ((status = sm_lidmap_alloc()) != VSTATUS_OK)
+		fatal("cannot allocate lidmap", status);
+	if ((status = vs_lock_init(&sm_datelineSwitchGUIDLock, VLOCK_FREE, VLOCK_THREAD)) != VSTATUS_OK)
+		fatal("cannot init dateline lock", status);
+	if ((status = vs_lock_init(&old_topology_lock, VLOCK_FREE, VLOCK_RWTHREAD)) != VSTATUS_OK)
+		fatal("cannot init old topology lock", status);
+	if ((status = sa_McGroupInit()) != VSTATUS_OK)
+		fatal("cannot init multicast groups", status);
+	if (vs_pool_alloc(&sm_pool, sizeof(McSpanningTree_t *) * (STL_MTU_MAX * IB_STATIC_RATE_MAX),
+			(void *)&uniqueSpanningTrees) != VSTATUS_OK)
+		fatal("cannot allocate spanning tree array", VSTATUS_NOMEM);
+	sm_multicast_init_mlid_list();
+	if ((status = sm_multicast_set_default_group_class(sm_mcast_mlid_table_cap, 0)) != VSTATUS_OK)
+		fatal("cannot set default multicast group class", status);
+
+	if ((status = sm_routing_init()) != VSTATUS_OK)
+		fatal("cannot init routing modules", status);
+	bench_new_topology();
+}
+
+//---------------------------------------------------------------------------//
+// Routing phases, in the order topology_assignments()/topology_activate()
+// run them.
+
+void
+bench_reset_routing_counters(void)
+{
+	Node_t *nodep;
+	Port_t *portp;
+
+	for_all_nodes(&sm_newTopology, nodep) {
+		nodep->numLidsRouted = 0;
+		nodep->numBaseLidsRouted = 0;
+		for_all_ports(nodep, portp) {
+			if (!sm_valid_port(portp)) continue;
+			portp->portData->lidsRouted = 0;
+			portp->portData->baseLidsRouted = 0;
+		}
+	}
+}
+
+Status_t
+bench_run_phase(BenchPhase_t phase)
+{
+	Topology_t *topop = &sm_newTopology;
+	RoutingModule_t *rm = topop->routingModule;
+	int rebalance = 1, routing_needed = 1;
+	Node_t *switchp;
+	Status_t status = VSTATUS_OK;
+
+	switch (phase) {
+	case PHASE_COST_MATRIX:
+		if ((status = rm->funcs.allocate_cost_matrix(topop)) != VSTATUS_OK)
+			break;
+		rm->funcs.initialize_cost_matrix(topop);
+		status = rm->funcs.calculate_cost_matrix(topop, topop->max_sws, topop->cost, topop->path);
+		if (status == VSTATUS_OK)
+			status = sm_routing_compact_cost_matrix(topop);
+		topology_cost_path_changes = 1;
+		break;
+	case PHASE_POST_ROUTING:
+		status = rm->funcs.post_process_routing(topop, &old_topology, &rebalance);
+		break;
+	case PHASE_LFT:
+		bench_reset_routing_counters();
+		if (rm->funcs.init_switch_routing &&
+			(status = rm->funcs.init_switch_routing(topop, &routing_needed, &rebalance)) != VSTATUS_OK)
+			break;
+		// Modules that route lazily fill in the remaining switches as
+		// topology_setup_switches_LR_DR() would.
+		for_all_switch_nodes(topop, switchp) {
+			if (switchp->lft) continue;
+			if ((status = rm->funcs.calculate_routes(topop, switchp)) != VSTATUS_OK)
+				break;
+		}
+		break;
+	case PHASE_SPANNING_TREES:
+		rm->funcs.build_spanning_trees();
+		break;
+	case PHASE_MFT:
+		status = sm_calculate_mfts();
+		break;
+	default:
+		break;
+	}
+
+	return status;
+}
+
+// FNV-1a over all LFTs and the MFT blocks in use, so that runs before and
+// after a routing change can be checked for identical output.
+uint64_t
+bench_hash(const void *data, size_t len, uint64_t hash)
+{
+	const uint8_t *p = data;
+
+	while (len--) {
+		hash ^= *p++;
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+void
+bench_table_hashes(Topology_t *topop, uint64_t *lftHash, uint64_t *mftHash)
+{
+	STL_LID maxMcLid = sm_multicast_get_max_lid();
+	Node_t *switchp;
+	STL_LID lid;
+
+	*lftHash = *mftHash = 0xcbf29ce484222325ull;
+	for_all_switch_nodes(topop, switchp) {
+		if (switchp->lft)
+			*lftHash = bench_hash(switchp->lft, sizeof(PORT) * (topop->maxLid + 1), *lftHash);
+		if (!switchp->mft) continue;
+		for (lid = STL_LID_MULTICAST_BEGIN; lid <= maxMcLid; lid++) {
+			*mftHash = bench_hash(switchp->mft[lid - STL_LID_MULTICAST_BEGIN],
+				sizeof(STL_PORTMASK) * STL_NUM_MFT_POSITIONS_MASK, *mftHash);
+		}
+	}
+}
+
+//---------------------------------------------------------------------------//
+// Fabric options, BENCH_FABRIC_OPTS for getopt().
+
+void
+bench_fabric_usage(void)
+{
+	fprintf(stderr, "    -t  fattree, torus, mesh, hypercube, dragonfly or random (default fattree)\n");
+	fprintf(stderr, "    -r  routing algorithm (default fattree for fattree, dor for torus/mesh, else shortestpath)\n");
+	fprintf(stderr, "    -k  fattree switch radix, even, at most 64 (default 16); ISLs per random switch\n");
+	fprintf(stderr, "    -T  fattree tiers, 2 or 3 (default 3)\n");
+	fprintf(stderr, "    -d  torus/mesh dimension lengths, e.g. 8x8x8; hypercube order, e.g. 9\n");
+	fprintf(stderr, "    -a  dragonfly switches per group (default 8)\n");
+	fprintf(stderr, "    -g  dragonfly global links per switch (default 4); groups = a*g+1\n");
+	fprintf(stderr, "    -n  random fabric switches (default 256)\n");
+	fprintf(stderr, "    -e  HFIs per edge switch (default radix/2 for fattree, 4 for torus/mesh/hypercube, g for dragonfly)\n");
+	fprintf(stderr, "    -l  HFI LMC (default 0)\n");
+	fprintf(stderr, "    -m  multicast groups (default 16)\n");
+}
+
+static int
+parse_dims(const char *arg)
+{
+	char *end;
+	long v;
+
+	numDims = 0;
+	do {
+		v = strtol(arg, &end, 10);
+		if (end == arg || v < 1 || v > 255 || numDims >= BENCH_MAX_DIMS)
+			return 0;
+		dims[numDims++] = (int)v;
+		arg = end + 1;
+	} while (*end == 'x' || *end == 'X' || *end == ',');
+
+	return *end == '\0';
+}
+
+// Takes one getopt() option of BENCH_FABRIC_OPTS; returns 0 if c is not
+// one of them or its argument is invalid.
+int
+bench_fabric_option(int c, const char *arg)
+{
+	int i;
+
+	switch (c) {
+	case 't':
+		for (i = 0; i < BENCH_SHAPE_COUNT; i++) {
+			if (strcmp(arg, shapeNames[i]) == 0)
+				break;
+		}
+		if (i == BENCH_SHAPE_COUNT)
+			return 0;
+		shape = (BenchShape_t)i;
+		break;
+	case 'r':
+		routingName = arg;
+		break;
+	case 'k':
+		radix = atoi(arg);
+		break;
+	case 'T':
+		tiers = atoi(arg);
+		break;
+	case 'd':
+		if (!parse_dims(arg))
+			return 0;
+		dimsGiven = 1;
+		break;
+	case 'a':
+		groupSwitches = atoi(arg);
+		break;
+	case 'g':
+		globalLinks = atoi(arg);
+		break;
+	case 'n':
+		randomSwitches = atoi(arg);
+		break;
+	case 'e':
+		hfisPerSwitch = atoi(arg);
+		break;
+	case 'l':
+		lmc = atoi(arg);
+		break;
+	case 'm':
+		numMcGroups = atoi(arg);
+		break;
+	default:
+		return 0;
+	}
+	return 1;
+}
+
+// Fills in the defaults that depend on the shape once every option is
+// known; returns 0 if the fabric options are inconsistent.
+int
+bench_fabric_check(void)
+{
+	if (shape == BENCH_HYPERCUBE && !dimsGiven) {
+		dims[0] = 9;
+		numDims = 1;
+	}
+	if (hfisPerSwitch < 0) {
+		hfisPerSwitch = (shape == BENCH_FATTREE) ? radix / 2 :
+			(shape == BENCH_DRAGONFLY) ? globalLinks : 4;
+	}
+	if (routingName == NULL) {
+		routingName = (shape == BENCH_FATTREE) ? "fattree" :
+			(shape == BENCH_TORUS || shape == BENCH_MESH) ? "dor" : "shortestpath";
+	}
+
+	return !(radix < 2 || radix % 2 || radix > MAX_STL_PORTS || (tiers != 2 && tiers != 3) ||
+		hfisPerSwitch < 0 || lmc < 0 || lmc > 7 || numMcGroups < 0 ||
+		numMcGroups > DEFAULT_SW_MLID_TABLE_CAP ||
+		groupSwitches < 1 || globalLinks < 1 || randomSwitches < 3 ||
+		(shape == BENCH_RANDOM && radix < 4) ||
+		(shape == BENCH_HYPERCUBE && (numDims != 1 || dims[0] > 16)));
+}
@@ -0,0 +1,118 @@
+/* BEGIN_ICS_COPYRIGHT7 ****************************************
+
+Copyright (c) 2015-2020, Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+** END_ICS_COPYRIGHT7   ****************************************/
+
+/* [ICS VERSION STRING: unknown] */
+
+//===========================================================================//
+//									     //
+// FILE NAME								     //
+//    smbenchfabric.h							     //
+//									     //
+// DESCRIPTION								     //
+//    Synthetic fabric shared by smroutebench and smsabench.		     //
+//									     //
+// DEPENDENCIES								     //
+//    sm_l.h								     //
+//									     //
+//===========================================================================//
+
+#ifndef _SMBENCHFABRIC_H_
+#define _SMBENCHFABRIC_H_ 1
+
+#include "sm_l.h"
+
+#define BENCH_MAX_DIMS			6
+#define BENCH_FABRIC_OPTS		"t:r:k:T:d:a:g:n:e:l:m:"
+
+typedef enum {
+	BENCH_FATTREE,
+	BENCH_TORUS,
+	BENCH_MESH,
+	BENCH_HYPERCUBE,
+	BENCH_DRAGONFLY,
+	BENCH_RANDOM,
+	BENCH_SHAPE_COUNT
+} BenchShape_t;
+
+typedef enum {
+	PHASE_DISCOVERY,
+	PHASE_COST_MATRIX,
+	PHASE_POST_ROUTING,
+	PHASE_LFT,
+	PHASE_SPANNING_TREES,
+	PHASE_MFT,
+	PHASE_COUNT
+} BenchPhase_t;
+
+extern	const char	*benchName;		// defined by each bench, for messages
+extern	const char	*phaseNames[PHASE_COUNT];
+extern	const char	*shapeNames[BENCH_SHAPE_COUNT];
+
+// Fabric options
+extern	BenchShape_t	shape;
+extern	const char	*routingName;
+extern	int		radix;
+extern	int		tiers;
+extern	int		dims[BENCH_MAX_DIMS];
+extern	int		numDims;
+extern	int		groupSwitches;
+extern	int		globalLinks;
+extern	int		randomSwitches;
+extern	int		hfisPerSwitch;
+extern	int		lmc;
+extern	int		numMcGroups;
+extern	int		csvOutput;
+
+// ISLs bench_link() leaves down while islFailStride is set
+extern	int		islCount;
+extern	int		islFailStride;
+extern	int		islFailOffset;
+extern	int		islFailCount;
+extern	int		islsDown;
+
+extern	Node_t	**hfiList;		// end nodes of the built fabric
+extern	int		numHfis;
+
+extern	void	bench_fabric_usage(void);
+extern	int		bench_fabric_option(int c, const char *arg);
+extern	int		bench_fabric_check(void);
+
+extern	long	maxRssKb(void);
+extern	void	fatal(const char *msg, Status_t status);
+extern	void	bench_init(void);
+extern	void	bench_new_topology(void);
+extern	void	bench_build(void);
+extern	void	bench_create_mc_groups(void);
+extern	IB_GID	bench_port_gid(Port_t *portp);
+extern	void	bench_reset_routing_counters(void);
+extern	Status_t	bench_run_phase(BenchPhase_t phase);
+extern	uint64_t	bench_hash(const void *data, size_t len, uint64_t hash);
+extern	void	bench_table_hashes(Topology_t *topop, uint64_t *lftHash, uint64_t *mftHash);
+
+#endif	// _SMBENCHFABRIC_H_
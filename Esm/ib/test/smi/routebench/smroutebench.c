@@ -0,0 +1,1530 @@
+/* BEGIN_ICS_COPYRIGHT7 ****************************************
+
+Copyright (c) 2015-2020, Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+** END_ICS_COPYRIGHT7   ****************************************/
+
+/* [ICS VERSION STRING: unknown] */
+
+//===========================================================================//
+//									     //
+// FILE NAME								     //
+//    smroutebench.c							     //
+//									     //
+// DESCRIPTION								     //
+//    Offline benchmark for the SM routing engines.  Runs the routing	     //
+//    phases of a sweep against a synthetic fabric from smbenchfabric.c:     //
+//    discovery hooks, cost matrix, post routing, LFT calculation,	     //
+//    multicast spanning trees and MFTs.  Per-phase wall time and peak RSS  //
+//    are reported as JSON lines or CSV.  Each optional mode checks its	     //
+//    result against a reference calculation and exits non-zero if they    //
+//    differ.								     //
+//									     //
+// DEPENDENCIES								     //
+//    sm_l.h								     //
+//    sa_l.h								     //
+//    smbenchfabric.h							     //
+//									     //
+//===========================================================================//
+
+#include "os_g.h"
+#include "ib_status.h"
+#include "ib_types.h"
+#include "ib_mad.h"
+#include "ib_macros.h"
+#include "sm_l.h"
+#include "sa_l.h"
+#include "cs_g.h"
+#include "cs_log.h"
+#include "smbenchfabric.h"
+#include <pthread.h>
+#include <time.h>
+
+extern	int	optind;
+extern	char	*optarg;
+extern	ParallelSweepContext_t	*sm_psc_g;
+
+#define BENCH_MAX_READERS		64
+#define BENCH_READER_SAMPLES	(1 << 20)
+#define BENCH_SMA_DEPTH			16	// requests a healthy simulated SMA holds
+#define BENCH_SMA_SLOW_DEPTH	1	// requests a slow simulated SMA holds
+
+typedef struct {
+	uint64_t	usecs;
+	long		maxRssKb;
+} BenchPhaseResult_t;
+
+const char			*benchName = "smroutebench";
+static int			iterations = 1;
+static int			verify = 0;
+static int			compareEngines = 0;
+static int			lidLookups = 0;
+static int			resweep = 0;
+static int			publishRounds = 0;
+static int			readerThreads = 4;
+static int			mcJoins = 0;
+static int			smaLatency = 0;		// simulated SMA round trip in usec
+static int			smaLossPct = 10;	// requests lost on the way to slow SMAs
+static int			smaSlowPct = 5;		// switches with a slow SMA
+static int			smaParallel = 64;	// MaxParallelReqs for the simulation
+static int			failedIsls = 0;		// ISLs failed before the LFT write comparison
+static int			flapRounds = 0;		// link flaps repaired incrementally
+static int			flapLinks = 1;		// ISLs each flap takes down
+static int			lftThreads = 0;		// parallel sweep workers computing the LFTs
+
+// An SA-like reader resolving LIDs against old_topology while sweeps are
+// published; samples is a ring of per-query latencies in nanoseconds.
+typedef struct {
+	pthread_t	thread;
+	uint32_t	seed;
+	uint64_t	*samples;
+	uint64_t	count;
+} BenchReader_t;
+
+static volatile int	readersRunning;
+
+void
+usage(void) {
+	fprintf(stderr, "smroutebench [-t shape] [-r routing] [-k radix] [-T tiers] [-d dims] [-a switches] [-g links]\n");
+	fprintf(stderr, "             [-n switches] [-e hfis] [-l lmc] [-m groups] [-i iterations] [-L lookups] [-s] [-b]\n");
+	fprintf(stderr, "             [-p rounds] [-R readers] [-j joins] [-S usec[,loss,slow,parallel]] [-W links]\n");
+	fprintf(stderr, "             [-F rounds[,links]] [-M threads] [-c] [-v]\n");
+	bench_fabric_usage();
+	fprintf(stderr, "    -i  routing iterations over the same fabric (default 1)\n");
+	fprintf(stderr, "    -L  also time this many LID to port lookups at several miss ratios\n");
+	fprintf(stderr, "    -s  also resweep the unchanged fabric, carrying the LFTs over\n");
+	fprintf(stderr, "    -b  also compute the cost matrix with BFS and with Floyd-Warshall and compare them\n");
+	fprintf(stderr, "    -p  also publish this many back to back sweeps under SA-like reader load\n");
+	fprintf(stderr, "    -R  reader threads for -p (default 4)\n");
+	fprintf(stderr, "    -j  also resweep this many times with one multicast join each, comparing\n");
+	fprintf(stderr, "        incremental and full MFT calculation\n");
+	fprintf(stderr, "    -S  also program the LFTs, MFTs and VLArb tables through the dispatcher against\n");
+	fprintf(stderr, "        simulated SMAs with this round trip, losing loss%% (default 10) of the\n");
+	fprintf(stderr, "        requests to the slow%% (default 5) slow ones, parallel (default 64) at a time\n");
+	fprintf(stderr, "    -W  also fail this many ISLs, reroute and compare writing the full LFTs with\n");
+	fprintf(stderr, "        writing only the changed blocks in loop avoiding waves\n");
+	fprintf(stderr, "    -F  also flap links (default 1) ISLs this many times, repairing the cost matrix\n");
+	fprintf(stderr, "        after each change and comparing it with a full recompute\n");
+	fprintf(stderr, "    -M  also compute the LFTs on this many parallel sweep workers, as LftThreads,\n");
+	fprintf(stderr, "        and compare them with the serial LFTs\n");
+	fprintf(stderr, "    -c  CSV output instead of JSON lines\n");
+	fprintf(stderr, "    -v  verify every switch reaches every LID through the LFTs\n");
+	exit(1);
+}
+
+// Follows the LFTs hop by hop from every switch to every LID; returns the
+// number of switch/LID pairs that never reach the destination.
+static int
+bench_verify_lfts(void)
+{
+	Topology_t *topop = &sm_newTopology;
+	Node_t *switchp, *nodep, *destp;
+	Port_t *portp;
+	STL_LID lid;
+	int hops, failures = 0;
+
+	for_all_switch_nodes(topop, switchp) {
+		for (lid = 1; lid <= topop->maxLid; lid++) {
+			if ((destp = lidmap[lid].newNodep) == NULL)
+				continue;
+			for (nodep = switchp, hops = 0; nodep != destp && hops <= (int)topop->num_sws; hops++) {
+				if (nodep->nodeInfo.NodeType != NI_TYPE_SWITCH || nodep->lft == NULL)
+					break;
+				portp = sm_get_port(nodep, nodep->lft[lid]);
+				if (!sm_valid_port(portp) || portp->state < IB_PORT_INIT)
+					break;
+				nodep = sm_find_node(topop, portp->nodeno);
+				if (nodep == NULL)
+					break;
+			}
+			if (nodep != destp) {
+				if (failures++ < 10)
+					fprintf(stderr, "smroutebench: LID 0x%x unreachable from %s\n",
+						lid, sm_nodeDescString(switchp));
+			}
+		}
+	}
+
+	return failures;
+}
+
+static void
+bench_report(int iteration, BenchPhaseResult_t *results)
+{
+	Topology_t *topop = &sm_newTopology;
+	uint64_t total = 0, lftHash, mftHash;
+	int p;
+
+	for (p = 0; p < PHASE_COUNT; p++)
+		total += results[p].usecs;
+	bench_table_hashes(topop, &lftHash, &mftHash);
+
+	if (csvOutput) {
+		if (iteration == 0) {
+			printf("shape,routing,switches,hfis,lids,lmc,mcgroups,iteration");
+			for (p = 0; p < PHASE_COUNT; p++)
+				printf(",%s_usec,%s_maxrss_kb", phaseNames[p], phaseNames[p]);
+			printf(",total_usec,maxrss_kb,cost_matrix_kb,lft_hash,mft_hash\n");
+		}
+		printf("%s,%s,%u,%d,%u,%d,%d,%d", shapeNames[shape], topop->routingModule->name,
+			topop->num_sws, numHfis, topop->maxLid, lmc, numMcGroups, iteration);
+		for (p = 0; p < PHASE_COUNT; p++)
+			printf(",%"PRIu64",%ld", results[p].usecs, results[p].maxRssKb);
+		printf(",%"PRIu64",%ld,%lu,%016"PRIx64",%016"PRIx64"\n", total, maxRssKb(),
+			(unsigned long)(sm_routing_cost_matrix_size(topop) / 1024), lftHash, mftHash);
+	} else {
+		printf("{\"shape\":\"%s\",\"routing\":\"%s\",\"switches\":%u,\"hfis\":%d,\"lids\":%u,"
+			"\"lmc\":%d,\"mcgroups\":%d,\"iteration\":%d,\"phases\":{",
+			shapeNames[shape], topop->routingModule->name, topop->num_sws, numHfis,
+			topop->maxLid, lmc, numMcGroups, iteration);
+		for (p = 0; p < PHASE_COUNT; p++)
+			printf("%s\"%s\":{\"usec\":%"PRIu64",\"maxrss_kb\":%ld}", p ? "," : "",
+				phaseNames[p], results[p].usecs, results[p].maxRssKb);
+		printf("},\"total_usec\":%"PRIu64",\"maxrss_kb\":%ld,\"cost_matrix_kb\":%lu,"
+			"\"lft_hash\":\"%016"PRIx64"\",\"mft_hash\":\"%016"PRIx64"\"}\n",
+			total, maxRssKb(), (unsigned long)(sm_routing_cost_matrix_size(topop) / 1024),
+			lftHash, mftHash);
+	}
+	fflush(stdout);
+}
+
+// Counts the entries of the topology's cost and path matrices that differ
+// from cost and path, reporting the first few.
+static void
+bench_diff_cost_matrices(const uint16_t *cost, const SmPathPortmask_t *path, const char *name,
+	const char *otherName, int *costDiffs, int *pathDiffs)
+{
+	Topology_t *topop = &sm_newTopology;
+	int switches = topop->max_sws;
+	size_t pairs = (size_t)switches * switches, i;
+
+	for (i = 0; i < pairs; i++) {
+		if (topop->cost[i] != cost[i]) {
+			if ((*costDiffs)++ < 10)
+				fprintf(stderr, "smroutebench: cost %d -> %d is %u with %s, %u with %s\n",
+					(int)(i / switches), (int)(i % switches), topop->cost[i], name, cost[i], otherName);
+		}
+		if (memcmp(&topop->path[i], &path[i], sizeof(SmPathPortmask_t))) {
+			if ((*pathDiffs)++ < 10)
+				fprintf(stderr, "smroutebench: next hops %d -> %d differ between %s and %s\n",
+					(int)(i / switches), (int)(i % switches), name, otherName);
+		}
+	}
+}
+
+// Computes the cost and path matrices of the routed fabric once with
+// Floyd-Warshall and once with the BFS engine and checks that every cost and
+// every path entry is the same.  Prints the time each takes and the number
+// of entries that differ; returns that number.  The matrices are compacted
+// again afterwards, as the routing phase leaves them.
+static int
+bench_compare_cost_engines(void)
+{
+	Topology_t *topop = &sm_newTopology;
+	RoutingModule_t *rm = topop->routingModule;
+	int switches = topop->max_sws;
+	size_t pairs = (size_t)switches * switches;
+	uint16_t *floydCost;
+	SmPathPortmask_t *floydPath;
+	uint64_t start, end, floydUsecs, bfsUsecs;
+	int costDiffs = 0, pathDiffs = 0;
+	Status_t status;
+
+	if ((status = rm->funcs.allocate_cost_matrix(topop)) != VSTATUS_OK ||
+		(status = vs_pool_alloc(&sm_pool, pairs * sizeof(uint16_t), (void *)&floydCost)) != VSTATUS_OK ||
+		(status = vs_pool_alloc(&sm_pool, SM_PATH_SIZE(switches), (void *)&floydPath)) != VSTATUS_OK)
+		fatal("cannot allocate cost matrices", status);
+
+	rm->funcs.initialize_cost_matrix(topop);
+	vs_time_get(&start);
+	status = sm_routing_func_calc_cost_matrix_floyds(topop, switches, topop->cost, topop->path);
+	vs_time_get(&end);
+	if (status != VSTATUS_OK)
+		fatal("Floyd-Warshall cost matrix failed", status);
+	floydUsecs = end - start;
+	memcpy(floydCost, topop->cost, pairs * sizeof(uint16_t));
+	memcpy(floydPath, topop->path, SM_PATH_SIZE(switches));
+
+	rm->funcs.initialize_cost_matrix(topop);
+	vs_time_get(&start);
+	status = sm_routing_func_calc_cost_matrix_bfs(topop, switches, topop->cost, topop->path);
+	vs_time_get(&end);
+	if (status != VSTATUS_OK)
+		fatal("BFS cost matrix failed", status);
+	bfsUsecs = end - start;
+
+	bench_diff_cost_matrices(floydCost, floydPath, "BFS", "Floyd-Warshall", &costDiffs, &pathDiffs);
+
+	if ((status = sm_routing_compact_cost_matrix(topop)) != VSTATUS_OK)
+		fatal("cannot compact cost matrix", status);
+
+	if (csvOutput) {
+		printf("switches,pairs,floyd_usec,bfs_usec,cost_diffs,path_diffs\n");
+		printf("%d,%lu,%"PRIu64",%"PRIu64",%d,%d\n", switches, (unsigned long)pairs,
+			floydUsecs, bfsUsecs, costDiffs, pathDiffs);
+	} else {
+		printf("{\"cost_engines\":{\"switches\":%d,\"pairs\":%lu,\"floyd_usec\":%"PRIu64","
+			"\"bfs_usec\":%"PRIu64",\"cost_diffs\":%d,\"path_diffs\":%d}}\n", switches,
+			(unsigned long)pairs, floydUsecs, bfsUsecs, costDiffs, pathDiffs);
+	}
+	fflush(stdout);
+
+	vs_pool_free(&sm_pool, floydPath);
+	vs_pool_free(&sm_pool, floydCost);
+
+	return costDiffs + pathDiffs;
+}
+
+// Times sm_find_node_and_port_lid() over a mix of assigned and unassigned
+// LIDs, once through the per-topology LID index and once through the lidmap
+// and node walk used before the index is built.  Misses are where the walk
+// hurts: each one visits every port in the fabric.
+static void
+bench_lid_lookups(void)
+{
+	static const int missPcts[] = { 0, 10, 50, 90 };
+	Topology_t *topop = &sm_newTopology;
+	Port_t **lidPortArray = topop->lidPortArray;
+	STL_LID missBase = topop->maxLid + 1;
+	STL_LID missSpan = topop->maxLid + 1;
+	uint64_t start, end, walkUsecs, indexUsecs;
+	uint32_t seed = 1;
+	STL_LID *lids;
+	Port_t **walkPorts;
+	Node_t *nodep;
+	Port_t *portp;
+	int i, m;
+
+	if (missBase + missSpan - 1 > STL_GET_UNICAST_LID_MAX())
+		missSpan = STL_GET_UNICAST_LID_MAX() - missBase + 1;
+	if ((lids = calloc(lidLookups, sizeof(*lids))) == NULL ||
+		(walkPorts = calloc(lidLookups, sizeof(*walkPorts))) == NULL)
+		fatal("cannot allocate lookup buffers", VSTATUS_NOMEM);
+
+	if (csvOutput)
+		printf("lookups,miss_pct,walk_nsec,index_nsec\n");
+
+	for (m = 0; m < (int)(sizeof(missPcts) / sizeof(missPcts[0])); m++) {
+		for (i = 0; i < lidLookups; i++) {
+			seed = seed * 1103515245 + 12345;
+			if (missSpan > 0 && (int)((seed >> 8) % 100) < missPcts[m]) {
+				lids[i] = missBase + (seed >> 4) % missSpan;
+			} else {
+				do {
+					seed = seed * 1103515245 + 12345;
+					lids[i] = 1 + (seed >> 4) % topop->maxLid;
+				} while (lidmap[lids[i]].newPortp == NULL);
+			}
+		}
+
+		topop->lidPortArray = NULL;
+		vs_time_get(&start);
+		for (i = 0; i < lidLookups; i++)
+			walkPorts[i] = sm_find_node_and_port_lid(topop, lids[i], &nodep);
+		vs_time_get(&end);
+		walkUsecs = end - start;
+		topop->lidPortArray = lidPortArray;
+
+		vs_time_get(&start);
+		for (i = 0; i < lidLookups; i++) {
+			portp = sm_find_node_and_port_lid(topop, lids[i], &nodep);
+			if (portp != walkPorts[i] || (portp && nodep != portp->portData->nodePtr))
+				fatal("LID index and node walk disagree", VSTATUS_BAD);
+		}
+		vs_time_get(&end);
+		indexUsecs = end - start;
+
+		if (csvOutput) {
+			printf("%d,%d,%"PRIu64",%"PRIu64"\n", lidLookups, missPcts[m],
+				walkUsecs * 1000 / lidLookups, indexUsecs * 1000 / lidLookups);
+		} else {
+			printf("{\"lookups\":%d,\"miss_pct\":%d,\"walk_nsec\":%"PRIu64",\"index_nsec\":%"PRIu64"}\n",
+				lidLookups, missPcts[m], walkUsecs * 1000 / lidLookups,
+				indexUsecs * 1000 / lidLookups);
+		}
+	}
+	fflush(stdout);
+
+	free(walkPorts);
+	free(lids);
+}
+
+// Resweeps the unchanged fabric mcJoins times with one HFI joining one more
+// group in between, as sweep_multicast() does for membership-only changes.
+// Each sweep computes its MFTs incrementally, carrying over the entries of
+// the other groups from old_topology, and then again in full from cleared
+// tables; the two must hash the same.
+static void
+bench_mcast_joins(void)
+{
+	static Topology_t retired;
+	Topology_t *topop = &sm_newTopology;
+	McGroup_t *mcGroup;
+	McMember_t *mcMember;
+	Node_t *switchp;
+	Port_t *portp;
+	uint64_t start, end, incUsecs = 0, fullUsecs = 0;
+	uint64_t lftHash, incHash, fullHash;
+	int changed = 0, g, h, round;
+	Status_t status;
+
+	topology_passcount = 1;
+	for (round = 0; round < mcJoins; round++) {
+		for_all_switch_nodes(topop, switchp) {
+			portp = sm_get_port(switchp, 0);
+			lidmap[portp->portData->lid].oldNodep = switchp;
+		}
+		sm_topology_publish(&retired);
+		(void)topology_free_topology(&retired, FALSE, TRUE);
+
+		numHfis = 0;
+		bench_new_topology();
+		bench_build();
+		// Some modules build their spanning trees from routing state, and
+		// the modes run after this one expect a fully routed fabric.
+		if ((status = bench_run_phase(PHASE_COST_MATRIX)) != VSTATUS_OK ||
+			(status = bench_run_phase(PHASE_POST_ROUTING)) != VSTATUS_OK ||
+			(status = bench_run_phase(PHASE_LFT)) != VSTATUS_OK ||
+			(status = bench_run_phase(PHASE_SPANNING_TREES)) != VSTATUS_OK)
+			fatal("routing calculation failed", status);
+
+		// HFI h belongs to group h % numMcGroups; it joins the next one.
+		h = (int)(((uint64_t)round * 7919 + 1) % numHfis);
+		g = (h + 1) % numMcGroups;
+		for_all_multicast_groups(mcGroup) {
+			if (mcGroup->mGid.Type.Global.InterfaceID == (uint64_t)g + 1)
+				break;
+		}
+		if (mcGroup == NULL)
+			fatal("multicast group missing", VSTATUS_BAD);
+		portp = sm_get_port(hfiList[h], 1);
+		McMember_Create(mcGroup, mcMember, bench_port_gid(portp));
+		mcMember->slid = portp->portData->lid;
+		mcMember->state = MCMEMBER_STATE_FULL_MEMBER;
+		mcMember->nodeGuid = hfiList[h]->nodeInfo.NodeGUID;
+		mcMember->portGuid = portp->portData->guid;
+		mcMember->record.JoinFullMember = 1;
+		mcGroup->members_full++;
+
+		vs_time_get(&start);
+		status = sm_calculate_mfts_incremental();
+		vs_time_get(&end);
+		if (status != VSTATUS_OK)
+			fatal("incremental MFT calculation failed", status);
+		incUsecs += end - start;
+		bench_table_hashes(topop, &lftHash, &incHash);
+		for_all_switch_nodes(topop, switchp) {
+			changed += switchp->mftPortMaskChange;
+			memset(switchp->mft[0], 0,
+				sizeof(STL_PORTMASK) * sm_mcast_mlid_table_cap * STL_MFTABLE_POSITION_COUNT);
+			switchp->hasSendOnlyMember = 0;
+			switchp->mftPortMaskChange = 0;
+		}
+
+		vs_time_get(&start);
+		status = sm_calculate_mfts();
+		vs_time_get(&end);
+		if (status != VSTATUS_OK)
+			fatal("MFT calculation failed", status);
+		fullUsecs += end - start;
+		bench_table_hashes(topop, &lftHash, &fullHash);
+		if (incHash != fullHash)
+			fatal("incremental MFTs differ from a full calculation", VSTATUS_BAD);
+	}
+
+	if (csvOutput) {
+		printf("joins,mcgroups,changed_switches,incremental_usec,full_usec\n");
+		printf("%d,%d,%d,%"PRIu64",%"PRIu64"\n", mcJoins, numMcGroups, changed / mcJoins,
+			incUsecs / mcJoins, fullUsecs / mcJoins);
+	} else {
+		printf("{\"mcast_joins\":{\"joins\":%d,\"mcgroups\":%d,\"changed_switches\":%d,"
+			"\"incremental_usec\":%"PRIu64",\"full_usec\":%"PRIu64"}}\n", mcJoins, numMcGroups,
+			changed / mcJoins, incUsecs / mcJoins, fullUsecs / mcJoins);
+	}
+	fflush(stdout);
+}
+
+//---------------------------------------------------------------------------//
+// Simulated SMAs for the async dispatcher.  Each switch's SMA is a FIFO
+// server holding at most depth requests and dropping any beyond that; its
+// responses arrive one round trip after it has processed them.  A healthy
+// SMA needs a quarter of the round trip per request, a slow one the whole
+// round trip, holds only BENCH_SMA_SLOW_DEPTH requests and also loses
+// smaLossPct of them.  Lost attempts are resent after RespTimeout, up to
+// MaxAttempts, as the context layer does.  The dispatch order mirrors
+// sm_dispatch_update() and the windows are adapted by the SM's own
+// sm_dispatch_adjust_window(), all in simulated time.
+
+typedef struct {
+	uint64_t	busyUntil;
+	uint64_t	done[BENCH_SMA_DEPTH];	// completion times of held requests
+	int			held, head;
+	int			depth;
+	int			serviceUsecs;
+	int			lossPct;
+} BenchSma_t;
+
+typedef struct {
+	Node_t		*nodep;
+	BenchSma_t	*sma;
+	uint64_t	sendTime;
+	int			attempts;
+	int			next;
+} BenchSmaReq_t;
+
+typedef struct {
+	uint64_t	time;
+	int			req;
+	int			lost;
+} BenchSmaEvent_t;
+
+static BenchSmaReq_t	*smaReqs;
+static BenchSmaEvent_t	*smaEvents;
+static int				smaNumReqs;
+static int				smaNumEvents;
+static int				smaQueueHead, smaQueueTail;
+static int				smaOutstanding;
+static uint32_t			smaSeed;
+
+static void
+bench_sma_push(uint64_t time, int req, int lost)
+{
+	BenchSmaEvent_t ev = { time, req, lost };
+	int i = smaNumEvents++, parent;
+
+	for (; i > 0; i = parent) {
+		parent = (i - 1) / 2;
+		if (smaEvents[parent].time <= time)
+			break;
+		smaEvents[i] = smaEvents[parent];
+	}
+	smaEvents[i] = ev;
+}
+
+static BenchSmaEvent_t
+bench_sma_pop(void)
+{
+	BenchSmaEvent_t top = smaEvents[0], last = smaEvents[--smaNumEvents];
+	int i = 0, child;
+
+	for (; (child = 2 * i + 1) < smaNumEvents; i = child) {
+		if (child + 1 < smaNumEvents && smaEvents[child + 1].time < smaEvents[child].time)
+			child++;
+		if (last.time <= smaEvents[child].time)
+			break;
+		smaEvents[i] = smaEvents[child];
+	}
+	smaEvents[i] = last;
+	return top;
+}
+
+static int
+bench_sma_random(void)
+{
+	smaSeed = smaSeed * 1103515245 + 12345;
+	return (int)((smaSeed >> 16) % 100);
+}
+
+// One attempt of request r reaching its SMA at now.
+static void
+bench_sma_attempt(int r, uint64_t now)
+{
+	BenchSma_t *sma = smaReqs[r].sma;
+	uint64_t done;
+
+	smaReqs[r].attempts++;
+	while (sma->held && sma->done[sma->head] <= now) {
+		sma->head = (sma->head + 1) % BENCH_SMA_DEPTH;
+		sma->held--;
+	}
+	if (sma->held >= sma->depth || bench_sma_random() < sma->lossPct) {
+		bench_sma_push(now + (uint64_t)sm_config.rcv_wait_msec * 1000, r, 1);
+		return;
+	}
+	done = MAX(now, sma->busyUntil) + sma->serviceUsecs;
+	sma->busyUntil = done;
+	sma->done[(sma->head + sma->held++) % BENCH_SMA_DEPTH] = done;
+	bench_sma_push(done + smaLatency, r, 0);
+}
+
+static void
+bench_sma_dispatch(uint64_t now)
+{
+	BenchSmaReq_t *req;
+	int r, prev = -1, next;
+
+	for (r = smaQueueHead; r >= 0 && smaOutstanding < smaParallel; r = next) {
+		req = &smaReqs[r];
+		next = req->next;
+		if (req->nodep->asyncReqsOutstanding >= req->nodep->asyncReqsSupported) {
+			prev = r;
+			continue;
+		}
+		if (prev < 0)
+			smaQueueHead = next;
+		else
+			smaReqs[prev].next = next;
+		if (r == smaQueueTail)
+			smaQueueTail = prev;
+		smaOutstanding++;
+		req->nodep->asyncReqsOutstanding++;
+		req->sendTime = now;
+		req->attempts = 0;
+		bench_sma_attempt(r, now);
+	}
+}
+
+// Queues count requests to switchp behind the ones already queued.
+static void
+bench_sma_enqueue(BenchSma_t *smas, Node_t *switchp, int count)
+{
+	BenchSmaReq_t *req;
+
+	for (; count > 0; count--, smaNumReqs++) {
+		req = &smaReqs[smaNumReqs];
+		req->nodep = switchp;
+		req->sma = &smas[switchp->swIdx];
+		req->next = -1;
+		if (smaQueueTail < 0)
+			smaQueueHead = smaNumReqs;
+		else
+			smaReqs[smaQueueTail].next = smaNumReqs;
+		smaQueueTail = smaNumReqs;
+	}
+}
+
+// Sends the queued requests starting at now and waits for the dispatcher
+// to drain, returning the simulated time it finished.
+static uint64_t
+bench_sma_drain(uint64_t now)
+{
+	BenchSmaEvent_t ev;
+	BenchSmaReq_t *req;
+
+	bench_sma_dispatch(now);
+	while (smaNumEvents) {
+		ev = bench_sma_pop();
+		now = ev.time;
+		req = &smaReqs[ev.req];
+		if (ev.lost && req->attempts < (int)sm_config.max_retries) {
+			bench_sma_attempt(ev.req, now);
+			continue;
+		}
+		sm_dispatch_adjust_window(req->nodep, ev.lost ? VSTATUS_TIMEOUT : VSTATUS_OK,
+			now - req->sendTime, req->nodep->asyncReqsOutstanding >= req->nodep->asyncReqsSupported &&
+			smaOutstanding < smaParallel);
+		smaOutstanding--;
+		req->nodep->asyncReqsOutstanding--;
+		bench_sma_dispatch(now);
+	}
+	if (smaQueueHead >= 0)
+		fatal("dispatcher stalled", VSTATUS_BAD);
+
+	smaQueueHead = smaQueueTail = -1;
+	smaNumReqs = 0;
+	return now;
+}
+
+// Programs one table type on every switch, starting at now, and waits for
+// the dispatcher to drain, returning the simulated time it finished.
+static uint64_t
+bench_sma_table(BenchSma_t *smas, int table, uint64_t now)
+{
+	Topology_t *topop = &sm_newTopology;
+	STL_LID maxMcLid = sm_multicast_get_max_lid();
+	Node_t *switchp;
+	Port_t *portp;
+	int count;
+
+	smaQueueHead = smaQueueTail = -1;
+	smaNumReqs = 0;
+	for_all_switch_nodes(topop, switchp) {
+		if (table == 0) {
+			count = topop->maxLid / MAX_LFT_ELEMENTS_BLOCK + 1;
+		} else if (table == 1) {
+			count = (maxMcLid >= STL_LID_MULTICAST_BEGIN) ?
+				((maxMcLid - STL_LID_MULTICAST_BEGIN) / STL_NUM_MFT_ELEMENTS_BLOCK + 1) *
+				(switchp->nodeInfo.NumPorts / STL_PORT_MASK_WIDTH + 1) : 0;
+		} else {
+			// low, high and preemption matrix
+			count = 0;
+			for_all_physical_ports(switchp, portp) {
+				if (sm_valid_port(portp) && portp->state >= IB_PORT_INIT)
+					count += 3;
+			}
+		}
+		bench_sma_enqueue(smas, switchp, count);
+	}
+
+	return bench_sma_drain(now);
+}
+
+// Programs the LFTs, MFTs and VLArb tables three times: with the fixed
+// window of SmaBatchSize, with adaptive windows starting from SmaBatchSize
+// and again with the adaptive windows carried over as on a resweep.
+static void
+bench_sma_programming(void)
+{
+	static const char *runNames[] = { "fixed", "adaptive", "adaptive_resweep" };
+	Topology_t *topop = &sm_newTopology;
+	BenchSma_t *smas, *sma;
+	Node_t *switchp;
+	uint64_t usecs[3], now;
+	uint32_t late, timeouts, window;
+	int run, table, maxReqs = 0, slow = 0;
+
+	for_all_switch_nodes(topop, switchp) {
+		maxReqs += (topop->maxLid / MAX_LFT_ELEMENTS_BLOCK + 1) +
+			DEFAULT_SW_MLID_TABLE_CAP / STL_NUM_MFT_ELEMENTS_BLOCK * STL_NUM_MFT_POSITIONS_MASK +
+			3 * switchp->nodeInfo.NumPorts;
+	}
+	if (vs_pool_alloc(&sm_pool, sizeof(BenchSma_t) * topop->max_sws, (void *)&smas) != VSTATUS_OK ||
+		vs_pool_alloc(&sm_pool, sizeof(BenchSmaReq_t) * maxReqs, (void *)&smaReqs) != VSTATUS_OK ||
+		vs_pool_alloc(&sm_pool, sizeof(BenchSmaEvent_t) * smaParallel, (void *)&smaEvents) != VSTATUS_OK)
+		fatal("cannot allocate simulated SMAs", VSTATUS_NOMEM);
+
+	if (csvOutput)
+		printf("run,latency_usec,loss_pct,slow_switches,parallel,lft_usec,mft_usec,vlarb_usec,late,timeouts,avg_window\n");
+
+	for (run = 0; run < 3; run++) {
+		memset(smas, 0, sizeof(BenchSma_t) * topop->max_sws);
+		sm_config.sma_batch_size_max = run ? 8 : 0;
+		smaSeed = 1;
+		slow = 0;
+		for_all_switch_nodes(topop, switchp) {
+			sma = &smas[switchp->swIdx];
+			if (bench_sma_random() < smaSlowPct) {
+				sma->depth = BENCH_SMA_SLOW_DEPTH;
+				sma->serviceUsecs = smaLatency;
+				sma->lossPct = smaLossPct;
+				slow++;
+			} else {
+				sma->depth = BENCH_SMA_DEPTH;
+				sma->serviceUsecs = smaLatency / 4;
+			}
+			sm_dispatch_init_node(switchp, run == 2 ? switchp : NULL);
+			memset(&switchp->asyncStats, 0, sizeof(switchp->asyncStats));
+			switchp->asyncReqsOutstanding = 0;
+		}
+
+		for (table = 0, now = 0; table < 3; table++) {
+			usecs[table] = bench_sma_table(smas, table, now) - now;
+			now += usecs[table];
+		}
+
+		late = timeouts = window = 0;
+		for_all_switch_nodes(topop, switchp) {
+			late += switchp->asyncStats.late;
+			timeouts += switchp->asyncStats.timeouts;
+			window += switchp->asyncReqsSupported;
+		}
+		if (csvOutput) {
+			printf("%s,%d,%d,%d,%d,%"PRIu64",%"PRIu64",%"PRIu64",%u,%u,%.1f\n", runNames[run],
+				smaLatency, smaLossPct, slow, smaParallel, usecs[0], usecs[1], usecs[2],
+				late, timeouts, (double)window / topop->num_sws);
+		} else {
+			printf("{\"sma_programming\":{\"run\":\"%s\",\"latency_usec\":%d,\"loss_pct\":%d,"
+				"\"slow_switches\":%d,\"parallel\":%d,\"lft_usec\":%"PRIu64",\"mft_usec\":%"PRIu64","
+				"\"vlarb_usec\":%"PRIu64",\"late\":%u,\"timeouts\":%u,\"avg_window\":%.1f}}\n",
+				runNames[run], smaLatency, smaLossPct, slow, smaParallel, usecs[0], usecs[1],
+				usecs[2], late, timeouts, (double)window / topop->num_sws);
+		}
+	}
+	sm_config.sma_batch_size_max = 0;
+	fflush(stdout);
+
+	vs_pool_free(&sm_pool, smaEvents);
+	vs_pool_free(&sm_pool, smaReqs);
+	vs_pool_free(&sm_pool, smas);
+}
+
+// Follows the mock SMAs' LFTs from every switch to every LID; returns the
+// number of switch/LID pairs that loop.
+static int
+bench_count_loops(PORT **tables)
+{
+	Topology_t *topop = &sm_newTopology;
+	Node_t *switchp, *nodep, *destp;
+	Port_t *portp;
+	STL_LID lid;
+	int hops, loops = 0;
+
+	for_all_switch_nodes(topop, switchp) {
+		for (lid = 1; lid <= topop->maxLid; lid++) {
+			if ((destp = lidmap[lid].newNodep) == NULL)
+				continue;
+			for (nodep = switchp, hops = 0; nodep != destp && hops <= (int)topop->num_sws; hops++) {
+				if (nodep->nodeInfo.NodeType != NI_TYPE_SWITCH)
+					break;
+				portp = sm_get_port(nodep, tables[nodep->swIdx][lid]);
+				if (!sm_valid_port(portp) || portp->state < IB_PORT_INIT)
+					break;
+				if ((nodep = sm_find_node(topop, portp->nodeno)) == NULL)
+					break;
+			}
+			if (hops > (int)topop->num_sws)
+				loops++;
+		}
+	}
+
+	return loops;
+}
+
+static int
+bench_cmp_lft_write(const void *a, const void *b)
+{
+	const SmLftWrite_t *wa = a, *wb = b;
+
+	if (wa->block != wb->block)
+		return wa->block < wb->block ? -1 : 1;
+	return wa->switchp->swIdx < wb->switchp->swIdx ? -1 : wa->switchp->swIdx > wb->switchp->swIdx;
+}
+
+// Applies writes to the mock SMAs' tables in order, counting the looping
+// switch/LID pairs each time one of the writes at checkpoints is reached.
+// The switches outside planned have their full LFTs written first.
+static int
+bench_apply_lft_writes(PORT **tables, bitset_t *planned, SmLftWrite_t *writes, int numWrites,
+	const int *checkpoints)
+{
+	Topology_t *topop = &sm_newTopology;
+	Node_t *switchp;
+	size_t size = sizeof(PORT) * ROUNDUP(topop->maxLid + 1, MAX_LFT_ELEMENTS_BLOCK);
+	int i, loops = 0;
+
+	for_all_switch_nodes(topop, switchp)
+		memcpy(tables[switchp->swIdx], bitset_test(planned, switchp->swIdx) ?
+			switchp->old->lft : switchp->lft, size);
+
+	for (i = 0; i < numWrites; i++) {
+		if (checkpoints[i])
+			loops += bench_count_loops(tables);
+		memcpy(&tables[writes[i].switchp->swIdx][writes[i].block * MAX_LFT_ELEMENTS_BLOCK],
+			&writes[i].switchp->lft[writes[i].block * MAX_LFT_ELEMENTS_BLOCK],
+			sizeof(PORT) * MAX_LFT_ELEMENTS_BLOCK * writes[i].numBlocks);
+	}
+
+	for_all_switch_nodes(topop, switchp) {
+		if (memcmp(tables[switchp->swIdx], switchp->lft, sizeof(PORT) * (topop->maxLid + 1)))
+			fatal("programmed LFT differs from the calculated one", VSTATUS_BAD);
+	}
+
+	return loops;
+}
+
+// Starts every switch's simulated SMA idle, with a fresh dispatcher window.
+static void
+bench_lft_smas_init(BenchSma_t *smas)
+{
+	Topology_t *topop = &sm_newTopology;
+	Node_t *switchp;
+
+	memset(smas, 0, sizeof(BenchSma_t) * topop->max_sws);
+	for_all_switch_nodes(topop, switchp) {
+		smas[switchp->swIdx].depth = BENCH_SMA_DEPTH;
+		smas[switchp->swIdx].serviceUsecs = smaLatency / 4;
+		sm_dispatch_init_node(switchp, NULL);
+		switchp->asyncReqsOutstanding = 0;
+	}
+}
+
+// Fails failedIsls ISLs spread over the fabric and reroutes it, then brings
+// each switch from its old LFT to the new one both ways a rebalance can:
+// writing the whole LFT, as sm_write_full_lfts_by_block_LR() did for every
+// switch, and writing only the changed blocks in the waves planned by
+// sm_plan_lft_writes().  A mock SMA per switch holds a copy of the old LFT
+// and applies the planned writes in order; it must end up with the new LFT,
+// and at every wave boundary the switch/LID pairs that loop through the
+// partly updated tables are counted.  The same writes applied block by
+// block without waves are checked at the same points for comparison.  Each
+// way is also timed through the simulated dispatcher with healthy SMAs.
+static void
+bench_lft_writes(void)
+{
+	Topology_t *topop = &sm_newTopology;
+	SmLftWritePlan_t plan;
+	SmLftWrite_t *unordered;
+	SwitchList_t *swlist;
+	BenchSma_t *smas;
+	Node_t *switchp, *oldnodep;
+	PORT **tables;
+	int *checkpoints;
+	uint64_t start, end, planUsecs, fullUsecs, deltaUsecs, now;
+	uint32_t numBlocks, fullSmps, deltaSmps, i, changedSwitches = 0;
+	int loopsOrdered, loopsUnordered, numIsls, sw = 0;
+	Status_t status;
+
+	memcpy(&old_topology, topop, sizeof(Topology_t));
+
+	numIsls = islCount;
+	islCount = islsDown = 0;
+	islFailStride = MAX(1, numIsls / failedIsls);
+	islFailCount = failedIsls;
+	numHfis = 0;
+	bench_new_topology();
+	bench_build();
+	islFailStride = 0;
+
+	for_all_switch_nodes(topop, switchp) {
+		if ((oldnodep = sm_find_guid(&old_topology, switchp->nodeInfo.NodeGUID)) == NULL)
+			fatal("switch missing from the old topology", VSTATUS_BAD);
+		switchp->old = oldnodep;
+		switchp->oldExists = 1;
+	}
+
+	if ((status = bench_run_phase(PHASE_COST_MATRIX)) != VSTATUS_OK ||
+		(status = bench_run_phase(PHASE_POST_ROUTING)) != VSTATUS_OK ||
+		(status = bench_run_phase(PHASE_LFT)) != VSTATUS_OK)
+		fatal("rerouting around the failed links failed", status);
+
+	if (vs_pool_alloc(&sm_pool, sizeof(SwitchList_t) * topop->num_sws, (void *)&swlist) != VSTATUS_OK ||
+		vs_pool_alloc(&sm_pool, sizeof(PORT *) * topop->max_sws, (void *)&tables) != VSTATUS_OK)
+		fatal("cannot allocate switch list", VSTATUS_NOMEM);
+	for_all_switch_nodes(topop, switchp) {
+		swlist[sw].switchp = switchp;
+		swlist[sw].next = (sw + 1 < (int)topop->num_sws) ? &swlist[sw + 1] : NULL;
+		if (vs_pool_alloc(&sm_pool, sizeof(PORT) * ROUNDUP(topop->maxLid + 1, MAX_LFT_ELEMENTS_BLOCK),
+				(void *)&tables[switchp->swIdx]) != VSTATUS_OK)
+			fatal("cannot allocate mock SMA tables", VSTATUS_NOMEM);
+		sw++;
+	}
+
+	vs_time_get(&start);
+	status = sm_plan_lft_writes(topop, &old_topology, swlist, &plan);
+	vs_time_get(&end);
+	if (status != VSTATUS_OK)
+		fatal("cannot plan LFT writes", status);
+	planUsecs = end - start;
+
+	numBlocks = topop->maxLid / MAX_LFT_ELEMENTS_BLOCK + 1;
+	fullSmps = topop->num_sws * ((numBlocks + sm_config.lft_multi_block - 1) / sm_config.lft_multi_block);
+
+	if (vs_pool_alloc(&sm_pool, sizeof(SmLftWrite_t) * MAX(plan.numWrites, 1), (void *)&unordered) != VSTATUS_OK ||
+		vs_pool_alloc(&sm_pool, sizeof(int) * MAX(plan.numWrites, 1), (void *)&checkpoints) != VSTATUS_OK)
+		fatal("cannot allocate LFT write copies", VSTATUS_NOMEM);
+	for (i = 0; i < plan.numWrites; i++)
+		checkpoints[i] = i > 0 && plan.writes[i].wave != plan.writes[i - 1].wave;
+	memcpy(unordered, plan.writes, sizeof(SmLftWrite_t) * plan.numWrites);
+	qsort(unordered, plan.numWrites, sizeof(SmLftWrite_t), bench_cmp_lft_write);
+
+	loopsOrdered = bench_apply_lft_writes(tables, &plan.switches, plan.writes, plan.numWrites, checkpoints);
+	loopsUnordered = bench_apply_lft_writes(tables, &plan.switches, unordered, plan.numWrites, checkpoints);
+
+	// Healthy simulated SMAs, fixed windows.
+	if (vs_pool_alloc(&sm_pool, sizeof(BenchSma_t) * topop->max_sws, (void *)&smas) != VSTATUS_OK ||
+		vs_pool_alloc(&sm_pool, sizeof(BenchSmaReq_t) * (fullSmps + plan.numWrites), (void *)&smaReqs) != VSTATUS_OK ||
+		vs_pool_alloc(&sm_pool, sizeof(BenchSmaEvent_t) * smaParallel, (void *)&smaEvents) != VSTATUS_OK)
+		fatal("cannot allocate simulated SMAs", VSTATUS_NOMEM);
+	if (!smaLatency)
+		smaLatency = 10;
+	for_all_switch_nodes(topop, switchp) {
+		if (bitset_test(&plan.switches, switchp->swIdx) && switchp->lft != switchp->old->lft &&
+			memcmp(switchp->lft, switchp->old->lft, sizeof(PORT) * (topop->maxLid + 1)))
+			changedSwitches++;
+	}
+
+	smaQueueHead = smaQueueTail = -1;
+	smaNumReqs = 0;
+	bench_lft_smas_init(smas);
+	for_all_switch_nodes(topop, switchp)
+		bench_sma_enqueue(smas, switchp, fullSmps / topop->num_sws);
+	fullUsecs = bench_sma_drain(0);
+
+	// Switches left out of the plan are written in full ahead of it.
+	bench_lft_smas_init(smas);
+	deltaSmps = plan.numWrites;
+	for_all_switch_nodes(topop, switchp) {
+		if (!bitset_test(&plan.switches, switchp->swIdx)) {
+			bench_sma_enqueue(smas, switchp, fullSmps / topop->num_sws);
+			deltaSmps += fullSmps / topop->num_sws;
+		}
+	}
+	for (i = 0, now = 0; i < plan.numWrites; i++) {
+		if (i > 0 && plan.writes[i].wave != plan.writes[i - 1].wave)
+			now = bench_sma_drain(now);
+		bench_sma_enqueue(smas, plan.writes[i].switchp, 1);
+	}
+	deltaUsecs = bench_sma_drain(now);
+
+	if (csvOutput) {
+		printf("failed_links,switches,changed_switches,full_switches,full_smps,delta_smps,changed_blocks,"
+			"waves,plan_usec,full_usec,delta_usec,loops_ordered,loops_unordered\n");
+		printf("%d,%u,%u,%u,%u,%u,%u,%u,%"PRIu64",%"PRIu64",%"PRIu64",%d,%d\n", islsDown, topop->num_sws,
+			changedSwitches, plan.fullSwitches, fullSmps, deltaSmps, plan.changedBlocks, plan.numWaves,
+			planUsecs, fullUsecs, deltaUsecs, loopsOrdered, loopsUnordered);
+	} else {
+		printf("{\"lft_writes\":{\"failed_links\":%d,\"switches\":%u,\"changed_switches\":%u,"
+			"\"full_switches\":%u,\"full_smps\":%u,\"delta_smps\":%u,\"changed_blocks\":%u,\"waves\":%u,"
+			"\"plan_usec\":%"PRIu64",\"full_usec\":%"PRIu64",\"delta_usec\":%"PRIu64","
+			"\"loops_ordered\":%d,\"loops_unordered\":%d}}\n", islsDown, topop->num_sws,
+			changedSwitches, plan.fullSwitches, fullSmps, deltaSmps, plan.changedBlocks, plan.numWaves,
+			planUsecs, fullUsecs, deltaUsecs, loopsOrdered, loopsUnordered);
+	}
+	fflush(stdout);
+
+	sm_free_lft_write_plan(&plan);
+	vs_pool_free(&sm_pool, smaEvents);
+	vs_pool_free(&sm_pool, smaReqs);
+	vs_pool_free(&sm_pool, smas);
+	vs_pool_free(&sm_pool, checkpoints);
+	vs_pool_free(&sm_pool, unordered);
+	for_all_switch_nodes(topop, switchp)
+		vs_pool_free(&sm_pool, tables[switchp->swIdx]);
+	vs_pool_free(&sm_pool, tables);
+	vs_pool_free(&sm_pool, swlist);
+}
+
+// Resweeps the unchanged fabric: the routed topology becomes old_topology,
+// the same fabric is built again and every switch's LFT is carried over the
+// way the copy_routing hooks do it, once copying and once sharing the old
+// table.  A full LFT calculation on the new topology must then reproduce
+// the carried-over tables and leave the old ones untouched.
+static void
+bench_resweep(void)
+{
+	Topology_t *topop = &sm_newTopology;
+	Node_t *switchp, *oldnodep;
+	uint64_t start, end, copyUsecs, shareUsecs;
+	uint64_t oldHash, hash, mftHash;
+	size_t sharedBytes = 0;
+	int shared = 0;
+	Status_t status;
+
+	bench_table_hashes(topop, &oldHash, &mftHash);
+	memcpy(&old_topology, topop, sizeof(Topology_t));
+
+	numHfis = 0;
+	bench_new_topology();
+	bench_build();
+	for_all_switch_nodes(topop, switchp) {
+		if ((oldnodep = sm_find_guid(&old_topology, switchp->nodeInfo.NodeGUID)) == NULL)
+			fatal("switch missing from the old topology", VSTATUS_BAD);
+		switchp->old = oldnodep;
+		switchp->oldExists = 1;
+	}
+
+	sm_config.lft_carry_over = 0;
+	vs_time_get(&start);
+	for_all_switch_nodes(topop, switchp) {
+		if ((status = sm_Node_copy_lft(switchp, switchp->old)) != VSTATUS_OK)
+			fatal("cannot copy LFT", status);
+	}
+	vs_time_get(&end);
+	copyUsecs = end - start;
+	bench_table_hashes(topop, &hash, &mftHash);
+	if (hash != oldHash)
+		fatal("copied LFTs differ from the old topology", VSTATUS_BAD);
+	for_all_switch_nodes(topop, switchp)
+		sm_Node_release_lft(switchp);
+
+	sm_config.lft_carry_over = 1;
+	vs_time_get(&start);
+	for_all_switch_nodes(topop, switchp) {
+		if ((status = sm_Node_copy_lft(switchp, switchp->old)) != VSTATUS_OK)
+			fatal("cannot share LFT", status);
+	}
+	vs_time_get(&end);
+	shareUsecs = end - start;
+	for_all_switch_nodes(topop, switchp) {
+		if (switchp->lft != switchp->old->lft)
+			continue;
+		shared++;
+		sharedBytes += sizeof(PORT) * ROUNDUP(switchp->switchInfo.LinearFDBTop + 1, MAX_LFT_ELEMENTS_BLOCK);
+	}
+	bench_table_hashes(topop, &hash, &mftHash);
+	if (hash != oldHash)
+		fatal("shared LFTs differ from the old topology", VSTATUS_BAD);
+
+	// Full rebuild on top of the shared tables.
+	if ((status = bench_run_phase(PHASE_COST_MATRIX)) != VSTATUS_OK ||
+		(status = bench_run_phase(PHASE_POST_ROUTING)) != VSTATUS_OK ||
+		(status = bench_run_phase(PHASE_LFT)) != VSTATUS_OK)
+		fatal("full LFT calculation failed", status);
+	bench_table_hashes(topop, &hash, &mftHash);
+	if (hash != oldHash)
+		fatal("full LFT calculation differs from the carried-over LFTs", VSTATUS_BAD);
+	bench_table_hashes(&old_topology, &hash, &mftHash);
+	if (hash != oldHash)
+		fatal("old topology LFTs changed", VSTATUS_BAD);
+
+	if (csvOutput) {
+		printf("switches,shared,shared_kb,copy_usec,share_usec\n");
+		printf("%u,%d,%lu,%"PRIu64",%"PRIu64"\n", topop->num_sws, shared,
+			(unsigned long)(sharedBytes / 1024), copyUsecs, shareUsecs);
+	} else {
+		printf("{\"resweep\":{\"switches\":%u,\"shared\":%d,\"shared_kb\":%lu,"
+			"\"copy_usec\":%"PRIu64",\"share_usec\":%"PRIu64"}}\n", topop->num_sws, shared,
+			(unsigned long)(sharedBytes / 1024), copyUsecs, shareUsecs);
+	}
+	fflush(stdout);
+}
+
+// Flaps flapLinks ISLs flapRounds times, taking a different set down each
+// round and bringing it back up.  After every change the cost matrix is
+// repaired from the previous one by sm_routing_func_update_cost_matrix(),
+// or recomputed when it declines, as a sweep does, and then recomputed in
+// full; the two must match entry for entry.  With floyds set every matrix
+// is computed with Floyd's algorithm instead of the module's engine.
+// Prints the average time of each and how many changes were repaired.
+// Returns the entries that differ.
+static int
+bench_cost_flaps(int floyds)
+{
+	Topology_t *topop = &sm_newTopology;
+	RoutingModule_t *rm;
+	Status_t (*calculate)(Topology_t *, int, unsigned short *, SmPathPortmask_t *) = NULL;
+	int switches = topop->max_sws, numIsls = islCount, step, repaired = 0;
+	int costDiffs = 0, pathDiffs = 0;
+	size_t pairs = (size_t)switches * switches;
+	uint16_t *cost;
+	SmPathPortmask_t *path;
+	uint64_t start, end, repairUsecs = 0, fullUsecs = 0;
+	Status_t status;
+
+	if (vs_pool_alloc(&sm_pool, pairs * sizeof(uint16_t), (void *)&cost) != VSTATUS_OK ||
+		vs_pool_alloc(&sm_pool, SM_PATH_SIZE(switches), (void *)&path) != VSTATUS_OK)
+		fatal("cannot allocate cost matrices", VSTATUS_NOMEM);
+
+	// BFS and Floyd's algorithm give the same matrix, so the routed fabric's
+	// can stand in for a Floyd one.
+	if (floyds)
+		topop->costMatrixBfs = 0;
+
+	for (step = 0; step < 2 * flapRounds; step++) {
+		memcpy(&old_topology, topop, sizeof(Topology_t));
+
+		// Even steps take the links down, odd steps bring them back.
+		islCount = islsDown = 0;
+		if (step % 2 == 0) {
+			islFailStride = MAX(1, numIsls / flapLinks);
+			islFailCount = flapLinks;
+			islFailOffset = (step / 2) * 7919 % islFailStride;
+		}
+		numHfis = 0;
+		bench_new_topology();
+		bench_build();
+		islFailStride = 0;
+		rm = topop->routingModule;
+		if (floyds) {
+			calculate = rm->funcs.calculate_cost_matrix;
+			rm->funcs.calculate_cost_matrix = sm_routing_func_calc_cost_matrix_floyds;
+		}
+
+		if ((status = rm->funcs.allocate_cost_matrix(topop)) != VSTATUS_OK)
+			fatal("cannot allocate cost matrix", status);
+		vs_time_get(&start);
+		if ((status = sm_routing_func_update_cost_matrix(&old_topology, topop)) == VSTATUS_OK) {
+			repaired++;
+		} else if (status == VSTATUS_NOSUPPORT) {
+			rm->funcs.initialize_cost_matrix(topop);
+			status = rm->funcs.calculate_cost_matrix(topop, switches, topop->cost, topop->path);
+		}
+		vs_time_get(&end);
+		if (status != VSTATUS_OK)
+			fatal("cost matrix repair failed", status);
+		repairUsecs += end - start;
+		memcpy(cost, topop->cost, pairs * sizeof(uint16_t));
+		memcpy(path, topop->path, SM_PATH_SIZE(switches));
+
+		vs_time_get(&start);
+		rm->funcs.initialize_cost_matrix(topop);
+		status = rm->funcs.calculate_cost_matrix(topop, switches, topop->cost, topop->path);
+		vs_time_get(&end);
+		if (status != VSTATUS_OK)
+			fatal("cost matrix calculation failed", status);
+		fullUsecs += end - start;
+
+		bench_diff_cost_matrices(cost, path, "a full recompute", "the repair", &costDiffs, &pathDiffs);
+
+		if ((status = sm_routing_compact_cost_matrix(topop)) != VSTATUS_OK)
+			fatal("cannot compact cost matrix", status);
+	}
+	if (calculate)
+		rm->funcs.calculate_cost_matrix = calculate;
+
+	if (csvOutput) {
+		if (!floyds)
+			printf("engine,rounds,links,changes,repaired,repair_usec,full_usec,cost_diffs,path_diffs\n");
+		printf("%s,%d,%d,%d,%d,%"PRIu64",%"PRIu64",%d,%d\n", floyds ? "floyds" : "module",
+			flapRounds, flapLinks, step, repaired, repairUsecs / step, fullUsecs / step,
+			costDiffs, pathDiffs);
+	} else {
+		printf("{\"link_flaps\":{\"engine\":\"%s\",\"rounds\":%d,\"links\":%d,\"changes\":%d,"
+			"\"repaired\":%d,\"repair_usec\":%"PRIu64",\"full_usec\":%"PRIu64",\"cost_diffs\":%d,"
+			"\"path_diffs\":%d}}\n", floyds ? "floyds" : "module", flapRounds, flapLinks, step,
+			repaired, repairUsecs / step, fullUsecs / step, costDiffs, pathDiffs);
+	}
+	fflush(stdout);
+
+	vs_pool_free(&sm_pool, path);
+	vs_pool_free(&sm_pool, cost);
+
+	return costDiffs + pathDiffs;
+}
+
+// Computes the LFTs serially and then on threads parallel sweep workers, as
+// sm_calculate_all_lfts() does with LftThreads, and returns the number of
+// switches whose LFTs differ.  Modules that do not route through
+// sm_calculate_all_lfts() with the default setup_xft() and select_ports(),
+// such as fattree, always route serially, so both runs take the same path.
+static int
+bench_lft_threads(int threads)
+{
+	Topology_t *topop = &sm_newTopology;
+	RoutingModule_t *rm = topop->routingModule;
+	uint32_t psThreads = sm_config.psThreads, smLftThreads = sm_config.lft_threads;
+	size_t lftBytes = sizeof(PORT) * (topop->maxLid + 1);
+	uint64_t start, end, serialUsecs, threadedUsecs, serialHash, threadedHash, mftHash;
+	int parallel, diffs = 0;
+	Node_t *switchp;
+	PORT *lfts;
+	Status_t status;
+
+	parallel = threads > 1 && rm->funcs.init_switch_routing == sm_routing_func_init_switch_routing_lfts &&
+		rm->funcs.setup_xft == sm_routing_func_setup_xft &&
+		rm->funcs.select_ports == sm_routing_func_select_ports;
+	if (vs_pool_alloc(&sm_pool, lftBytes * topop->max_sws, (void *)&lfts) != VSTATUS_OK)
+		fatal("cannot allocate LFT copies", VSTATUS_NOMEM);
+	memset(lfts, 0, lftBytes * topop->max_sws);
+
+	sm_config.lft_threads = 1;
+	vs_time_get(&start);
+	status = bench_run_phase(PHASE_LFT);
+	vs_time_get(&end);
+	if (status != VSTATUS_OK)
+		fatal("serial LFT calculation failed", status);
+	serialUsecs = end - start;
+	bench_table_hashes(topop, &serialHash, &mftHash);
+	for_all_switch_nodes(topop, switchp) {
+		if (switchp->lft)
+			memcpy(&lfts[switchp->swIdx * (topop->maxLid + 1)], switchp->lft, lftBytes);
+	}
+
+	sm_config.psThreads = sm_config.lft_threads = threads;
+	if ((sm_psc_g = psc_init_nomai()) == NULL)
+		fatal("cannot start the parallel sweep workers", VSTATUS_NOMEM);
+	vs_time_get(&start);
+	status = bench_run_phase(PHASE_LFT);
+	vs_time_get(&end);
+	if (status != VSTATUS_OK)
+		fatal("threaded LFT calculation failed", status);
+	threadedUsecs = end - start;
+	bench_table_hashes(topop, &threadedHash, &mftHash);
+	for_all_switch_nodes(topop, switchp) {
+		if (switchp->lft && memcmp(&lfts[switchp->swIdx * (topop->maxLid + 1)], switchp->lft, lftBytes) != 0 &&
+			diffs++ < 10)
+			fprintf(stderr, "smroutebench: threaded LFT of %s differs\n", sm_nodeDescString(switchp));
+	}
+	psc_cleanup(sm_psc_g);
+	sm_psc_g = NULL;
+	sm_config.psThreads = psThreads;
+	sm_config.lft_threads = smLftThreads;
+
+	if (csvOutput) {
+		printf("threads,parallel,serial_usec,threaded_usec,serial_lft_hash,threaded_lft_hash,switches_differ\n");
+		printf("%d,%d,%"PRIu64",%"PRIu64",%016"PRIx64",%016"PRIx64",%d\n", threads, parallel,
+			serialUsecs, threadedUsecs, serialHash, threadedHash, diffs);
+	} else {
+		printf("{\"lft_threads\":{\"threads\":%d,\"parallel\":%s,\"serial_usec\":%"PRIu64","
+			"\"threaded_usec\":%"PRIu64",\"serial_lft_hash\":\"%016"PRIx64"\","
+			"\"threaded_lft_hash\":\"%016"PRIx64"\",\"switches_differ\":%d}}\n",
+			threads, parallel ? "true" : "false", serialUsecs, threadedUsecs, serialHash,
+			threadedHash, diffs);
+	}
+	fflush(stdout);
+
+	vs_pool_free(&sm_pool, lfts);
+
+	return diffs;
+}
+
+static uint64_t
+bench_nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int
+bench_cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+// Resolves a random LID and then its port GUID, as a PathRecord query does
+// for its source and destination, holding old_topology_lock as a reader.
+static void *
+bench_reader(void *arg)
+{
+	BenchReader_t *reader = (BenchReader_t *)arg;
+	struct timespec gap = { 0, 10000 };	// time between one reader's queries
+	uint64_t start;
+	Node_t *nodep;
+	Port_t *portp;
+	STL_LID lid;
+
+	while (readersRunning) {
+		reader->seed = reader->seed * 1103515245 + 12345;
+		start = bench_nsecs();
+		(void)vs_rdlock(&old_topology_lock);
+		if (old_topology.maxLid) {
+			lid = 1 + (reader->seed >> 4) % old_topology.maxLid;
+			portp = sm_find_node_and_port_lid(&old_topology, lid, &nodep);
+			if (sm_valid_port(portp) &&
+				sm_find_port_guid(&old_topology, portp->portData->guid) != portp)
+				fatal("published topology is inconsistent", VSTATUS_BAD);
+		}
+		(void)vs_rwunlock(&old_topology_lock);
+		reader->samples[reader->count++ % BENCH_READER_SAMPLES] = bench_nsecs() - start;
+		(void)nanosleep(&gap, NULL);
+	}
+	return NULL;
+}
+
+// Routes and publishes publishRounds sweeps of the same fabric back to back
+// while reader threads query old_topology.  With deferred set the replaced
+// topology is freed after old_topology_lock is dropped, as topology_copy()
+// does; otherwise it is freed under the lock.  Reports how long the writer
+// held the lock and the readers' latency percentiles.
+static void
+bench_publish(int deferred)
+{
+	static Topology_t retired;
+	BenchReader_t readers[BENCH_MAX_READERS];
+	uint64_t start, end, lockedUsecs = 0, maxLockedUsecs = 0, queries = 0;
+	uint64_t *samples;
+	size_t n = 0;
+	Status_t status;
+	int r, round;
+
+	memset(readers, 0, sizeof(readers));
+	readersRunning = 1;
+	for (r = 0; r < readerThreads; r++) {
+		readers[r].seed = r + 1;
+		if ((readers[r].samples = calloc(BENCH_READER_SAMPLES, sizeof(uint64_t))) == NULL)
+			fatal("cannot allocate latency samples", VSTATUS_NOMEM);
+		if (pthread_create(&readers[r].thread, NULL, bench_reader, &readers[r]) != 0)
+			fatal("cannot start reader thread", VSTATUS_BAD);
+	}
+
+	for (round = 0; round < publishRounds; round++) {
+		numHfis = 0;
+		bench_new_topology();
+		bench_build();
+		if ((status = bench_run_phase(PHASE_COST_MATRIX)) != VSTATUS_OK ||
+			(status = bench_run_phase(PHASE_POST_ROUTING)) != VSTATUS_OK ||
+			(status = bench_run_phase(PHASE_LFT)) != VSTATUS_OK)
+			fatal("routing failed", status);
+
+		(void)vs_wrlock(&old_topology_lock);
+		vs_time_get(&start);
+		sm_topology_publish(&retired);
+		if (!deferred)
+			(void)topology_free_topology(&retired, FALSE, TRUE);
+		vs_time_get(&end);
+		(void)vs_rwunlock(&old_topology_lock);
+		if (deferred)
+			(void)topology_free_topology(&retired, FALSE, TRUE);
+
+		lockedUsecs += end - start;
+		if (end - start > maxLockedUsecs)
+			maxLockedUsecs = end - start;
+	}
+
+	readersRunning = 0;
+	for (r = 0; r < readerThreads; r++) {
+		(void)pthread_join(readers[r].thread, NULL);
+		queries += readers[r].count;
+	}
+	if ((samples = calloc(readerThreads, BENCH_READER_SAMPLES * sizeof(uint64_t))) == NULL)
+		fatal("cannot allocate latency samples", VSTATUS_NOMEM);
+	for (r = 0; r < readerThreads; r++) {
+		uint64_t count = MIN(readers[r].count, BENCH_READER_SAMPLES);
+
+		memcpy(&samples[n], readers[r].samples, count * sizeof(uint64_t));
+		n += count;
+		free(readers[r].samples);
+	}
+	if (n == 0)
+		fatal("readers made no queries", VSTATUS_BAD);
+	qsort(samples, n, sizeof(uint64_t), bench_cmp_u64);
+
+	if (csvOutput) {
+		printf("mode,rounds,readers,queries,locked_usec,max_locked_usec,p50_nsec,p99_nsec,p999_nsec,max_nsec\n");
+		printf("%s,%d,%d,%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64"\n",
+			deferred ? "deferred" : "locked", publishRounds, readerThreads, queries,
+			lockedUsecs / publishRounds, maxLockedUsecs, samples[n / 2], samples[n * 99 / 100],
+			samples[n * 999 / 1000], samples[n - 1]);
+	} else {
+		printf("{\"publish\":{\"mode\":\"%s\",\"rounds\":%d,\"readers\":%d,\"queries\":%"PRIu64","
+			"\"locked_usec\":%"PRIu64",\"max_locked_usec\":%"PRIu64",\"p50_nsec\":%"PRIu64","
+			"\"p99_nsec\":%"PRIu64",\"p999_nsec\":%"PRIu64",\"max_nsec\":%"PRIu64"}}\n",
+			deferred ? "deferred" : "locked", publishRounds, readerThreads, queries,
+			lockedUsecs / publishRounds, maxLockedUsecs, samples[n / 2], samples[n * 99 / 100],
+			samples[n * 999 / 1000], samples[n - 1]);
+	}
+	fflush(stdout);
+	free(samples);
+}
+
+//
+//  main utility function
+//
+int main(int argc, char *argv[]) {
+	BenchPhaseResult_t results[PHASE_COUNT];
+	uint64_t start, end;
+	Status_t status;
+	int c, i, p;
+
+	while ((c = getopt(argc, argv, BENCH_FABRIC_OPTS "i:L:sbp:R:j:S:W:F:M:cv")) != -1) {
+		switch (c) {
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		case 'L':
+			lidLookups = atoi(optarg);
+			break;
+		case 's':
+			resweep = 1;
+			break;
+		case 'b':
+			compareEngines = 1;
+			break;
+		case 'p':
+			publishRounds = atoi(optarg);
+			break;
+		case 'R':
+			readerThreads = atoi(optarg);
+			break;
+		case 'j':
+			mcJoins = atoi(optarg);
+			break;
+		case 'S':
+			if (sscanf(optarg, "%d,%d,%d,%d", &smaLatency, &smaLossPct, &smaSlowPct, &smaParallel) < 1)
+				usage();
+			break;
+		case 'W':
+			failedIsls = atoi(optarg);
+			break;
+		case 'F':
+			if (sscanf(optarg, "%d,%d", &flapRounds, &flapLinks) < 1)
+				usage();
+			break;
+		case 'M':
+			lftThreads = atoi(optarg);
+			break;
+		case 'c':
+			csvOutput = 1;
+			break;
+		case 'v':
+			verify = 1;
+			break;
+		default:
+			if (!bench_fabric_option(c, optarg))
+				usage();
+			break;
+		}
+	}
+
+	if (!bench_fabric_check() || iterations < 1 || lidLookups < 0 ||
+		publishRounds < 0 || mcJoins < 0 || failedIsls < 0 || flapRounds < 0 || lftThreads < 0 || flapLinks < 1 ||
+		(mcJoins && numMcGroups < 2) || readerThreads < 1 || readerThreads > BENCH_MAX_READERS ||
+		smaLatency < 0 || smaLossPct < 0 || smaLossPct > 100 || smaSlowPct < 0 || smaSlowPct > 100 || smaParallel < 1)
+		usage();
+
+	bench_init();
+
+	// Discovery: build the graph, assign LIDs and run the routing module's
+	// discovery hooks.
+	vs_time_get(&start);
+	bench_build();
+	bench_create_mc_groups();
+	vs_time_get(&end);
+	results[PHASE_DISCOVERY].usecs = end - start;
+	results[PHASE_DISCOVERY].maxRssKb = maxRssKb();
+
+	for (i = 0; i < iterations; i++) {
+		for (p = PHASE_DISCOVERY + 1; p < PHASE_COUNT; p++) {
+			vs_time_get(&start);
+			status = bench_run_phase((BenchPhase_t)p);
+			vs_time_get(&end);
+			if (status != VSTATUS_OK) {
+				fprintf(stderr, "smroutebench: phase %s failed (status %d)\n", phaseNames[p], (int)status);
+				exit(2);
+			}
+			results[p].usecs = end - start;
+			results[p].maxRssKb = maxRssKb();
+		}
+		bench_report(i, results);
+		if (verify && (c = bench_verify_lfts()) != 0) {
+			fprintf(stderr, "smroutebench: %d unreachable switch/LID pairs\n", c);
+			exit(3);
+		}
+		if (i == 0)
+			results[PHASE_DISCOVERY].usecs = 0;
+	}
+
+	if (compareEngines && (c = bench_compare_cost_engines()) != 0) {
+		fprintf(stderr, "smroutebench: %d cost or path entries differ\n", c);
+		exit(3);
+	}
+
+	if (lidLookups)
+		bench_lid_lookups();
+
+	if (mcJoins)
+		bench_mcast_joins();
+
+	if (smaLatency)
+		bench_sma_programming();
+
+	if (resweep)
+		bench_resweep();
+
+	if (publishRounds) {
+		bench_publish(0);
+		bench_publish(1);
+	}
+
+	if (failedIsls)
+		bench_lft_writes();
+
+	if (lftThreads && (c = bench_lft_threads(lftThreads)) != 0) {
+		fprintf(stderr, "smroutebench: %d switches have different LFTs on %d threads\n", c, lftThreads);
+		exit(3);
+	}
+
+	if (flapRounds && ((c = bench_cost_flaps(0)) != 0 || (c = bench_cost_flaps(1)) != 0)) {
+		fprintf(stderr, "smroutebench: %d cost or path entries differ\n", c);
+		exit(3);
+	}
+
+	exit(0);
+}
@@ -0,0 +1,1186 @@
+/* BEGIN_ICS_COPYRIGHT7 ****************************************
+
+Copyright (c) 2015-2020, Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+** END_ICS_COPYRIGHT7   ****************************************/
+
+/* [ICS VERSION STRING: unknown] */
+
+//===========================================================================//
+//									     //
+// FILE NAME								     //
+//    smsabench.c							     //
+//									     //
+// DESCRIPTION								     //
+//    Offline benchmark for the SA.  Builds and routes a synthetic fabric   //
+//    with smbenchfabric.c, then replays PathRecord, GETTABLE,		     //
+//    ServiceRecord, multicast join storm, trap forwarding and response     //
+//    assembly load against it.  Each replay checks the SA's cached or	     //
+//    indexed answers against the uncached ones and exits non-zero if they  //
+//    differ.								     //
+//									     //
+// DEPENDENCIES								     //
+//    sm_l.h								     //
+//    sa_l.h								     //
+//    smbenchfabric.h							     //
+//									     //
+//===========================================================================//
+
+#include "os_g.h"
+#include "ib_status.h"
+#include "ib_types.h"
+#include "ib_mad.h"
+#include "ib_macros.h"
+#include "sm_l.h"
+#include "sa_l.h"
+#include "cs_g.h"
+#include "cs_log.h"
+#include "smbenchfabric.h"
+
+extern	int	sm_sa_getNoticeCount(STL_NOTICE *);
+extern	Status_t	sweep_cache_build(SweepContext_t *);
+extern	Status_t	topology_cache_copy(void);
+
+#define BENCH_JOB_RANKS			256	// HFIs querying paths in the -P replay
+#define BENCH_PATH_INDEX_ENTRIES	65536	// SaPathIndexEntries default
+#define BENCH_PATH_WILDCARD_MB		64		// SaPathWildcardCacheMB default
+#define BENCH_SA_CACHE_MAX_MB	64		// SaCacheMaxMB default
+#define BENCH_SERVICE_ID_BASE	0x1000000000000000ull
+#define BENCH_SERVICE_REPLICAS	4		// HFIs registering each ServiceID in the -D replay
+#define BENCH_STORM_MGID_BASE	0x00000000f0000000ull	// InterfaceID of the first -J group
+#define BENCH_TRAP_NOTICES		65536	// notices matched in the -I replay
+#define BENCH_RESP_QUERIES		10		// GETTABLEs answered in the -Q replay
+
+const char		*benchName = "smsabench";
+
+static int		pathQueries;		// -P PathRecord queries to replay
+static int		tableQueries;		// -G GETTABLE queries per cached table
+static int		serviceRecords;		// -D ServiceRecords to register and age
+static int		stormGroups;		// -J groups every HFI joins and leaves
+static int		trapSubscribers;	// -I trap subscriptions to match against
+static int		responseRecords;	// -Q ServiceRecords per GETTABLE response
+
+// Makes the routed fabric old_topology, as the SA finds it after a sweep,
+// with one VF that every end port is a full member of.
+static VirtualFabrics_t *
+bench_sa_attach(void)
+{
+	VirtualFabrics_t *vfs;
+	Node_t *nodep;
+	Port_t *portp;
+	Status_t status;
+
+	memcpy(&old_topology, &sm_newTopology, sizeof(Topology_t));
+	if ((status = vs_pool_alloc(&sm_pool, sizeof(VirtualFabrics_t), (void *)&vfs)) != VSTATUS_OK)
+		fatal("cannot allocate VF configuration", status);
+	memset(vfs, 0, sizeof(VirtualFabrics_t));
+	vfs->number_of_vfs_all = 1;
+	vfs->number_of_qos_all = 1;
+	vfs->v_fabric_all[0].pkey = STL_DEFAULT_FM_PKEY;
+	vfs->v_fabric_all[0].max_mtu_int = STL_MTU_10240;
+	vfs->v_fabric_all[0].max_rate_int = IB_STATIC_RATE_MAX;
+	old_topology.vfs_ptr = vfs;
+
+	for_all_nodes(&old_topology, nodep) {
+		for_all_end_ports(nodep, portp) {
+			if (!sm_valid_port(portp) || portp->state < IB_PORT_ACTIVE)
+				continue;
+			portp->portData->pPKey[STL_DEFAULT_FM_PKEY_IDX].AsReg16 = STL_DEFAULT_FM_PKEY;
+			bitset_set(&portp->portData->vfMember, 0);
+			bitset_set(&portp->portData->fullPKeyMember, 0);
+		}
+	}
+	return vfs;
+}
+
+// Runs the PathRecord queries of the -P replay untimed and returns a hash
+// of the records and status each returns.
+static uint64_t
+bench_path_hash(int pathQueries, Port_t **srcPorts, Port_t **dstPorts, uint8_t *query,
+	uint8_t *records)
+{
+	uint64_t hash = 0;
+	uint32_t count, i, j;
+	Status_t status;
+
+	for (i = 0; i < (uint32_t)pathQueries; i++) {
+		count = 0;
+		if (dstPorts[i]) {
+			status = sa_PathRecord_Set(query, &count, SA_MAD_CVERSION, 1, srcPorts[i],
+				STL_LID_PERMISSIVE, dstPorts[i], STL_LID_PERMISSIVE, 0, 0, 0, 0xff);
+		} else {
+			status = sa_PathRecord_Wildcard(query, srcPorts[i], SA_MAD_CVERSION,
+				STL_LID_PERMISSIVE, &count, 0, 1, srcPorts[i]->portData->nodePtr, 0, 0xff);
+		}
+		hash = (hash ^ (uint32_t)status) * 0x100000001b3ull;
+		for (j = 0; j < count * sizeof(IB_PATH_RECORD); j++)
+			hash = (hash ^ records[j]) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+// Replays pathQueries PathRecord queries against the routed fabric as
+// old_topology, with one VF that every port is a full member of.  The
+// queries come from the HFIs of one job: 19 in 20 ask for the paths to
+// one other rank, the rest are wildcard queries for the paths to every
+// port.  The replay runs without the PathRecord index and wildcard cache,
+// then with them empty and once more with them warm, as later sweeps that
+// leave the routes alone find them; all three must return the same records.
+// Then the first source's PKey, VF membership and LID are changed in turn
+// under the warm index: once sa_PathRecIndexUpdate() has seen the change,
+// the replay must return what it returns without the index.
+static void
+bench_path_records(int pathQueries)
+{
+	static const char *runNames[] = { "off", "cold", "warm" };
+	VirtualFabrics_t *vfs;
+	Node_t *nodep;
+	Port_t *portp;
+	Port_t **hfiPorts, **srcPorts, **dstPorts;
+	uint8_t query[sizeof(IB_PATH_RECORD)];
+	uint8_t *records;
+	uint32_t seed = 1, numHfiPorts = 0, numEndPorts = 0, ranks, count, i, j;
+	uint64_t start, end, usecs, pairUsecs, wildcardUsecs, total, hash, refHash = 0, offHash;
+	uint32_t pairs = 0;
+	Port_t *victim;
+	STL_LID victimLid;
+	Status_t status;
+	int run, change;
+
+	vfs = bench_sa_attach();
+	sm_config.enforceVFPathRecs = 1;
+
+	for_all_nodes(&old_topology, nodep) {
+		for_all_end_ports(nodep, portp) {
+			if (!sm_valid_port(portp) || portp->state < IB_PORT_ACTIVE)
+				continue;
+			numEndPorts++;
+			if (nodep->nodeInfo.NodeType != NI_TYPE_SWITCH)
+				numHfiPorts++;
+		}
+	}
+	if (numHfiPorts < 2)
+		fatal("PathRecord replay needs at least two HFIs", VSTATUS_BAD);
+
+	// a wildcard query returns one path to every port
+	sa_max_ib_path_records = numEndPorts + 1;
+	if ((status = vs_pool_alloc(&sm_pool, sizeof(Port_t *) * (numHfiPorts + 2 * pathQueries),
+			(void *)&hfiPorts)) != VSTATUS_OK ||
+		(status = vs_pool_alloc(&sm_pool, sizeof(IB_PATH_RECORD) * (sa_max_ib_path_records + 1),
+			(void *)&records)) != VSTATUS_OK)
+		fatal("cannot allocate PathRecord replay buffers", status);
+	srcPorts = hfiPorts + numHfiPorts;
+	dstPorts = srcPorts + pathQueries;
+	sa_data = records;
+	memset(template_mask, 0, sizeof(template_mask));
+	memset(query, 0, sizeof(query));
+
+	numHfiPorts = 0;
+	for_all_nodes(&old_topology, nodep) {
+		if (nodep->nodeInfo.NodeType == NI_TYPE_SWITCH)
+			continue;
+		for_all_end_ports(nodep, portp) {
+			if (sm_valid_port(portp) && portp->state >= IB_PORT_ACTIVE)
+				hfiPorts[numHfiPorts++] = portp;
+		}
+	}
+	// the job's ranks are the first entries after a shuffle
+	for (i = numHfiPorts - 1; i > 0; i--) {
+		seed = seed * 1103515245 + 12345;
+		j = (seed >> 8) % (i + 1);
+		portp = hfiPorts[i];
+		hfiPorts[i] = hfiPorts[j];
+		hfiPorts[j] = portp;
+	}
+	ranks = MIN(numHfiPorts, BENCH_JOB_RANKS);
+	for (i = 0; i < (uint32_t)pathQueries; i++) {
+		seed = seed * 1103515245 + 12345;
+		srcPorts[i] = hfiPorts[(seed >> 8) % ranks];
+		seed = seed * 1103515245 + 12345;
+		dstPorts[i] = (seed >> 8) % 20 == 0 ? NULL : hfiPorts[(seed >> 12) % ranks];
+		if (dstPorts[i])
+			pairs++;
+	}
+
+	if (csvOutput)
+		printf("queries,ranks,index,records,usec,queries_per_sec,pair_queries_per_sec,"
+			"wildcard_queries_per_sec\n");
+
+	for (run = 0; run < 3; run++) {
+		if (run < 2 && (status = sa_PathRecIndexInit(run ? BENCH_PATH_INDEX_ENTRIES : 0,
+				run ? BENCH_PATH_WILDCARD_MB : 0)) != VSTATUS_OK)
+			fatal("cannot allocate PathRecord index", status);
+		total = 0;
+		hash = 0;
+		usecs = pairUsecs = wildcardUsecs = 0;
+		for (i = 0; i < (uint32_t)pathQueries; i++) {
+			count = 0;
+			vs_time_get(&start);
+			if (dstPorts[i]) {
+				status = sa_PathRecord_Set(query, &count, SA_MAD_CVERSION, 1, srcPorts[i],
+					STL_LID_PERMISSIVE, dstPorts[i], STL_LID_PERMISSIVE, 0, 0, 0, 0xff);
+			} else {
+				status = sa_PathRecord_Wildcard(query, srcPorts[i], SA_MAD_CVERSION,
+					STL_LID_PERMISSIVE, &count, 0, 1, srcPorts[i]->portData->nodePtr, 0, 0xff);
+			}
+			vs_time_get(&end);
+			usecs += end - start;
+			if (dstPorts[i])
+				pairUsecs += end - start;
+			else
+				wildcardUsecs += end - start;
+			if (status != VSTATUS_OK)
+				fatal("PathRecord query failed", status);
+			total += count;
+			for (j = 0; j < count * sizeof(IB_PATH_RECORD); j++)
+				hash = (hash ^ records[j]) * 0x100000001b3ull;
+		}
+		if (run == 0)
+			refHash = hash;
+		else if (hash != refHash)
+			fatal("PathRecord index or wildcard cache changed the records returned", VSTATUS_BAD);
+
+		if (csvOutput) {
+			printf("%d,%u,%s,%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64"\n", pathQueries, ranks,
+				runNames[run], total, usecs, usecs ? (uint64_t)pathQueries * 1000000 / usecs : 0,
+				pairUsecs ? (uint64_t)pairs * 1000000 / pairUsecs : 0,
+				wildcardUsecs ? (uint64_t)(pathQueries - pairs) * 1000000 / wildcardUsecs : 0);
+		} else {
+			printf("{\"path_records\":{\"queries\":%d,\"ranks\":%u,\"index\":\"%s\",\"records\":%"PRIu64","
+				"\"usec\":%"PRIu64",\"queries_per_sec\":%"PRIu64",\"pair_queries_per_sec\":%"PRIu64","
+				"\"wildcard_queries_per_sec\":%"PRIu64"}}\n",
+				pathQueries, ranks, runNames[run], total, usecs,
+				usecs ? (uint64_t)pathQueries * 1000000 / usecs : 0,
+				pairUsecs ? (uint64_t)pairs * 1000000 / pairUsecs : 0,
+				wildcardUsecs ? (uint64_t)(pathQueries - pairs) * 1000000 / wildcardUsecs : 0);
+		}
+	}
+	fflush(stdout);
+
+	victim = srcPorts[0];
+	victimLid = victim->portData->lid;
+	refHash = bench_path_hash(pathQueries, srcPorts, dstPorts, query, records);
+	for (change = 0; change < 3; change++) {
+		if (change && ((status = sa_PathRecIndexInit(BENCH_PATH_INDEX_ENTRIES,
+				BENCH_PATH_WILDCARD_MB)) != VSTATUS_OK ||
+				bench_path_hash(pathQueries, srcPorts, dstPorts, query, records) != refHash))
+			fatal("PathRecord index did not warm up again", VSTATUS_BAD);
+		switch (change) {
+		case 0:
+			victim->portData->pPKey[STL_DEFAULT_FM_PKEY_IDX].AsReg16 = 0;
+			break;
+		case 1:
+			bitset_clear(&victim->portData->vfMember, 0);
+			bitset_clear(&victim->portData->fullPKeyMember, 0);
+			break;
+		case 2:
+			victim->portData->lid = victimLid + (1 << victim->portData->lmc) * numEndPorts;
+			break;
+		}
+		(void)vs_wrlock(&old_topology_lock);
+		sa_PathRecIndexUpdate(&old_topology, 0);
+		(void)vs_rwunlock(&old_topology_lock);
+		hash = bench_path_hash(pathQueries, srcPorts, dstPorts, query, records);
+		if ((status = sa_PathRecIndexInit(0, 0)) != VSTATUS_OK)
+			fatal("cannot free PathRecord index", status);
+		offHash = bench_path_hash(pathQueries, srcPorts, dstPorts, query, records);
+		if (offHash == refHash)
+			fatal("PathRecord replay does not see the change", VSTATUS_BAD);
+		if (hash != offHash)
+			fatal("PathRecord index was not emptied after a change", VSTATUS_BAD);
+
+		victim->portData->pPKey[STL_DEFAULT_FM_PKEY_IDX].AsReg16 = STL_DEFAULT_FM_PKEY;
+		bitset_set(&victim->portData->vfMember, 0);
+		bitset_set(&victim->portData->fullPKeyMember, 0);
+		victim->portData->lid = victimLid;
+	}
+
+	(void)sa_PathRecIndexInit(0, 0);
+	sa_data = NULL;
+	old_topology.vfs_ptr = NULL;
+	vs_pool_free(&sm_pool, records);
+	vs_pool_free(&sm_pool, hfiPorts);
+	vs_pool_free(&sm_pool, vfs);
+}
+
+// The record types sweep_cache_build() keeps unfiltered GETTABLE responses
+// for, besides NodeRecords, in SA cache index order.
+typedef struct {
+	const char	*name;
+	uint16_t	aid;
+	uint32_t	recordLen;
+	int			cacheIndex;
+	Status_t	(*getTable)(Mai_t *, uint32_t *, SACacheEntry_t **);
+} BenchSaTable_t;
+
+static const BenchSaTable_t saTables[] = {
+	{ "portinfo", STL_SA_ATTR_PORTINFO_RECORD, sizeof(STL_PORTINFO_RECORD),
+		SA_CACHE_PORTINFO, sa_PortInfoRecord_GetTable },
+	{ "link", STL_SA_ATTR_LINK_RECORD, sizeof(STL_LINK_RECORD),
+		SA_CACHE_LINKS, sa_LinkRecord_GetTable },
+	{ "switchinfo", STL_SA_ATTR_SWITCHINFO_RECORD, sizeof(STL_SWITCHINFO_RECORD),
+		SA_CACHE_SWITCHINFO, sa_SwitchInfoRecord_GetTable },
+	{ "vfabric", STL_SA_ATTR_VF_INFO_RECORD, sizeof(STL_VFINFO_RECORD),
+		SA_CACHE_VFABRICS, sa_VFabric_GetTable },
+	{ "lft", STL_SA_ATTR_LINEAR_FWDTBL_RECORD, sizeof(STL_LINEAR_FORWARDING_TABLE_RECORD),
+		SA_CACHE_LFTS, sa_LFTableRecord_GetTable },
+};
+
+// Replays tableQueries unfiltered GETTABLE queries of each record type in
+// saTables from the fabric's HFIs, the way tools poll the SA, and hands each
+// response to an SA context as the record handlers do.  The replay runs with
+// the SA caches off (SaCacheMaxMB 0), building each table per query, and
+// again after sweep_cache_build() has built them; both must return the same
+// records, and every query of the second run must be a cache hit.
+static void
+bench_sa_tables(int tableQueries)
+{
+	static const char *runNames[] = { "off", "on" };
+	Topology_t *topop = &sm_newTopology;
+	const BenchSaTable_t *table;
+	VirtualFabrics_t *vfs;
+	Node_t *nodep;
+	Port_t *portp;
+	STL_LID *srcLids;
+	Mai_t mad;
+	sa_cntxt_t cntxt;
+	SACacheEntry_t *cache;
+	uint32_t seed = 1, numSrcs = 0, count, i, j;
+	uint64_t start, end, usecs, buildUsecs, hits, total, hash, refHash[sizeof(saTables) / sizeof(saTables[0])];
+	Status_t status;
+	int run, t;
+
+	vfs = bench_sa_attach();
+	topop->vfs_ptr = vfs;
+
+	// as large as an SA sized for this fabric would allow
+	sa_data_length = 512 * (topop->num_nodes + topop->num_ports);
+	if ((status = vs_pool_alloc(&sm_pool, sa_data_length, (void *)&sa_data)) != VSTATUS_OK ||
+		(status = vs_pool_alloc(&sm_pool, sizeof(STL_LID) * numHfis, (void *)&srcLids)) != VSTATUS_OK)
+		fatal("cannot allocate SA table replay buffers", status);
+	memset(template_mask, 0, sizeof(template_mask));
+
+	for_all_nodes(&old_topology, nodep) {
+		if (nodep->nodeInfo.NodeType == NI_TYPE_SWITCH)
+			continue;
+		for_all_end_ports(nodep, portp) {
+			if (sm_valid_port(portp) && portp->state >= IB_PORT_ACTIVE && numSrcs < (uint32_t)numHfis)
+				srcLids[numSrcs++] = portp->portData->lid;
+		}
+	}
+	if (numSrcs == 0)
+		fatal("SA table replay needs at least one HFI", VSTATUS_BAD);
+
+	if ((status = sa_cache_init()) != VSTATUS_OK)
+		fatal("cannot init SA caches", status);
+
+	if (csvOutput)
+		printf("queries,table,cache,records,build_usec,usec,nsec_per_query,hits\n");
+
+	for (run = 0; run < 2; run++) {
+		sm_config.sa_cache_max_mb = run ? BENCH_SA_CACHE_MAX_MB : 0;
+		vs_time_get(&start);
+		(void)sweep_cache_build(NULL);
+		(void)topology_cache_copy();
+		vs_time_get(&end);
+		buildUsecs = end - start;
+
+		for (t = 0; t < (int)(sizeof(saTables) / sizeof(saTables[0])); t++) {
+			table = &saTables[t];
+			hits = saCache.hits[table->cacheIndex];
+			total = 0;
+			hash = 0;
+			usecs = 0;
+			for (i = 0; i < (uint32_t)tableQueries; i++) {
+				memset(&mad, 0, sizeof(mad));
+				mad.base.bversion = STL_BASE_VERSION;
+				mad.base.cversion = STL_SA_CLASS_VERSION;
+				mad.base.method = SA_CM_GETTABLE;
+				mad.base.aid = table->aid;
+				mad.datasize = sizeof(STL_SA_MAD_HEADER) + table->recordLen;
+				seed = seed * 1103515245 + 12345;
+				mad.addrInfo.slid = srcLids[(seed >> 8) % numSrcs];
+				memset(&cntxt, 0, sizeof(cntxt));
+				count = 0;
+
+				vs_time_get(&start);
+				(void)table->getTable(&mad, &count, &cache);
+				if (mad.base.status != MAD_STATUS_OK)
+					fatal("SA table query failed", mad.base.status);
+				(void)sa_cntxt_data_cached(&cntxt, sa_data,
+					count * (table->recordLen + Calculate_Padding(table->recordLen)), cache);
+				vs_time_get(&end);
+				usecs += end - start;
+
+				total += count;
+				for (j = 0; j < cntxt.len; j++)
+					hash = (hash ^ (uint8_t)cntxt.data[j]) * 0x100000001b3ull;
+
+				vs_time_get(&start);
+				if (cntxt.freeDataFunc)
+					(void)cntxt.freeDataFunc(&cntxt);
+				vs_time_get(&end);
+				usecs += end - start;
+			}
+			hits = saCache.hits[table->cacheIndex] - hits;
+			if (run == 0)
+				refHash[t] = hash;
+			else if (hash != refHash[t])
+				fatal("SA cache changed the records returned", VSTATUS_BAD);
+			else if (hits != (uint64_t)tableQueries)
+				fatal("SA table query missed its cache", VSTATUS_BAD);
+
+			if (csvOutput) {
+				printf("%d,%s,%s,%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64"\n", tableQueries,
+					table->name, runNames[run], total / tableQueries, buildUsecs, usecs,
+					usecs * 1000 / tableQueries, hits);
+			} else {
+				printf("{\"sa_tables\":{\"queries\":%d,\"table\":\"%s\",\"cache\":\"%s\","
+					"\"records\":%"PRIu64",\"build_usec\":%"PRIu64",\"usec\":%"PRIu64","
+					"\"nsec_per_query\":%"PRIu64",\"hits\":%"PRIu64"}}\n",
+					tableQueries, table->name, runNames[run], total / tableQueries, buildUsecs,
+					usecs, usecs * 1000 / tableQueries, hits);
+			}
+		}
+	}
+	fflush(stdout);
+
+	sm_config.sa_cache_max_mb = 0;
+	(void)sweep_cache_build(NULL);
+	(void)topology_cache_copy();
+	sa_cache_clean();
+	topop->vfs_ptr = NULL;
+	old_topology.vfs_ptr = NULL;
+	vs_pool_free(&sm_pool, srcLids);
+	vs_pool_free(&sm_pool, sa_data);
+	sa_data = NULL;
+	vs_pool_free(&sm_pool, vfs);
+}
+
+// The ServiceRecord queries of the -D replay, by the fields they name.
+typedef enum {
+	SERVICE_QUERY_KEY,		// ServiceID, ServiceGID and ServiceP_Key
+	SERVICE_QUERY_ID,		// ServiceID
+	SERVICE_QUERY_GID,		// ServiceGID
+	SERVICE_QUERY_NAME,		// ServiceName, which no index covers
+	SERVICE_QUERY_COUNT
+} BenchServiceQuery_t;
+
+static const char *serviceQueryNames[SERVICE_QUERY_COUNT] = { "key", "id", "gid", "name" };
+static const uint64_t serviceQueryMasks[SERVICE_QUERY_COUNT] = {
+	IB_SERVICE_RECORD_COMP_SERVICEID | IB_SERVICE_RECORD_COMP_SERVICEGID | IB_SERVICE_RECORD_COMP_SERVICEPKEY,
+	IB_SERVICE_RECORD_COMP_SERVICEID,
+	IB_SERVICE_RECORD_COMP_SERVICEGID,
+	IB_SERVICE_RECORD_COMP_SERVICENAME,
+};
+
+// Registers serviceRecords ServiceRecords from the fabric's HFIs, each
+// ServiceID from BENCH_SERVICE_REPLICAS of them, 1 in 8 with a lease that
+// has run out, 3 in 8 with an hour's lease and the rest for good.  Then
+// queries each of them once, by its whole key, by its ServiceID, by its
+// GID or by its name, in turn, through the IB ServiceRecord GETTABLE the
+// SA answers, and checks the number of records returned against a scan of
+// what was registered.  Last it ages the table twice: once removing the
+// expired records, once with nothing left to expire.
+static void
+bench_service_records(int serviceRecords)
+{
+	STL_SERVICE_RECORD sr, *registered;
+	IB_SA_MAD query;
+	IB_SERVICE_RECORD *ibsrp;
+	Port_t **hfiPorts;
+	Node_t *nodep;
+	Port_t *portp;
+	Mai_t mad;
+	SAResponse_t *resp;
+	uint32_t numHfiPorts = 0, count, expected, added, aged, expired = 0, i, j;
+	uint64_t start, end, addUsecs, ageUsecs[2];
+	uint64_t usecs[SERVICE_QUERY_COUNT], total[SERVICE_QUERY_COUNT], queries[SERVICE_QUERY_COUNT];
+	BenchServiceQuery_t kind;
+	Status_t status;
+
+	memcpy(&old_topology, &sm_newTopology, sizeof(Topology_t));
+	for_all_nodes(&old_topology, nodep) {
+		if (nodep->nodeInfo.NodeType == NI_TYPE_SWITCH)
+			continue;
+		for_all_end_ports(nodep, portp) {
+			if (sm_valid_port(portp) && portp->state >= IB_PORT_ACTIVE)
+				numHfiPorts++;
+		}
+	}
+	if (numHfiPorts < BENCH_SERVICE_REPLICAS)
+		fatal("ServiceRecord replay needs at least four HFIs", VSTATUS_BAD);
+
+	if ((status = vs_pool_alloc(&sm_pool, sizeof(Port_t *) * numHfiPorts, (void *)&hfiPorts)) != VSTATUS_OK ||
+		(status = vs_pool_alloc(&sm_pool, sizeof(STL_SERVICE_RECORD) * serviceRecords,
+			(void *)&registered)) != VSTATUS_OK)
+		fatal("cannot allocate ServiceRecord replay buffers", status);
+
+	numHfiPorts = 0;
+	for_all_nodes(&old_topology, nodep) {
+		if (nodep->nodeInfo.NodeType == NI_TYPE_SWITCH)
+			continue;
+		for_all_end_ports(nodep, portp) {
+			if (sm_valid_port(portp) && portp->state >= IB_PORT_ACTIVE)
+				hfiPorts[numHfiPorts++] = portp;
+		}
+	}
+
+	if ((status = sa_ServiceRecInit()) != VSTATUS_OK)
+		fatal("cannot init the ServiceRecord table", status);
+
+	addUsecs = 0;
+	for (i = 0; i < (uint32_t)serviceRecords; i++) {
+		// replicas of a ServiceID on HFIs far apart, so every key is unique
+		portp = hfiPorts[(i % BENCH_SERVICE_REPLICAS) * (numHfiPorts / BENCH_SERVICE_REPLICAS) +
+			(i / BENCH_SERVICE_REPLICAS) % (numHfiPorts / BENCH_SERVICE_REPLICAS)];
+		memset(&sr, 0, sizeof(sr));
+		sr.RID.ServiceID = BENCH_SERVICE_ID_BASE + i / BENCH_SERVICE_REPLICAS;
+		sr.RID.ServiceGID.Type.Global.SubnetPrefix = sm_config.subnet_prefix;
+		sr.RID.ServiceGID.Type.Global.InterfaceID = portp->portData->guid;
+		sr.RID.ServiceP_Key = STL_DEFAULT_FM_PKEY;
+		sr.ServiceLease = (i % 8 == 0) ? 0 : (i % 8 < 4) ? 3600 : 0xffffffff;
+		snprintf((char *)sr.ServiceName, sizeof(sr.ServiceName), "bench.service.%u", i);
+		registered[i] = sr;
+		if (sr.ServiceLease == 0)
+			expired++;
+
+		vs_time_get(&start);
+		status = sa_ServiceRecord_DoAdd(portp->portData->lid, &sr, &added, 0);
+		vs_time_get(&end);
+		addUsecs += end - start;
+		if (status != VSTATUS_OK || added != 1)
+			fatal("cannot register a ServiceRecord", status);
+	}
+
+	memset(usecs, 0, sizeof(usecs));
+	memset(total, 0, sizeof(total));
+	memset(queries, 0, sizeof(queries));
+	for (i = 0; i < (uint32_t)serviceRecords; i++) {
+		kind = i % SERVICE_QUERY_COUNT;
+		memset(&query, 0, sizeof(query));
+		query.SaHdr.ComponentMask = serviceQueryMasks[kind];
+		ibsrp = (IB_SERVICE_RECORD *)query.Data;
+		memcpy(ibsrp->RID.ServiceGID.Raw, registered[i].RID.ServiceGID.Raw, sizeof(IB_GID));
+		ibsrp->RID.ServiceID = registered[i].RID.ServiceID;
+		ibsrp->RID.ServiceP_Key = registered[i].RID.ServiceP_Key;
+		memcpy(ibsrp->ServiceName, registered[i].ServiceName, sizeof(ibsrp->ServiceName));
+		BSWAP_IB_SERVICE_RECORD(ibsrp);
+
+		memset(&mad, 0, sizeof(mad));
+		mad.base.bversion = IB_BASE_VERSION;
+		mad.base.cversion = SA_MAD_CVERSION;
+		mad.base.method = SA_CM_GETTABLE;
+		mad.base.aid = SA_ATTRIB_SERVICE_RECORD;
+		mad.addrInfo.slid = hfiPorts[i % numHfiPorts]->portData->lid;
+		mad.datasize = sizeof(SA_MAD_HDR) + sizeof(IB_SERVICE_RECORD);
+		BSWAPCOPY_IB_SA_MAD(&query, (IB_SA_MAD *)mad.data, sizeof(IB_SERVICE_RECORD));
+
+		count = 0;
+		vs_time_get(&start);
+		if ((status = sa_resp_alloc(IB_SA_DATA_LEN, &resp)) != VSTATUS_OK)
+			fatal("cannot allocate a ServiceRecord response", status);
+		(void)sa_IbServiceRecord_GetTable(&mad, resp, &count);
+		sa_resp_release(resp);
+		vs_time_get(&end);
+		if (mad.base.status != MAD_STATUS_OK)
+			fatal("ServiceRecord query failed", mad.base.status);
+
+		expected = 0;
+		for (j = 0; j < (uint32_t)serviceRecords; j++) {
+			if (kind == SERVICE_QUERY_ID ? registered[j].RID.ServiceID == registered[i].RID.ServiceID :
+				kind == SERVICE_QUERY_NAME ? j == i :
+				!memcmp(registered[j].RID.ServiceGID.Raw, registered[i].RID.ServiceGID.Raw, sizeof(IB_GID)) &&
+				(kind == SERVICE_QUERY_GID || registered[j].RID.ServiceID == registered[i].RID.ServiceID))
+				expected++;
+		}
+		if (count != expected)
+			fatal("ServiceRecord query returned the wrong records", VSTATUS_BAD);
+
+		usecs[kind] += end - start;
+		total[kind] += count;
+		queries[kind]++;
+	}
+
+	for (j = 0; j < 2; j++) {
+		vs_time_get(&start);
+		(void)sa_ServiceRecord_Age(&aged);
+		vs_time_get(&end);
+		ageUsecs[j] = end - start;
+		if (aged != (j ? 0 : expired) ||
+			cs_hashtable_count(saServiceRecords.serviceRecMap) != (uint32_t)serviceRecords - expired)
+			fatal("ServiceRecord aging removed the wrong records", VSTATUS_BAD);
+	}
+
+	if (csvOutput)
+		printf("services,query,queries,records,usec,nsec_per_query,add_usec,age_usec,idle_age_usec\n");
+	for (kind = 0; kind < SERVICE_QUERY_COUNT; kind++) {
+		if (csvOutput) {
+			printf("%d,%s,%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64"\n",
+				serviceRecords, serviceQueryNames[kind], queries[kind], total[kind], usecs[kind],
+				queries[kind] ? usecs[kind] * 1000 / queries[kind] : 0, addUsecs, ageUsecs[0], ageUsecs[1]);
+		} else {
+			printf("{\"service_records\":{\"services\":%d,\"query\":\"%s\",\"queries\":%"PRIu64","
+				"\"records\":%"PRIu64",\"usec\":%"PRIu64",\"nsec_per_query\":%"PRIu64","
+				"\"add_usec\":%"PRIu64",\"age_usec\":%"PRIu64",\"idle_age_usec\":%"PRIu64"}}\n",
+				serviceRecords, serviceQueryNames[kind], queries[kind], total[kind], usecs[kind],
+				queries[kind] ? usecs[kind] * 1000 / queries[kind] : 0, addUsecs, ageUsecs[0], ageUsecs[1]);
+		}
+	}
+	fflush(stdout);
+
+	sa_ServiceRecDelete();
+	vs_pool_free(&sm_pool, registered);
+	vs_pool_free(&sm_pool, hfiPorts);
+}
+
+// Replays a job start: every HFI joins stormGroups IPoIB-like groups through
+// sa_McMemberRecord_Set(), the first join creating each group, and then
+// leaves them all again through sa_McMemberRecord_Delete(), the last leave
+// deleting the group.  After the joins every HFI must be found in every
+// group, after the leaves no group may be left.
+static void
+bench_mcast_storm(int stormGroups)
+{
+	STL_MCMEMBER_RECORD rec;
+	STL_SA_MAD query;
+	VirtualFabrics_t *vfs;
+	McGroup_t *mcGroup;
+	Port_t **hfiPorts;
+	Node_t *nodep;
+	Port_t *portp;
+	Mai_t mad;
+	IB_GID mgid;
+	uint32_t numHfiPorts = 0, baseGroups, records, h, g, leave;
+	uint64_t start, end, usecs[2];
+	Status_t status;
+
+	// the VF takes every MGID, as the default VF does
+	vfs = bench_sa_attach();
+	cl_qmap_init(&vfs->v_fabric_all[0].apps.mgidMap, NULL);
+	vfs->v_fabric_all[0].apps.select_unmatched_mgid = 1;
+	for_all_nodes(&old_topology, nodep) {
+		if (nodep->nodeInfo.NodeType == NI_TYPE_SWITCH)
+			continue;
+		for_all_end_ports(nodep, portp) {
+			if (sm_valid_port(portp) && portp->state >= IB_PORT_ACTIVE)
+				numHfiPorts++;
+		}
+	}
+	sa_data_length = sizeof(STL_MCMEMBER_RECORD) + Calculate_Padding(sizeof(STL_MCMEMBER_RECORD));
+	if ((status = vs_pool_alloc(&sm_pool, sizeof(Port_t *) * numHfiPorts, (void *)&hfiPorts)) != VSTATUS_OK ||
+		(status = vs_pool_alloc(&sm_pool, sa_data_length, (void *)&sa_data)) != VSTATUS_OK)
+		fatal("cannot allocate multicast storm buffers", status);
+	numHfiPorts = 0;
+	for_all_nodes(&old_topology, nodep) {
+		if (nodep->nodeInfo.NodeType == NI_TYPE_SWITCH)
+			continue;
+		for_all_end_ports(nodep, portp) {
+			if (sm_valid_port(portp) && portp->state >= IB_PORT_ACTIVE)
+				hfiPorts[numHfiPorts++] = portp;
+		}
+	}
+
+	baseGroups = sm_numMcGroups;
+	mgid.Type.Global.SubnetPrefix = 0xff12601bffff0000ull;
+	for (leave = 0; leave < 2; leave++) {
+		usecs[leave] = 0;
+		for (h = 0; h < numHfiPorts; h++) {
+			for (g = 0; g < (uint32_t)stormGroups; g++) {
+				mgid.Type.Global.InterfaceID = BENCH_STORM_MGID_BASE + g;
+				memset(&rec, 0, sizeof(rec));
+				rec.RID.MGID = mgid;
+				rec.RID.PortGID = bench_port_gid(hfiPorts[h]);
+				rec.Q_Key = 0x0b1b;
+				rec.P_Key = STL_DEFAULT_FM_PKEY;
+				rec.JoinFullMember = 1;
+				memset(&query, 0, sizeof(query));
+				query.header.mask = leave ? STL_MCMEMBER_COMPONENTMASK_OK_JOIN :
+					STL_MCMEMBER_COMPONENTMASK_OK_CREATE | STL_MCMEMBER_COMPONENTMASK_OK_JOIN;
+				BSWAPCOPY_STL_MCMEMBER_RECORD(&rec, (STL_MCMEMBER_RECORD *)query.data);
+
+				memset(&mad, 0, sizeof(mad));
+				mad.base.bversion = STL_BASE_VERSION;
+				mad.base.cversion = STL_SA_CLASS_VERSION;
+				mad.base.method = leave ? SA_CM_DELETE : SA_CM_SET;
+				mad.base.aid = STL_SA_ATTR_MCMEMBER_RECORD;
+				mad.addrInfo.slid = hfiPorts[h]->portData->lid;
+				mad.datasize = sizeof(STL_SA_MAD_HEADER) + sizeof(STL_MCMEMBER_RECORD);
+				BSWAPCOPY_STL_SA_MAD(&query, (STL_SA_MAD *)mad.data, sizeof(STL_MCMEMBER_RECORD));
+
+				records = 0;
+				vs_time_get(&start);
+				status = leave ? sa_McMemberRecord_Delete(NULL, &mad, &records) :
+					sa_McMemberRecord_Set(NULL, &mad, &records);
+				vs_time_get(&end);
+				if (status != VSTATUS_OK || mad.base.status != MAD_STATUS_OK)
+					fatal(leave ? "multicast leave failed" : "multicast join failed", mad.base.status);
+				usecs[leave] += end - start;
+			}
+		}
+
+		if (leave) {
+			if (sm_numMcGroups != baseGroups)
+				fatal("multicast groups left after every member left", VSTATUS_BAD);
+			break;
+		}
+		if (sm_numMcGroups != baseGroups + stormGroups)
+			fatal("multicast joins created the wrong groups", VSTATUS_BAD);
+		for (g = 0; g < (uint32_t)stormGroups; g++) {
+			mgid.Type.Global.InterfaceID = BENCH_STORM_MGID_BASE + g;
+			if ((mcGroup = sm_find_multicast_gid(mgid)) == NULL ||
+				mcGroup->members_full != numHfiPorts)
+				fatal("multicast group is missing members", VSTATUS_BAD);
+			for (h = 0; h < numHfiPorts; h++) {
+				if (sm_find_multicast_member(mcGroup, bench_port_gid(hfiPorts[h])) == NULL)
+					fatal("multicast member not found", VSTATUS_BAD);
+			}
+		}
+	}
+
+	if (csvOutput) {
+		printf("hfis,groups,joins,join_usec,nsec_per_join,leave_usec,nsec_per_leave\n");
+		printf("%u,%d,%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64"\n", numHfiPorts, stormGroups,
+			(uint64_t)numHfiPorts * stormGroups, usecs[0], usecs[0] * 1000 / ((uint64_t)numHfiPorts * stormGroups),
+			usecs[1], usecs[1] * 1000 / ((uint64_t)numHfiPorts * stormGroups));
+	} else {
+		printf("{\"mcast_storm\":{\"hfis\":%u,\"groups\":%d,\"joins\":%"PRIu64",\"join_usec\":%"PRIu64","
+			"\"nsec_per_join\":%"PRIu64",\"leave_usec\":%"PRIu64",\"nsec_per_leave\":%"PRIu64"}}\n",
+			numHfiPorts, stormGroups, (uint64_t)numHfiPorts * stormGroups, usecs[0],
+			usecs[0] * 1000 / ((uint64_t)numHfiPorts * stormGroups), usecs[1],
+			usecs[1] * 1000 / ((uint64_t)numHfiPorts * stormGroups));
+	}
+	fflush(stdout);
+
+	vs_pool_free(&sm_pool, sa_data);
+	sa_data = NULL;
+	vs_pool_free(&sm_pool, hfiPorts);
+}
+
+// Trap numbers the -I subscribers ask for, in turn; notices are also sent
+// for MAD_SMT_UNPATH, which only the TRAP_ALL subscribers want.
+static const uint16_t benchTrapNumbers[] = {
+	MAD_SMT_PORT_UP, MAD_SMT_PORT_DOWN, MAD_SMT_MCAST_GRP_CREATED, MAD_SMT_MCAST_GRP_DELETED,
+	MAD_SMT_PORT_CHANGE, MAD_SMT_LINK_INTEGRITY, MAD_SMT_BUF_OVERRUN, MAD_SMT_FLOW_CONTROL,
+	MAD_SMT_CAPABILITYMASK_CHANGE, MAD_SMT_SYSTEMIMAGEGUID_CHANGE, MAD_SMT_BAD_MKEY,
+	MAD_SMT_BAD_PKEY, MAD_SMT_BAD_QKEY, MAD_SMT_BAD_PKEY_ONPORT,
+};
+#define BENCH_TRAP_KINDS	(sizeof(benchTrapNumbers) / sizeof(benchTrapNumbers[0]))
+
+// The key subscription i of the -I replay is filed under: the HFIs take
+// the subscriptions in turn, on a QP per round, and 1 in 32 is to TRAP_ALL.
+static void
+bench_trap_key(uint32_t i, SubscriberKey_t *subsKeyp)
+{
+	Port_t *portp = sm_get_port(hfiList[i % numHfis], 1);
+
+	memset(subsKeyp, 0, sizeof(SubscriberKey_t));
+	memcpy(subsKeyp->subscriberGid, portp->portData->gid, sizeof(IB_GID));
+	subsKeyp->lid = portp->portData->lid;
+	subsKeyp->trapnum = (i % 32 == 0) ? TRAP_ALL : benchTrapNumbers[i % BENCH_TRAP_KINDS];
+	subsKeyp->qpn = 1 + i / numHfis;
+	subsKeyp->pkey = STL_DEFAULT_FM_PKEY;
+	subsKeyp->qkey = GSI_WELLKNOWN_QKEY;
+	subsKeyp->startLid = 1;
+	subsKeyp->endLid = STL_LID_UNICAST_END;
+}
+
+// The subscriptions a notice would go to, found by walking the whole
+// subscriber table as trap forwarding used to.
+static int
+bench_trap_walk(STL_NOTICE *noticep)
+{
+	STL_INFORM_INFO_RECORD *iRecordp;
+	CS_HashTableItr_t itr;
+	int count = 0;
+
+	if (cs_hashtable_count(saSubscribers.subsMap) == 0)
+		return 0;
+	cs_hashtable_iterator(saSubscribers.subsMap, &itr);
+	do {
+		iRecordp = cs_hashtable_iterator_value(&itr);
+		if (iRecordp->InformInfoData.IsGeneric == noticep->Attributes.Generic.u.s.IsGeneric &&
+			(iRecordp->InformInfoData.Type == TRAP_ALL || iRecordp->InformInfoData.Type == noticep->Attributes.Generic.u.s.Type) &&
+			(iRecordp->InformInfoData.u.Generic.TrapNumber == TRAP_ALL ||
+			 iRecordp->InformInfoData.u.Generic.TrapNumber == noticep->Attributes.Generic.TrapNumber))
+			count++;
+	} while (cs_hashtable_iterator_advance(&itr));
+	return count;
+}
+
+// Registers trapSubscribers InformInfo subscriptions from the fabric's HFIs
+// and matches BENCH_TRAP_NOTICES notices against them, once through the
+// trap number index sm_sa_getNoticeCount() shares with trap forwarding and
+// once by walking the whole table, as forwarding used to.  Both must find
+// the same subscribers.  Sending the reports is not timed.  Last every
+// subscription is removed again and the index must be left empty.
+static void
+bench_trap_forwarding(int trapSubscribers)
+{
+	STL_INFORM_INFO_RECORD *iRecordp;
+	SubscriberKey_t subsKey, *subsKeyp;
+	STL_NOTICE notice;
+	uint64_t start, end, addUsecs, removeUsecs, usecs[2], matched = 0;
+	uint32_t i;
+	int count[2];
+	Status_t status;
+
+	if ((status = sa_SubscriberInit()) != VSTATUS_OK)
+		fatal("cannot init the subscriber table", status);
+
+	addUsecs = 0;
+	for (i = 0; i < (uint32_t)trapSubscribers; i++) {
+		if ((subsKeyp = (SubscriberKeyp)malloc(sizeof(SubscriberKey_t))) == NULL ||
+			(iRecordp = sa_SubscriberAlloc()) == NULL)
+			fatal("cannot allocate a subscription", VSTATUS_NOMEM);
+		bench_trap_key(i, subsKeyp);
+		iRecordp->RID.SubscriberLID = subsKeyp->lid;
+		iRecordp->RID.Enum = i;
+		iRecordp->InformInfoData.IsGeneric = 1;
+		iRecordp->InformInfoData.Subscribe = 1;
+		iRecordp->InformInfoData.Type = TRAP_ALL;
+		iRecordp->InformInfoData.u.Generic.TrapNumber = subsKeyp->trapnum;
+		iRecordp->InformInfoData.u.Generic.u1.s.QPNumber = subsKeyp->qpn;
+		iRecordp->InformInfoData.u.Generic.u2.s.ProducerType = NODE_TYPE_ALL;
+
+		vs_time_get(&start);
+		(void)vs_lock(&saSubscribers.subsLock);
+		if (!sa_SubscriberInsert(subsKeyp, iRecordp))
+			fatal("cannot add a subscription", VSTATUS_BAD);
+		(void)vs_unlock(&saSubscribers.subsLock);
+		vs_time_get(&end);
+		addUsecs += end - start;
+	}
+
+	usecs[0] = usecs[1] = 0;
+	for (i = 0; i < BENCH_TRAP_NOTICES; i++) {
+		memset(&notice, 0, sizeof(notice));
+		notice.Attributes.Generic.u.s.IsGeneric = 1;
+		notice.Attributes.Generic.u.s.Type = NOTICE_TYPE_INFO;
+		notice.Attributes.Generic.u.s.ProducerType = NOTICE_PRODUCERTYPE_CLASSMANAGER;
+		notice.Attributes.Generic.TrapNumber = (i % (BENCH_TRAP_KINDS + 1) == BENCH_TRAP_KINDS) ?
+			MAD_SMT_UNPATH : benchTrapNumbers[i % (BENCH_TRAP_KINDS + 1)];
+		notice.IssuerLID = sm_lid;
+
+		vs_time_get(&start);
+		count[0] = sm_sa_getNoticeCount(&notice);
+		vs_time_get(&end);
+		usecs[0] += end - start;
+
+		vs_time_get(&start);
+		(void)vs_lock(&saSubscribers.subsLock);
+		count[1] = bench_trap_walk(&notice);
+		(void)vs_unlock(&saSubscribers.subsLock);
+		vs_time_get(&end);
+		usecs[1] += end - start;
+
+		if (count[0] != count[1])
+			fatal("trap index found the wrong subscribers", VSTATUS_BAD);
+		matched += count[0];
+	}
+
+	vs_time_get(&start);
+	(void)vs_lock(&saSubscribers.subsLock);
+	for (i = 0; i < (uint32_t)trapSubscribers; i++) {
+		bench_trap_key(i, &subsKey);
+		if ((iRecordp = sa_SubscriberRemove(&subsKey)) == NULL)
+			fatal("subscription not found", VSTATUS_BAD);
+		free(iRecordp);
+	}
+	(void)vs_unlock(&saSubscribers.subsLock);
+	vs_time_get(&end);
+	removeUsecs = end - start;
+	if (cs_hashtable_count(saSubscribers.subsMap) != 0 || saSubscribers.allTraps != NULL)
+		fatal("subscriptions left after removing them all", VSTATUS_BAD);
+	for (i = 0; i < SA_SUBSCRIBER_TRAP_CHAINS; i++) {
+		if (saSubscribers.trapIndex[i] != NULL)
+			fatal("subscriptions left in the trap index", VSTATUS_BAD);
+	}
+
+	if (csvOutput) {
+		printf("subscribers,notices,matched,indexed_usec,nsec_per_notice,walk_usec,walk_nsec_per_notice,add_usec,remove_usec\n");
+		printf("%d,%d,%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64"\n",
+			trapSubscribers, BENCH_TRAP_NOTICES, matched, usecs[0], usecs[0] * 1000 / BENCH_TRAP_NOTICES,
+			usecs[1], usecs[1] * 1000 / BENCH_TRAP_NOTICES, addUsecs, removeUsecs);
+	} else {
+		printf("{\"trap_forwarding\":{\"subscribers\":%d,\"notices\":%d,\"matched\":%"PRIu64","
+			"\"indexed_usec\":%"PRIu64",\"nsec_per_notice\":%"PRIu64",\"walk_usec\":%"PRIu64","
+			"\"walk_nsec_per_notice\":%"PRIu64",\"add_usec\":%"PRIu64",\"remove_usec\":%"PRIu64"}}\n",
+			trapSubscribers, BENCH_TRAP_NOTICES, matched, usecs[0], usecs[0] * 1000 / BENCH_TRAP_NOTICES,
+			usecs[1], usecs[1] * 1000 / BENCH_TRAP_NOTICES, addUsecs, removeUsecs);
+	}
+	fflush(stdout);
+
+	sa_SubscriberDelete();
+}
+
+// Registers responseRecords ServiceRecords from the fabric's HFIs and
+// answers BENCH_RESP_QUERIES unfiltered IB ServiceRecord GETTABLEs for all
+// of them.  The SA builds each response in chunks and hands it to a context,
+// from which every RMPP segment is gathered and the checksum taken, as
+// sa_send_multi() does.  For comparison the same response is sent the way
+// every response used to be: copied whole out of the worker's staging
+// buffer into the context and sent from the copy.  Both must send the same
+// bytes.
+static void
+bench_sa_response(int responseRecords)
+{
+	static uint8_t segment[IB_SA_DATA_LEN];
+	STL_SERVICE_RECORD sr;
+	IB_SA_MAD query;
+	Port_t **hfiPorts;
+	Node_t *nodep;
+	Port_t *portp;
+	Mai_t mad;
+	sa_cntxt_t cntxt;
+	SAResponse_t *resp;
+	uint8_t *staging, *copy, chkSum;
+	uint32_t numHfiPorts = 0, stagingLen, respLen, chunkBytes, count, added, segs, seg, dlen, i, q;
+	uint64_t start, end, buildUsecs = 0, sendUsecs = 0, stagedUsecs = 0;
+	Status_t status;
+
+	memcpy(&old_topology, &sm_newTopology, sizeof(Topology_t));
+	for_all_nodes(&old_topology, nodep) {
+		if (nodep->nodeInfo.NodeType == NI_TYPE_SWITCH)
+			continue;
+		for_all_end_ports(nodep, portp) {
+			if (sm_valid_port(portp) && portp->state >= IB_PORT_ACTIVE)
+				numHfiPorts++;
+		}
+	}
+	if (numHfiPorts == 0)
+		fatal("SA response replay needs an HFI", VSTATUS_BAD);
+	if ((status = vs_pool_alloc(&sm_pool, sizeof(Port_t *) * numHfiPorts, (void *)&hfiPorts)) != VSTATUS_OK)
+		fatal("cannot allocate SA response replay buffers", status);
+	numHfiPorts = 0;
+	for_all_nodes(&old_topology, nodep) {
+		if (nodep->nodeInfo.NodeType == NI_TYPE_SWITCH)
+			continue;
+		for_all_end_ports(nodep, portp) {
+			if (sm_valid_port(portp) && portp->state >= IB_PORT_ACTIVE)
+				hfiPorts[numHfiPorts++] = portp;
+		}
+	}
+
+	if ((status = sa_ServiceRecInit()) != VSTATUS_OK)
+		fatal("cannot init the ServiceRecord table", status);
+	for (i = 0; i < (uint32_t)responseRecords; i++) {
+		portp = hfiPorts[i % numHfiPorts];
+		memset(&sr, 0, sizeof(sr));
+		sr.RID.ServiceID = BENCH_SERVICE_ID_BASE + i;
+		sr.RID.ServiceGID.Type.Global.SubnetPrefix = sm_config.subnet_prefix;
+		sr.RID.ServiceGID.Type.Global.InterfaceID = portp->portData->guid;
+		sr.RID.ServiceP_Key = STL_DEFAULT_FM_PKEY;
+		sr.ServiceLease = 0xffffffff;
+		snprintf((char *)sr.ServiceName, sizeof(sr.ServiceName), "bench.response.%u", i);
+		status = sa_ServiceRecord_DoAdd(portp->portData->lid, &sr, &added, 0);
+		if (status != VSTATUS_OK || added != 1)
+			fatal("cannot register a ServiceRecord", status);
+	}
+
+	// the staging buffer an SA sized for this fabric gives each worker
+	stagingLen = 512 * (old_topology.num_nodes + old_topology.num_ports);
+	respLen = responseRecords * (sizeof(IB_SERVICE_RECORD) + Calculate_Padding(sizeof(IB_SERVICE_RECORD)));
+	if ((status = vs_pool_alloc(&sm_pool, respLen, (void *)&staging)) != VSTATUS_OK)
+		fatal("cannot allocate SA response replay buffers", status);
+
+	memset(&query, 0, sizeof(query));
+	memset(&mad, 0, sizeof(mad));
+	mad.base.bversion = IB_BASE_VERSION;
+	mad.base.cversion = SA_MAD_CVERSION;
+	mad.base.method = SA_CM_GETTABLE;
+	mad.base.aid = SA_ATTRIB_SERVICE_RECORD;
+	mad.addrInfo.slid = hfiPorts[0]->portData->lid;
+	mad.datasize = sizeof(SA_MAD_HDR) + sizeof(IB_SERVICE_RECORD);
+	BSWAPCOPY_IB_SA_MAD(&query, (IB_SA_MAD *)mad.data, sizeof(IB_SERVICE_RECORD));
+
+	chunkBytes = 0;
+	segs = (respLen + IB_SA_DATA_LEN - 1) / IB_SA_DATA_LEN;
+	for (q = 0; q < BENCH_RESP_QUERIES; q++) {
+		count = 0;
+		mad.base.status = MAD_STATUS_OK;
+		vs_time_get(&start);
+		if ((status = sa_resp_alloc(IB_SA_DATA_LEN, &resp)) != VSTATUS_OK)
+			fatal("cannot allocate a ServiceRecord response", status);
+		(void)sa_IbServiceRecord_GetTable(&mad, resp, &count);
+		memset(&cntxt, 0, sizeof(cntxt));
+		(void)sa_cntxt_data_resp(&cntxt, resp);
+		sa_resp_release(resp);
+		vs_time_get(&end);
+		buildUsecs += end - start;
+		if (mad.base.status != MAD_STATUS_OK || count != (uint32_t)responseRecords || cntxt.len != respLen)
+			fatal("ServiceRecord GETTABLE returned the wrong records", mad.base.status);
+		chunkBytes = cntxt.resp->size + sizeof(SAResponse_t);
+
+		vs_time_get(&start);
+		for (seg = 0; seg < segs; seg++) {
+			dlen = MIN(IB_SA_DATA_LEN, respLen - seg * IB_SA_DATA_LEN);
+			sa_resp_copy(cntxt.resp, seg * IB_SA_DATA_LEN, segment, dlen);
+		}
+		vs_time_get(&end);
+		sendUsecs += end - start;
+
+		// what the handler would have left in the staging buffer
+		sa_resp_copy(cntxt.resp, 0, staging, respLen);
+
+		vs_time_get(&start);
+		if ((status = vs_pool_alloc(&sm_pool, respLen, (void *)&copy)) != VSTATUS_OK)
+			fatal("cannot allocate a staged response copy", status);
+		memcpy(copy, staging, respLen);
+		for (seg = 0; seg < segs; seg++) {
+			dlen = MIN(IB_SA_DATA_LEN, respLen - seg * IB_SA_DATA_LEN);
+			memcpy(segment, copy + seg * IB_SA_DATA_LEN, dlen);
+		}
+		vs_pool_free(&sm_pool, copy);
+		vs_time_get(&end);
+		stagedUsecs += end - start;
+
+		if (q == 0) {
+			// SaRmppCheckSum, off by default, sums every byte of the response
+			chkSum = 0;
+			for (i = 0; i < respLen; i++)
+				chkSum += staging[i];
+			if (chkSum != sa_resp_checksum(cntxt.resp))
+				fatal("chunked response checksum differs", VSTATUS_BAD);
+
+			// segments out of order make the copy search from the start
+			for (seg = segs; seg-- > 0; ) {
+				dlen = MIN(IB_SA_DATA_LEN, respLen - seg * IB_SA_DATA_LEN);
+				sa_resp_copy(cntxt.resp, seg * IB_SA_DATA_LEN, segment, dlen);
+				if (memcmp(segment, staging + seg * IB_SA_DATA_LEN, dlen))
+					fatal("chunked response sent the wrong bytes", VSTATUS_BAD);
+			}
+		}
+		(void)cntxt.freeDataFunc(&cntxt);
+	}
+
+	if (csvOutput) {
+		printf("records,queries,resp_bytes,segments,chunk_bytes,staging_bytes,staged_bytes,fits_staging,"
+			"build_usec,send_usec,staged_send_usec\n");
+		printf("%d,%d,%u,%u,%u,%u,%u,%d,%"PRIu64",%"PRIu64",%"PRIu64"\n",
+			responseRecords, BENCH_RESP_QUERIES, respLen, segs, chunkBytes, stagingLen,
+			stagingLen + respLen, respLen <= stagingLen, buildUsecs, sendUsecs, stagedUsecs);
+	} else {
+		printf("{\"sa_response\":{\"records\":%d,\"queries\":%d,\"resp_bytes\":%u,\"segments\":%u,"
+			"\"chunk_bytes\":%u,\"staging_bytes\":%u,\"staged_bytes\":%u,\"fits_staging\":%s,"
+			"\"build_usec\":%"PRIu64",\"send_usec\":%"PRIu64",\"staged_send_usec\":%"PRIu64"}}\n",
+			responseRecords, BENCH_RESP_QUERIES, respLen, segs, chunkBytes, stagingLen,
+			stagingLen + respLen, respLen <= stagingLen ? "true" : "false", buildUsecs, sendUsecs, stagedUsecs);
+	}
+	fflush(stdout);
+
+	sa_ServiceRecDelete();
+	vs_pool_free(&sm_pool, staging);
+	vs_pool_free(&sm_pool, hfiPorts);
+}
+
+void
+usage(void) {
+	fprintf(stderr, "smsabench [-t shape] [-r routing] [-k radix] [-T tiers] [-d dims] [-a switches] [-g links]\n");
+	fprintf(stderr, "          [-n switches] [-e hfis] [-l lmc] [-m groups] [-P queries] [-G queries]\n");
+	fprintf(stderr, "          [-D services] [-J groups] [-I subscribers] [-Q records] [-c]\n");
+	bench_fabric_usage();
+	fprintf(stderr, "    -P  replay this many PathRecord queries, without and with the PathRecord index\n");
+	fprintf(stderr, "    -G  replay this many unfiltered GETTABLE queries of each cached record type,\n");
+	fprintf(stderr, "        without and with the SA caches\n");
+	fprintf(stderr, "    -D  register this many ServiceRecords, query each once and age them\n");
+	fprintf(stderr, "    -J  have every HFI join and then leave this many multicast groups through the SA\n");
+	fprintf(stderr, "    -I  register this many trap subscriptions and time matching notices against them\n");
+	fprintf(stderr, "    -Q  answer GETTABLEs returning this many ServiceRecords and send them in RMPP segments\n");
+	fprintf(stderr, "    -c  CSV output instead of JSON lines\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[]) {
+	Status_t status;
+	int c, p;
+
+	while ((c = getopt(argc, argv, BENCH_FABRIC_OPTS "P:G:D:J:I:Q:c")) != -1) {
+		switch (c) {
+		case 'P':
+			pathQueries = atoi(optarg);
+			break;
+		case 'G':
+			tableQueries = atoi(optarg);
+			break;
+		case 'D':
+			serviceRecords = atoi(optarg);
+			break;
+		case 'J':
+			stormGroups = atoi(optarg);
+			break;
+		case 'I':
+			trapSubscribers = atoi(optarg);
+			break;
+		case 'Q':
+			responseRecords = atoi(optarg);
+			break;
+		case 'c':
+			csvOutput = 1;
+			break;
+		default:
+			if (!bench_fabric_option(c, optarg))
+				usage();
+			break;
+		}
+	}
+
+	if (!bench_fabric_check() || pathQueries < 0 || tableQueries < 0 || serviceRecords < 0 ||
+		stormGroups < 0 || trapSubscribers < 0 || responseRecords < 0 ||
+		!(pathQueries || tableQueries || serviceRecords || stormGroups || trapSubscribers || responseRecords))
+		usage();
+
+	// The SA answers from a routed fabric, so sweep it once first.
+	bench_init();
+	bench_build();
+	bench_create_mc_groups();
+	for (p = PHASE_DISCOVERY + 1; p < PHASE_COUNT; p++) {
+		if ((status = bench_run_phase((BenchPhase_t)p)) != VSTATUS_OK) {
+			fprintf(stderr, "smsabench: phase %s failed (status %d)\n", phaseNames[p], (int)status);
+			exit(2);
+		}
+	}
+
+	if (pathQueries)
+		bench_path_records(pathQueries);
+
+	if (tableQueries)
+		bench_sa_tables(tableQueries);
+
+	if (serviceRecords)
+		bench_service_records(serviceRecords);
+
+	if (stormGroups)
+		bench_mcast_storm(stormGroups);
+
+	if (trapSubscribers)
+		bench_trap_forwarding(trapSubscribers);
+
+	if (responseRecords)
+		bench_sa_response(responseRecords);
+
+	exit(0);
+}
@@ -0,0 +1,487 @@
+/* BEGIN_ICS_COPYRIGHT7 ****************************************
+
+Copyright (c) 2015-2020, Intel Corporation
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+** END_ICS_COPYRIGHT7   ****************************************/
+
+/* [ICS VERSION STRING: unknown] */
+//===========================================================================//
+//===========================================================================//
+//									     //
+// FILE NAME								     //
+//    smsastorm.c							     //
+//									     //
+// DESCRIPTION								     //
+//    Load generator for the SA request context table.  Replays synthetic  //
+//    query storms, as seen from thousands of clients at job launch,	     //
+//    through sa_main_reader_process() with handlers that stand in for     //
+//    the query processing and the replies, then acknowledges the	     //
+//    multi-packet responses through sa_cntxt_find() the way the SA	     //
+//    writer does.  Reports the cost per request and per ACK lookup and    //
+//    checks that every retransmitted request is recognised.		     //
+//    With -w, instead replays paced queries, a few of them expensive,	     //
+//    through the SA worker threads and reports throughput and latency    //
+//    for each worker count.						     //
+//									     //
+// DEPENDENCIES								     //
+//    sm_l.h								     //
+//    sa_l.h								     //
+//									     //
+//===========================================================================//
+
+#include "os_g.h"
+#include "ib_status.h"
+#include "ib_types.h"
+#include "ib_mad.h"
+#include "ib_sa.h"
+#include "sm_l.h"
+#include "sa_l.h"
+#include "cs_g.h"
+#include <time.h>
+#include <sched.h>
+
+extern	int	optind;
+extern	char	*optarg;
+
+#define TEST_POOL_SIZE		0x40000000
+
+typedef enum {
+	REQ_SINGLE,			// answered with one packet, context released at once
+	REQ_RMPP,			// multi-packet response in flight until acknowledged
+	REQ_GETMULTI,		// getMulti request still arriving
+} BenchReqType_t;
+
+static int			clients = 10000;
+static int			rounds = 8;
+static int			rmppPct = 50;
+static int			multiPct = 5;
+static int			dupPct = 20;
+static int			maxCntxt = 0;	// sa_max_cntxt, default 2 per client
+static uint32_t		seed = 1;
+static int			failures;
+
+static uint64_t		*tidBase;		// first TID of each client
+static uint8_t		*reqType;		// BenchReqType_t of each client's current request
+static sa_cntxt_t	**inFlight;		// context each client's response holds, if hashed
+static int			*order;			// client order of the current round
+static uint64_t		processed, continued, busy;
+
+#define MAX_WORKER_RUNS		16
+
+static int			workerRuns;		// number of -w worker counts
+static int			workerCounts[MAX_WORKER_RUNS];
+static int			rate;			// requests per second, 0 all at once
+static int			cheapUsecs = 10;
+static int			expensivePermille = 2;
+static int			expensiveUsecs = 5000;
+static uint64_t		*arrival;		// when each client's request of each round arrived
+static uint64_t		*latency;		// how long until it was processed
+static int			*lastRound;		// last round processed for each client
+static volatile uint64_t completed;
+
+static void
+usage(void) {
+	fprintf(stderr, "smsastorm [-n clients] [-r rounds] [-p rmpp%%] [-g getmulti%%] [-d dup%%] [-m contexts]\n");
+	fprintf(stderr, "smsastorm -w workers[,workers...] [-n clients] [-r rounds] [-a rate] [-c usecs] [-x permille] [-X usecs]\n");
+	fprintf(stderr, "    -n  clients querying at once (default 10000)\n");
+	fprintf(stderr, "    -r  queries per client (default 8)\n");
+	fprintf(stderr, "    -p  queries whose response takes several packets (default 50)\n");
+	fprintf(stderr, "    -g  queries that are getMulti requests (default 5)\n");
+	fprintf(stderr, "    -d  queries retransmitted while in progress (default 20)\n");
+	fprintf(stderr, "    -m  SA contexts, sa_max_cntxt (default 2 per client)\n");
+	fprintf(stderr, "    -w  SA worker threads to compare, 0 processes on the reader thread\n");
+	fprintf(stderr, "    -a  queries arriving per second (default 0, all at once)\n");
+	fprintf(stderr, "    -c  time to process an ordinary query (default 10 usecs)\n");
+	fprintf(stderr, "    -x  queries per thousand that are expensive (default 2)\n");
+	fprintf(stderr, "    -X  time to process an expensive query (default 5000 usecs)\n");
+	exit(1);
+}
+
+static uint32_t
+next_random(void)
+{
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+static uint64_t
+now_nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void
+check(int ok, const char *what, int client)
+{
+	if (!ok && failures++ < 20)
+		fprintf(stderr, "smsastorm: FAIL %s (client %d)\n", what, client);
+}
+
+// What sa_process_mad() leaves behind: sa_send_multi() reserves the context
+// of a response that needs more than one packet, and a getMulti request
+// reserves its context until the whole request has arrived.
+static Status_t
+bench_process(Mai_t *maip, sa_cntxt_t *sa_cntxt)
+{
+	int client = maip->addrInfo.slid - 1;
+
+	processed++;
+	if (reqType[client] == REQ_SINGLE)
+		return VSTATUS_OK;
+	if (reqType[client] == REQ_GETMULTI)
+		sa_cntxt->reqInProg = 1;
+	sa_cntxt_reserve(sa_cntxt);
+	inFlight[client] = sa_cntxt;
+	return VSTATUS_OK;
+}
+
+static Status_t
+bench_getmulti(Mai_t *maip, sa_cntxt_t *sa_cntxt)
+{
+	int client = maip->addrInfo.slid - 1;
+
+	continued++;
+	check(sa_cntxt == inFlight[client], "getMulti segment found another context", client);
+	return VSTATUS_OK;
+}
+
+static Status_t
+bench_reply(Mai_t *maip, sa_cntxt_t *sa_cntxt)
+{
+	busy++;
+	return VSTATUS_OK;
+}
+
+static const SAReaderOps_t benchOps = {
+	bench_process,
+	bench_getmulti,
+	bench_reply,
+};
+
+static void
+bench_request(Mai_t *maip, int client, int round)
+{
+	memset(maip, 0, sizeof(Mai_t));
+	maip->base.bversion = STL_BASE_VERSION;
+	maip->base.mclass = MAD_CV_SUBN_ADM;
+	maip->base.method = reqType[client] == REQ_GETMULTI ? SA_CM_GETMULTI : SA_CM_GETTABLE;
+	maip->base.aid = SA_PATH_RECORD;
+	maip->base.tid = tidBase[client] + round;
+	maip->addrInfo.slid = client + 1;
+	maip->addrInfo.dlid = clients + 1;
+}
+
+// Stand-in for the work of a query, such as a wildcard PathRecord query
+// for the expensive ones.  Which queries are expensive depends only on the
+// client and round, so every worker count replays the same load.
+static Status_t
+worker_process(Mai_t *maip, sa_cntxt_t *sa_cntxt)
+{
+	int client = maip->addrInfo.slid - 1;
+	int round = (int)(maip->base.tid - tidBase[client]);
+	uint32_t hash = (uint32_t)(client * 2654435761u) ^ (uint32_t)(round * 40503u);
+	uint64_t until = now_nsecs() + 1000ull *
+		((hash * 2246822519u >> 8) % 1000 < (uint32_t)expensivePermille ? expensiveUsecs : cheapUsecs);
+
+	while (now_nsecs() < until)
+		;
+	// a client's queries all go to one worker, so this needs no lock
+	check(round > lastRound[client], "query processed out of order", client);
+	lastRound[client] = round;
+	latency[client * rounds + round] = now_nsecs() - arrival[client * rounds + round];
+	__sync_fetch_and_add(&completed, 1);
+	return VSTATUS_OK;
+}
+
+static const SAReaderOps_t workerOps = {
+	worker_process,
+	bench_getmulti,
+	bench_reply,
+};
+
+static int
+compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void
+run_workers(int workers)
+{
+	Mai_t mad;
+	Status_t status;
+	uint64_t start, next, elapsed, total = (uint64_t)clients * rounds, retries = 0;
+	int round, i, j, c;
+
+	for (c = 0; c < clients; c++) {
+		lastRound[c] = -1;
+		reqType[c] = REQ_SINGLE;
+	}
+	completed = 0;
+	if (workers && (status = sa_workers_start(workers, 0, &workerOps)) != VSTATUS_OK) {
+		fprintf(stderr, "smsastorm: cannot start %d SA workers (status %d)\n", workers, (int)status);
+		exit(2);
+	}
+
+	// The reader: queries arrive at the paced rate and are processed
+	// inline or handed to the client's worker, retried while it is busy.
+	start = now_nsecs();
+	for (round = 0; round < rounds; round++) {
+		for (i = 0; i < clients; i++) {
+			j = next_random() % (i + 1);
+			order[i] = order[j];
+			order[j] = i;
+		}
+		for (i = 0; i < clients; i++) {
+			c = order[i];
+			next = start;
+			if (rate)
+				next += ((uint64_t)round * clients + i) * 1000000000ull / rate;
+			// sleep rather than spin, the workers may need this CPU
+			if (now_nsecs() < next) {
+				struct timespec ts = { next / 1000000000ull, next % 1000000000ull };
+
+				clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+			}
+			arrival[c * rounds + round] = next;
+			bench_request(&mad, c, round);
+			if (!workers) {
+				sa_main_reader_process(&mad, 0, &workerOps);
+				continue;
+			}
+			while (sa_workers_submit(&mad) == VSTATUS_BUSY) {
+				retries++;
+				sched_yield();
+			}
+		}
+	}
+	while (completed < total)
+		sched_yield();
+	elapsed = now_nsecs() - start;
+	if (workers)
+		sa_workers_stop();
+
+	qsort(latency, total, sizeof(uint64_t), compare_u64);
+	printf("%2d workers: %8"PRIu64" queries/s, latency p50 %8"PRIu64" us, p99 %8"PRIu64" us, p99.9 %8"PRIu64" us, max %8"PRIu64" us, %"PRIu64" retried\n",
+		workers, total * 1000000000ull / elapsed, latency[total / 2] / 1000,
+		latency[total * 99 / 100] / 1000, latency[total * 999 / 1000] / 1000,
+		latency[total - 1] / 1000, retries);
+}
+
+static void
+run_storm(void)
+{
+	Mai_t mad;
+	sa_cntxt_t *sa_cntxt;
+	uint64_t start, readerNsecs = 0, ackNsecs = 0, requests = 0, acks = 0;
+	uint64_t dups = 0, expectDups = 0, expectContinued = 0, lastProcessed, lastContinued, lastBusy;
+	uint32_t buckets, hashed, pooled, peakHashed = 0;
+	int round, i, j, c, r;
+
+	for (round = 0; round < rounds; round++) {
+		for (i = 0; i < clients; i++) {
+			j = next_random() % (i + 1);
+			order[i] = order[j];
+			order[j] = i;
+			r = next_random() % 100;
+			reqType[i] = r < multiPct ? REQ_GETMULTI : r < multiPct + rmppPct ? REQ_RMPP : REQ_SINGLE;
+			inFlight[i] = NULL;
+		}
+
+		// The burst: every client queries, some retransmit before the
+		// response or the rest of their getMulti request has arrived.
+		for (i = 0; i < clients; i++) {
+			c = order[i];
+			bench_request(&mad, c, round);
+			start = now_nsecs();
+			sa_main_reader_process(&mad, 0, &benchOps);
+			readerNsecs += now_nsecs() - start;
+			requests++;
+		}
+		sa_cntxt_table_info(&buckets, &hashed, &pooled);
+		peakHashed = MAX(peakHashed, hashed);
+		for (i = 0; i < clients; i++) {
+			c = order[i];
+			if ((int)(next_random() % 100) >= dupPct)
+				continue;
+			lastProcessed = processed;
+			lastContinued = continued;
+			lastBusy = busy;
+			bench_request(&mad, c, round);
+			start = now_nsecs();
+			sa_main_reader_process(&mad, 0, &benchOps);
+			readerNsecs += now_nsecs() - start;
+			requests++;
+			if (!inFlight[c])
+				continue;
+			if (reqType[c] == REQ_GETMULTI) {
+				expectContinued++;
+				check(continued == lastContinued + 1, "getMulti segment not continued", c);
+			} else {
+				expectDups++;
+				dups += processed == lastProcessed && busy == lastBusy;
+				check(processed == lastProcessed, "retransmission processed again", c);
+			}
+		}
+
+		// The writer side: each response in flight is acknowledged and
+		// completes, releasing the context reserved for it.
+		for (i = 0; i < clients; i++) {
+			c = order[i];
+			if (!inFlight[c])
+				continue;
+			bench_request(&mad, c, round);
+			mad.base.method = SA_CM_GETTABLE_RESP;
+			start = now_nsecs();
+			sa_cntxt = sa_cntxt_find(&mad);
+			ackNsecs += now_nsecs() - start;
+			acks++;
+			check(sa_cntxt == inFlight[c], "ACK found another context", c);
+			if (sa_cntxt)
+				sa_cntxt_release(sa_cntxt);
+			sa_cntxt_release(inFlight[c]);
+		}
+		sa_cntxt_table_info(&buckets, &hashed, &pooled);
+		check(hashed == 0, "contexts left hashed after the round", hashed);
+	}
+
+	sa_cntxt_table_info(&buckets, &hashed, &pooled);
+	printf("storm: %d clients, %d rounds, %"PRIu64" requests: reader %"PRIu64" ns/request, ACK lookup %"PRIu64" ns\n",
+		clients, rounds, requests, requests ? readerNsecs / requests : 0, acks ? ackNsecs / acks : 0);
+	printf("contexts: %u buckets, peak %u hashed, %u of %u pooled, %"PRIu64" BUSY\n",
+		buckets, peakHashed, pooled, sa_max_cntxt, busy);
+	check(continued == expectContinued, "getMulti segments continued", (int)continued);
+	check(dups == expectDups, "duplicates detected", (int)dups);
+	printf("duplicates: %"PRIu64" of %"PRIu64" detected, %"PRIu64" getMulti segments: %s\n",
+		dups, expectDups, continued, failures ? "FAIL" : "PASS");
+}
+
+//
+//  main utility function
+//
+int main(int argc, char *argv[]) {
+	Status_t status;
+	int c;
+
+	char *list;
+
+	while ((c = getopt(argc, argv, "n:r:p:g:d:m:w:a:c:x:X:")) != -1) {
+		switch (c) {
+		case 'n':
+			clients = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 'p':
+			rmppPct = atoi(optarg);
+			break;
+		case 'g':
+			multiPct = atoi(optarg);
+			break;
+		case 'd':
+			dupPct = atoi(optarg);
+			break;
+		case 'm':
+			maxCntxt = atoi(optarg);
+			break;
+		case 'w':
+			for (list = strtok(optarg, ","); list; list = strtok(NULL, ",")) {
+				if (workerRuns == MAX_WORKER_RUNS || atoi(list) < 0)
+					usage();
+				workerCounts[workerRuns++] = atoi(list);
+			}
+			break;
+		case 'a':
+			rate = atoi(optarg);
+			break;
+		case 'c':
+			cheapUsecs = atoi(optarg);
+			break;
+		case 'x':
+			expensivePermille = atoi(optarg);
+			break;
+		case 'X':
+			expensiveUsecs = atoi(optarg);
+			break;
+		default:
+			usage();
+			break;
+		}
+	}
+	if (clients < 1 || clients > 0xBFFFFE || rounds < 1 || rmppPct < 0 || multiPct < 0 ||
+		rmppPct + multiPct > 100 || dupPct < 0 || dupPct > 100 || maxCntxt < 0 ||
+		rate < 0 || cheapUsecs < 0 || expensivePermille < 0 || expensiveUsecs < 0)
+		usage();
+
+	memset(&sm_pool, 0, sizeof(sm_pool));
+	if ((status = vs_pool_create(&sm_pool, 0, (uint8_t *)"sm_pool", NULL, TEST_POOL_SIZE)) != VSTATUS_OK) {
+		fprintf(stderr, "smsastorm: cannot create SM pool (status %d)\n", (int)status);
+		exit(2);
+	}
+	// as sm_main() sizes it from the subnet size
+	sa_max_cntxt = maxCntxt ? maxCntxt : 2 * clients;
+	if ((status = sa_cntxt_init()) != VSTATUS_OK) {
+		fprintf(stderr, "smsastorm: cannot initialize SA contexts (status %d)\n", (int)status);
+		exit(2);
+	}
+	tidBase = malloc(sizeof(uint64_t) * clients);
+	reqType = malloc(clients);
+	inFlight = malloc(sizeof(sa_cntxt_t *) * clients);
+	order = malloc(sizeof(int) * clients);
+	if (!tidBase || !reqType || !inFlight || !order) {
+		fprintf(stderr, "smsastorm: cannot allocate client state\n");
+		exit(2);
+	}
+	// TIDs carry the client's agent in the upper half and count up from
+	// an arbitrary start in the lower one
+	for (c = 0; c < clients; c++)
+		tidBase[c] = ((uint64_t)(next_random() & 0xff) << 32) | next_random();
+
+	if (!workerRuns) {
+		run_storm();
+		exit(failures ? 3 : 0);
+	}
+
+	arrival = malloc(sizeof(uint64_t) * clients * rounds);
+	latency = malloc(sizeof(uint64_t) * clients * rounds);
+	lastRound = malloc(sizeof(int) * clients);
+	if (!arrival || !latency || !lastRound) {
+		fprintf(stderr, "smsastorm: cannot allocate client state\n");
+		exit(2);
+	}
+	printf("workers: %d clients, %d rounds, %d queries/s, %d us per query, %d per 1000 taking %d us\n",
+		clients, rounds, rate, cheapUsecs, expensivePermille, expensiveUsecs);
+	for (c = 0; c < workerRuns; c++)
+		run_workers(workerCounts[c]);
+	printf("per-client order: %s\n", failures ? "FAIL" : "PASS");
+	exit(failures ? 3 : 0);
+}